@@ -0,0 +1,179 @@
+/*
+  assetindex.cpp - esp3d static files index class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "assetindex.h"
+#include "webinterface.h"
+#include "httprange.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "SPIFFS.h"
+#endif
+
+ASSETINDEX_CLASS asset_index;
+
+//FNV-1a
+static uint32_t hash_bytes(uint32_t hash, const uint8_t * data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+//name has a part of at least 8 hex digits with letters and digits, like app.1a2b3c4d.js
+static bool is_fingerprinted(const String & uri)
+{
+    int start = uri.lastIndexOf('/') + 1;
+    int len = 0;
+    bool digit = false;
+    bool letter = false;
+    for (int i = start; i <= (int)uri.length(); i++) {
+        char c = (i < (int)uri.length()) ? uri[i] : '.';
+        if ((c == '.') || (c == '-') || (c == '_')) {
+            if ((len >= 8) && digit && letter) {
+                return true;
+            }
+            len = 0;
+            digit = false;
+            letter = false;
+        } else if (isdigit(c)) {
+            digit = true;
+            len++;
+        } else if (((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'))) {
+            letter = true;
+            len++;
+        } else {
+            //not hex, so skip until next separator
+            len = -1024;
+        }
+    }
+    return false;
+}
+
+//gzip version is preferred, explicit query of gzip file gets it as is
+dir_node * ASSETINDEX_CLASS::find(const String & uri, bool & gzip)
+{
+    dir_node * node = dir_index.find(uri + ".gz");
+    gzip = (node != NULL) && !node->is_dir;
+    if (!gzip) {
+        node = dir_index.find(uri);
+    }
+    return (node && !node->is_dir) ? node : NULL;
+}
+
+//hash content with file already open, then rewind it
+void ASSETINDEX_CLASS::compute_hash(dir_node * node, FS_FILE & file)
+{
+    uint8_t buf[256];
+    uint32_t hash = 2166136261UL;
+    int len;
+    while ((len = file.read(buf, sizeof(buf))) > 0) {
+        hash = hash_bytes(hash, buf, len);
+    }
+    file.seek(0, fs::SeekSet);
+    node->hash = hash;
+    node->hashed = true;
+}
+
+//send length bytes from start, file is not given to streamFile so range is handled
+//the same way on both cores
+static void send_file(FS_FILE & file, const String & uri, int code, size_t start, size_t length)
+{
+    String content_type = web_interface->getContentType(uri);
+    web_interface->web_server.sendHeader("Accept-Ranges", "bytes");
+    if (code == 206) {
+        web_interface->web_server.sendHeader("Content-Range", "bytes " + String(start) + "-" + String(start + length - 1) + "/" + String(file.size()));
+    }
+    if (String(file.name()).endsWith(".gz") && (content_type != "application/x-gzip") && (content_type != "application/octet-stream")) {
+        web_interface->web_server.sendHeader("Content-Encoding", "gzip");
+    }
+    web_interface->web_server.setContentLength(length);
+    web_interface->web_server.send(code, content_type, "");
+    uint8_t buf[512];
+    while ((length > 0) && web_interface->web_server.client().connected()) {
+        size_t nb = (length < sizeof(buf)) ? length : sizeof(buf);
+        int len = file.read(buf, nb);
+        if (len <= 0) {
+            break;
+        }
+        web_interface->web_server.client().write(buf, len);
+        length -= len;
+        yield();
+    }
+}
+
+//send file with ETag, or 304 if browser has it already
+//a Range request gets only asked bytes, unless If-Range says file changed
+bool ASSETINDEX_CLASS::serve(const String & uri)
+{
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        bool gzip;
+        dir_node * node = find(uri, gzip);
+        if (!node) {
+            return false;
+        }
+        FS_FILE file = SPIFFS.open(gzip ? uri + ".gz" : uri, SPIFFS_FILE_READ);
+        //file changed since index was built
+        if (!file || (file.size() != node->size)) {
+            if (file) {
+                file.close();
+            }
+            dir_index.invalidate();
+            continue;
+        }
+        if (!node->hashed) {
+            compute_hash(node, file);
+        }
+        char etag[22];
+        snprintf(etag, sizeof(etag), "\"%08x-%x\"", (unsigned int)node->hash, (unsigned int)node->size);
+        web_interface->web_server.sendHeader("ETag", etag);
+        web_interface->web_server.sendHeader("Cache-Control", is_fingerprinted(uri) ? ASSET_IMMUTABLE_CACHE : "no-cache");
+        if (web_interface->web_server.header("If-None-Match").indexOf(etag) != -1) {
+            file.close();
+            web_interface->web_server.send(304);
+            return true;
+        }
+        size_t start;
+        size_t length;
+        int code = 200;
+        String if_range = web_interface->web_server.header("If-Range");
+        if ((if_range.length() == 0) || (if_range == etag)) {
+            code = parse_range(web_interface->web_server.header("Range"), node->size, start, length);
+        } else {
+            start = 0;
+            length = node->size;
+        }
+        if (code == 416) {
+            file.close();
+            web_interface->web_server.sendHeader("Content-Range", "bytes */" + String(node->size));
+            web_interface->web_server.send(416, "text/plain", "");
+            return true;
+        }
+        //file may not be at start after hashing, and 206 must give asked bytes only
+        if (!file.seek(start, fs::SeekSet)) {
+            file.close();
+            web_interface->web_server.send(500, "text/plain", "");
+            return true;
+        }
+        send_file(file, uri, code, start, length);
+        file.close();
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+/*
+  assetindex.h - esp3d static files index class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ASSETINDEX_h
+#define ASSETINDEX_h
+#include <Arduino.h>
+#include "config.h"
+#ifndef FS_NO_GLOBALS
+#define FS_NO_GLOBALS
+#endif
+#include <FS.h>
+#include "dirindex.h"
+
+//cache duration for files with content hash in name, like app.1a2b3c4d.js
+#define ASSET_IMMUTABLE_CACHE "max-age=31536000, immutable"
+
+//files are found in dir_index, which also keeps their ETag, so
+//each request is resolved without exists() calls or another copy of names
+class ASSETINDEX_CLASS
+{
+public:
+    bool serve(const String & uri);
+private:
+    dir_node * find(const String & uri, bool & gzip);
+    void compute_hash(dir_node * node, FS_FILE & file);
+};
+
+extern ASSETINDEX_CLASS asset_index;
+
+#endif
@@ -22,14 +22,133 @@
 #include "bridge.h"
 #include "command.h"
 #include "webinterface.h"
+#include "ringbuffer.h"
+#include "serialout.h"
+#include "webterminal.h"
+#include "responsewriter.h"
+#ifdef ARDUINO_ARCH_ESP32
+//ESP32 client has no availableForWrite(), bundled WebServer library tells it
+#include <ClientRoom.h>
+#endif
 
 #ifdef TCP_IP_DATA_FEATURE
 WiFiServer * data_server;
 WiFiClient serverClients[MAX_SRV_CLIENTS];
+//last time each client could take data
+static uint32_t tcp_last_send[MAX_SRV_CLIENTS];
+//raw clients are a plain pipe to UART, their data are not parsed
+static bool tcp_raw[MAX_SRV_CLIENTS];
+#ifdef TCP_RAW_MODE
+static bool tcp_raw_default = true;
+#else
+static bool tcp_raw_default = false;
+#endif
+//client whose data are being parsed
+static int8_t tcp_current = -1;
+//last data of client did not end a line
+static bool tcp_line_open[MAX_SRV_CLIENTS];
+
+//room in client send buffer, so a slow client never blocks loop
+static size_t tcp_room(uint8_t i, size_t len)
+{
+#ifdef ARDUINO_ARCH_ESP32
+    size_t room = clientRoom(serverClients[i]);
+#else
+    size_t room = serverClients[i].availableForWrite();
+#endif
+    return (room < len) ? room : len;
+}
+
+//queue client data, realtime lines on urgent lane so they pass lines queued before
+//only a line fully read from its start can be realtime, else it is interactive
+static void tcp_queue(uint8_t i, uint8_t * data, size_t len)
+{
+    size_t run = 0;
+    size_t start = 0;
+    for (size_t pos = 0; pos < len; pos++) {
+        if (data[pos] != '\n') {
+            continue;
+        }
+        size_t end = pos + 1;
+        bool urgent = false;
+        if (!tcp_line_open[i] && (serial_out.room(PRIO_URGENT) >= (end - start))) {
+            data[pos] = 0;
+            urgent = SERIALOUT_CLASS::is_realtime((const char *)data + start);
+            data[pos] = '\n';
+        }
+        if (urgent) {
+            serial_out.queue(data + run, start - run, PRIO_INTERACTIVE);
+            serial_out.queue(data + start, end - start, PRIO_URGENT);
+            run = end;
+        }
+        tcp_line_open[i] = false;
+        start = end;
+    }
+    serial_out.queue(data + run, len - run, PRIO_INTERACTIVE);
+    if (start < len) {
+        tcp_line_open[i] = true;
+    }
+}
+
+//UART is given to raw clients while one is connected
+static bool tcp_raw_connected()
+{
+    for(uint8_t i = 0; i < MAX_SRV_CLIENTS; i++) {
+        if (tcp_raw[i] && serial_ring.attached(RING_READER_TCP + i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void tcp_drop_client(uint8_t i)
+{
+    if (serverClients[i]) {
+        serverClients[i].stop();
+    }
+    serial_ring.detach(RING_READER_TCP + i);
+}
+
+//send what client can take from its ring reader
+static bool tcp_flush_client(uint8_t i)
+{
+    bool sent = false;
+    const uint8_t * data;
+    size_t len;
+    uint8_t reader = RING_READER_TCP + i;
+    if (!serial_ring.attached(reader)) {
+        return false;
+    }
+    if (!serverClients[i] || !serverClients[i].connected()) {
+        tcp_drop_client(i);
+        return false;
+    }
+    while ((len = serial_ring.peek(reader, &data)) > 0) {
+        len = tcp_room(i, len);
+        if (len == 0) {
+            break;
+        }
+        size_t nb = serverClients[i].write(data, len);
+        if (nb == 0) {
+            break;
+        }
+        serial_ring.consume(reader, nb);
+        tcp_last_send[i] = millis();
+        sent = true;
+    }
+    if (serial_ring.available(reader) == 0) {
+        tcp_last_send[i] = millis();
+    }
+#ifdef TCP_EVICT_SLOW_CLIENTS
+    else if ((millis() - tcp_last_send[i]) > TCP_CLIENT_EVICT_TIMEOUT) {
+        LOG("Slow TCP client disconnected\r\n")
+        tcp_drop_client(i);
+    }
+#endif
+    return sent;
+}
 #endif
 
-bool BRIDGE::header_sent = false;
-String BRIDGE::buffer_web = "";
 void BRIDGE::print (const __FlashStringHelper *data, tpipe output)
 {
     String tmp = data;
@@ -43,35 +162,50 @@ void BRIDGE::print (const char * data, tpipe output)
 {
     switch(output) {
     case SERIAL_PIPE:
-        header_sent = false;
-        ESP_SERIAL_OUT.print(data);
+        serial_out.print(data);
         break;
 #ifdef TCP_IP_DATA_FEATURE
     case TCP_PIPE:
-        header_sent = false;
         BRIDGE::send2TCP(data);
         break;
+#endif
+#ifdef WS_TERMINAL_FEATURE
+    case WS_PIPE:
+        WEBTERMINAL::print(data);
+        break;
 #endif
     case WEB_PIPE:
-        if (!header_sent) {
-            web_interface->web_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
-            web_interface->web_server.sendHeader("Content-Type","text/html");
-            web_interface->web_server.sendHeader("Cache-Control","no-cache");
-            web_interface->web_server.send(200);
-            header_sent = true;
-        }
-        buffer_web+=data;
-        if (buffer_web.length() > 1200) {
-            //send data
-            web_interface->web_server.sendContent(buffer_web);
-            //reset buffer
-            buffer_web="";
+        if (!response_writer.started()) {
+            response_writer.begin(200, "text/html");
         }
+        response_writer.print(data);
         break;
     default:
         break;
     }
 }
+size_t PIPEPRINT_CLASS::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+//pipes take strings, so data goes by small pieces
+size_t PIPEPRINT_CLASS::write(const uint8_t * data, size_t len)
+{
+    char buf[65];
+    size_t done = 0;
+    while (done < len) {
+        size_t nb = len - done;
+        if (nb > (sizeof(buf) - 1)) {
+            nb = sizeof(buf) - 1;
+        }
+        memcpy(buf, data + done, nb);
+        buf[nb] = 0;
+        BRIDGE::print(buf, _output);
+        done += nb;
+    }
+    return done;
+}
 void BRIDGE::println (const __FlashStringHelper *data, tpipe output)
 {
     BRIDGE::print(data,output);
@@ -100,25 +234,22 @@ void BRIDGE::flush (tpipe output)
 {
     switch(output) {
     case SERIAL_PIPE:
-        ESP_SERIAL_OUT.flush();
+        serial_out.flush();
         break;
 #ifdef TCP_IP_DATA_FEATURE
     case TCP_PIPE:
         break;
+#endif
+#ifdef WS_TERMINAL_FEATURE
+    case WS_PIPE:
+        break;
 #endif
     case WEB_PIPE:
-        if(header_sent) {
-            //send data
-            web_interface->web_server.sendContent(buffer_web);
-            //close line
-            web_interface->web_server.sendContent("");
-        }
+        response_writer.end();
         break;
     default:
         break;
     }
-    header_sent = false;
-    buffer_web = String();
 }
 
 
@@ -134,73 +265,162 @@ void BRIDGE::send2TCP(String data)
 }
 void BRIDGE::send2TCP(const char * data)
 {
+    size_t len = strlen(data);
     for(uint8_t i = 0; i < MAX_SRV_CLIENTS; i++) {
-        if (serverClients[i] && serverClients[i].connected()) {
-            serverClients[i].write(data, strlen(data));
+        if (serverClients[i] && serverClients[i].connected() && !tcp_raw[i]) {
+            //client which cannot take it misses it, like serial data
+            if (tcp_room(i, len) == len) {
+                serverClients[i].write(data, len);
+            }
             delay(0);
         }
     }
 }
+
+//from data port: only the client which sent command, else all clients
+void BRIDGE::setRawMode(bool raw, tpipe origin)
+{
+    if ((origin == TCP_PIPE) && (tcp_current >= 0)) {
+        tcp_raw[tcp_current] = raw;
+        return;
+    }
+    tcp_raw_default = raw;
+    for(uint8_t i = 0; i < MAX_SRV_CLIENTS; i++) {
+        tcp_raw[i] = raw;
+    }
+}
+
+bool BRIDGE::isRawMode(tpipe origin)
+{
+    if ((origin == TCP_PIPE) && (tcp_current >= 0)) {
+        return tcp_raw[tcp_current];
+    }
+    return tcp_raw_default;
+}
 #endif
 
+//readers which are always fed by serial ring
+void BRIDGE::begin()
+{
+    serial_ring.attach(RING_READER_COMMAND);
+}
+
 bool BRIDGE::processFromSerial2TCP()
 {
-    uint8_t i;
+    bool data_read = false;
+    uint8_t * data;
     //check UART for data
-    if(ESP_SERIAL_OUT.available()) {
-        size_t len = ESP_SERIAL_OUT.available();
-        uint8_t sbuf[len];
-        ESP_SERIAL_OUT.readBytes(sbuf, len);
-#ifdef TCP_IP_DATA_FEATURE
-          if (WiFi.getMode()!=WIFI_OFF ) {
-            //push UART data to all connected tcp clients
-            for(i = 0; i < MAX_SRV_CLIENTS; i++) {
-                if (serverClients[i] && serverClients[i].connected()) {
-                    serverClients[i].write(sbuf, len);
-                    delay(0);
-                }
+    size_t len = ESP_SERIAL_OUT.available();
+    //read UART directly in ring, at most twice due to wrap
+    while (len > 0) {
+        size_t space = serial_ring.write_space(&data);
+        if (space == 0) {
+            //ring is full so let readers free some room
+            if (!dispatchSerial()) {
+                break;
             }
+            continue;
         }
+        if (space > len) {
+            space = len;
+        }
+        size_t nb = ESP_SERIAL_OUT.readBytes(data, space);
+        serial_ring.commit(nb);
+        if (nb == 0) {
+            break;
+        }
+        data_read = true;
+        len -= nb;
+    }
+    //process data if any
+    dispatchSerial();
+    return data_read;
+}
+
+//give serial ring data to tcp and terminal clients and command parser
+bool BRIDGE::dispatchSerial()
+{
+    bool done = false;
+    const uint8_t * data;
+    size_t len;
+#ifdef TCP_IP_DATA_FEATURE
+    //each tcp client reads at its own pace, a slow one only loses its data
+    for(uint8_t i = 0; i < MAX_SRV_CLIENTS; i++) {
+        if (tcp_flush_client(i)) {
+            done = true;
+        }
+    }
 #endif
-        //process data if any
-        COMMAND::read_buffer_serial(sbuf, len);
-        return true;
-    } else {
-        return false;
+#ifdef WS_TERMINAL_FEATURE
+    if (WEBTERMINAL::dispatch()) {
+        done = true;
     }
+#endif
+    //answers are parsed in raw mode too, so oks of lines already sent are counted
+    while ((len = serial_ring.peek(RING_READER_COMMAND, &data)) > 0) {
+        COMMAND::read_buffer_serial(data, len);
+        serial_ring.consume(RING_READER_COMMAND, len);
+        done = true;
+    }
+    return done;
 }
 #ifdef TCP_IP_DATA_FEATURE
 void BRIDGE::processFromTCP2Serial()
 {
-    uint8_t i,data;
+    uint8_t i;
+    uint8_t buf[TCP_TO_SERIAL_BLOCK];
     //check if there are any new clients
     if (data_server->hasClient()) {
         for(i = 0; i < MAX_SRV_CLIENTS; i++) {
             //find free/disconnected spot
             if (!serverClients[i] || !serverClients[i].connected()) {
-                if(serverClients[i]) {
-                    serverClients[i].stop();
-                }
+                tcp_drop_client(i);
                 serverClients[i] = data_server->available();
-                continue;
+                //client only gets serial data received from now
+                serial_ring.attach(RING_READER_TCP + i, true);
+                tcp_last_send[i] = millis();
+                tcp_raw[i] = tcp_raw_default;
+                tcp_line_open[i] = false;
+                break;
             }
         }
         //no free/disconnected spot so reject
-        WiFiClient serverClient = data_server->available();
-        serverClient.stop();
+        if (i == MAX_SRV_CLIENTS) {
+            WiFiClient serverClient = data_server->available();
+            serverClient.stop();
+        }
     }
+    //raw client has UART alone, other producers wait in their lanes
+    serial_out.raw(tcp_raw_connected());
     //check clients for data
-    //to avoid any pollution if Uploading file to SDCard
-    if ((web_interface->blockserial) == false) {
-        for(i = 0; i < MAX_SRV_CLIENTS; i++) {
-            if (serverClients[i] && serverClients[i].connected()) {
-                if(serverClients[i].available()) {
-                    //get data from the tcp client and push it to the UART
-                    while(serverClients[i].available()) {
-                        data = serverClients[i].read();
-                        ESP_SERIAL_OUT.write(data);
-                        COMMAND::read_buffer_tcp(data);
-                    }
+    //during SD upload interactive lane is held, so data waits in tcp buffer
+    for(i = 0; i < MAX_SRV_CLIENTS; i++) {
+        if (serverClients[i] && serverClients[i].connected()) {
+            //get data from the tcp client and queue it for the UART by blocks
+            //what queue cannot take now stays in tcp buffer
+            size_t len;
+            while ((len = serverClients[i].available()) > 0) {
+                size_t room = tcp_raw[i] ? serial_out.raw_room() : serial_out.room(PRIO_INTERACTIVE);
+                if (room == 0) {
+                    break;
+                }
+                if (len > room) {
+                    len = room;
+                }
+                if (len > sizeof(buf)) {
+                    len = sizeof(buf);
+                }
+                len = serverClients[i].read(buf, len);
+                if (len == 0) {
+                    break;
+                }
+                if (tcp_raw[i]) {
+                    serial_out.write_raw(buf, len);
+                } else {
+                    tcp_queue(i, buf, len);
+                    tcp_current = i;
+                    COMMAND::read_buffer_tcp(buf, len);
+                    tcp_current = -1;
                 }
             }
         }
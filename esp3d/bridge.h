@@ -29,9 +29,9 @@ extern WiFiServer * data_server;
 class BRIDGE
 {
 public:
-    static bool header_sent;
-    static String buffer_web;
+    static void begin();
     static bool processFromSerial2TCP();
+    static bool dispatchSerial();
     static void print (const __FlashStringHelper *data, tpipe output);
     static void print (String & data, tpipe output);
     static void print (const char * data, tpipe output);
@@ -44,6 +44,20 @@ public:
     static void send2TCP(const __FlashStringHelper *data);
     static void send2TCP(String data);
     static void send2TCP(const char * data);
+    static void setRawMode(bool raw, tpipe origin);
+    static bool isRawMode(tpipe origin);
 #endif
 };
+
+//Print on a pipe, so a writer can stream to any of them
+class PIPEPRINT_CLASS : public Print
+{
+public:
+    PIPEPRINT_CLASS(tpipe output) : _output(output) {};
+    size_t write(uint8_t c);
+    size_t write(const uint8_t * data, size_t len);
+    using Print::write;
+private:
+    tpipe _output;
+};
 #endif
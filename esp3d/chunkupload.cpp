@@ -0,0 +1,340 @@
+/*
+  chunkupload.cpp - esp3d resumable chunked upload class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "chunkupload.h"
+#include "webinterface.h"
+#include "serialout.h"
+#include "printjob.h"
+#include "dirindex.h"
+#include "sdupload.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "SPIFFS.h"
+#endif
+
+CHUNKUPLOAD_CLASS chunk_upload;
+
+//CRC32 of zlib, one nibble at once to keep table small
+static const uint32_t crc_table[16] PROGMEM = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+uint32_t CHUNKUPLOAD_CLASS::crc32(uint32_t crc, const uint8_t * data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = pgm_read_dword(&crc_table[crc & 0x0f]) ^ (crc >> 4);
+        crc = pgm_read_dword(&crc_table[crc & 0x0f]) ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+//Constructor
+CHUNKUPLOAD_CLASS::CHUNKUPLOAD_CLASS()
+{
+    _target = CHUNK_TARGET_SPIFFS;
+    _offset = 0;
+    _total = 0;
+    _crc = 0;
+    _buffer = NULL;
+    _len = 0;
+    _has_result = false;
+    _code = 0;
+    _status = NULL;
+    _committed = 0;
+    _sd_active = false;
+    _sd_total = 0;
+    _sd_last = 0;
+}
+
+//Destructor
+CHUNKUPLOAD_CLASS::~CHUNKUPLOAD_CLASS()
+{
+    release();
+}
+
+void CHUNKUPLOAD_CLASS::release()
+{
+    if (_buffer) {
+        free(_buffer);
+        _buffer = NULL;
+    }
+    _len = 0;
+}
+
+void CHUNKUPLOAD_CLASS::set_result(int code, const char * status)
+{
+    _code = code;
+    _status = status;
+    _has_result = true;
+}
+
+bool CHUNKUPLOAD_CLASS::get_result(int & code, const char * & status, uint32_t & offset)
+{
+    if (!_has_result) {
+        return false;
+    }
+    code = _code;
+    status = _status;
+    offset = _committed;
+    _has_result = false;
+    return true;
+}
+
+//SPIFFS: size of .part file, SD: what was given to printer upload if still running
+uint32_t CHUNKUPLOAD_CLASS::committed(tchunk_target target, const String & path)
+{
+    if (target == CHUNK_TARGET_SD) {
+        return (_sd_active && sd_upload.active() && (sd_upload.filename() == path)) ? sd_upload.received() : 0;
+    }
+    uint32_t size = 0;
+    FS_FILE part = SPIFFS.open(path + CHUNK_UPLOAD_PART_EXT, SPIFFS_FILE_READ);
+    if (part) {
+        size = part.size();
+        part.close();
+    }
+    return size;
+}
+
+uint32_t CHUNKUPLOAD_CLASS::expected_total(tchunk_target target, const String & path)
+{
+    if (target == CHUNK_TARGET_SD) {
+        return (committed(target, path) > 0) ? _sd_total : 0;
+    }
+    uint32_t total = 0;
+    FS_FILE file = SPIFFS.open(path + CHUNK_UPLOAD_SIZE_EXT, SPIFFS_FILE_READ);
+    if (file) {
+        if (file.read((uint8_t *)&total, sizeof(total)) != sizeof(total)) {
+            total = 0;
+        }
+        file.close();
+    }
+    return total;
+}
+
+void CHUNKUPLOAD_CLASS::fail(int code, const char * status)
+{
+    release();
+    _committed = 0;
+    set_result(code, status);
+}
+
+void CHUNKUPLOAD_CLASS::begin(tchunk_target target, const String & path, uint32_t offset, uint32_t total, uint32_t crc)
+{
+    release();
+    _has_result = false;
+    _target = target;
+    _path = path;
+    _offset = offset;
+    _total = total;
+    _crc = crc;
+    _committed = committed(target, path);
+    //.part name must fit too
+    if ((target == CHUNK_TARGET_SPIFFS) && ((path.length() + strlen(CHUNK_UPLOAD_PART_EXT)) > CHUNK_UPLOAD_NAME_MAX)) {
+        _committed = 0;
+        set_result(400, "File name too long");
+        return;
+    }
+    if (target == CHUNK_TARGET_SD) {
+        //serial is used by a job or an upload which is not this one
+        if (print_job.active() || (sd_upload.active() && !_sd_active)) {
+            set_result(409, "Printer busy");
+            return;
+        }
+        //previous chunk is still being sent
+        if ((offset > 0) && (offset == _committed) && !sd_upload.ready()) {
+            set_result(503, "Busy");
+            return;
+        }
+    }
+    //offset 0 starts again, SD upload is started again once chunk is checked
+    if ((offset == 0) && (_committed > 0)) {
+        if (target == CHUNK_TARGET_SPIFFS) {
+            remove_part();
+        }
+        _committed = 0;
+    }
+    //data kept belongs to a file of another size, client must start again
+    if ((offset > 0) && (_committed > 0) && (expected_total(target, path) != total)) {
+        _committed = 0;
+        set_result(409, "Wrong total");
+        return;
+    }
+    if ((offset != _committed) || (offset >= total)) {
+        set_result(409, "Wrong offset");
+        return;
+    }
+    _buffer = (uint8_t *)malloc(CHUNK_UPLOAD_MAX_SIZE);
+    if (!_buffer) {
+        set_result(500, "Not enough memory");
+    }
+}
+
+void CHUNKUPLOAD_CLASS::write(const uint8_t * data, size_t len)
+{
+    if (!_buffer) {
+        return;
+    }
+    if ((_len + len) > CHUNK_UPLOAD_MAX_SIZE) {
+        release();
+        set_result(413, "Chunk too big");
+        return;
+    }
+    memcpy(_buffer + _len, data, len);
+    _len += len;
+}
+
+//check chunk then write it, _committed is where next one must start
+void CHUNKUPLOAD_CLASS::end()
+{
+    if (!_buffer) {
+        return;
+    }
+    if ((_len == 0) || ((_offset + _len) > _total)) {
+        set_result(400, "Wrong size");
+    } else if (crc32(0, _buffer, _len) != _crc) {
+        set_result(400, "CRC mismatch");
+    } else if (_target == CHUNK_TARGET_SD) {
+        if (commit_sd()) {
+            set_result(200, (_committed == _total) ? "Sending to printer" : "Ok");
+        } else {
+            set_result(500, "SD upload failed");
+        }
+    } else {
+        if (commit_spiffs()) {
+            set_result(200, (_committed == _total) ? "Upload done" : "Ok");
+        } else {
+            set_result(500, "Write failed");
+        }
+    }
+    release();
+}
+
+//connection lost during chunk, what was committed before is kept
+void CHUNKUPLOAD_CLASS::abort()
+{
+    release();
+    _has_result = false;
+}
+
+void CHUNKUPLOAD_CLASS::remove_part()
+{
+    String part = _path + CHUNK_UPLOAD_PART_EXT;
+    String size = _path + CHUNK_UPLOAD_SIZE_EXT;
+    SPIFFS.remove(part);
+    SPIFFS.remove(size);
+    dir_index.remove_file(part);
+    dir_index.remove_file(size);
+}
+
+bool CHUNKUPLOAD_CLASS::commit_spiffs()
+{
+    String part = _path + CHUNK_UPLOAD_PART_EXT;
+    //total is kept before any data, so a .part always has one
+    if (_offset == 0) {
+        String size = _path + CHUNK_UPLOAD_SIZE_EXT;
+        FS_FILE file = SPIFFS.open(size, SPIFFS_FILE_WRITE);
+        if (!file) {
+            return false;
+        }
+        size_t written = file.write((const uint8_t *)&_total, sizeof(_total));
+        file.close();
+        dir_index.add_file(size, written);
+        if (written != sizeof(_total)) {
+            return false;
+        }
+    }
+    FS_FILE file = SPIFFS.open(part, SPIFFS_FILE_APPEND);
+    if (!file) {
+        return false;
+    }
+    size_t written = file.write(_buffer, _len);
+    //file size is committed offset, so bytes of a short write are kept
+    _committed = file.size();
+    file.close();
+    dir_index.add_file(part, _committed);
+    if (written != _len) {
+        return false;
+    }
+    if (_committed == _total) {
+        SPIFFS.remove(_path);
+        if (!SPIFFS.rename(part, _path)) {
+            return false;
+        }
+        //file is added first, so directory is not seen empty
+        dir_index.add_file(_path, _total);
+        dir_index.remove_file(part);
+        SPIFFS.remove(_path + CHUNK_UPLOAD_SIZE_EXT);
+        dir_index.remove_file(_path + CHUNK_UPLOAD_SIZE_EXT);
+        serial_out.println("M117 End ESP upload");
+    }
+    return true;
+}
+
+//chunk is given to sd_upload which sends it from loop()
+//a previous chunked upload is replaced when offset is 0
+bool CHUNKUPLOAD_CLASS::commit_sd()
+{
+    if (_offset == 0) {
+        if (_sd_active) {
+            sd_upload.abort();
+        }
+        _sd_active = sd_upload.begin(_path);
+        if (!_sd_active) {
+            _committed = 0;
+            return false;
+        }
+        _sd_total = _total;
+    }
+    //buffer now belongs to sd_upload
+    if (!sd_upload.feed(_buffer, _len)) {
+        _committed = 0;
+        return false;
+    }
+    _buffer = NULL;
+    _len = 0;
+    _sd_last = millis();
+    _committed = sd_upload.received();
+    if (_committed == _total) {
+        sd_upload.end();
+    }
+    return true;
+}
+
+//client did not send next chunk, printer file is closed and removed
+void CHUNKUPLOAD_CLASS::process()
+{
+    if (!_sd_active) {
+        return;
+    }
+    if (!sd_upload.active()) {
+        _sd_active = false;
+    } else if (!sd_upload.ready()) {
+        //client waits for chunk being sent
+        _sd_last = millis();
+    } else if ((millis() - _sd_last) > CHUNK_UPLOAD_SD_TIMEOUT) {
+        LOG("SD chunk upload timeout\r\n");
+        sd_upload.abort();
+        _sd_active = false;
+    }
+}
@@ -0,0 +1,95 @@
+/*
+  chunkupload.h - esp3d resumable chunked upload class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef CHUNKUPLOAD_h
+#define CHUNKUPLOAD_h
+#include <Arduino.h>
+#include "config.h"
+
+//data already received on SPIFFS is kept in file name + this extension
+#define CHUNK_UPLOAD_PART_EXT ".part"
+//and total size given with first chunk in file name + this one, same length
+#define CHUNK_UPLOAD_SIZE_EXT ".size"
+//SPIFFS object name is 32 bytes with its ending 0
+#define CHUNK_UPLOAD_NAME_MAX 31
+
+typedef enum {
+    CHUNK_TARGET_SPIFFS = 0,
+    CHUNK_TARGET_SD = 1
+} tchunk_target;
+
+//a file is sent as chunks, each one with its offset, file total size and CRC32
+//chunk is kept in RAM until its CRC is checked, so only good data is written
+//and client can ask where to continue after connection is lost:
+//SPIFFS data goes to a .part file, renamed once complete, so it survives restart
+//total size of file is kept too, chunk of another total is refused with 409
+//SD data is given to sd_upload, so printer file is kept open between chunks
+//and interactive lines wait: once a chunk is sent, next one must come within
+//CHUNK_UPLOAD_SD_TIMEOUT, so SD upload only resumes after a short drop
+//next chunk is refused with 503 until previous one is sent
+//offset 0 always starts again
+class CHUNKUPLOAD_CLASS
+{
+public:
+    CHUNKUPLOAD_CLASS();
+    ~CHUNKUPLOAD_CLASS();
+    static uint32_t crc32(uint32_t crc, const uint8_t * data, size_t len);
+    //offset where next chunk of this file must start
+    uint32_t committed(tchunk_target target, const String & path);
+    //total size given with first chunk of this file, 0 if none
+    uint32_t expected_total(tchunk_target target, const String & path);
+    //upload handler steps for one chunk
+    void begin(tchunk_target target, const String & path, uint32_t offset, uint32_t total, uint32_t crc);
+    void write(const uint8_t * data, size_t len);
+    void end();
+    void abort();
+    //chunk refused before any data
+    void fail(int code, const char * status);
+    //close SD upload when client does not come back
+    void process();
+    //answer of last chunk, false if none since last call
+    bool get_result(int & code, const char * & status, uint32_t & offset);
+private:
+    tchunk_target _target;
+    String _path;
+    uint32_t _offset;
+    uint32_t _total;
+    uint32_t _crc;
+    //chunk being received
+    uint8_t * _buffer;
+    size_t _len;
+    bool _has_result;
+    int _code;
+    const char * _status;
+    uint32_t _committed;
+    //sd_upload was started by a chunk
+    bool _sd_active;
+    uint32_t _sd_total;
+    uint32_t _sd_last;
+    void set_result(int code, const char * status);
+    void release();
+    void remove_part();
+    bool commit_spiffs();
+    bool commit_sd();
+};
+
+extern CHUNKUPLOAD_CLASS chunk_upload;
+
+#endif
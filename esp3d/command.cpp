@@ -21,6 +21,16 @@
 #include "command.h"
 #include "wificonf.h"
 #include "webinterface.h"
+#include "gcodesender.h"
+#include "settings.h"
+#include "printjob.h"
+#include "serialout.h"
+#include "printerstate.h"
+#include "webevents.h"
+#include "webcommand.h"
+#include "eventlog.h"
+#include "jsonwriter.h"
+#include "dirindex.h"
 #ifndef FS_NO_GLOBALS
 #define FS_NO_GLOBALS
 #endif
@@ -31,8 +41,8 @@
 #else
 #define MAX_GPIO 37
 #endif
-String COMMAND::buffer_serial;
-String COMMAND::buffer_tcp;
+TOKENIZER_CLASS COMMAND::tokenizer_serial;
+TOKENIZER_CLASS COMMAND::tokenizer_tcp;
 
 #define ERROR_CMD_MSG (output == WEB_PIPE)?F("Error: Wrong Command"):F("M117 Cmd Error")
 #define INCORRECT_CMD_MSG (output == WEB_PIPE)?F("Error: Incorrect Command"):F("M117 Incorrect Cmd")
@@ -358,7 +368,7 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
             if (mode == 0) {
                  if (WiFi.getMode() !=WIFI_OFF) {
                      //disable wifi
-                     ESP_SERIAL_OUT.println("M117 Disabling Wifi");
+                     serial_out.println("M117 Disabling Wifi");
                      WiFi.mode(WIFI_OFF);
                      wifi_config.Disable_servers();
                      return response;
@@ -366,11 +376,11 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
             }
             else if (mode == 1) { //restart device is the best way to start everything clean
                  if (WiFi.getMode() == WIFI_OFF) {
-                      ESP_SERIAL_OUT.println("M117 Enabling Wifi");
+                      serial_out.println("M117 Enabling Wifi");
                       CONFIG::esp_restart();
                  } else BRIDGE::println("M117 Wifi already on", output);
             } else  { //restart wifi and restart is the best way to start everything clean
-                 ESP_SERIAL_OUT.println("M117 Enabling Wifi");
+                 serial_out.println("M117 Enabling Wifi");
                  CONFIG::esp_restart();
             }
         }
@@ -405,6 +415,36 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
         LOG("\r\n")
     }
     break;
+#ifdef TCP_IP_DATA_FEATURE
+    //Get/Set data port mode, RAW is a plain pipe without [ESP] commands
+    //sent from data port it only applies to this connection
+    //[ESP130]<RAW/GCODE>[pwd=<user password>]
+    case 130:
+        parameter = get_param(cmd_params,"", true);
+        if (parameter.length() == 0) {
+            BRIDGE::println(BRIDGE::isRawMode(output) ? "RAW" : "GCODE", output);
+            break;
+        }
+        parameter.toUpperCase();
+#ifdef AUTHENTICATION_FEATURE
+        if (auth_type == LEVEL_GUEST) {
+            BRIDGE::println(INCORRECT_CMD_MSG, output);
+            response = false;
+        } else
+#endif
+            if (parameter == "RAW") {
+                //answer before data port stops seeing [ESP] answers
+                BRIDGE::println(OK_CMD_MSG, output);
+                BRIDGE::setRawMode(true, output);
+            } else if (parameter == "GCODE") {
+                BRIDGE::setRawMode(false, output);
+                BRIDGE::println(OK_CMD_MSG, output);
+            } else {
+                BRIDGE::println(INCORRECT_CMD_MSG, output);
+                response = false;
+            }
+        break;
+#endif
 #ifdef DIRECT_PIN_FEATURE
     //Get/Set pin value
     //[ESP201]P<pin> V<value> [PULLUP=YES RAW=YES]pwd=<admin password>
@@ -527,517 +567,8 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
     //Get full EEPROM settings content
     //[ESP400]
     case 400: {
-        char sbuf[MAX_DATA_LENGTH+1];
-        uint8_t ipbuf[4];
-        byte bbuf=0;
-        int ibuf=0;
         parameter = get_param(cmd_params,"", true);
-        delay(0);
-        //Start JSON
-        BRIDGE::println(F("{\"EEPROM\":["), output);
-        if (cmd_params == "network" || cmd_params == "") {
-            
-            //1- Baud Rate
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_BAUD_RATE), output);
-            BRIDGE::print(F("\",\"T\":\"I\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_BAUD_RATE,  (byte *)&ibuf, INTEGER_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(ibuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Baud Rate\",\"O\":[{\"9600\":\"9600\"},{\"19200\":\"19200\"},{\"38400\":\"38400\"},{\"57600\":\"57600\"},{\"115200\":\"115200\"},{\"230400\":\"230400\"},{\"250000\":\"250000\"}]}"), output);
-            BRIDGE::println(F(","), output);
-            
-            //2-Sleep Mode
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_SLEEP_MODE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_SLEEP_MODE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Sleep Mode\",\"O\":[{\"None\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_NONE_SLEEP), output);
-#ifdef ARDUINO_ARCH_ESP8266
-            BRIDGE::print(F("\"},{\"Light\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_LIGHT_SLEEP), output);
-#endif
-            BRIDGE::print(F("\"},{\"Modem\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_MODEM_SLEEP), output);
-            BRIDGE::print(F("\"}]}"), output);
-            BRIDGE::println(F(","), output);
-            
-            //3-Web Port
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_WEB_PORT), output);
-            BRIDGE::print(F("\",\"T\":\"I\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_WEB_PORT,  (byte *)&ibuf, INTEGER_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(ibuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Web Port\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MAX_WEB_PORT), output);
-            BRIDGE::print(F("\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MIN_WEB_PORT), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //4-Data Port
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_DATA_PORT), output);
-            BRIDGE::print(F("\",\"T\":\"I\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_DATA_PORT,  (byte *)&ibuf, INTEGER_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(ibuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Data Port\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MAX_DATA_PORT), output);
-            BRIDGE::print(F("\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MIN_DATA_PORT), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-#ifdef AUTHENTICATION_FEATURE
-             //5-Admin password
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_ADMIN_PWD), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_ADMIN_PWD, sbuf, MAX_LOCAL_PASSWORD_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print("********", output);
-            }
-            BRIDGE::print(F("\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_LOCAL_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\",\"H\":\"Admin Password\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_LOCAL_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //6-User password
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_USER_PWD), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_USER_PWD, sbuf, MAX_LOCAL_PASSWORD_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print("********", output);
-            }
-            BRIDGE::print(F("\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_LOCAL_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\",\"H\":\"User Password\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_LOCAL_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-#endif
-            //7-Hostname
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_HOSTNAME), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_HOSTNAME, sbuf, MAX_HOSTNAME_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(sbuf, output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Hostname\" ,\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_HOSTNAME_LENGTH), output);
-            BRIDGE::print(F("\", \"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_HOSTNAME_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-            
-            //8-wifi mode
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_WIFI_MODE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_WIFI_MODE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Wifi mode\",\"O\":[{\"AP\":\"1\"},{\"STA\":\"2\"}]}"), output);
-            BRIDGE::println(F(","), output);
-
-            //9-STA SSID
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_STA_SSID), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_STA_SSID, sbuf, MAX_SSID_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(sbuf, output);
-            }
-            BRIDGE::print(F("\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_SSID_LENGTH), output);
-            BRIDGE::print(F("\",\"H\":\"Station SSID\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_SSID_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //10-STA password
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_STA_PASSWORD), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_STA_PASSWORD, sbuf, MAX_PASSWORD_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print("********", output);
-            }
-            BRIDGE::print(F("\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\",\"H\":\"Station Password\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-            
-            //11-Station Network Mode
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_STA_PHY_MODE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_STA_PHY_MODE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Station Network Mode\",\"O\":[{\"11b\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_PHY_MODE_11B), output);
-            BRIDGE::print(F("\"},{\"11g\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_PHY_MODE_11G), output);
-            BRIDGE::print(F("\"},{\"11n\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_PHY_MODE_11N), output);
-            BRIDGE::print(F("\"}]}"), output);
-            BRIDGE::println(F(","), output);
-
-            //12-STA IP mode
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_STA_IP_MODE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_STA_IP_MODE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Station IP Mode\",\"O\":[{\"DHCP\":\"1\"},{\"Static\":\"2\"}]}"), output);
-            BRIDGE::println(F(","), output);
-
-            //13-STA static IP
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_STA_IP_VALUE), output);
-            BRIDGE::print(F("\",\"T\":\"A\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_STA_IP_VALUE,(byte *)ipbuf, IP_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(IPAddress(ipbuf).toString().c_str(), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Station Static IP\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //14-STA static Mask
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_STA_MASK_VALUE), output);
-            BRIDGE::print(F("\",\"T\":\"A\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_STA_MASK_VALUE,(byte *)ipbuf, IP_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(IPAddress(ipbuf).toString().c_str(), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Station Static Mask\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //15-STA static Gateway
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_STA_GATEWAY_VALUE), output);
-            BRIDGE::print(F("\",\"T\":\"A\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_STA_GATEWAY_VALUE,(byte *)ipbuf, IP_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(IPAddress(ipbuf).toString().c_str(), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Station Static Gateway\"}"), output);
-            BRIDGE::println(F(","), output);
-
-           //16-AP SSID
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AP_SSID), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_AP_SSID, sbuf, MAX_SSID_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(sbuf, output);
-            }
-            BRIDGE::print(F("\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_SSID_LENGTH), output);
-            BRIDGE::print(F("\",\"H\":\"AP SSID\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_SSID_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //17-AP password
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AP_PASSWORD), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_AP_PASSWORD, sbuf, MAX_PASSWORD_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print("********", output);
-            }
-            BRIDGE::print(F("\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\",\"H\":\"AP Password\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_PASSWORD_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //18 - AP Network Mode
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AP_PHY_MODE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_AP_PHY_MODE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"AP Network Mode\",\"O\":[{\"11b\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_PHY_MODE_11B), output);
-            BRIDGE::print(F("\"},{\"11g\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(WIFI_PHY_MODE_11G), output);
-            BRIDGE::print(F("\"}]}"), output);
-            BRIDGE::println(F(","), output);
-
-            //19-AP SSID visibility
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_SSID_VISIBLE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_SSID_VISIBLE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"SSID Visible\",\"O\":[{\"No\":\"0\"},{\"Yes\":\"1\"}]}"), output);
-            BRIDGE::println(F(","), output);
-            
-            //20-AP Channel
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_CHANNEL), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_CHANNEL, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"AP Channel\",\"O\":["), output);
-            for (int i=1; i < 12 ; i++) {
-                BRIDGE::print(F("{\""), output);
-                BRIDGE::print((const char *)CONFIG::intTostr(i), output);
-                BRIDGE::print(F("\":\""), output);
-                BRIDGE::print((const char *)CONFIG::intTostr(i), output);
-                BRIDGE::print(F("\"}"), output);
-                if (i<11) {
-                    BRIDGE::print(F(","), output);
-                }
-            }
-            BRIDGE::print(F("]}"), output);
-            BRIDGE::println(F(","), output);
-
-            //21-AP Authentication
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AUTH_TYPE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_AUTH_TYPE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Authentication\",\"O\":[{\"Open\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(AUTH_OPEN), output);
-            BRIDGE::print(F("\"},{\"WPA\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(AUTH_WPA_PSK), output);
-            BRIDGE::print(F("\"},{\"WPA2\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(AUTH_WPA2_PSK), output);
-            BRIDGE::print(F("\"},{\"WPA/WPA2\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(AUTH_WPA_WPA2_PSK), output);
-            BRIDGE::print(F("\"}]}"), output);
-            BRIDGE::println(F(","), output);
-
-            //22-AP IP mode
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AP_IP_MODE), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_AP_IP_MODE, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"AP IP Mode\",\"O\":[{\"DHCP\":\"1\"},{\"Static\":\"2\"}]}"), output);
-            BRIDGE::println(F(","), output);
-
-            //23-AP static IP
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AP_IP_VALUE), output);
-            BRIDGE::print(F("\",\"T\":\"A\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_AP_IP_VALUE,(byte *)ipbuf, IP_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(IPAddress(ipbuf).toString().c_str(), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"AP Static IP\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //24-AP static Mask
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AP_MASK_VALUE), output);
-            BRIDGE::print(F("\",\"T\":\"A\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_AP_MASK_VALUE,(byte *)ipbuf, IP_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(IPAddress(ipbuf).toString().c_str(), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"AP Static Mask\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //25-AP static Gateway
-            BRIDGE::print(F("{\"F\":\"network\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_AP_GATEWAY_VALUE), output);
-            BRIDGE::print(F("\",\"T\":\"A\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_AP_GATEWAY_VALUE,(byte *)ipbuf, IP_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(IPAddress(ipbuf).toString().c_str(), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"AP Static Gateway\"}"), output);
-            delay(0);
-        }
-        
-        if (cmd_params == "printer" || cmd_params == "") {
-            if (cmd_params == "") {
-                BRIDGE::println(F(","), output);
-            }
-            //Target FW
-            BRIDGE::print(F("{\"F\":\"printer\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_TARGET_FW), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_TARGET_FW, &bbuf )) {
-                BRIDGE::print("Unknown", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Target FW\",\"O\":[{\"Repetier\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(REPETIER), output);
-            BRIDGE::print(F("\"},{\"Repetier for Davinci\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(REPETIER4DV), output);
-            BRIDGE::print(F("\"},{\"Marlin\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MARLIN), output);
-            BRIDGE::print(F("\"},{\"Marlin Kimbra\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MARLINKIMBRA), output);
-            BRIDGE::print(F("\"},{\"Smoothieware\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(SMOOTHIEWARE), output);
-            BRIDGE::print(F("\"},{\"Unknown\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(UNKNOWN_FW), output);
-            BRIDGE::print(F("\"}]}"), output);
-            BRIDGE::println(F(","), output);
-            
-            //Refresh time 1
-            BRIDGE::print(F("{\"F\":\"printer\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_REFRESH_PAGE_TIME), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_REFRESH_PAGE_TIME, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Temperature Refresh Time\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MAX_REFRESH), output);
-            BRIDGE::print(F("\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MIN_REFRESH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-            
-            //Refresh time 2
-            BRIDGE::print(F("{\"F\":\"printer\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_REFRESH_PAGE_TIME2), output);
-            BRIDGE::print(F("\",\"T\":\"B\",\"V\":\""), output);
-            if (!CONFIG::read_byte(EP_REFRESH_PAGE_TIME2, &bbuf )) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(bbuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Position Refresh Time\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MAX_REFRESH), output);
-            BRIDGE::print(F("\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MIN_REFRESH), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //XY feedrate
-            BRIDGE::print(F("{\"F\":\"printer\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_XY_FEEDRATE), output);
-            BRIDGE::print(F("\",\"T\":\"I\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_XY_FEEDRATE,  (byte *)&ibuf, INTEGER_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(ibuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"XY feedrate\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MAX_XY_FEEDRATE), output);
-            BRIDGE::print(F("\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MIN_XY_FEEDRATE), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //Z feedrate
-            BRIDGE::print(F("{\"F\":\"printer\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_Z_FEEDRATE), output);
-            BRIDGE::print(F("\",\"T\":\"I\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_Z_FEEDRATE,  (byte *)&ibuf, INTEGER_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(ibuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"Z feedrate\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MAX_Z_FEEDRATE), output);
-            BRIDGE::print(F("\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MIN_Z_FEEDRATE), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //E feedrate
-            BRIDGE::print(F("{\"F\":\"printer\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_E_FEEDRATE), output);
-            BRIDGE::print(F("\",\"T\":\"I\",\"V\":\""), output);
-            if (!CONFIG::read_buffer(EP_E_FEEDRATE,  (byte *)&ibuf, INTEGER_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print((const char *)CONFIG::intTostr(ibuf), output);
-            }
-            BRIDGE::print(F("\",\"H\":\"E feedrate\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MAX_E_FEEDRATE), output);
-            BRIDGE::print(F("\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(DEFAULT_MIN_E_FEEDRATE), output);
-            BRIDGE::print(F("\"}"), output);
-            BRIDGE::println(F(","), output);
-
-            //Camera address, data string
-            BRIDGE::print(F("{\"F\":\"printer\",\"P\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(EP_DATA_STRING), output);
-            BRIDGE::print(F("\",\"T\":\"S\",\"V\":\""), output);
-            if (!CONFIG::read_string(EP_DATA_STRING, sbuf, MAX_DATA_LENGTH)) {
-                BRIDGE::print("???", output);
-            } else {
-                BRIDGE::print(sbuf, output);
-            }
-            BRIDGE::print(F("\",\"S\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MAX_DATA_LENGTH), output);
-            BRIDGE::print(F("\",\"H\":\"Camera address\",\"M\":\""), output);
-            BRIDGE::print((const char *)CONFIG::intTostr(MIN_DATA_LENGTH), output);
-            BRIDGE::print(F("\"}"), output);
-        }
-
-        //end JSON
-        BRIDGE::println(F("\n]}"), output);
-        delay(0);
+        SETTINGS::print_json(output, parameter);
     }
     break;
 
@@ -1050,33 +581,30 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
         String sval = get_param(cmd_params,"V=", true);
         sval.trim();
         int pos = spos.toInt();
-        if ((pos == 0 && spos != "0") || (pos > LAST_EEPROM_ADDRESS || pos < 0)) {
+        setting_desc desc;
+        if ((pos == 0 && spos != "0") || !SETTINGS::get(pos, desc)) {
             response = false;
         }
-        if (!(styp == "B" || styp == "S" || styp == "A" || styp == "I")) {
+        if (sval.length() == 0) {
             response = false;
         }
-        if (sval.length() == 0) {
+        //type, range and options come from settings description
+        if (response && ((styp.length() != 1) || !SETTINGS::check(desc, styp[0], sval))) {
             response = false;
         }
 
-
 #ifdef AUTHENTICATION_FEATURE
         if (response) {
             //check authentication
-            level_authenticate_type auth_need = LEVEL_ADMIN;
-            for (int i = 0; i < AUTH_ENTRY_NB; i++) {
-                if (Setting[i][0] == pos ) {
-                    auth_need = (level_authenticate_type)(Setting[i][1]);
-                    i = AUTH_ENTRY_NB;
-                }
-            }
+            level_authenticate_type auth_need = (level_authenticate_type)desc.level;
             if ((auth_need == LEVEL_ADMIN && auth_type == LEVEL_USER) || (auth_type == LEVEL_GUEST)) {
                 response = false;
             }
         }
 #endif
         if (response) {
+            //settings sent in a row are committed together
+            CONFIG::begin_batch();
             if (styp == "B") {
                 byte bbuf = sval.toInt();
                 if(!CONFIG::write_byte(pos,bbuf)) {
@@ -1109,6 +637,7 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
                     response = false;
                 }
             }
+            CONFIG::end_batch(true);
         }
         if(!response) {
             BRIDGE::println(INCORRECT_CMD_MSG, output);
@@ -1125,31 +654,37 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
     case 410: {
 		parameter = get_param(cmd_params,"", true);
 		int n = WiFi.scanNetworks();
-		bool plain = parameter == "plain";
-        if (!plain)BRIDGE::print(F("{\"AP_LIST\":["), output);
-        for (int i = 0; i < n; ++i) {
+        if (parameter == "plain") {
+            for (int i = 0; i < n; ++i) {
                 if (i>0) {
-                   if (!plain) BRIDGE::print(F(","), output);
-                   else BRIDGE::print(F("\n"), output);
+                    BRIDGE::print(F("\n"), output);
                 }
-                if (!plain)BRIDGE::print(F("{\"SSID\":\""), output);
                 BRIDGE::print(WiFi.SSID(i).c_str(), output);
-                if (!plain)BRIDGE::print(F("\",\"SIGNAL\":\""), output);
-                else BRIDGE::print(F("\t"), output);
-                BRIDGE::print(CONFIG::intTostr(wifi_config.getSignal(WiFi.RSSI(i))), output);;
-                //BRIDGE::print(F("%"), output);
-                if (!plain)BRIDGE::print(F("\",\"IS_PROTECTED\":\""), output);
+                BRIDGE::print(F("\t"), output);
+                BRIDGE::print(CONFIG::intTostr(wifi_config.getSignal(WiFi.RSSI(i))), output);
                 if (WiFi.encryptionType(i) == ENC_TYPE_NONE) {
-                    if (!plain)BRIDGE::print(F("0"), output);
-                    else BRIDGE::print(F("\tOpen"), output);
+                    BRIDGE::print(F("\tOpen"), output);
                 } else {
-                    if (!plain)BRIDGE::print(F("1"), output);
-                    else BRIDGE::print(F("\tSecure"), output);
+                    BRIDGE::print(F("\tSecure"), output);
                 }
-                if (!plain)BRIDGE::print(F("\"}"), output);
             }
-        if (!plain)BRIDGE::print(F("]}"), output);
-        else BRIDGE::print(F("\n"), output);
+            BRIDGE::print(F("\n"), output);
+        } else {
+            //SSID can have any char, so it is escaped
+            PIPEPRINT_CLASS pipe(output);
+            JSONWRITER_CLASS json(pipe);
+            json.begin_object();
+            json.begin_array("AP_LIST");
+            for (int i = 0; i < n; ++i) {
+                json.begin_object();
+                json.add("SSID", WiFi.SSID(i));
+                json.add("SIGNAL", CONFIG::intTostr(wifi_config.getSignal(WiFi.RSSI(i))));
+                json.add("IS_PROTECTED", (WiFi.encryptionType(i) == ENC_TYPE_NONE) ? "0" : "1");
+                json.end_object();
+            }
+            json.end_array();
+            json.end_object();
+        }
         WiFi.scanDelete();
 	}
 	break;
@@ -1223,59 +758,46 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
 #endif
     //[ESP700]<filename>
     case 700: { //read local file
-        //be sure serial is locked
-        if ((web_interface->blockserial)) {
+        //file is sent from loop(), with printer acknowledgements
+        parameter = get_param(cmd_params,"", true);
+        if (print_job.start(parameter, auth_type)) {
+            BRIDGE::println(OK_CMD_MSG, output);
+        } else {
+            BRIDGE::println(ERROR_CMD_MSG, output);
+            response = false;
+        }
+        break;
+    }
+    //Get status or pause/resume/abort job started by [ESP700]
+    //[ESP701]<PAUSE/RESUME/ABORT>
+    case 701: {
+        parameter = get_param(cmd_params,"", true);
+        parameter.toUpperCase();
+        if (parameter.length() == 0) {
+            print_job.print_status(output);
             break;
         }
-        cmd_params.trim() ;
-        if ((cmd_params.length() > 0) && (cmd_params[0] != '/')) {
-            cmd_params = "/" + cmd_params;
+#ifdef AUTHENTICATION_FEATURE
+        if (auth_type == LEVEL_GUEST) {
+            BRIDGE::println(INCORRECT_CMD_MSG, output);
+            response = false;
+            break;
         }
-        FS_FILE currentfile = SPIFFS.open(cmd_params, SPIFFS_FILE_READ);
-        if (currentfile) {//if file open success
-            //flush to be sure send buffer is empty
-            ESP_SERIAL_OUT.flush();
-            //until no line in file
-            while (currentfile.available()) {
-                String currentline = currentfile.readStringUntil('\n');
-                currentline.replace("\n","");
-                currentline.replace("\r","");
-                if (currentline.length() > 0) {
-                    int ESPpos = currentline.indexOf("[ESP");
-                    if (ESPpos>-1) {
-                        //is there the second part?
-                        int ESPpos2 = currentline.indexOf("]",ESPpos);
-                        if (ESPpos2>-1) {
-                            //Split in command and parameters
-                            String cmd_part1=currentline.substring(ESPpos+4,ESPpos2);
-                            String cmd_part2="";
-                            //is there space for parameters?
-                            if (ESPpos2<currentline.length()) {
-                                cmd_part2=currentline.substring(ESPpos2+1);
-                            }
-                            //if command is a valid number then execute command
-                            if(cmd_part1.toInt()!=0) {
-                                execute_command(cmd_part1.toInt(),cmd_part2,NO_PIPE, auth_type);
-                            }
-                            //if not is not a valid [ESPXXX] command ignore it
-                        }
-                    } else {
-                        //send line to serial
-                        ESP_SERIAL_OUT.println(currentline);
-                        //flush to be sure send buffer is empty
-                        delay(0);
-                        ESP_SERIAL_OUT.flush();
-                    }
-                 delay(0);   
-                }
-            }
-            currentfile.close();
+#endif
+        if (parameter == "PAUSE") {
+            response = print_job.pause();
+        } else if (parameter == "RESUME") {
+            response = print_job.resume();
+        } else if (parameter == "ABORT") {
+            response = print_job.abort();
+        } else {
+            response = false;
+        }
+        if (response) {
             BRIDGE::println(OK_CMD_MSG, output);
         } else {
             BRIDGE::println(ERROR_CMD_MSG, output);
-            response = false;
         }
-
         break;
     }
     //Format SPIFFS
@@ -1295,6 +817,7 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
 			 delay(0);
 			 SPIFFS.format();
 			 //SPIFFS.begin();
+			 dir_index.invalidate();
 			 BRIDGE::println(F("...Done"), output);
             } else {
 			BRIDGE::println(INCORRECT_CMD_MSG, output);
@@ -1368,35 +891,27 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
         cmd_params.trim();
 #ifdef ERROR_MSG_FEATURE
         if (cmd_params=="ERROR") {
-            web_interface->error_msg.clear();
+            event_log.clear(EVENT_ERROR);
             BRIDGE::println(OK_CMD_MSG, output);
             break;
         }
 #endif
 #ifdef INFO_MSG_FEATURE
         if (cmd_params=="INFO") {
-            web_interface->info_msg.clear();
+            event_log.clear(EVENT_INFO);
             BRIDGE::println(OK_CMD_MSG, output);
             break;
         }
 #endif
 #ifdef STATUS_MSG_FEATURE
         if (cmd_params=="STATUS") {
-            web_interface->status_msg.clear();
+            event_log.clear(EVENT_STATUS);
             BRIDGE::println(OK_CMD_MSG, output);
             break;
         }
 #endif
         if (cmd_params=="ALL") {
-#ifdef ERROR_MSG_FEATURE
-            web_interface->error_msg.clear();
-#endif
-#ifdef STATUS_MSG_FEATURE
-            web_interface->status_msg.clear();
-#endif
-#ifdef INFO_MSG_FEATURE
-            web_interface->info_msg.clear();
-#endif
+            event_log.clear();
             BRIDGE::println(OK_CMD_MSG, output);
             break;
         }
@@ -1407,194 +922,86 @@ bool COMMAND::execute_command(int cmd,String cmd_params, tpipe output, level_aut
     return response;
 }
 
-bool COMMAND::check_command(String buffer, tpipe output, bool handlelockserial)
+//remove quotes which would break JSON
+static const char * strip_quotes(char * msg)
 {
-    String buffer2;
-    LOG("Check Command:")
-    LOG(buffer)
-    LOG("\r\n")
-    bool is_temp = false;
-    if ((buffer.indexOf("T:") > -1 ) || (buffer.indexOf("B:") > -1 )) is_temp = true;
-    //feed the WD for safety
-    delay(0);
-    if (( CONFIG::GetFirmwareTarget()  == REPETIER4DV) || (CONFIG::GetFirmwareTarget() == REPETIER)) {
-        //save time no need to continue
-        if ((buffer.indexOf("busy:") > -1) || (buffer.startsWith("wait"))) {
-            return false;
-        }
-        if (buffer.startsWith("ok")) {
-            return false;
+    char * dst = msg;
+    for (char * src = msg; *src; src++) {
+        if ((*src != '"') && (*src != '\'')) {
+            *dst++ = *src;
         }
-    }   
-#ifdef ERROR_MSG_FEATURE
-        int Errorpos = -1;
-#endif
-#ifdef INFO_MSG_FEATURE
-        int Infopos = -1;
-#endif
-#ifdef STATUS_MSG_FEATURE
-        int Statuspos = -1;
-#endif
-if (CONFIG::GetFirmwareTarget()  == SMOOTHIEWARE) {
-#ifdef ERROR_MSG_FEATURE
-        Errorpos= buffer.indexOf("error:");
-#endif
-#ifdef INFO_MSG_FEATURE
-        Infopos= buffer.indexOf("info:");
-#endif
-#ifdef STATUS_MSG_FEATURE
-        Statuspos= buffer.indexOf("warning:");
-#endif
-} else {
-#ifdef ERROR_MSG_FEATURE
-        Errorpos= buffer.indexOf("Error:");
-#endif
-#ifdef INFO_MSG_FEATURE
-        Infopos= buffer.indexOf("Info:");
-#endif
-#ifdef STATUS_MSG_FEATURE
-    Statuspos= -1;
-    if (CONFIG::GetFirmwareTarget()  == MARLIN){
-        Statuspos= buffer.indexOf("echo:");
     }
-    else {
-        Statuspos= buffer.indexOf("Status:");
-    }
-
-#endif
+    *dst = '\0';
+    return msg;
 }
 
+bool COMMAND::check_command(tline_event & event, tpipe output)
+{
+    LOG("Check Command:")
+    LOG(event.line)
+    LOG("\r\n")
+    //feed the WD for safety
+    delay(0);
+    switch (event.type) {
 #ifdef SERIAL_COMMAND_FEATURE
-        String ESP_Command;
-        int ESPpos = buffer.indexOf("[ESP");
-        if (ESPpos>-1) {
-            //is there the second part?
-            int ESPpos2 = buffer.indexOf("]",ESPpos);
-            if (ESPpos2>-1) {
-                //Split in command and parameters
-                String cmd_part1=buffer.substring(ESPpos+4,ESPpos2);
-                String cmd_part2="";
-                //is there space for parameters?
-                if (ESPpos2<buffer.length()) {
-                    cmd_part2=buffer.substring(ESPpos2+1);
-                }
-                //if command is a valid number then execute command
-                if(cmd_part1.toInt()!=0) {
-                    execute_command(cmd_part1.toInt(),cmd_part2,output);
-                }
-                //if not is not a valid [ESPXXX] command
-            }
-        }
+    case LINE_ESP_COMMAND: {
+        char * cmd_end;
+        int cmd = strtol(event.payload, &cmd_end, 10);
+        //if command is a valid number then execute command
+        if ((*cmd_end == ']') && (cmd != 0)) {
+            execute_command(cmd, String(cmd_end + 1), output);
+        }
+        //if not is not a valid [ESPXXX] command
+    }
+    break;
 #endif
 #ifdef ERROR_MSG_FEATURE
-        //Error
-        if (Errorpos>-1 && !(buffer.indexOf("Format error")!=-1 || buffer.indexOf("wait")==Errorpos+6) ) {
-            String ss = buffer.substring(Errorpos+6);
-            ss.replace("\"","");
-            ss.replace("'","");
-            (web_interface->error_msg).add(ss.c_str());
-        }
+    case LINE_ERROR:
+        event_log.add(strip_quotes(event.payload), EVENT_ERROR);
+        break;
 #endif
 #ifdef INFO_MSG_FEATURE
-        //Info
-        if (Infopos>-1) {
-            String ss = buffer.substring(Errorpos+5);
-            ss.replace("\"","");
-            ss.replace("'","");
-            (web_interface->info_msg).add(ss.c_str());
-        }
+    case LINE_INFO:
+        event_log.add(strip_quotes(event.payload), EVENT_INFO);
+        break;
 #endif
 #ifdef STATUS_MSG_FEATURE
-        //Status
-        if (Statuspos>-1) {
-            String ss ;
-            if (CONFIG::GetFirmwareTarget() == SMOOTHIEWARE)ss = buffer.substring(Errorpos+8);
-            else if (CONFIG::GetFirmwareTarget() == MARLIN) ss = buffer.substring(Errorpos+5);
-            else ss = buffer.substring(Errorpos+7);
-            ss.replace("\"","");
-            ss.replace("'","");
-            (web_interface->info_msg).add(ss.c_str());
-        }
+    case LINE_STATUS:
+        event_log.add(strip_quotes(event.payload), EVENT_STATUS);
+        break;
 #endif
-    
-    return is_temp;
+    default:
+        break;
+    }
+    return event.has_temperature;
 }
 
-//read a buffer in an array
-void COMMAND::read_buffer_serial(uint8_t *b, size_t len)
+//split buffer in lines and check them
+void COMMAND::read_buffer_serial(const uint8_t *b, size_t len)
 {
-    for (long i = 0; i< len; i++) {
-        read_buffer_serial(b[i]);
-       //*b++;
+    tline_event event;
+    while (tokenizer_serial.feed(b, len, event)) {
+        //find which line an ok answers before producers look at it
+        serial_out.check_response(event);
+        gcode_sender.check_response(event);
+        WEBCOMMAND::check_line(event);
+#ifdef MONITORING_FEATURE
+        printer_state.update(event);
+#endif
+#ifdef WEB_EVENTS_FEATURE
+        WEBEVENTS::check_line(event);
+#endif
+        check_command(event, SERIAL_PIPE);
     }
 }
 
 #ifdef TCP_IP_DATA_FEATURE
-//read buffer as char
-void COMMAND::read_buffer_tcp(uint8_t b)
+void COMMAND::read_buffer_tcp(const uint8_t *b, size_t len)
 {
-    static bool previous_was_char=false;
-    static bool iscomment=false;
-//to ensure it is continuous string, no char separated by binaries
-    if (!previous_was_char) {
-        buffer_tcp="";
-        iscomment = false;
-    }
-//is comment ?
-    if (char(b) == ';') {
-        iscomment = true;
-    }
-//it is a char so add it to buffer
-    if (isPrintable(b)) {
-        previous_was_char=true;
-        //add char if not a comment
-        if (!iscomment) {
-            buffer_tcp+=char(b);
-        }
-    } else {
-        previous_was_char=false; //next call will reset the buffer
-    }
-//this is not printable but end of command check if need to handle it
-    if (b==13 || b==10) {
-        //reset comment flag
-        iscomment = false;
-        //Minimum is something like M10 so 3 char
-        if (buffer_tcp.length()>3) {
-            check_command(buffer_tcp, TCP_PIPE);
-        }
+    tline_event event;
+    //gcode streamed by host has no [ESP so complete lines are skipped
+    while (tokenizer_tcp.feed_marked(b, len, event, '[')) {
+        check_command(event, TCP_PIPE);
     }
 }
 #endif
-//read buffer as char
-void COMMAND::read_buffer_serial(uint8_t b)
-{
-    static bool previous_was_char=false;
-    static bool iscomment=false;
-//to ensure it is continuous string, no char separated by binaries
-    if (!previous_was_char) {
-        buffer_serial="";
-        iscomment = false;
-    }
-//is comment ?
-    if (char(b) == ';') {
-        iscomment = true;
-    }
-//it is a char so add it to buffer
-    if (isPrintable(b)) {
-        previous_was_char=true;
-        if (!iscomment) {
-            buffer_serial+=char(b);
-        }
-    } else {
-        previous_was_char=false; //next call will reset the buffer
-    }
-//this is not printable but end of command check if need to handle it
-    if (b==13 || b==10) {
-        //reset comment flag
-        iscomment = false;
-        //Minimum is something like M10 so 3 char
-        if (buffer_serial.length()>3) {
-            check_command(buffer_serial, SERIAL_PIPE);
-        }
-    }
-}
@@ -22,18 +22,18 @@
 #define COMMAND_h
 #include <Arduino.h>
 #include "bridge.h"
+#include "tokenizer.h"
 
 class COMMAND
 {
 public:
-    static String buffer_serial;
-    static String buffer_tcp;
-    static void read_buffer_serial(uint8_t *b, size_t len);
-    static void read_buffer_serial(uint8_t b);
+    static TOKENIZER_CLASS tokenizer_serial;
+    static TOKENIZER_CLASS tokenizer_tcp;
+    static void read_buffer_serial(const uint8_t *b, size_t len);
 #ifdef TCP_IP_DATA_FEATURE
-    static void read_buffer_tcp(uint8_t b);
+    static void read_buffer_tcp(const uint8_t *b, size_t len);
 #endif
-    static bool check_command(String buffer, tpipe output, bool handlelockserial = true);
+    static bool check_command(tline_event & event, tpipe output);
     static bool execute_command(int cmd,String cmd_params, tpipe output, level_authenticate_type auth_level = LEVEL_GUEST);
     static String get_param(String & cmd_params, const char * id, bool withspace = false);
     static bool isadmin(String & cmd_params);
@@ -34,6 +34,8 @@ extern "C" {
 #include "esp_wifi.h"
 #endif
 #include "bridge.h"
+#include "serialout.h"
+#include "jsonwriter.h"
 
 #ifdef ARDUINO_ARCH_ESP32
 //This is output for ESP32 to avoid garbage
@@ -41,6 +43,10 @@ HardwareSerial Serial2(2);
 #endif
 
 uint8_t CONFIG::FirmwareTarget = UNKNOWN_FW;
+bool CONFIG::eeprom_ready = false;
+uint8_t CONFIG::batch_level = 0;
+bool CONFIG::commit_pending = false;
+uint32_t CONFIG::last_change = 0;
 
 bool CONFIG::SetFirmwareTarget(uint8_t fw){
     if ( fw <= MAX_FW_ID) {
@@ -130,6 +136,8 @@ bool CONFIG::update_settings(){
         IniFile espconfig((char *)filename.c_str());
         //validate file is correct
         if (espconfig.open()) {
+            //all settings of file are committed at once
+            begin_batch();
             if (!espconfig.validate(buffer, bufferLen)) {
                 success = false;
                 LOG("Invalid config file\r\n")
@@ -675,6 +683,9 @@ bool CONFIG::update_settings(){
             
             }
             espconfig.close();
+            if (!end_batch()) {
+                success = false;
+            }
             if(success) {
                 newfilename.replace(String(".txt"), String(".ok"));
             } else {
@@ -705,7 +716,10 @@ bool CONFIG::update_settings(){
 void CONFIG::esp_restart()
 {
     LOG("Restarting\r\n")
-    ESP_SERIAL_OUT.flush();
+    if (commit_pending) {
+        commit_settings();
+    }
+    serial_out.flush();
     delay(500);
 #ifdef ARDUINO_ARCH_ESP8266
     ESP_SERIAL_OUT.swap();
@@ -915,6 +929,66 @@ char * CONFIG::mac2str(uint8_t mac [WL_MAC_ADDR_LENGTH])
 }
 
 
+//settings are read once from flash, then EEPROM RAM image is used as cache
+void CONFIG::open_settings()
+{
+    if (!eeprom_ready) {
+        EEPROM.begin(EEPROM_SIZE);
+        eeprom_ready = true;
+    }
+}
+
+//commit now, or later if a batch of changes is ongoing
+bool CONFIG::save_settings()
+{
+    last_change = millis();
+    if (batch_level > 0) {
+        commit_pending = true;
+        return true;
+    }
+    return commit_settings();
+}
+
+//write pending changes to flash
+bool CONFIG::commit_settings()
+{
+    commit_pending = false;
+    if (!eeprom_ready) {
+        return true;
+    }
+    if (!EEPROM.commit()) {
+        LOG("Error commit settings\r\n")
+        return false;
+    }
+    return true;
+}
+
+//following writes are committed once, by end_batch()
+void CONFIG::begin_batch()
+{
+    batch_level++;
+}
+
+//deferred commit is done by handle_settings() when no change comes anymore
+bool CONFIG::end_batch(bool deferred)
+{
+    if (batch_level > 0) {
+        batch_level--;
+    }
+    if ((batch_level > 0) || !commit_pending || deferred) {
+        return true;
+    }
+    return commit_settings();
+}
+
+//called in loop to commit deferred changes
+void CONFIG::handle_settings()
+{
+    if (commit_pending && (batch_level == 0) && ((millis() - last_change) > EEPROM_COMMIT_DELAY)) {
+        commit_settings();
+    }
+}
+
 //read a string
 //a string is multibyte + \0, this is won't work if 1 char is multibyte like chinese char
 bool CONFIG::read_string(int pos, char byte_buffer[], int size_max)
@@ -924,7 +998,7 @@ bool CONFIG::read_string(int pos, char byte_buffer[], int size_max)
         LOG("Error read string\r\n")
         return false;
     }
-    EEPROM.begin(EEPROM_SIZE);
+    open_settings();
     byte b = 13; // non zero for the while loop below
     int i=0;
 
@@ -939,8 +1013,6 @@ bool CONFIG::read_string(int pos, char byte_buffer[], int size_max)
     if (b!=0) {
         byte_buffer[i-1]=0x00;
     }
-    EEPROM.end();
-
     return true;
 }
 
@@ -955,7 +1027,7 @@ bool CONFIG::read_string(int pos, String & sbuffer, int size_max)
     int i=0;
     sbuffer="";
 
-    EEPROM.begin(EEPROM_SIZE);
+    open_settings();
     //read until max size is reached or \0 is found
     while (i < size_max && b != 0) {
         b = EEPROM.read(pos+i);
@@ -964,8 +1036,6 @@ bool CONFIG::read_string(int pos, String & sbuffer, int size_max)
         }
         i++;
     }
-    EEPROM.end();
-
     return true;
 }
 
@@ -978,13 +1048,12 @@ bool CONFIG::read_buffer(int pos, byte byte_buffer[], int size_buffer)
         return false;
     }
     int i=0;
-    EEPROM.begin(EEPROM_SIZE);
+    open_settings();
     //read until max size is reached
     while (i<size_buffer ) {
         byte_buffer[i]=EEPROM.read(pos+i);
         i++;
     }
-    EEPROM.end();
     return true;
 }
 
@@ -996,9 +1065,8 @@ bool CONFIG::read_byte(int pos, byte * value)
         LOG("Error read byte\r\n")
         return false;
     }
-    EEPROM.begin(EEPROM_SIZE);
+    open_settings();
     value[0] = EEPROM.read(pos);
-    EEPROM.end();
     return true;
 }
 
@@ -1037,7 +1105,8 @@ bool CONFIG::check_update_presence( ){
             delay(1);
         }
         //Send command
-        ESP_SERIAL_OUT.println(cmd);
+        serial_out.println(cmd);
+        serial_out.flush();
         count = 0;
         String current_buffer;
         String current_line;
@@ -1139,16 +1208,14 @@ bool CONFIG::write_string(int pos, const char * byte_buffer)
         return false;
     }
     //copy the value(s)
-    EEPROM.begin(EEPROM_SIZE);
+    open_settings();
     for (int i = 0; i < size_buffer; i++) {
         EEPROM.write(pos + i, byte_buffer[i]);
     }
 
     //0 terminal
     EEPROM.write(pos + size_buffer, 0x00);
-    EEPROM.commit();
-    EEPROM.end();
-    return true;
+    return save_settings();
 }
 
 //write a buffer
@@ -1159,14 +1226,12 @@ bool CONFIG::write_buffer(int pos, const byte * byte_buffer, int size_buffer)
         LOG("Error write buffer\r\n")
         return false;
     }
-    EEPROM.begin(EEPROM_SIZE);
+    open_settings();
     //copy the value(s)
     for (int i = 0; i < size_buffer; i++) {
         EEPROM.write(pos + i, byte_buffer[i]);
     }
-    EEPROM.commit();
-    EEPROM.end();
-    return true;
+    return save_settings();
 }
 
 //read a flag / byte
@@ -1177,14 +1242,22 @@ bool CONFIG::write_byte(int pos, const byte value)
         LOG("Error write byte\r\n")
         return false;
     }
-    EEPROM.begin(EEPROM_SIZE);
+    open_settings();
     EEPROM.write(pos, value);
-    EEPROM.commit();
-    EEPROM.end();
-    return true;
+    return save_settings();
 }
 
 bool CONFIG::reset_config()
+{
+    begin_batch();
+    bool res = write_default_settings();
+    if (!end_batch()) {
+        return false;
+    }
+    return res;
+}
+
+bool CONFIG::write_default_settings()
 {
     if(!CONFIG::write_string(EP_DATA_STRING,"")) {
         return false;
@@ -1326,103 +1399,95 @@ bool CONFIG::reset_config()
     return true;
 }
 
+//[ESP420] item, a "Label: value" line in plain text, a json member otherwise
+//unit is only shown in plain text
+class CONFIG_ITEMS
+{
+public:
+    CONFIG_ITEMS(tpipe output, bool plaintext) : _output(output), _plaintext(plaintext), _pipe(output), _json(_pipe) {};
+    void add(const char * key, const __FlashStringHelper * label, const String & value, const char * unit = "")
+    {
+        if (!_plaintext) {
+            _json.add(key, value);
+            return;
+        }
+        BRIDGE::print(label, _output);
+        BRIDGE::print(F(": "), _output);
+        BRIDGE::print(value.c_str(), _output);
+        BRIDGE::print(unit, _output);
+        BRIDGE::print(F("\n"), _output);
+    };
+    inline bool plaintext()
+    {
+        return _plaintext;
+    };
+    inline JSONWRITER_CLASS & json()
+    {
+        return _json;
+    };
+private:
+    tpipe _output;
+    bool _plaintext;
+    PIPEPRINT_CLASS _pipe;
+    JSONWRITER_CLASS _json;
+};
+
+static const __FlashStringHelper * feature_state(bool enabled)
+{
+    return enabled ? F("Enabled") : F("Disabled");
+}
+
 void CONFIG::print_config(tpipe output, bool plaintext)
-{    
-    if (!plaintext)BRIDGE::print(F("{\"chip_id\":\""), output);
-    else BRIDGE::print(F("Chip ID: "), output);
+{
+    //ssid and hostname can have any char, so json is done by writer
+    CONFIG_ITEMS items(output, plaintext);
+    if (!plaintext) {
+        items.json().begin_object();
+    }
 #ifdef ARDUINO_ARCH_ESP8266
-    BRIDGE::print(String(ESP.getChipId()).c_str(), output);
+    items.add("chip_id", F("Chip ID"), String(ESP.getChipId()));
 #else
-	BRIDGE::print(String((uint16_t)(ESP.getEfuseMac()>>32)).c_str(), output);
+    items.add("chip_id", F("Chip ID"), String((uint16_t)(ESP.getEfuseMac() >> 32)));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"cpu\":\""), output);
-    else BRIDGE::print(F("CPU Frequency: "), output);
-    BRIDGE::print(String(ESP.getCpuFreqMHz()).c_str(), output);
-    if (plaintext)BRIDGE::print(F("Mhz"), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-#ifdef ARDUINO_ARCH_ESP32 
-    if (!plaintext)BRIDGE::print(F("\"cpu_temp\":\""), output);
-    else BRIDGE::print(F("CPU Temperature: "), output);
-    BRIDGE::print(String(temperatureRead(),1).c_str(), output);
-    if (plaintext)BRIDGE::print(F("C"), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-#endif  
-    if (!plaintext)BRIDGE::print(F("\"freemem\":\""), output);
-    else BRIDGE::print(F("Free memory: "), output);
-    BRIDGE::print(formatBytes(ESP.getFreeHeap()).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\""), output);
-    BRIDGE::print(F("SDK"), output);
-    if (!plaintext)BRIDGE::print(F("\":\""), output);
-    else BRIDGE::print(F(": "), output);
-    BRIDGE::print(ESP.getSdkVersion(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-      
-    if (!plaintext)BRIDGE::print(F("\"flash_size\":\""), output);
-    else BRIDGE::print(F("Flash Size: "), output);
-    BRIDGE::print(formatBytes(ESP.getFlashChipSize()).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-#ifdef ARDUINO_ARCH_ESP8266    
-    if (!plaintext)BRIDGE::print(F("\"update_size\":\""), output);
-    else BRIDGE::print(F("Available Size for update: "), output);
+    items.add("cpu", F("CPU Frequency"), String(ESP.getCpuFreqMHz()), "Mhz");
+#ifdef ARDUINO_ARCH_ESP32
+    items.add("cpu_temp", F("CPU Temperature"), String(temperatureRead(), 1), "C");
+#endif
+    items.add("freemem", F("Free memory"), formatBytes(ESP.getFreeHeap()));
+    items.add("SDK", F("SDK"), ESP.getSdkVersion());
+    items.add("flash_size", F("Flash Size"), formatBytes(ESP.getFlashChipSize()));
+#ifdef ARDUINO_ARCH_ESP8266
     uint32_t  flashsize = ESP.getFlashChipSize();
-    if (flashsize > 1024 * 1024) flashsize = 1024 * 1024;
-    BRIDGE::print(formatBytes(flashsize - ESP.getSketchSize()).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else {
-        if ((flashsize - ESP.getSketchSize()) > (flashsize / 2)) BRIDGE::println(F("(Ok)"), output);
-        else BRIDGE::print(F("(Not enough)"), output);
-        }
-
-    if (!plaintext)BRIDGE::print(F("\"spiffs_size\":\""), output);
-    else BRIDGE::print(F("Available Size for SPIFFS: "), output);
+    if (flashsize > 1024 * 1024) {
+        flashsize = 1024 * 1024;
+    }
+    items.add("update_size", F("Available Size for update"), formatBytes(flashsize - ESP.getSketchSize()),
+              ((flashsize - ESP.getSketchSize()) > (flashsize / 2)) ? "(Ok)" : "(Not enough)");
     fs::FSInfo info;
     SPIFFS.info(info);
-    BRIDGE::print(formatBytes(info.totalBytes).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-#else 
-	if (!plaintext)BRIDGE::print(F("\"update_size\":\""), output);
-    else BRIDGE::print(F("Available Size for update: "), output);
+    items.add("spiffs_size", F("Available Size for SPIFFS"), formatBytes(info.totalBytes));
+#else
     uint32_t  flashsize = ESP.getFlashChipSize();
-//Not OTA on 2Mb board per spec
-    if (flashsize > 0x20000) flashsize = 0x140000;
-    else flashsize = 0x0;
-    BRIDGE::print(formatBytes(flashsize).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else {
-        if (flashsize  > 0x0) BRIDGE::println(F("(Ok)"), output);
-        else BRIDGE::print(F("(Not enough)"), output);
-        }
-    if (!plaintext)BRIDGE::print(F("\"spiffs_size\":\""), output);
-    else BRIDGE::print(F("Available Size for SPIFFS: "), output);
-    BRIDGE::print(formatBytes(SPIFFS.totalBytes()).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
+    //Not OTA on 2Mb board per spec
+    if (flashsize > 0x20000) {
+        flashsize = 0x140000;
+    } else {
+        flashsize = 0x0;
+    }
+    items.add("update_size", F("Available Size for update"), formatBytes(flashsize), (flashsize > 0x0) ? "(Ok)" : "(Not enough)");
+    items.add("spiffs_size", F("Available Size for SPIFFS"), formatBytes(SPIFFS.totalBytes()));
 #endif
-    if (!plaintext)BRIDGE::print(F("\"baud_rate\":\""), output);
-    else BRIDGE::print(F("Baud rate: "), output);
     uint32_t br = ESP_SERIAL_OUT.baudRate();
 #ifdef ARDUINO_ARCH_ESP32
     //workaround for ESP32
-    if(br == 115201)br = 115200;
-    if(br == 230423)br = 230400;
+    if(br == 115201) {
+        br = 115200;
+    }
+    if(br == 230423) {
+        br = 230400;
+    }
 #endif
-    BRIDGE::print(String(br).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-
-    if (!plaintext)BRIDGE::print(F("\"sleep_mode\":\""), output);
-    else BRIDGE::print(F("Sleep mode: "), output);
+    items.add("baud_rate", F("Baud rate"), String(br));
 #ifdef ARDUINO_ARCH_ESP32
     wifi_ps_type_t ps_type;
     esp_wifi_get_ps(&ps_type);
@@ -1430,163 +1495,86 @@ void CONFIG::print_config(tpipe output, bool plaintext)
     WiFiSleepType_t ps_type;
     ps_type = WiFi.getSleepMode();
 #endif
+    const __FlashStringHelper * sleep_mode = F("???");
     if (ps_type == WIFI_NONE_SLEEP) {
-        BRIDGE::print(F("None"), output);
+        sleep_mode = F("None");
 #ifdef ARDUINO_ARCH_ESP8266
     } else if (ps_type == WIFI_LIGHT_SLEEP) {
-        BRIDGE::print(F("Light"), output);
+        sleep_mode = F("Light");
 #endif
     } else if (ps_type == WIFI_MODEM_SLEEP) {
-        BRIDGE::print(F("Modem"), output);
-    } else {
-        BRIDGE::print(F("???"), output);
+        sleep_mode = F("Modem");
     }
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"channel\":\""), output);
-    else BRIDGE::print(F("Channel: "), output);
-    BRIDGE::print(String(WiFi.channel()).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
+    items.add("sleep_mode", F("Sleep mode"), sleep_mode);
+    items.add("channel", F("Channel"), String(WiFi.channel()));
 #ifdef ARDUINO_ARCH_ESP32
     uint8_t PhyMode;
-    if (WiFi.getMode() == WIFI_STA)esp_wifi_get_protocol(ESP_IF_WIFI_STA, &PhyMode);
-    else esp_wifi_get_protocol(ESP_IF_WIFI_AP, &PhyMode);
-#else   
+    if (WiFi.getMode() == WIFI_STA) {
+        esp_wifi_get_protocol(ESP_IF_WIFI_STA, &PhyMode);
+    } else {
+        esp_wifi_get_protocol(ESP_IF_WIFI_AP, &PhyMode);
+    }
+#else
     WiFiPhyMode_t PhyMode = WiFi.getPhyMode();
 #endif
-    if (!plaintext)BRIDGE::print(F("\"phy_mode\":\""), output);
-    else BRIDGE::print(F("Phy Mode: "), output);
-    if (PhyMode == (WIFI_PHY_MODE_11G))BRIDGE::print(F("11g"), output);
-    else if (PhyMode == (WIFI_PHY_MODE_11B))BRIDGE::print(F("11b"), output);
-    else if (PhyMode == (WIFI_PHY_MODE_11N))BRIDGE::print(F("11n"), output);
-    else BRIDGE::print(F("???"), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"web_port\":\""), output);
-    else BRIDGE::print(F("Web port: "), output);
-    BRIDGE::print(String(wifi_config.iweb_port).c_str(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"data_port\":\""), output);
-    else BRIDGE::print(F("Data port: "), output);
+    const __FlashStringHelper * phy_mode = F("???");
+    if (PhyMode == (WIFI_PHY_MODE_11G)) {
+        phy_mode = F("11g");
+    } else if (PhyMode == (WIFI_PHY_MODE_11B)) {
+        phy_mode = F("11b");
+    } else if (PhyMode == (WIFI_PHY_MODE_11N)) {
+        phy_mode = F("11n");
+    }
+    items.add("phy_mode", F("Phy Mode"), phy_mode);
+    items.add("web_port", F("Web port"), String(wifi_config.iweb_port));
 #ifdef TCP_IP_DATA_FEATURE
-    BRIDGE::print(String(wifi_config.idata_port).c_str(), output);
+    items.add("data_port", F("Data port"), String(wifi_config.idata_port));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("data_port", F("Data port"), F("Disabled"));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
     if (WiFi.getMode() == WIFI_STA || WiFi.getMode() == WIFI_AP_STA) {
-        if (!plaintext)BRIDGE::print(F("\"hostname\":\""), output);
-        else BRIDGE::print(F("Hostname: "), output);
 #ifdef ARDUINO_ARCH_ESP32
-        BRIDGE::print(WiFi.getHostname(), output);
+        items.add("hostname", F("Hostname"), WiFi.getHostname());
 #else
-        BRIDGE::print(WiFi.hostname().c_str(), output);
+        items.add("hostname", F("Hostname"), WiFi.hostname());
 #endif
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
     }
 
-    if (!plaintext)BRIDGE::print(F("\"active_mode\":\""), output);
-    else BRIDGE::print(F("Active Mode: "), output);
     if (WiFi.getMode() == WIFI_STA) {
-        BRIDGE::print(F("Station ("), output);
-        BRIDGE::print(WiFi.macAddress().c_str(), output);
-        BRIDGE::print(F(")"), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
+        items.add("active_mode", F("Active Mode"), String(F("Station (")) + WiFi.macAddress().c_str() + F(")"));
         if (WiFi.isConnected()) {
-             if (!plaintext)BRIDGE::print(F("\"connected_ssid\":\""), output);
-            else BRIDGE::print(F("Connected to: "), output);
-            BRIDGE::print(WiFi.SSID().c_str(), output);
-            if (!plaintext)BRIDGE::print(F("\","), output);
-            else BRIDGE::print(F("\n"), output);
-            if (!plaintext)BRIDGE::print(F("\"connected_signal\":\""), output);
-            else BRIDGE::print(F("Signal: "), output);
-            BRIDGE::print(String(wifi_config.getSignal(WiFi.RSSI())).c_str(), output);
-            BRIDGE::print(F("%"), output);
-            if (!plaintext)BRIDGE::print(F("\","), output);
-            else BRIDGE::print(F("\n"), output);
-            }
-        else {
-             if (!plaintext)BRIDGE::print(F("\"connection_status\":\""), output);
-            else BRIDGE::print(F("Connection Status: "), output);
-            BRIDGE::print(F("Connection Status: "), output);
+            items.add("connected_ssid", F("Connected to"), WiFi.SSID());
+            items.add("connected_signal", F("Signal"), String(wifi_config.getSignal(WiFi.RSSI())) + F("%"));
+        } else {
+            const __FlashStringHelper * status = F("Unknown");
             if (WiFi.status() == WL_DISCONNECTED) {
-                BRIDGE::print(F("Disconnected"), output);
+                status = F("Disconnected");
             } else if (WiFi.status() == WL_CONNECTION_LOST) {
-                BRIDGE::print(F("Connection lost"), output);
+                status = F("Connection lost");
             } else if (WiFi.status() == WL_CONNECT_FAILED) {
-                BRIDGE::print(F("Connection failed"), output);
+                status = F("Connection failed");
             } else if (WiFi.status() == WL_NO_SSID_AVAIL) {
-                BRIDGE::print(F("No connection"), output);
+                status = F("No connection");
             } else if (WiFi.status() == WL_IDLE_STATUS   ) {
-                BRIDGE::print(F("Idle"), output);
-            } else  BRIDGE::print(F("Unknown"), output);
-            if (!plaintext)BRIDGE::print(F("\","), output);
-            else BRIDGE::print(F("\n"), output);
+                status = F("Idle");
+            }
+            items.add("connection_status", F("Connection Status"), status);
         }
-         if (!plaintext)BRIDGE::print(F("\"ip_mode\":\""), output);
-        else BRIDGE::print(F("IP Mode: "), output);
 #ifdef ARDUINO_ARCH_ESP32
         tcpip_adapter_dhcp_status_t dhcp_status;
         tcpip_adapter_dhcpc_get_status(TCPIP_ADAPTER_IF_STA, &dhcp_status);
-        if (dhcp_status == TCPIP_ADAPTER_DHCP_STARTED)
+        bool dhcp = (dhcp_status == TCPIP_ADAPTER_DHCP_STARTED);
 #else
-        if (wifi_station_dhcpc_status()==DHCP_STARTED) 
+        bool dhcp = (wifi_station_dhcpc_status() == DHCP_STARTED);
 #endif
-        {
-			BRIDGE::print(F("DHCP"), output);
-		}
-        else BRIDGE::print(F("Static"), output);
-         if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"ip\":\""), output);
-        else BRIDGE::print(F("IP: "), output);
-        BRIDGE::print(WiFi.localIP().toString().c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"gw\":\""), output);
-        else BRIDGE::print(F("Gateway: "), output);
-        BRIDGE::print(WiFi.gatewayIP().toString().c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"msk\":\""), output);
-        else BRIDGE::print(F("Mask: "), output);
-        BRIDGE::print(WiFi.subnetMask().toString().c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"dns\":\""), output);
-        else BRIDGE::print(F("DNS: "), output);
-        BRIDGE::print(WiFi.dnsIP().toString().c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"disabled_mode\":\""), output);
-        else BRIDGE::print(F("Disabled Mode: "), output);
-        BRIDGE::print(F("Access Point ("), output);
-        BRIDGE::print(WiFi.softAPmacAddress().c_str(), output);
-        BRIDGE::print(F(")"), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
+        items.add("ip_mode", F("IP Mode"), dhcp ? F("DHCP") : F("Static"));
+        items.add("ip", F("IP"), WiFi.localIP().toString());
+        items.add("gw", F("Gateway"), WiFi.gatewayIP().toString());
+        items.add("msk", F("Mask"), WiFi.subnetMask().toString());
+        items.add("dns", F("DNS"), WiFi.dnsIP().toString());
+        items.add("disabled_mode", F("Disabled Mode"), String(F("Access Point (")) + WiFi.softAPmacAddress().c_str() + F(")"));
     } else if (WiFi.getMode() == WIFI_AP) {
-        BRIDGE::print(F("Access Point ("), output);
-        BRIDGE::print(WiFi.softAPmacAddress().c_str(), output);
-        BRIDGE::print(F(")"), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
+        items.add("active_mode", F("Active Mode"), String(F("Access Point (")) + WiFi.softAPmacAddress().c_str() + F(")"));
         //get current config
 #ifdef ARDUINO_ARCH_ESP32
         wifi_ap_config_t apconfig;
@@ -1595,274 +1583,158 @@ void CONFIG::print_config(tpipe output, bool plaintext)
         apconfig.ssid_hidden = conf.ap.ssid_hidden;
         apconfig.authmode = conf.ap.authmode;
         apconfig.max_connection = conf.ap.max_connection;
+        items.add("ap_ssid", F("SSID"), (const char*)conf.ap.ssid);
 #else
         struct softap_config apconfig;
         wifi_softap_get_config(&apconfig);
+        items.add("ap_ssid", F("SSID"), (const char*)apconfig.ssid);
 #endif
-        if (!plaintext)BRIDGE::print(F("\"ap_ssid\":\""), output);
-        else BRIDGE::print(F("SSID: "), output);
-#ifdef ARDUINO_ARCH_ESP32
-        BRIDGE::print((const char*)conf.ap.ssid, output);
-#else
-		BRIDGE::print((const char*)apconfig.ssid, output);
-#endif
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"ssid_visible\":\""), output);
-        else BRIDGE::print(F("Visible: "), output);
-        BRIDGE::print((apconfig.ssid_hidden == 0)?F("Yes"):F("No"), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"ssid_authentication\":\""), output);
-        else BRIDGE::print(F("Authentication: "), output);
-        if (apconfig.authmode==AUTH_OPEN) {
-            BRIDGE::print(F("None"), output);
-        } else if (apconfig.authmode==AUTH_WEP) {
-            BRIDGE::print(F("WEP"), output);
-        } else if (apconfig.authmode==AUTH_WPA_PSK) {
-           BRIDGE::print(F("WPA"), output);
-        } else if (apconfig.authmode==AUTH_WPA2_PSK) {
-            BRIDGE::print(F("WPA2"), output);
-        } else {
-            BRIDGE::print(F("WPA/WPA2"), output);
+        items.add("ssid_visible", F("Visible"), (apconfig.ssid_hidden == 0) ? F("Yes") : F("No"));
+        const __FlashStringHelper * authentication = F("WPA/WPA2");
+        if (apconfig.authmode == AUTH_OPEN) {
+            authentication = F("None");
+        } else if (apconfig.authmode == AUTH_WEP) {
+            authentication = F("WEP");
+        } else if (apconfig.authmode == AUTH_WPA_PSK) {
+            authentication = F("WPA");
+        } else if (apconfig.authmode == AUTH_WPA2_PSK) {
+            authentication = F("WPA2");
         }
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"ssid_max_connections\":\""), output);
-        else BRIDGE::print(F("Max Connections: "), output);
-        BRIDGE::print(String(apconfig.max_connection).c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"ssid_dhcp\":\""), output);
-        else BRIDGE::print(F("DHCP Server: "), output);
+        items.add("ssid_authentication", F("Authentication"), authentication);
+        items.add("ssid_max_connections", F("Max Connections"), String(apconfig.max_connection));
 #ifdef ARDUINO_ARCH_ESP32
         tcpip_adapter_dhcp_status_t dhcp_status;
         tcpip_adapter_dhcps_get_status(TCPIP_ADAPTER_IF_AP, &dhcp_status);
-        if (dhcp_status == TCPIP_ADAPTER_DHCP_STARTED)
+        bool dhcp = (dhcp_status == TCPIP_ADAPTER_DHCP_STARTED);
 #else
-        if(wifi_softap_dhcps_status() == DHCP_STARTED) 
+        bool dhcp = (wifi_softap_dhcps_status() == DHCP_STARTED);
 #endif
-        {
-			BRIDGE::print(F("Started"), output);
-		}
-        else BRIDGE::print(F("Stopped"), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"ip\":\""), output);
-        else BRIDGE::print(F("IP: "), output);
-        BRIDGE::print(WiFi.softAPIP().toString().c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-#ifdef ARDUINO_ARCH_ESP32      
+        items.add("ssid_dhcp", F("DHCP Server"), dhcp ? F("Started") : F("Stopped"));
+        items.add("ip", F("IP"), WiFi.softAPIP().toString());
+#ifdef ARDUINO_ARCH_ESP32
         tcpip_adapter_ip_info_t ip;
         tcpip_adapter_get_ip_info(TCPIP_ADAPTER_IF_AP, &ip);
-#else    
+#else
         struct ip_info ip;
         wifi_get_ip_info(SOFTAP_IF, &ip);
 #endif
-        if (!plaintext)BRIDGE::print(F("\"gw\":\""), output);
-        else BRIDGE::print(F("Gateway: "), output);
-        BRIDGE::print(IPAddress(ip.gw.addr).toString().c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        if (!plaintext)BRIDGE::print(F("\"msk\":\""), output);
-        else BRIDGE::print(F("Mask: "), output);
-        BRIDGE::print(IPAddress(ip.netmask.addr).toString().c_str(), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
-        
-        if (!plaintext)BRIDGE::print(F("\"connected_clients\":["), output);
-        else BRIDGE::print(F("Connected clients: "), output);
-        int client_counter=0;
-#ifdef ARDUINO_ARCH_ESP32     
+        items.add("gw", F("Gateway"), IPAddress(ip.gw.addr).toString());
+        items.add("msk", F("Mask"), IPAddress(ip.netmask.addr).toString());
+
+#ifdef ARDUINO_ARCH_ESP32
         wifi_sta_list_t station;
         tcpip_adapter_sta_list_t tcpip_sta_list;
         esp_wifi_ap_get_sta_list(&station);
         tcpip_adapter_get_sta_list(&station, &tcpip_sta_list);
-#else       
+#else
         struct station_info * station;
         station = wifi_softap_get_station_info();
 #endif
-        String stmp ="";
+        //plain text shows number of clients before list
+        int client_counter = 0;
+        String list = "";
+        if (!plaintext) {
+            items.json().begin_array("connected_clients");
+        }
 #ifdef ARDUINO_ARCH_ESP32
-		for (int i=0; i < station.num; i++){
+        for (int i = 0; i < station.num; i++) {
+            String bssid = CONFIG::mac2str(tcpip_sta_list.sta[i].mac);
+            String client_ip = IPAddress(tcpip_sta_list.sta[i].ip.addr).toString();
 #else
         while(station) {
+            String bssid = CONFIG::mac2str(station->bssid);
+            String client_ip = IPAddress((const uint8_t *)&station->ip).toString();
 #endif
-            if(stmp.length() > 0) {
-                if (!plaintext)stmp+=F(",");
-                else stmp+=F("\n");
-                
+            if (!plaintext) {
+                items.json().begin_object();
+                items.json().add("bssid", bssid);
+                items.json().add("ip", client_ip);
+                items.json().end_object();
+            } else {
+                if (list.length() > 0) {
+                    list += F("\n");
+                }
+                list += bssid + F(" ") + client_ip;
             }
-            if (!plaintext)stmp+=F("{\"bssid\":\"");
-            //BSSID
-#ifdef ARDUINO_ARCH_ESP32
-            stmp += CONFIG::mac2str(tcpip_sta_list.sta[i].mac);
-#else
-			stmp += CONFIG::mac2str(station->bssid);
-#endif
-            if (!plaintext)stmp+=F("\",\"ip\":\"");
-            else stmp += F(" ");
-            //IP
-#ifdef ARDUINO_ARCH_ESP32
-            stmp += IPAddress(tcpip_sta_list.sta[i].ip.addr).toString().c_str();
-#else
-			stmp += IPAddress((const uint8_t *)&station->ip).toString().c_str();
-#endif
-            if (!plaintext)stmp+=F("\"}");
-            //increment counter
             client_counter++;
 #ifdef ARDUINO_ARCH_ESP32
-		}
+        }
 #else
             //go next record
-            station =STAILQ_NEXT(station,	next);
+            station = STAILQ_NEXT(station, next);
         }
         wifi_softap_free_station_info();
 #endif
         if (!plaintext) {
-            BRIDGE::print(stmp.c_str(), output);
-            BRIDGE::print(F("],"), output);
-            }
-        else {
-                //display number of client
-                BRIDGE::println(String(client_counter).c_str(), output);
-                //display list if any
-                if(stmp.length() > 0)BRIDGE::println(stmp.c_str(), output);
+            items.json().end_array();
+        } else {
+            items.add(NULL, F("Connected clients"), String(client_counter));
+            if (list.length() > 0) {
+                BRIDGE::println(list.c_str(), output);
             }
-        
-        if (!plaintext)BRIDGE::print(F("\"disabled_mode\":\""), output);
-        else BRIDGE::print(F("Disabled Mode: "), output);
-        BRIDGE::print(F("Station ("), output);
-        BRIDGE::print(WiFi.macAddress().c_str(), output);
-        BRIDGE::print(F(") is disabled"), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        
+        }
+        items.add("disabled_mode", F("Disabled Mode"), String(F("Station (")) + WiFi.macAddress().c_str() + F(") is disabled"));
     } else if (WiFi.getMode() == WIFI_AP_STA) {
-        BRIDGE::print(F("Mixed"), output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
-        if (!plaintext)BRIDGE::print(F("\"active_mode\":\""), output);
-        else BRIDGE::print(F("Active Mode: "), output);
-        BRIDGE::print(F("Access Point ("), output);
-        BRIDGE::print(WiFi.softAPmacAddress().c_str(), output);
-        BRIDGE::println(F(")"), output);
-        BRIDGE::print(F("Station ("), output);
-        BRIDGE::print(WiFi.macAddress().c_str(), output);
-        BRIDGE::print(F(")"), output);
-         if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
+        items.add("active_mode", F("Active Mode"), F("Mixed"));
+        items.add("active_mode", F("Active Mode"), String(F("Access Point (")) + WiFi.softAPmacAddress().c_str() + F(")\nStation (") + WiFi.macAddress().c_str() + F(")"));
     } else {
-        BRIDGE::print("Wifi Off", output);
-        if (!plaintext)BRIDGE::print(F("\","), output);
-        else BRIDGE::print(F("\n"), output);
+        items.add("active_mode", F("Active Mode"), F("Wifi Off"));
     }
 
-    if (!plaintext)BRIDGE::print(F("\"captive_portal\":\""), output);
-    else BRIDGE::print(F("Captive portal: "), output);
 #ifdef CAPTIVE_PORTAL_FEATURE
-    BRIDGE::print(F("Enabled"), output);
+    items.add("captive_portal", F("Captive portal"), feature_state(true));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("captive_portal", F("Captive portal"), feature_state(false));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"ssdp\":\""), output);
-    else BRIDGE::print(F("SSDP: "), output);
 #ifdef SSDP_FEATURE
-    BRIDGE::print(F("Enabled"), output);
+    items.add("ssdp", F("SSDP"), feature_state(true));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("ssdp", F("SSDP"), feature_state(false));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"netbios\":\""), output);
-    else BRIDGE::print(F("NetBios: "), output);
 #ifdef NETBIOS_FEATURE
-    BRIDGE::print(F("Enabled"), output);
+    items.add("netbios", F("NetBios"), feature_state(true));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("netbios", F("NetBios"), feature_state(false));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"mdns\":\""), output);
-    else BRIDGE::print(F("mDNS: "), output);
 #ifdef MDNS_FEATURE
-    BRIDGE::print(F("Enabled"), output);
+    items.add("mdns", F("mDNS"), feature_state(true));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("mdns", F("mDNS"), feature_state(false));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-
-    if (!plaintext)BRIDGE::print(F("\"web_update\":\""), output);
-    else BRIDGE::print(F("Web Update: "), output);
 #ifdef WEB_UPDATE_FEATURE
-    BRIDGE::print(F("Enabled"), output);
+    items.add("web_update", F("Web Update"), feature_state(true));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("web_update", F("Web Update"), feature_state(false));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-
-    if (!plaintext)BRIDGE::print(F("\"pin recovery\":\""), output);
-    else BRIDGE::print(F("Pin Recovery: "), output);
 #ifdef RECOVERY_FEATURE
-    BRIDGE::print(F("Enabled"), output);
+    items.add("pin recovery", F("Pin Recovery"), feature_state(true));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("pin recovery", F("Pin Recovery"), feature_state(false));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-
-    if (!plaintext)BRIDGE::print(F("\"autentication\":\""), output);
-    else BRIDGE::print(F("Authentication: "), output);
 #ifdef AUTHENTICATION_FEATURE
-    BRIDGE::print(F("Enabled"), output);
+    items.add("autentication", F("Authentication"), feature_state(true));
 #else
-    BRIDGE::print(F("Disabled"), output);
+    items.add("autentication", F("Authentication"), feature_state(false));
 #endif
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
-    
-    if (!plaintext)BRIDGE::print(F("\"target_fw\":\""), output);
-    else BRIDGE::print(F("Target Firmware: "), output);
-    BRIDGE::print(CONFIG::GetFirmwareTargetName(), output);
-    if (!plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
+    items.add("target_fw", F("Target Firmware"), CONFIG::GetFirmwareTargetName());
 #ifdef DEBUG_ESP3D
-    if (!plaintext)BRIDGE::print(F("\"debug\":\""), output);
-    else BRIDGE::print(F("Debug: "), output);
-    BRIDGE::print(F("Debug Enabled :"), output);
+    String debug = F("Debug Enabled :");
 #ifdef DEBUG_OUTPUT_SPIFFS
-    BRIDGE::print(F("SPIFFS"), output);
+    debug += F("SPIFFS");
 #endif
 #ifdef DEBUG_OUTPUT_SD
-    BRIDGE::print(F("SD"), output);
+    debug += F("SD");
 #endif
 #ifdef DEBUG_OUTPUT_SERIAL
-    BRIDGE::print(F("serial"), output);
+    debug += F("serial");
 #endif
 #ifdef DEBUG_OUTPUT_TCP
-    BRIDGE::print(F("TCP"), output);
+    debug += F("TCP");
 #endif
-    if (plaintext)BRIDGE::print(F("\","), output);
-    else BRIDGE::print(F("\n"), output);
+    items.add("debug", F("Debug"), debug);
 #endif
-    if (!plaintext)BRIDGE::print(F("\"fw\":\""), output);
-    else BRIDGE::print(F("FW version: "), output);
-    BRIDGE::print(FW_VERSION, output);
-    if (!plaintext)BRIDGE::print(F("\"}"), output);
-    else BRIDGE::print(F("\n"), output);
+    items.add("fw", F("FW version"), FW_VERSION);
+    if (!plaintext) {
+        items.json().end_object();
+    }
 }
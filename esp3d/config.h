@@ -47,6 +47,7 @@
 #define SPIFFS_FILE_READ FILE_READ
 #define SD_FILE_WRITE FILE_WRITE
 #define SPIFFS_FILE_WRITE FILE_WRITE
+#define SPIFFS_FILE_APPEND FILE_APPEND
 
 extern HardwareSerial Serial2;
 #else
@@ -57,12 +58,27 @@ extern HardwareSerial Serial2;
 #define SPIFFS_FILE_READ "r"
 #define SD_FILE_WRITE FILE_WRITE
 #define SPIFFS_FILE_WRITE "w"
+#define SPIFFS_FILE_APPEND "a"
 #endif
 
 #define MAX_FW_ID REPETIER
 
 //number of clients allowed to use data port at once
-#define MAX_SRV_CLIENTS 1
+#ifndef MAX_SRV_CLIENTS
+#define MAX_SRV_CLIENTS 4
+#endif
+
+//data port client which cannot receive anything for this time (ms) is disconnected
+//comment TCP_EVICT_SLOW_CLIENTS to keep it connected, it then just misses data
+#define TCP_EVICT_SLOW_CLIENTS
+#define TCP_CLIENT_EVICT_TIMEOUT 10000
+
+//max data moved from a data port client to UART at once
+#define TCP_TO_SERIAL_BLOCK 256
+
+//uncomment to start data port clients in raw mode: no [ESP] command parsing
+//mode can also be changed by [ESP130]
+//#define TCP_RAW_MODE
 
 //comment to disable
 //MDNS_FEATURE: this feature allow  type the name defined
@@ -110,6 +126,44 @@ extern HardwareSerial Serial2;
 //DIRECT_PIN_FEATURE: allow to access pin using ESP201 command
 #define DIRECT_PIN_FEATURE
 
+//MONITORING_FEATURE: keep temperatures/position/fan/SD progress parsed from printer answers, served by /STATUS
+#define MONITORING_FEATURE
+
+#ifdef MONITORING_FEATURE
+//hotends followed in printer state
+#define MAX_HOTENDS 4
+//temperature history: bytes per resolution (1s, 10s, 1min), size must be a power of 2
+//a sample is 1 byte when temperatures are stable
+#define TELEMETRY_LEVEL_SIZE 1024
+#endif
+
+//WEB_EVENTS_FEATURE: push console lines, messages and printer state to web clients on /events
+#define WEB_EVENTS_FEATURE
+
+//WS_TERMINAL_FEATURE: serial terminal for web browsers on /ws (WebSocket)
+//WebSocket comes with bundled WebServer library, so only ESP32 builds have it
+#define WS_TERMINAL_FEATURE
+
+#ifdef ARDUINO_ARCH_ESP8266
+#undef WS_TERMINAL_FEATURE
+#endif
+
+#ifdef WS_TERMINAL_FEATURE
+//browsers connected to /ws at once
+#define MAX_WS_CLIENTS 2
+#endif
+
+//CHUNK_UPLOAD_FEATURE: resumable upload on /upload_chunk, file is sent as chunks with CRC32
+#define CHUNK_UPLOAD_FEATURE
+
+#ifdef CHUNK_UPLOAD_FEATURE
+//biggest chunk accepted, chunk is kept in RAM until its CRC is checked
+#define CHUNK_UPLOAD_MAX_SIZE 4096
+//ms without chunk before SD upload is closed and its file removed, other lines
+//wait meanwhile so it is short, SPIFFS ones are kept in .part file without limit
+#define CHUNK_UPLOAD_SD_TIMEOUT 10000
+#endif
+
 //INFO_MSG_FEATURE: catch the Info msg and filter it to specific table
 #define INFO_MSG_FEATURE
 
@@ -119,9 +173,25 @@ extern HardwareSerial Serial2;
 //STATUS_MSG_FEATURE: catch the status msg and filter it to specific table
 #define STATUS_MSG_FEATURE
 
+//messages caught are kept in one log, /STATUS?since= only sends newer ones
+//entries in log, oldest is removed when full
+#define EVENT_LOG_SIZE 16
+//longer messages are cut with "..."
+#define EVENT_LOG_LENGTH 50
+
 //Serial rx buffer size is 256 but can be extended
 #define SERIAL_RX_BUFFER_SIZE 512
 
+//Serial data are read once in a ring shared by tcp, web and command parser
+//size must be a power of 2
+#define SERIAL_RING_SIZE 1024
+
+//Serial output is queued by priority lanes, each lane has this size
+//size must be a power of 2 and hold a full window of gcode sender
+#define SERIAL_OUT_QUEUE_SIZE 512
+//bytes written by interactive or bulk lane before giving turn to the other
+#define SERIAL_OUT_QUANTUM 128
+
 #ifdef ARDUINO_ARCH_ESP32
 #ifdef SSDP_FEATURE
 #undef SSDP_FEATURE
@@ -139,9 +209,9 @@ extern HardwareSerial Serial2;
 //#define DEBUG_OUTPUT_SERIAL
 //#define DEBUG_OUTPUT_TCP
 
-//store performance result in storestring variable : info_msg / status_msg
+//store performance result in event log as info messages
 //#define DEBUG_PERFORMANCE
-#define DEBUG_PERF_VARIABLE  (web_interface->info_msg)
+#define DEBUG_PERF_VARIABLE  (event_log)
 /*
 #ifndef FS_NO_GLOBALS
 #define FS_NO_GLOBALS
@@ -195,6 +265,9 @@ typedef enum {
     SERIAL1_PIPE = 3,
 #ifdef TCP_IP_DATA_FEATURE
     TCP_PIPE = 4,
+#endif
+#ifdef WS_TERMINAL_FEATURE
+    WS_PIPE = 6,
 #endif
     WEB_PIPE = 5
 } tpipe;
@@ -313,51 +386,6 @@ const char DEFAULT_TIME_SERVER3 []  PROGMEM =	"1.pool.ntp.org";
 
 
 
-const uint16_t Setting[][2] = {
-    {EP_WIFI_MODE, LEVEL_ADMIN},//0
-    {EP_STA_SSID, LEVEL_ADMIN},//1
-    {EP_STA_PASSWORD, LEVEL_ADMIN},//2
-    {EP_STA_IP_MODE, LEVEL_ADMIN},//3
-    {EP_STA_IP_VALUE, LEVEL_ADMIN},//4
-    {EP_STA_MASK_VALUE, LEVEL_ADMIN},//5
-    {EP_STA_GATEWAY_VALUE, LEVEL_ADMIN},//6
-    {EP_BAUD_RATE, LEVEL_ADMIN},//7
-    {EP_STA_PHY_MODE, LEVEL_ADMIN},//8
-    {EP_SLEEP_MODE, LEVEL_ADMIN},//9
-    {EP_CHANNEL, LEVEL_ADMIN},//10
-    {EP_AUTH_TYPE, LEVEL_ADMIN},//11
-    {EP_SSID_VISIBLE, LEVEL_ADMIN},//12
-    {EP_WEB_PORT, LEVEL_ADMIN},//13
-    {EP_DATA_PORT, LEVEL_ADMIN},//14
-    {EP_REFRESH_PAGE_TIME, LEVEL_USER},//15
-    {EP_HOSTNAME, LEVEL_ADMIN},//16
-    {EP_XY_FEEDRATE, LEVEL_USER},//17
-    {EP_Z_FEEDRATE, LEVEL_USER},//18
-    {EP_E_FEEDRATE, LEVEL_USER},//19
-    {EP_ADMIN_PWD, LEVEL_ADMIN},//20
-    {EP_USER_PWD, LEVEL_USER},//21
-    {EP_AP_SSID, LEVEL_ADMIN},//22
-    {EP_AP_PASSWORD, LEVEL_ADMIN},//23
-    {EP_AP_IP_VALUE, LEVEL_ADMIN},//24
-    {EP_AP_MASK_VALUE, LEVEL_ADMIN},//25
-    {EP_AP_GATEWAY_VALUE, LEVEL_ADMIN},//26
-    {EP_AP_IP_MODE, LEVEL_ADMIN},//27
-    {EP_AP_PHY_MODE, LEVEL_ADMIN},//28
-    {EP_DATA_STRING, LEVEL_USER},//29
-    {EP_REFRESH_PAGE_TIME2, LEVEL_USER},//30
-    {EP_TARGET_FW, LEVEL_USER},//31
-    {EP_TIMEZONE, LEVEL_USER},//32
-    {EP_TIME_ISDST, LEVEL_USER},//33
-    {EP_TIME_SERVER1, LEVEL_USER},//34
-    {EP_TIME_SERVER2, LEVEL_USER},//35
-    {EP_TIME_SERVER3, LEVEL_USER},//36
-    {EP_IS_DIRECT_SD, LEVEL_USER},//37
-    {EP_PRIMARY_SD, LEVEL_USER},//38
-    {EP_SECONDARY_SD, LEVEL_USER},//39
-    {EP_DIRECT_SD_CHECK, LEVEL_USER}, //40
-    {EP_SD_CHECK_UPDATE_AT_BOOT, LEVEL_USER} //41
-};
-#define AUTH_ENTRY_NB 42
 //values
 #define DEFAULT_MAX_REFRESH			120
 #define DEFAULT_MIN_REFRESH			0
@@ -376,6 +404,8 @@ const uint16_t Setting[][2] = {
 
 //sizes
 #define EEPROM_SIZE				1024 //max is 1024
+//ms without new setting change before pending ones are committed
+#define EEPROM_COMMIT_DELAY			1000
 #define MAX_SSID_LENGTH				32
 #define MIN_SSID_LENGTH				1
 #define MAX_PASSWORD_LENGTH 			64
@@ -405,6 +435,10 @@ public:
     static bool write_buffer(int pos, const byte * byte_buffer, int size_buffer);
     static bool write_byte(int pos, const byte value);
     static bool reset_config();
+    static void begin_batch();
+    static bool end_batch(bool deferred = false);
+    static bool commit_settings();
+    static void handle_settings();
     static void print_config(tpipe output, bool plaintext);
     static bool SetFirmwareTarget(uint8_t fw);
     static void InitFirmwareTarget();
@@ -428,6 +462,13 @@ public:
     static void esp_restart();
 private:
     static uint8_t FirmwareTarget;
+    static bool eeprom_ready;
+    static uint8_t batch_level;
+    static bool commit_pending;
+    static uint32_t last_change;
+    static void open_settings();
+    static bool save_settings();
+    static bool write_default_settings();
 };
 
 #endif
@@ -0,0 +1,305 @@
+/*
+  dirindex.cpp - esp3d SPIFFS directory tree class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "dirindex.h"
+#ifndef FS_NO_GLOBALS
+#define FS_NO_GLOBALS
+#endif
+#include <FS.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include "SPIFFS.h"
+#endif
+
+//serial SD upload of older firmware staged file here, now it is streamed
+#define DIR_OLD_SD_STAGE "/sdupload.tmp"
+
+DIRINDEX_CLASS dir_index;
+
+//Constructor
+DIRINDEX_CLASS::DIRINDEX_CLASS()
+{
+    _root.name[0] = 0;
+    _root.size = 0;
+    _root.hash = 0;
+    _root.hashed = false;
+    _root.is_dir = true;
+    _root.parent = NULL;
+    _root.child = NULL;
+    _root.next = NULL;
+    _valid = false;
+}
+
+//Destructor
+DIRINDEX_CLASS::~DIRINDEX_CLASS()
+{
+    clear();
+}
+
+void DIRINDEX_CLASS::free_node(dir_node * node)
+{
+    dir_node * c = node->child;
+    while (c) {
+        dir_node * next = c->next;
+        free_node(c);
+        c = next;
+    }
+    free(node);
+}
+
+void DIRINDEX_CLASS::clear()
+{
+    dir_node * c = _root.child;
+    while (c) {
+        dir_node * next = c->next;
+        free_node(c);
+        c = next;
+    }
+    _root.child = NULL;
+    _valid = false;
+}
+
+//SPIFFS changed outside of index, it will be built again on next request
+void DIRINDEX_CLASS::invalidate()
+{
+    clear();
+}
+
+void DIRINDEX_CLASS::unlink(dir_node * node)
+{
+    dir_node ** p = &node->parent->child;
+    while (*p && (*p != node)) {
+        p = &(*p)->next;
+    }
+    if (*p) {
+        *p = node->next;
+    }
+}
+
+//look for name in directory, new entry is added at end so order is creation one
+dir_node * DIRINDEX_CLASS::child(dir_node * dir, const char * name, size_t len, bool create, bool is_dir)
+{
+    dir_node ** p = &dir->child;
+    while (*p) {
+        if ((strncmp((*p)->name, name, len) == 0) && ((*p)->name[len] == 0)) {
+            return *p;
+        }
+        p = &(*p)->next;
+    }
+    if (!create) {
+        return NULL;
+    }
+    //one allocation for node and its name
+    dir_node * node = (dir_node *)malloc(sizeof(dir_node) + len);
+    if (!node) {
+        return NULL;
+    }
+    memcpy(node->name, name, len);
+    node->name[len] = 0;
+    node->size = 0;
+    node->hash = 0;
+    node->hashed = false;
+    node->is_dir = is_dir;
+    node->parent = dir;
+    node->child = NULL;
+    node->next = NULL;
+    *p = node;
+    return node;
+}
+
+//go through path, a last "." part is the directory itself
+dir_node * DIRINDEX_CLASS::walk(const String & path, bool create, bool last_is_dir)
+{
+    dir_node * node = &_root;
+    const char * p = path.c_str();
+    while (*p) {
+        while (*p == '/') {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        const char * end = strchr(p, '/');
+        size_t len = end ? (end - p) : strlen(p);
+        bool last = !end || !end[strspn(end, "/")];
+        if (last && (len == 1) && (*p == '.')) {
+            break;
+        }
+        if (!node->is_dir) {
+            return NULL;
+        }
+        node = child(node, p, len, create, last ? last_is_dir : true);
+        if (!node) {
+            return NULL;
+        }
+        p += len;
+    }
+    return node;
+}
+
+//list SPIFFS once, stale staging file is removed instead of listed
+void DIRINDEX_CLASS::build()
+{
+    bool old_stage = false;
+    clear();
+#ifdef ARDUINO_ARCH_ESP8266
+    FS_DIR dir = SPIFFS.openDir("/");
+    while (dir.next()) {
+        String name = dir.fileName();
+        uint32_t size = dir.fileSize();
+#else
+    FS_FILE dir = SPIFFS.open("/");
+    FS_FILE fileparsed = dir.openNextFile();
+    while (fileparsed) {
+        String name = fileparsed.name();
+        uint32_t size = fileparsed.size();
+        fileparsed = dir.openNextFile();
+#endif
+        if (name == DIR_OLD_SD_STAGE) {
+            old_stage = true;
+            continue;
+        }
+        dir_node * node = walk(name, true, false);
+        if (node && !node->is_dir) {
+            node->size = size;
+        }
+    }
+    //not removed while SPIFFS is being listed
+    if (old_stage) {
+        SPIFFS.remove(DIR_OLD_SD_STAGE);
+    }
+    _valid = true;
+    LOG("Directories indexed\r\n")
+}
+
+dir_node * DIRINDEX_CLASS::find(const String & path)
+{
+    if (!_valid) {
+        build();
+    }
+    return walk(path, false, false);
+}
+
+void DIRINDEX_CLASS::add_file(const String & path, uint32_t size)
+{
+    //file will be found when index is built
+    if (!_valid) {
+        return;
+    }
+    dir_node * node = walk(path, true, false);
+    if (node && !node->is_dir) {
+        node->size = size;
+        //content may have changed
+        node->hashed = false;
+    }
+}
+
+//write placeholder of empty directory, files already in it keep it
+bool DIRINDEX_CLASS::keep_dir(dir_node * dir)
+{
+    if ((dir == &_root) || dir->child) {
+        return true;
+    }
+    String path;
+    for (dir_node * node = dir; node != &_root; node = node->parent) {
+        path = "/" + String(node->name) + path;
+    }
+    path += DIR_PLACEHOLDER;
+    FS_FILE file = SPIFFS.open(path, SPIFFS_FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+bool DIRINDEX_CLASS::add_dir(const String & path)
+{
+    if (find(path)) {
+        return false;
+    }
+    dir_node * node = walk(path, true, true);
+    if (!node || !node->is_dir) {
+        return false;
+    }
+    if (!keep_dir(node)) {
+        unlink(node);
+        free_node(node);
+        return false;
+    }
+    return true;
+}
+
+void DIRINDEX_CLASS::remove_file(const String & path)
+{
+    if (!_valid) {
+        return;
+    }
+    dir_node * node = walk(path, false, false);
+    if (node && !node->is_dir) {
+        dir_node * parent = node->parent;
+        unlink(node);
+        free_node(node);
+        keep_dir(parent);
+    }
+}
+
+//remove files of directory and its subdirectories, only what is removed leaves index
+bool DIRINDEX_CLASS::remove_files(dir_node * dir, String & path)
+{
+    bool done = true;
+    size_t len = path.length();
+    path += DIR_PLACEHOLDER;
+    SPIFFS.remove(path);
+    dir_node * c = dir->child;
+    while (c) {
+        dir_node * next = c->next;
+        path.remove(len);
+        path += "/";
+        path += c->name;
+        bool removed = c->is_dir ? remove_files(c, path) : SPIFFS.remove(path);
+        if (removed) {
+            unlink(c);
+            free_node(c);
+        } else {
+            done = false;
+        }
+        c = next;
+    }
+    path.remove(len);
+    return done;
+}
+
+bool DIRINDEX_CLASS::remove_dir(const String & path)
+{
+    dir_node * node = find(path);
+    if (!node || !node->is_dir || (node == &_root)) {
+        return false;
+    }
+    String full = path;
+    while (full.endsWith("/")) {
+        full.remove(full.length() - 1);
+    }
+    if (!remove_files(node, full)) {
+        return false;
+    }
+    unlink(node);
+    free_node(node);
+    return true;
+}
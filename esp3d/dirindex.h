@@ -0,0 +1,76 @@
+/*
+  dirindex.h - esp3d SPIFFS directory tree class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef DIRINDEX_h
+#define DIRINDEX_h
+#include <Arduino.h>
+#include "config.h"
+
+typedef struct dir_node {
+    uint32_t size;
+    //content hash used as ETag by asset_index, computed on first request
+    uint32_t hash;
+    bool hashed;
+    bool is_dir;
+    dir_node * parent;
+    //first child and next one in same directory
+    dir_node * child;
+    dir_node * next;
+    //name in parent directory, not full path, allocated with node
+    char name[1];
+} dir_node;
+
+//empty directory is kept on SPIFFS by this file in it
+#define DIR_PLACEHOLDER "/."
+
+//SPIFFS only has full file names, so directories are built from them
+//once, then kept up to date by upload/delete/createdir
+//a directory left empty gets a DIR_PLACEHOLDER file, so it is still
+//there after restart or when index is built again
+//it is the only list of SPIFFS files, asset_index uses it too
+class DIRINDEX_CLASS
+{
+public:
+    DIRINDEX_CLASS();
+    ~DIRINDEX_CLASS();
+    void build();
+    void invalidate();
+    //path is full one like /user/macros/a.g, directories end or not with /
+    dir_node * find(const String & path);
+    void add_file(const String & path, uint32_t size);
+    bool add_dir(const String & path);
+    void remove_file(const String & path);
+    //remove all files of directory from SPIFFS then directory itself
+    bool remove_dir(const String & path);
+private:
+    dir_node _root;
+    bool _valid;
+    void clear();
+    void free_node(dir_node * node);
+    void unlink(dir_node * node);
+    dir_node * child(dir_node * dir, const char * name, size_t len, bool create, bool is_dir);
+    dir_node * walk(const String & path, bool create, bool last_is_dir);
+    bool remove_files(dir_node * dir, String & path);
+    bool keep_dir(dir_node * dir);
+};
+
+extern DIRINDEX_CLASS dir_index;
+
+#endif
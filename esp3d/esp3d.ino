@@ -33,6 +33,15 @@
 #include "bridge.h"
 #include "webinterface.h"
 #include "command.h"
+#include "webcommand.h"
+#include "dirindex.h"
+#include "printjob.h"
+#include "serialout.h"
+#include "telemetry.h"
+#include "webevents.h"
+#include "webterminal.h"
+#include "chunkupload.h"
+#include "sdupload.h"
 #ifdef ARDUINO_ARCH_ESP8266
 #include "ESP8266WiFi.h"
 #ifdef MDNS_FEATURE
@@ -145,6 +154,8 @@ void setup()
 #else
 	SPIFFS.begin();
 #endif
+    //list files once, for web files and file manager
+    dir_index.build();
        
     //setup wifi according settings
     if (!wifi_config.Setup()) {
@@ -156,6 +167,8 @@ void setup()
         }
     }
     delay(1000);
+    //setup serial readers
+    BRIDGE::begin();
     //setup servers
     if (!wifi_config.Enable_servers()) {
         ESP_SERIAL_OUT.println(F("M117 Error enabling servers"));
@@ -182,6 +195,36 @@ void loop()
 #endif
     }
         BRIDGE::processFromSerial2TCP();
+    //answer pending web commands
+    WEBCOMMAND::process();
+    //send next lines of [ESP700] job
+    print_job.process();
+    //send next lines of file uploaded to printer SD
+    sd_upload.process();
+#ifdef CHUNK_UPLOAD_FEATURE
+    //close SD upload when client does not send next chunk
+    chunk_upload.process();
+#endif
+    //write queued data to printer, realtime commands first
+    serial_out.process();
+#ifdef MONITORING_FEATURE
+    //record temperatures history
+    telemetry.process();
+#endif
+#ifdef WEB_EVENTS_FEATURE
+    //push printer state to /events clients
+    WEBEVENTS::process();
+#endif
+#ifdef WS_TERMINAL_FEATURE
+    //execute lines typed in /ws terminals
+    WEBTERMINAL::process();
+#endif
+    //commit settings changed by [ESP401]
+    CONFIG::handle_settings();
+#ifdef AUTHENTICATION_FEATURE
+    //remove expired sessions, one slot at once
+    web_interface->CheckAuthExpiry();
+#endif
     //in case of restart requested
     if (web_interface->restartmodule) {
         CONFIG::esp_restart();
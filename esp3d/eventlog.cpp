@@ -0,0 +1,82 @@
+/*
+  eventlog.cpp - esp3d printer messages log class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "eventlog.h"
+
+EVENTLOG_CLASS event_log;
+
+EVENTLOG_CLASS::EVENTLOG_CLASS()
+{
+    _head = 0;
+    _count = 0;
+    _seq = 0;
+    _clear_seq = 0;
+}
+
+//when full the oldest entry is overwritten
+uint32_t EVENTLOG_CLASS::add(const char * text, tevent_severity severity)
+{
+    tevent_entry & entry = _entries[_head];
+    _head = (_head + 1) % EVENT_LOG_SIZE;
+    if (_count < EVENT_LOG_SIZE) {
+        _count++;
+    }
+    entry.seq = ++_seq;
+    entry.time = millis();
+    entry.severity = severity;
+    size_t len = strlen(text);
+    if (len > EVENT_LOG_LENGTH) {
+        //keep room for the "..."
+        memcpy(entry.text, text, EVENT_LOG_LENGTH - 3);
+        strcpy(entry.text + EVENT_LOG_LENGTH - 3, "...");
+    } else {
+        memcpy(entry.text, text, len + 1);
+    }
+    return _seq;
+}
+
+//clear uses a sequence number, so clients see a change and drop their copy
+void EVENTLOG_CLASS::clear(tevent_severity severity)
+{
+    if (severity == EVENT_NONE) {
+        _count = 0;
+    } else {
+        for (uint8_t i = 0; i < EVENT_LOG_SIZE; i++) {
+            if (_entries[i].severity == severity) {
+                _entries[i].severity = EVENT_NONE;
+            }
+        }
+    }
+    _clear_seq = ++_seq;
+}
+
+const char * EVENTLOG_CLASS::severity_name(uint8_t severity)
+{
+    switch (severity) {
+    case EVENT_INFO:
+        return "info";
+    case EVENT_ERROR:
+        return "error";
+    case EVENT_STATUS:
+        return "status";
+    default:
+        return "none";
+    }
+}
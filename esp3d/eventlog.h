@@ -0,0 +1,84 @@
+/*
+  eventlog.h - esp3d printer messages log class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef EVENTLOG_h
+#define EVENTLOG_h
+#include <Arduino.h>
+#include "config.h"
+
+typedef enum {
+    EVENT_NONE = 0,
+    EVENT_INFO = 1,
+    EVENT_ERROR = 2,
+    EVENT_STATUS = 3
+} tevent_severity;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t time;
+    uint8_t severity;
+    char text[EVENT_LOG_LENGTH + 1];
+} tevent_entry;
+
+//fixed ring of messages, each one gets next sequence number
+//a client which knows last sequence it got only needs newer entries,
+//unless a clear happened since, then it must drop what it has
+class EVENTLOG_CLASS
+{
+public:
+    EVENTLOG_CLASS();
+    uint32_t add(const char * text, tevent_severity severity = EVENT_INFO);
+    inline uint32_t add(String & text, tevent_severity severity = EVENT_INFO)
+    {
+        return add(text.c_str(), severity);
+    };
+    //EVENT_NONE clears all
+    void clear(tevent_severity severity = EVENT_NONE);
+    //index 0 is oldest entry, removed entries have EVENT_NONE severity
+    inline const tevent_entry & get(uint8_t index)
+    {
+        return _entries[(_head + EVENT_LOG_SIZE - _count + index) % EVENT_LOG_SIZE];
+    };
+    inline uint8_t size()
+    {
+        return _count;
+    };
+    //last sequence number used
+    inline uint32_t seq()
+    {
+        return _seq;
+    };
+    //true if log has been cleared after client got since
+    inline bool reset_since(uint32_t since)
+    {
+        return since < _clear_seq;
+    };
+    static const char * severity_name(uint8_t severity);
+private:
+    tevent_entry _entries[EVENT_LOG_SIZE];
+    uint8_t _head;
+    uint8_t _count;
+    uint32_t _seq;
+    uint32_t _clear_seq;
+};
+
+extern EVENTLOG_CLASS event_log;
+
+#endif
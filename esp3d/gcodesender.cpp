@@ -0,0 +1,294 @@
+/*
+  gcodesender.cpp - esp3d gcode streaming class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gcodesender.h"
+#include "serialout.h"
+
+GCODESENDER_CLASS gcode_sender;
+
+//Constructor
+GCODESENDER_CLASS::GCODESENDER_CLASS()
+{
+    _first = 0;
+    _count = 0;
+    _next = 0;
+    _written_first = 0;
+    _pending = 0;
+    _resend_skip = 0;
+    _rejected = false;
+    _next_number = 0;
+    _last_activity = 0;
+    _retry = 0;
+    _numbered = false;
+    _active = false;
+    _error = false;
+}
+
+//start a new stream, line numbers restart at 0 with M110
+void GCODESENDER_CLASS::begin(bool numbered)
+{
+    _first = 0;
+    _count = 0;
+    _next = 0;
+    _written_first = 0;
+    _pending = 0;
+    _resend_skip = 0;
+    _rejected = false;
+    _next_number = 0;
+    _last_activity = millis();
+    _retry = 0;
+    _error = false;
+    _active = true;
+    _numbered = numbered;
+    if (_numbered) {
+        send("M110 N0");
+    }
+}
+
+void GCODESENDER_CLASS::end()
+{
+    _active = false;
+}
+
+bool GCODESENDER_CLASS::can_send()
+{
+    return _active && !_error && (_count < SENDER_WINDOW);
+}
+
+//add line to window and write it if printer can take it
+bool GCODESENDER_CLASS::send(const char * line, bool numbered)
+{
+    if (!can_send()) {
+        return false;
+    }
+    window_line & l = _window[(_first + _count) % SENDER_WINDOW];
+    int len;
+    if (numbered && _numbered) {
+        l.number = _next_number;
+        len = snprintf(l.data, SENDER_LINE_SIZE, "N%lu %s", (unsigned long)l.number, line);
+        //need room for *checksum and end of line
+        if ((len < 0) || (len > (SENDER_LINE_SIZE - 6))) {
+            _error = true;
+            return false;
+        }
+        uint8_t checksum = 0;
+        for (int i = 0; i < len; i++) {
+            checksum ^= l.data[i];
+        }
+        len += snprintf(&l.data[len], SENDER_LINE_SIZE - len, "*%u\n", checksum);
+        _next_number++;
+    } else {
+        //never matches a resend request
+        l.number = 0xFFFFFFFF;
+        len = snprintf(l.data, SENDER_LINE_SIZE, "%s\n", line);
+        if ((len < 0) || (len >= SENDER_LINE_SIZE)) {
+            _error = true;
+            return false;
+        }
+    }
+    l.len = len;
+    _count++;
+    write_pending();
+    return true;
+}
+
+//queue lines of window not written yet, as long as printer has room
+void GCODESENDER_CLASS::write_pending()
+{
+    while ((_next < _count) && (_pending < SENDER_WINDOW)) {
+        window_line & l = _window[(_first + _next) % SENDER_WINDOW];
+        if (_pending == 0) {
+            _last_activity = millis();
+        }
+        serial_out.queue((const uint8_t *)l.data, l.len, PRIO_BULK);
+        _written[(_written_first + _pending) % SENDER_WINDOW] = l.number;
+        _next++;
+        _pending++;
+    }
+}
+
+//remove oldest lines from window
+void GCODESENDER_CLASS::confirm(uint8_t nb)
+{
+    if (nb > _count) {
+        nb = _count;
+    }
+    _first = (_first + nb) % SENDER_WINDOW;
+    _count -= nb;
+    _next = (_next > nb) ? (_next - nb) : 0;
+    if (nb > 0) {
+        _retry = 0;
+    }
+}
+
+//lines up to number were received by printer
+void GCODESENDER_CLASS::confirm_to(uint32_t number)
+{
+    uint8_t nb = 0;
+    while ((nb < _count) && (_window[(_first + nb) % SENDER_WINDOW].number <= number)) {
+        nb++;
+    }
+    confirm(nb);
+}
+
+//number of a line written waiting for ok, 0 is oldest
+uint32_t GCODESENDER_CLASS::written(uint8_t index)
+{
+    return _written[(_written_first + index) % SENDER_WINDOW];
+}
+
+//line was answered before older ones, like a rejected line
+void GCODESENDER_CLASS::forget_written(uint8_t index)
+{
+    for (uint8_t i = index; i > 0; i--) {
+        _written[(_written_first + i) % SENDER_WINDOW] = _written[(_written_first + i - 1) % SENDER_WINDOW];
+    }
+    _written_first = (_written_first + 1) % SENDER_WINDOW;
+    _pending--;
+}
+
+//printer rejected a line and waits for number
+void GCODESENDER_CLASS::resend(uint32_t number)
+{
+    //lines written before number are taken and still wait for their ok
+    uint8_t index = 0;
+    while ((index < _pending) && (written(index) < number)) {
+        index++;
+    }
+    //answer to a line written before going back, already handled
+    if (_resend_skip > 0) {
+        _resend_skip--;
+        if (index < _pending) {
+            forget_written(index);
+        }
+        return;
+    }
+    if (index < _pending) {
+        //all lines written after the rejected one will be rejected too
+        _resend_skip = _pending - index - 1;
+        forget_written(index);
+    }
+    if (number > 0) {
+        confirm_to(number - 1);
+    }
+    if (_count == 0) {
+        //everything was received, only answers were lost
+        if (number != _next_number) {
+            _error = true;
+        }
+        return;
+    }
+    //line is no more in window
+    if (_window[_first].number != number) {
+        _error = true;
+        return;
+    }
+    if (++_retry > (SENDER_MAX_RETRY * SENDER_WINDOW)) {
+        _error = true;
+        return;
+    }
+    _next = 0;
+}
+
+//follow printer acknowledgements
+void GCODESENDER_CLASS::check_response(tline_event & event)
+{
+    if (!_active) {
+        return;
+    }
+    switch (event.type) {
+    case LINE_OK:
+        //answer to a line of another producer
+        if (serial_out.acknowledged() != PRIO_BULK) {
+            break;
+        }
+        if (_rejected) {
+            //rejected line was already forgotten
+            _rejected = false;
+        } else if (_pending > 0) {
+            uint32_t number = written(0);
+            forget_written(0);
+            if (number == 0xFFFFFFFF) {
+                confirm(1);
+            } else {
+                confirm_to(number);
+            }
+        } else {
+            //answer to none of ours
+            break;
+        }
+        _last_activity = millis();
+        write_pending();
+        break;
+    case LINE_WAIT:
+        //printer is idle so everything written was processed
+        if (_pending > 0) {
+            confirm(_next);
+            _pending = 0;
+            _resend_skip = 0;
+            _rejected = false;
+        }
+        write_pending();
+        break;
+    case LINE_RESEND:
+        _rejected = true;
+        _last_activity = millis();
+        if (!_numbered) {
+            _error = true;
+            break;
+        }
+        resend(strtoul(event.payload, NULL, 10));
+        break;
+    case LINE_BUSY:
+        //printer is still working on a line, nothing is lost
+        _last_activity = millis();
+        break;
+    default:
+        if (strstr(event.line, "open failed")) {
+            _error = true;
+        }
+        break;
+    }
+}
+
+//answer lost, write again lines not confirmed
+void GCODESENDER_CLASS::check_timeout()
+{
+    if (!_active || _error || (_pending == 0)) {
+        return;
+    }
+    if ((millis() - _last_activity) < SENDER_TIMEOUT) {
+        return;
+    }
+    if (++_retry > SENDER_MAX_RETRY) {
+        _error = true;
+        return;
+    }
+    _pending = 0;
+    _resend_skip = 0;
+    _rejected = false;
+    if (_numbered) {
+        //printer will ask for the right line if some were received
+        _next = 0;
+    } else {
+        //cannot resend without numbers, so consider ok was lost
+        confirm(_next);
+    }
+    write_pending();
+}
@@ -0,0 +1,102 @@
+/*
+  gcodesender.h - esp3d gcode streaming class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef GCODESENDER_h
+#define GCODESENDER_h
+#include <Arduino.h>
+#include "config.h"
+#include "tokenizer.h"
+
+//lines sent before waiting for ok, Marlin buffers 4 commands by default
+//must be a power of 2
+#define SENDER_WINDOW 4
+//longest line once framed as N<line> <gcode>*<checksum>
+#define SENDER_LINE_SIZE 128
+//ms without answer before sending again lines not confirmed
+#define SENDER_TIMEOUT 2000
+#define SENDER_MAX_RETRY 5
+
+//keep SENDER_WINDOW lines in flight, each ok confirms oldest one
+//with numbered lines a Resend: N makes sender go back to line N
+//printer answers a rejected line at once but a line it took once run, so
+//oks are matched to lines written by number, not by order of confirmation
+//lines go by bulk lane, so only oks serial_out gives to this lane count
+//nothing waits here: owner sends when can_send() and checks idle() from loop()
+class GCODESENDER_CLASS
+{
+public:
+    GCODESENDER_CLASS();
+    void begin(bool numbered);
+    void end();
+    bool can_send();
+    bool send(const char * line, bool numbered = true);
+    void check_response(tline_event & event);
+    void check_timeout();
+    inline bool active()
+    {
+        return _active;
+    };
+    inline bool error()
+    {
+        return _error;
+    };
+    //every line sent is confirmed
+    inline bool idle()
+    {
+        return (_count == 0);
+    };
+private:
+    struct window_line {
+        uint32_t number;
+        uint8_t len;
+        char data[SENDER_LINE_SIZE];
+    };
+    window_line _window[SENDER_WINDOW];
+    //oldest line not confirmed
+    uint8_t _first;
+    //lines not confirmed
+    uint8_t _count;
+    //offset in window of next line to write
+    uint8_t _next;
+    //numbers of lines written waiting for ok, oldest first
+    uint32_t _written[SENDER_WINDOW];
+    uint8_t _written_first;
+    uint8_t _pending;
+    //lines written before going back, printer will reject them
+    uint8_t _resend_skip;
+    //printer asked resend, so next ok answers the rejected line
+    bool _rejected;
+    uint32_t _next_number;
+    uint32_t _last_activity;
+    uint8_t _retry;
+    bool _numbered;
+    bool _active;
+    bool _error;
+    void write_pending();
+    void confirm(uint8_t nb);
+    void confirm_to(uint32_t number);
+    uint32_t written(uint8_t index);
+    void forget_written(uint8_t index);
+    void resend(uint32_t number);
+};
+
+extern GCODESENDER_CLASS gcode_sender;
+
+#endif
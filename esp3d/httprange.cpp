@@ -0,0 +1,63 @@
+/*
+  httprange.cpp - esp3d Range header parser
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "httprange.h"
+
+int parse_range(const String & range, size_t size, size_t & start, size_t & length)
+{
+    start = 0;
+    length = size;
+    if (!range.startsWith("bytes=") || (range.indexOf(',') != -1)) {
+        return 200;
+    }
+    const char * p = range.c_str() + 6;
+    char * end;
+    size_t last = size - 1;
+    if (*p == '-') {
+        size_t suffix = strtoul(p + 1, &end, 10);
+        if ((end == p + 1) || (*end != 0)) {
+            return 200;
+        }
+        if ((suffix == 0) || (size == 0)) {
+            return 416;
+        }
+        start = (suffix < size) ? size - suffix : 0;
+    } else {
+        start = strtoul(p, &end, 10);
+        if ((end == p) || (*end != '-')) {
+            return 200;
+        }
+        p = end + 1;
+        if (*p) {
+            last = strtoul(p, &end, 10);
+            if ((*end != 0) || (last < start)) {
+                return 200;
+            }
+            if (last >= size) {
+                last = size - 1;
+            }
+        }
+        if (start >= size) {
+            return 416;
+        }
+    }
+    length = last - start + 1;
+    return (length == size) ? 200 : 206;
+}
@@ -0,0 +1,31 @@
+/*
+  httprange.h - esp3d Range header parser
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HTTPRANGE_h
+#define HTTPRANGE_h
+#include <Arduino.h>
+
+//only one "bytes=first-last", "bytes=first-" or "bytes=-suffix" range is
+//answered: returns 206 with start and length of asked bytes, 416 when range
+//is out of content, 200 with whole content for any other header
+//bundled ESP32 WebServer declares it in its HttpRange.h, so both use this copy
+int parse_range(const String & range, size_t size, size_t & start, size_t & length);
+
+#endif
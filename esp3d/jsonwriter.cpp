@@ -0,0 +1,150 @@
+/*
+  jsonwriter.cpp - esp3d streaming json writer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "jsonwriter.h"
+
+JSONWRITER_CLASS::JSONWRITER_CLASS(Print & output) : _output(output)
+{
+    _depth = 0;
+    _has_item = 0;
+}
+
+//comma if level has already an item, then key if any
+void JSONWRITER_CLASS::next(const char * key)
+{
+    uint16_t mask = 1 << _depth;
+    if (_has_item & mask) {
+        _output.write(',');
+    }
+    _has_item |= mask;
+    if (key) {
+        _output.write('"');
+        _output.print(key);
+        _output.write((const uint8_t *)"\":", 2);
+    }
+}
+
+void JSONWRITER_CLASS::begin_object(const char * key)
+{
+    next(key);
+    _output.write('{');
+    if (_depth < (JSON_MAX_DEPTH - 1)) {
+        _depth++;
+    }
+    _has_item &= ~(1 << _depth);
+}
+
+void JSONWRITER_CLASS::end_object()
+{
+    _output.write('}');
+    if (_depth > 0) {
+        _depth--;
+    }
+}
+
+void JSONWRITER_CLASS::begin_array(const char * key)
+{
+    next(key);
+    _output.write('[');
+    if (_depth < (JSON_MAX_DEPTH - 1)) {
+        _depth++;
+    }
+    _has_item &= ~(1 << _depth);
+}
+
+void JSONWRITER_CLASS::end_array()
+{
+    _output.write(']');
+    if (_depth > 0) {
+        _depth--;
+    }
+}
+
+//text without special char is written in one piece
+void JSONWRITER_CLASS::escape(Print & output, const char * text)
+{
+    const char * start = text;
+    for (const char * p = text; *p; p++) {
+        uint8_t c = *p;
+        if ((c >= 0x20) && (c != '"') && (c != '\\')) {
+            continue;
+        }
+        if (p > start) {
+            output.write((const uint8_t *)start, p - start);
+        }
+        start = p + 1;
+        switch (c) {
+        case '"':
+            output.write((const uint8_t *)"\\\"", 2);
+            break;
+        case '\\':
+            output.write((const uint8_t *)"\\\\", 2);
+            break;
+        case '\n':
+            output.write((const uint8_t *)"\\n", 2);
+            break;
+        case '\r':
+            output.write((const uint8_t *)"\\r", 2);
+            break;
+        case '\t':
+            output.write((const uint8_t *)"\\t", 2);
+            break;
+        default: {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            output.write((const uint8_t *)buf, 6);
+        }
+        break;
+        }
+    }
+    if (*start) {
+        output.print(start);
+    }
+}
+
+void JSONWRITER_CLASS::add(const char * key, const char * value)
+{
+    next(key);
+    _output.write('"');
+    escape(_output, value ? value : "");
+    _output.write('"');
+}
+
+void JSONWRITER_CLASS::add_int(const char * key, long value)
+{
+    char buf[16];
+    next(key);
+    snprintf(buf, sizeof(buf), "%ld", value);
+    _output.print(buf);
+}
+
+void JSONWRITER_CLASS::add_uint(const char * key, unsigned long value)
+{
+    char buf[16];
+    next(key);
+    snprintf(buf, sizeof(buf), "%lu", value);
+    _output.print(buf);
+}
+
+void JSONWRITER_CLASS::add_bool(const char * key, bool value)
+{
+    next(key);
+    _output.print(value ? "true" : "false");
+}
@@ -0,0 +1,70 @@
+/*
+  jsonwriter.h - esp3d streaming json writer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef JSONWRITER_h
+#define JSONWRITER_h
+#include <Arduino.h>
+
+//max objects/arrays opened at once
+#define JSON_MAX_DEPTH 16
+
+//json is written to output as it is built, nothing is kept but
+//which levels already have an item, to know where a comma is needed
+//key is NULL for array items, keys are not escaped, string values are
+class JSONWRITER_CLASS
+{
+public:
+    JSONWRITER_CLASS(Print & output);
+    void begin_object(const char * key = NULL);
+    void end_object();
+    void begin_array(const char * key = NULL);
+    void end_array();
+    void add(const char * key, const char * value);
+    inline void add(const char * key, const String & value)
+    {
+        add(key, value.c_str());
+    };
+    void add_int(const char * key, long value);
+    void add_uint(const char * key, unsigned long value);
+    void add_bool(const char * key, bool value);
+    static void escape(Print & output, const char * text);
+private:
+    Print & _output;
+    uint8_t _depth;
+    uint16_t _has_item;
+    void next(const char * key);
+};
+
+//to build json in a String, when its size must be known before sending it
+class STRINGPRINT_CLASS : public Print
+{
+public:
+    STRINGPRINT_CLASS(String & output) : _output(output) {};
+    size_t write(uint8_t c)
+    {
+        _output += (char)c;
+        return 1;
+    };
+    using Print::write;
+private:
+    String & _output;
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*
+  printerstate.cpp - esp3d printer state class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "printerstate.h"
+
+#ifdef MONITORING_FEATURE
+
+PRINTERSTATE_CLASS printer_state;
+
+//Constructor
+PRINTERSTATE_CLASS::PRINTERSTATE_CLASS()
+{
+    reset();
+}
+
+void PRINTERSTATE_CLASS::reset()
+{
+    _version = 0;
+    _last_change = 0;
+    _status = PRINTER_UNKNOWN;
+    for (uint8_t i = 0; i < MAX_HOTENDS; i++) {
+        _hotends[i].current = 0;
+        _hotends[i].target = 0;
+        _hotends[i].present = false;
+    }
+    _bed.current = 0;
+    _bed.target = 0;
+    _bed.present = false;
+    _chamber = _bed;
+    for (uint8_t i = 0; i < 4; i++) {
+        _position[i] = 0;
+    }
+    _has_position = false;
+    _fan = -1;
+    _sd_done = 0;
+    _sd_size = 0;
+}
+
+void PRINTERSTATE_CLASS::changed()
+{
+    _version++;
+    _last_change = millis();
+}
+
+void PRINTERSTATE_CLASS::set_status(tprinter_status status)
+{
+    if (_status != status) {
+        _status = status;
+        changed();
+    }
+}
+
+void PRINTERSTATE_CLASS::set_heater(heater_state & heater, int16_t current, int16_t target)
+{
+    if (!heater.present || (heater.current != current) || (heater.target != target)) {
+        heater.current = current;
+        heater.target = target;
+        heater.present = true;
+        changed();
+    }
+}
+
+//value in tenth, return false if there is no number
+static bool read_tenth(const char * &p, int16_t & value)
+{
+    char * end;
+    while (*p == ' ') {
+        p++;
+    }
+    float v = strtod(p, &end);
+    if (end == p) {
+        return false;
+    }
+    p = end;
+    value = (int16_t)((v * 10) + ((v < 0) ? -0.5 : 0.5));
+    return true;
+}
+
+//T:20.0 /0.0 B:20.0 /0.0 T0:20.0 /0.0 T1:21.0 /0.0 @:0 B@:0
+//T: is active hotend, it is only used when there is no T0:, else
+//hotend 0 would change twice when active one is not T0
+void PRINTERSTATE_CLASS::parse_temperatures(const char * line)
+{
+    bool indexed = (strstr(line, "T0:") != NULL);
+    const char * p = line;
+    while ((p = strchr(p, ':')) != NULL) {
+        const char * key = p;
+        while ((key > line) && isalnum(key[-1])) {
+            key--;
+        }
+        size_t klen = p - key;
+        p++;
+        heater_state * heater = NULL;
+        if ((klen == 1) && (key[0] == 'T')) {
+            if (!indexed) {
+                heater = &_hotends[0];
+            }
+        } else if ((klen > 1) && (key[0] == 'T') && isdigit(key[1])) {
+            int index = atoi(key + 1);
+            if (index < MAX_HOTENDS) {
+                heater = &_hotends[index];
+            }
+        } else if ((klen == 1) && (key[0] == 'B')) {
+            heater = &_bed;
+        } else if ((klen == 1) && (key[0] == 'C')) {
+            heater = &_chamber;
+        }
+        if (!heater) {
+            continue;
+        }
+        int16_t current;
+        int16_t target = heater->target;
+        if (!read_tenth(p, current)) {
+            continue;
+        }
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p == '/') {
+            p++;
+            read_tenth(p, target);
+        }
+        set_heater(*heater, current, target);
+    }
+}
+
+//X:0.00 Y:0.00 Z:0.00 E:0.00 Count X:0 Y:0 Z:0
+//Smoothieware answer starts with ok C:
+void PRINTERSTATE_CLASS::parse_position(const char * line)
+{
+    static const char axis[] = "XYZE";
+    const char * count = strstr(line, "Count");
+    bool updated = false;
+    for (uint8_t i = 0; i < 4; i++) {
+        char key[3] = {axis[i], ':', '\0'};
+        const char * p = strstr(line, key);
+        if (!p || (count && (p > count))) {
+            continue;
+        }
+        float value = strtod(p + 2, NULL);
+        if (!_has_position || (value != _position[i])) {
+            _position[i] = value;
+            updated = true;
+        }
+    }
+    if (updated) {
+        _has_position = true;
+        changed();
+    }
+}
+
+//SD printing byte 123/4567
+void PRINTERSTATE_CLASS::parse_sd_progress(const char * line)
+{
+    char * end;
+    uint32_t done = strtoul(line, &end, 10);
+    if ((end == line) || (*end != '/')) {
+        return;
+    }
+    uint32_t size = strtoul(end + 1, NULL, 10);
+    if ((done != _sd_done) || (size != _sd_size)) {
+        _sd_done = done;
+        _sd_size = size;
+        changed();
+    }
+    set_status(PRINTER_SD_PRINTING);
+}
+
+//called for each line printer sent
+void PRINTERSTATE_CLASS::update(tline_event & event)
+{
+    const char * line = event.line;
+    switch (event.type) {
+    case LINE_BUSY:
+        set_status(PRINTER_BUSY);
+        break;
+    case LINE_OK:
+    case LINE_WAIT:
+        if ((_status == PRINTER_BUSY) || (_status == PRINTER_UNKNOWN)) {
+            set_status(PRINTER_IDLE);
+        }
+        break;
+    default:
+        break;
+    }
+    if (event.has_temperature) {
+        parse_temperatures(line);
+        return;
+    }
+    if (strncmp(line, "SD printing byte ", 17) == 0) {
+        parse_sd_progress(line + 17);
+        return;
+    }
+    if ((strncmp(line, "Not SD printing", 15) == 0) || (strncmp(line, "Done printing file", 18) == 0)) {
+        if (_status == PRINTER_SD_PRINTING) {
+            set_status(PRINTER_IDLE);
+        }
+        return;
+    }
+    //Repetier reports fan speed
+    const char * fan = strstr(line, "anspeed:");
+    if (!fan) {
+        fan = strstr(line, "anSpeed:");
+    }
+    if (fan && (fan > line) && ((fan[-1] == 'F') || (fan[-1] == 'f'))) {
+        int16_t value = atoi(fan + 8);
+        if (value != _fan) {
+            _fan = value;
+            changed();
+        }
+        return;
+    }
+    if (strncmp(line, "ok", 2) == 0) {
+        line += 2;
+    }
+    while (*line == ' ') {
+        line++;
+    }
+    if (strncmp(line, "C:", 2) == 0) {
+        line += 2;
+        while (*line == ' ') {
+            line++;
+        }
+    }
+    if (strncmp(line, "X:", 2) == 0) {
+        parse_position(line);
+    }
+}
+
+static void add_tenth(JSONWRITER_CLASS & json, const char * key, int16_t value)
+{
+    char buf[12];
+    snprintf(buf, sizeof(buf), "%s%d.%d", (value < 0) ? "-" : "", abs(value) / 10, abs(value) % 10);
+    json.add(key, buf);
+}
+
+static void add_heater(JSONWRITER_CLASS & json, const char * name, heater_state & heater)
+{
+    if (!heater.present) {
+        return;
+    }
+    json.begin_object();
+    json.add("name", name);
+    add_tenth(json, "current", heater.current);
+    add_tenth(json, "target", heater.target);
+    json.end_object();
+}
+
+//snapshot of state, nothing is asked to printer
+void PRINTERSTATE_CLASS::print_json(JSONWRITER_CLASS & json, const char * key)
+{
+    static const char * names[] = {"unknown", "idle", "busy", "printing"};
+    char buf[24];
+    json.begin_object(key);
+    json.add("version", String(_version));
+    json.add("state", names[_status]);
+    json.add("age", String(_version ? (millis() - _last_change) : 0));
+    json.begin_array("heaters");
+    for (uint8_t i = 0; i < MAX_HOTENDS; i++) {
+        snprintf(buf, sizeof(buf), "T%d", i);
+        add_heater(json, buf, _hotends[i]);
+    }
+    add_heater(json, "B", _bed);
+    add_heater(json, "C", _chamber);
+    json.end_array();
+    if (_has_position) {
+        static const char * axis[] = {"X", "Y", "Z", "E"};
+        json.begin_object("position");
+        for (uint8_t i = 0; i < 4; i++) {
+            snprintf(buf, sizeof(buf), "%.2f", _position[i]);
+            json.add(axis[i], buf);
+        }
+        json.end_object();
+    }
+    if (_fan >= 0) {
+        json.add("fan", String(_fan));
+    }
+    if (_sd_size > 0) {
+        json.begin_object("sd");
+        json.add("done", String(_sd_done));
+        json.add("size", String(_sd_size));
+        json.add("progress", String((uint32_t)(((uint64_t)_sd_done * 100) / _sd_size)));
+        json.end_object();
+    }
+    json.end_object();
+}
+
+#endif //MONITORING_FEATURE
@@ -0,0 +1,90 @@
+/*
+  printerstate.h - esp3d printer state class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef PRINTERSTATE_h
+#define PRINTERSTATE_h
+#include <Arduino.h>
+#include "config.h"
+#include "tokenizer.h"
+#include "jsonwriter.h"
+
+#ifdef MONITORING_FEATURE
+
+typedef enum {
+    PRINTER_UNKNOWN = 0,
+    PRINTER_IDLE = 1,
+    PRINTER_BUSY = 2,
+    PRINTER_SD_PRINTING = 3
+} tprinter_status;
+
+//temperatures are in tenth of degree
+typedef struct {
+    int16_t current;
+    int16_t target;
+    bool present;
+} heater_state;
+
+//last values printer reported, updated from each answer line
+//version changes each time a value changes, so a client can
+//know if it already has last state
+class PRINTERSTATE_CLASS
+{
+public:
+    PRINTERSTATE_CLASS();
+    void reset();
+    void update(tline_event & event);
+    void print_json(JSONWRITER_CLASS & json, const char * key = NULL);
+    inline uint32_t version()
+    {
+        return _version;
+    };
+    inline heater_state & hotend(uint8_t index)
+    {
+        return _hotends[index];
+    };
+    inline heater_state & bed()
+    {
+        return _bed;
+    };
+private:
+    uint32_t _version;
+    uint32_t _last_change;
+    tprinter_status _status;
+    heater_state _hotends[MAX_HOTENDS];
+    heater_state _bed;
+    heater_state _chamber;
+    float _position[4];
+    bool _has_position;
+    int16_t _fan;
+    uint32_t _sd_done;
+    uint32_t _sd_size;
+    void changed();
+    void set_status(tprinter_status status);
+    void set_heater(heater_state & heater, int16_t current, int16_t target);
+    void parse_temperatures(const char * line);
+    void parse_position(const char * line);
+    void parse_sd_progress(const char * line);
+};
+
+extern PRINTERSTATE_CLASS printer_state;
+
+#endif //MONITORING_FEATURE
+
+#endif
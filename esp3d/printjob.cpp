@@ -0,0 +1,257 @@
+/*
+  printjob.cpp - esp3d print from flash class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "printjob.h"
+#include "command.h"
+#include "bridge.h"
+#include "webinterface.h"
+#include "sdupload.h"
+#include "serialout.h"
+#include "jsonwriter.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "SPIFFS.h"
+#endif
+
+//lines handled in one loop(), comments and empty lines included
+#define PRINTJOB_LINES_PER_LOOP 16
+
+PRINTJOB_CLASS print_job;
+
+//Constructor
+PRINTJOB_CLASS::PRINTJOB_CLASS()
+{
+    _status = JOB_IDLE;
+    _auth_level = LEVEL_GUEST;
+    _size = 0;
+    _processed = 0;
+    _lines = 0;
+    _start_time = 0;
+    _end_time = 0;
+    _buffer_pos = 0;
+    _buffer_len = 0;
+    _line_len = 0;
+    _line_too_long = false;
+}
+
+bool PRINTJOB_CLASS::start(const String & filename, level_authenticate_type auth_level)
+{
+    //only one job at once, and not during SD upload or raw mode
+    if (active() || sd_upload.active() || serial_out.raw_active()) {
+        return false;
+    }
+    _filename = filename;
+    _filename.trim();
+    if ((_filename.length() > 0) && (_filename[0] != '/')) {
+        _filename = "/" + _filename;
+    }
+    _file = SPIFFS.open(_filename, SPIFFS_FILE_READ);
+    if (!_file) {
+        return false;
+    }
+    _auth_level = auth_level;
+    _size = _file.size();
+    _processed = 0;
+    _lines = 0;
+    _start_time = millis();
+    _buffer_pos = 0;
+    _buffer_len = 0;
+    _line_len = 0;
+    _line_too_long = false;
+    //line number and checksum only if FW handles resend
+    byte fw = CONFIG::GetFirmwareTarget();
+    gcode_sender.begin((fw == MARLIN) || (fw == MARLINKIMBRA) || (fw == REPETIER) || (fw == REPETIER4DV));
+    _status = JOB_RUNNING;
+    LOG("Job started\r\n")
+    return true;
+}
+
+//no new line is sent, lines in flight are still confirmed
+bool PRINTJOB_CLASS::pause()
+{
+    if (_status != JOB_RUNNING) {
+        return false;
+    }
+    _status = JOB_PAUSED;
+    return true;
+}
+
+bool PRINTJOB_CLASS::resume()
+{
+    if (_status != JOB_PAUSED) {
+        return false;
+    }
+    _status = JOB_RUNNING;
+    return true;
+}
+
+bool PRINTJOB_CLASS::abort()
+{
+    if (!active()) {
+        return false;
+    }
+    finish(JOB_ABORTED);
+    return true;
+}
+
+void PRINTJOB_CLASS::finish(tjob_status status)
+{
+    _file.close();
+    gcode_sender.end();
+    _end_time = millis();
+    _status = status;
+    LOG("Job ended\r\n")
+}
+
+//extract next line from file, using read ahead buffer
+//return false at end of file
+bool PRINTJOB_CLASS::next_line()
+{
+    _line_len = 0;
+    _line_too_long = false;
+    bool has_data = false;
+    while (true) {
+        if (_buffer_pos >= _buffer_len) {
+            int len = _file.available() ? _file.read(_buffer, PRINTJOB_BUFFER_SIZE) : 0;
+            if (len <= 0) {
+                _buffer_len = 0;
+                _buffer_pos = 0;
+                break;
+            }
+            _buffer_len = len;
+            _buffer_pos = 0;
+        }
+        //copy until end of line
+        const uint8_t * start = &_buffer[_buffer_pos];
+        size_t avail = _buffer_len - _buffer_pos;
+        const uint8_t * eol = (const uint8_t *)memchr(start, '\n', avail);
+        size_t seg = eol ? (eol - start) : avail;
+        has_data = true;
+        for (size_t i = 0; i < seg; i++) {
+            if (start[i] == '\r') {
+                continue;
+            }
+            if (_line_len < (SENDER_LINE_SIZE - 1)) {
+                _line[_line_len++] = start[i];
+            } else {
+                _line_too_long = true;
+            }
+        }
+        _buffer_pos += seg;
+        _processed += seg;
+        if (eol) {
+            _buffer_pos++;
+            _processed++;
+            break;
+        }
+    }
+    _line[_line_len] = '\0';
+    return has_data;
+}
+
+//send line to printer, or execute it if it is an [ESP] command
+bool PRINTJOB_CLASS::send_line()
+{
+    char * line = _line;
+    char * esp = strstr(line, "[ESP");
+    if (esp) {
+        char * cmd_end = strchr(esp, ']');
+        int cmd = atoi(esp + 4);
+        //if not a valid [ESPXXX] command ignore it
+        if (cmd_end && (cmd != 0)) {
+            COMMAND::execute_command(cmd, String(cmd_end + 1), NO_PIPE, _auth_level);
+        }
+        return true;
+    }
+    //remove comment and spaces to save transfer time
+    char * comment = strchr(line, ';');
+    if (comment) {
+        *comment = '\0';
+    } else if (_line_too_long) {
+        return false;
+    }
+    size_t len = strlen(line);
+    while ((len > 0) && (line[len - 1] == ' ')) {
+        line[--len] = '\0';
+    }
+    while (*line == ' ') {
+        line++;
+    }
+    if (*line == '\0') {
+        return true;
+    }
+    _lines++;
+    return gcode_sender.send(line);
+}
+
+//called in loop, send lines as long as printer has room for them
+void PRINTJOB_CLASS::process()
+{
+    if (!active()) {
+        return;
+    }
+    gcode_sender.check_timeout();
+    if (gcode_sender.error()) {
+        finish(JOB_ERROR);
+        return;
+    }
+    if (_status == JOB_PAUSED) {
+        return;
+    }
+    for (uint8_t i = 0; (i < PRINTJOB_LINES_PER_LOOP) && gcode_sender.can_send(); i++) {
+        if (!next_line()) {
+            //end of file, wait printer confirms every line
+            if (gcode_sender.idle()) {
+                finish(JOB_DONE);
+            }
+            return;
+        }
+        if (!send_line()) {
+            finish(JOB_ERROR);
+            return;
+        }
+        //[ESP] command in file may pause or abort job
+        if (_status != JOB_RUNNING) {
+            return;
+        }
+    }
+}
+
+//[ESP701] answer
+void PRINTJOB_CLASS::print_status(tpipe output)
+{
+    static const char * names[] = {"idle", "running", "paused", "done", "aborted", "error"};
+    //file name can have any char, so it is escaped
+    PIPEPRINT_CLASS pipe(output);
+    JSONWRITER_CLASS json(pipe);
+    json.begin_object();
+    json.add("status", names[_status]);
+    json.add("file", _filename);
+    json.add_uint("size", _size);
+    json.add_uint("processed", _processed);
+    json.add_uint("progress", _size ? ((uint64_t)_processed * 100) / _size : 0);
+    json.add_uint("lines", _lines);
+    uint32_t duration = 0;
+    if (_start_time && (_status != JOB_IDLE)) {
+        duration = (active() ? millis() : _end_time) - _start_time;
+    }
+    json.add_uint("time", duration / 1000);
+    json.end_object();
+    BRIDGE::println(F(""), output);
+}
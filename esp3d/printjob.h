@@ -0,0 +1,91 @@
+/*
+  printjob.h - esp3d print from flash class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef PRINTJOB_h
+#define PRINTJOB_h
+#include <Arduino.h>
+#include "config.h"
+#ifndef FS_NO_GLOBALS
+#define FS_NO_GLOBALS
+#endif
+#include <FS.h>
+#include "gcodesender.h"
+
+//file is read by blocks of this size
+#define PRINTJOB_BUFFER_SIZE 512
+
+typedef enum {
+    JOB_IDLE = 0,
+    JOB_RUNNING = 1,
+    JOB_PAUSED = 2,
+    JOB_DONE = 3,
+    JOB_ABORTED = 4,
+    JOB_ERROR = 5
+} tjob_status;
+
+//file is sent to printer from loop(), a new line is sent each time
+//printer confirms one, so web server and bridge keep working
+//lines go by bulk lane, serial is not locked so web, tcp and ws commands
+//are written between them by turns
+class PRINTJOB_CLASS
+{
+public:
+    PRINTJOB_CLASS();
+    bool start(const String & filename, level_authenticate_type auth_level);
+    bool pause();
+    bool resume();
+    bool abort();
+    void process();
+    void print_status(tpipe output);
+    inline bool active()
+    {
+        return (_status == JOB_RUNNING) || (_status == JOB_PAUSED);
+    };
+    inline tjob_status status()
+    {
+        return _status;
+    };
+private:
+    FS_FILE _file;
+    String _filename;
+    tjob_status _status;
+    level_authenticate_type _auth_level;
+    uint32_t _size;
+    uint32_t _processed;
+    uint32_t _lines;
+    uint32_t _start_time;
+    //time job stopped, so a finished job does not get older
+    uint32_t _end_time;
+    //read ahead buffer
+    uint8_t _buffer[PRINTJOB_BUFFER_SIZE];
+    uint16_t _buffer_pos;
+    uint16_t _buffer_len;
+    //line being extracted
+    char _line[SENDER_LINE_SIZE];
+    uint16_t _line_len;
+    bool _line_too_long;
+    bool next_line();
+    bool send_line();
+    void finish(tjob_status status);
+};
+
+extern PRINTJOB_CLASS print_job;
+
+#endif
@@ -0,0 +1,116 @@
+/*
+  responsewriter.cpp - esp3d chunked web response writer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "responsewriter.h"
+#include "webinterface.h"
+
+RESPONSEWRITER_CLASS response_writer;
+
+#ifdef ARDUINO_ARCH_ESP8266
+typedef ESP8266WebServer WEBSERVER_TYPE;
+#else
+typedef WebServer WEBSERVER_TYPE;
+#endif
+
+//server only chunks answers to HTTP/1.1 clients, but version is protected
+class WEBSERVER_VERSION : public WEBSERVER_TYPE
+{
+public:
+    static bool http11(WEBSERVER_TYPE & server)
+    {
+        return server.*(&WEBSERVER_VERSION::_currentVersion) != 0;
+    }
+};
+
+RESPONSEWRITER_CLASS::RESPONSEWRITER_CLASS()
+{
+    _len = 0;
+    _started = false;
+    _chunked = false;
+}
+
+//send headers, data will follow
+void RESPONSEWRITER_CLASS::begin(int code, const char * content_type)
+{
+    web_interface->web_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    web_interface->web_server.sendHeader("Cache-Control","no-cache");
+    web_interface->web_server.send(code, content_type, "");
+    _chunked = WEBSERVER_VERSION::http11(web_interface->web_server);
+    _len = 0;
+    _started = true;
+}
+
+void RESPONSEWRITER_CLASS::send_chunk()
+{
+    if (_len == 0) {
+        return;
+    }
+    uint8_t * data = _buffer + RESPONSE_HEADER_ROOM;
+    size_t len = _len;
+    if (_chunked) {
+        //size line is put just before data
+        char header[RESPONSE_HEADER_ROOM + 1];
+        size_t header_len = sprintf(header, "%x\r\n", (unsigned int)_len);
+        data -= header_len;
+        memcpy(data, header, header_len);
+        memcpy(data + header_len + _len, "\r\n", 2);
+        len += header_len + 2;
+    }
+    web_interface->web_server.client().write(data, len);
+    _len = 0;
+}
+
+size_t RESPONSEWRITER_CLASS::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t RESPONSEWRITER_CLASS::write(const uint8_t * data, size_t len)
+{
+    if (!_started) {
+        return 0;
+    }
+    size_t done = 0;
+    while (done < len) {
+        size_t nb = RESPONSE_CHUNK_SIZE - _len;
+        if (nb > (len - done)) {
+            nb = len - done;
+        }
+        memcpy(_buffer + RESPONSE_HEADER_ROOM + _len, data + done, nb);
+        _len += nb;
+        done += nb;
+        if (_len == RESPONSE_CHUNK_SIZE) {
+            send_chunk();
+        }
+    }
+    return done;
+}
+
+//send what is left and last chunk
+void RESPONSEWRITER_CLASS::end()
+{
+    if (!_started) {
+        return;
+    }
+    send_chunk();
+    //server knows answer is complete, so connection can be kept
+    web_interface->web_server.sendContent("");
+    _started = false;
+}
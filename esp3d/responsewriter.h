@@ -0,0 +1,63 @@
+/*
+  responsewriter.h - esp3d chunked web response writer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef RESPONSEWRITER_h
+#define RESPONSEWRITER_h
+#include <Arduino.h>
+#include "config.h"
+#ifdef ARDUINO_ARCH_ESP8266
+#include <ESP8266WebServer.h>
+#else
+#include <WebServer.h>
+#endif
+
+//room before data for chunk size line, 4 hex digits and \r\n
+#define RESPONSE_HEADER_ROOM 6
+//data in one chunk, so size line, data and \r\n fit in one TCP segment
+#define RESPONSE_CHUNK_SIZE (HTTP_DOWNLOAD_UNIT_SIZE - RESPONSE_HEADER_ROOM - 2)
+
+//answer of unknown length for current web request
+//data is kept in one buffer which is sent as a chunk, with size line
+//written in place before data, in one write, when full or at end
+//HTTP/1.0 clients get raw data and server closes connection
+class RESPONSEWRITER_CLASS : public Print
+{
+public:
+    RESPONSEWRITER_CLASS();
+    void begin(int code, const char * content_type);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t * data, size_t len);
+    using Print::write;
+    void end();
+    inline bool started()
+    {
+        return _started;
+    };
+private:
+    uint8_t _buffer[RESPONSE_HEADER_ROOM + RESPONSE_CHUNK_SIZE + 2];
+    size_t _len;
+    bool _started;
+    bool _chunked;
+    void send_chunk();
+};
+
+extern RESPONSEWRITER_CLASS response_writer;
+
+#endif
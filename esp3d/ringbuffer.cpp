@@ -0,0 +1,147 @@
+/*
+  ringbuffer.cpp - esp3d serial ring buffer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ringbuffer.h"
+
+//positions are free running counters, only masked when accessing buffer
+#define RING_MASK (SERIAL_RING_SIZE - 1)
+
+RINGBUFFER_CLASS serial_ring;
+
+//Constructor
+RINGBUFFER_CLASS::RINGBUFFER_CLASS()
+{
+    _head = 0;
+    for (uint8_t i = 0; i < MAX_RING_READERS; i++) {
+        _readers[i].tail = 0;
+        _readers[i].dropped = 0;
+        _readers[i].used = false;
+        _readers[i].lossy = false;
+    }
+}
+
+//forget any pending data for all readers
+void RINGBUFFER_CLASS::clear()
+{
+    for (uint8_t i = 0; i < MAX_RING_READERS; i++) {
+        _readers[i].tail = _head;
+    }
+}
+
+//space left before overwriting data a lossless reader did not read yet
+size_t RINGBUFFER_CLASS::free_space()
+{
+    uint32_t used = 0;
+    for (uint8_t i = 0; i < MAX_RING_READERS; i++) {
+        if (_readers[i].used && !_readers[i].lossy) {
+            if ((_head - _readers[i].tail) > used) {
+                used = _head - _readers[i].tail;
+            }
+        }
+    }
+    return SERIAL_RING_SIZE - used;
+}
+
+//give contiguous free space where writer can put data directly
+size_t RINGBUFFER_CLASS::write_space(uint8_t ** data)
+{
+    size_t space = free_space();
+    size_t pos = _head & RING_MASK;
+    if (space > (SERIAL_RING_SIZE - pos)) {
+        space = SERIAL_RING_SIZE - pos;
+    }
+    *data = &_buffer[pos];
+    return space;
+}
+
+//make written data visible to readers
+void RINGBUFFER_CLASS::commit(size_t len)
+{
+    _head += len;
+}
+
+//reader starts at current position, older data are not seen
+void RINGBUFFER_CLASS::attach(uint8_t reader, bool lossy)
+{
+    if (reader >= MAX_RING_READERS) {
+        return;
+    }
+    _readers[reader].tail = _head;
+    _readers[reader].dropped = 0;
+    _readers[reader].lossy = lossy;
+    _readers[reader].used = true;
+}
+
+void RINGBUFFER_CLASS::detach(uint8_t reader)
+{
+    if (reader >= MAX_RING_READERS) {
+        return;
+    }
+    _readers[reader].used = false;
+}
+
+size_t RINGBUFFER_CLASS::available(uint8_t reader)
+{
+    if (!attached(reader)) {
+        return 0;
+    }
+    ring_reader & r = _readers[reader];
+    //reader was overrun so jump to oldest data still in buffer
+    if ((_head - r.tail) > SERIAL_RING_SIZE) {
+        r.dropped += (_head - r.tail) - SERIAL_RING_SIZE;
+        r.tail = _head - SERIAL_RING_SIZE;
+    }
+    return _head - r.tail;
+}
+
+//give contiguous readable data without copying them
+size_t RINGBUFFER_CLASS::peek(uint8_t reader, const uint8_t ** data)
+{
+    size_t len = available(reader);
+    if (len == 0) {
+        return 0;
+    }
+    size_t pos = _readers[reader].tail & RING_MASK;
+    if (len > (SERIAL_RING_SIZE - pos)) {
+        len = SERIAL_RING_SIZE - pos;
+    }
+    *data = &_buffer[pos];
+    return len;
+}
+
+void RINGBUFFER_CLASS::consume(uint8_t reader, size_t len)
+{
+    size_t max = available(reader);
+    if (len > max) {
+        len = max;
+    }
+    if (len > 0) {
+        _readers[reader].tail += len;
+    }
+}
+
+//number of bytes a lossy reader missed since attached
+uint32_t RINGBUFFER_CLASS::dropped(uint8_t reader)
+{
+    if (!attached(reader)) {
+        return 0;
+    }
+    available(reader);
+    return _readers[reader].dropped;
+}
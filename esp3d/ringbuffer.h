@@ -0,0 +1,83 @@
+/*
+  ringbuffer.h - esp3d serial ring buffer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef RINGBUFFER_h
+#define RINGBUFFER_h
+#include <Arduino.h>
+#include "config.h"
+
+#if (SERIAL_RING_SIZE & (SERIAL_RING_SIZE - 1)) != 0
+#error SERIAL_RING_SIZE must be a power of 2
+#endif
+
+//readers of serial ring
+#define RING_READER_COMMAND 0
+//first tcp client, each data port client has its own lossy reader
+#define RING_READER_TCP 1
+#ifdef TCP_IP_DATA_FEATURE
+#define RING_READER_WS (RING_READER_TCP + MAX_SRV_CLIENTS)
+#else
+#define RING_READER_WS RING_READER_TCP
+#endif
+//first websocket terminal client, lossy too
+#ifdef WS_TERMINAL_FEATURE
+#define MAX_RING_READERS (RING_READER_WS + MAX_WS_CLIENTS)
+#else
+#define MAX_RING_READERS RING_READER_WS
+#endif
+
+//one writer (UART), several readers each with its own cursor
+//a lossless reader holds the writer back, a lossy one is overrun
+//and just skips what it missed
+class RINGBUFFER_CLASS
+{
+public:
+    RINGBUFFER_CLASS();
+    void clear();
+    //writer side
+    size_t write_space(uint8_t ** data);
+    void commit(size_t len);
+    //reader side
+    void attach(uint8_t reader, bool lossy = false);
+    void detach(uint8_t reader);
+    size_t available(uint8_t reader);
+    size_t peek(uint8_t reader, const uint8_t ** data);
+    void consume(uint8_t reader, size_t len);
+    uint32_t dropped(uint8_t reader);
+    inline bool attached(uint8_t reader)
+    {
+        return (reader < MAX_RING_READERS) && _readers[reader].used;
+    };
+private:
+    struct ring_reader {
+        uint32_t tail;
+        uint32_t dropped;
+        bool used;
+        bool lossy;
+    };
+    uint8_t _buffer[SERIAL_RING_SIZE];
+    uint32_t _head;
+    ring_reader _readers[MAX_RING_READERS];
+    size_t free_space();
+};
+
+extern RINGBUFFER_CLASS serial_ring;
+
+#endif
@@ -0,0 +1,243 @@
+/*
+  sdupload.cpp - esp3d upload to printer SD class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "sdupload.h"
+#include "webinterface.h"
+#include "serialout.h"
+#include "printjob.h"
+
+SDUPLOAD_CLASS sd_upload;
+
+//Constructor
+SDUPLOAD_CLASS::SDUPLOAD_CLASS()
+{
+    _status = SD_UPLOAD_IDLE;
+    _source_end = false;
+    _close_sent = false;
+    _received = 0;
+    _data = NULL;
+    _data_len = 0;
+    _data_pos = 0;
+    _data_owned = false;
+    _line_len = 0;
+    _is_comment = false;
+}
+
+//Destructor
+SDUPLOAD_CLASS::~SDUPLOAD_CLASS()
+{
+    release_data();
+}
+
+//ask printer to open file, only one upload or job at once
+//and none while UART is given to a raw client
+bool SDUPLOAD_CLASS::start(const String & filename)
+{
+    if (active() || print_job.active() || serial_out.raw_active()) {
+        return false;
+    }
+    _filename = filename;
+    _source_end = false;
+    _close_sent = false;
+    _received = 0;
+    _line_len = 0;
+    _is_comment = false;
+    serial_out.println("M117 Uploading...");
+    //printer would write other lines in file
+    serial_out.hold(true);
+    //line number and checksum only if FW handles resend
+    byte fw = CONFIG::GetFirmwareTarget();
+    gcode_sender.begin((fw == MARLIN) || (fw == MARLINKIMBRA) || (fw == REPETIER) || (fw == REPETIER4DV));
+    String command = "M28 " + _filename;
+    LOG(command);
+    LOG("\r\n");
+    if (!gcode_sender.send(command.c_str(), false)) {
+        finish(false);
+        return false;
+    }
+    _status = SD_UPLOAD_OPENING;
+    return true;
+}
+
+bool SDUPLOAD_CLASS::begin(const String & filename)
+{
+    return start(filename);
+}
+
+bool SDUPLOAD_CLASS::feed(uint8_t * data, size_t len, bool owned)
+{
+    if (!ready()) {
+        return false;
+    }
+    _data = data;
+    _data_len = len;
+    _data_pos = 0;
+    _data_owned = owned;
+    _received += len;
+    return true;
+}
+
+void SDUPLOAD_CLASS::end()
+{
+    _source_end = true;
+}
+
+void SDUPLOAD_CLASS::abort()
+{
+    if (active()) {
+        finish(false);
+    }
+}
+
+void SDUPLOAD_CLASS::release_data()
+{
+    if (_data_owned && _data) {
+        free(_data);
+    }
+    _data = NULL;
+    _data_len = 0;
+    _data_pos = 0;
+    _data_owned = false;
+}
+
+//data given by feed() not split yet
+bool SDUPLOAD_CLASS::next_data()
+{
+    if (_data && (_data_pos < _data_len)) {
+        return true;
+    }
+    release_data();
+    return false;
+}
+
+//send line without comment and spaces, empty lines are skipped
+bool SDUPLOAD_CLASS::send_line()
+{
+    char * line = _line;
+    int size = _line_len;
+    _line_len = 0;
+    _is_comment = false;
+    while ((size > 0) && (line[size - 1] == ' ')) {
+        size--;
+    }
+    line[size] = '\0';
+    while (*line == ' ') {
+        line++;
+    }
+    if (*line == '\0') {
+        return true;
+    }
+    return gcode_sender.send(line);
+}
+
+//split data in lines as long as printer has room for them
+//a line not finished at end of data is kept for next data
+bool SDUPLOAD_CLASS::send_lines()
+{
+    while (gcode_sender.can_send() && next_data()) {
+        while ((_data_pos < _data_len) && gcode_sender.can_send()) {
+            char c = _data[_data_pos++];
+            if (c == '\n') {
+                if (!send_line()) {
+                    return false;
+                }
+            } else if ((c == ';') || _is_comment) {
+                //comments are not sent to save transfer time and printer buffer
+                _is_comment = true;
+            } else if (c != '\r') {
+                if (_line_len >= SENDER_LINE_SIZE - 1) {
+                    LOG("\r\nlong line detected\r\n");
+                    return false;
+                }
+                _line[_line_len++] = c;
+            }
+        }
+    }
+    //buffer split to its end is given back now, not once printer has room
+    next_data();
+    return true;
+}
+
+//called in loop, never waits for printer
+void SDUPLOAD_CLASS::process()
+{
+    if (!active()) {
+        return;
+    }
+    gcode_sender.check_timeout();
+    if (gcode_sender.error()) {
+        LOG("SD upload error\r\n");
+        finish(false);
+        return;
+    }
+    switch (_status) {
+    case SD_UPLOAD_OPENING:
+        //lines already read by printer would not go to file
+        if (gcode_sender.idle()) {
+            _status = SD_UPLOAD_SENDING;
+        }
+        break;
+    case SD_UPLOAD_SENDING:
+        if (!send_lines()) {
+            finish(false);
+            return;
+        }
+        if (_source_end && !next_data() && gcode_sender.can_send()) {
+            //last line may not have '\n'
+            if (!send_line()) {
+                finish(false);
+                return;
+            }
+            _status = SD_UPLOAD_CLOSING;
+        }
+        break;
+    case SD_UPLOAD_CLOSING:
+        //every line is confirmed before closing file, then M29 too
+        if (gcode_sender.idle()) {
+            if (_close_sent) {
+                finish(true);
+            } else if (gcode_sender.send("M29")) {
+                _close_sent = true;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+//M29 is sent again without line number if upload failed, then file is removed
+void SDUPLOAD_CLASS::finish(bool success)
+{
+    bool opened = active();
+    gcode_sender.end();
+    //file is closed before held lines are written
+    if (!success && opened) {
+        serial_out.command("M29", PRIO_URGENT);
+    }
+    serial_out.hold(false);
+    release_data();
+    if (!success && opened) {
+        serial_out.println("M30 " + _filename);
+    }
+    serial_out.println(success ? "M117 SD upload done" : "M117 SD upload failed");
+    _status = success ? SD_UPLOAD_DONE : SD_UPLOAD_ERROR;
+    LOG(success ? "SD upload done\r\n" : "SD upload failed\r\n");
+}
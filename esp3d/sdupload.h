@@ -0,0 +1,102 @@
+/*
+  sdupload.h - esp3d upload to printer SD class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SDUPLOAD_h
+#define SDUPLOAD_h
+#include <Arduino.h>
+#include "config.h"
+#include "gcodesender.h"
+
+typedef enum {
+    SD_UPLOAD_IDLE = 0,
+    //M28 sent, waiting printer opened file
+    SD_UPLOAD_OPENING = 1,
+    SD_UPLOAD_SENDING = 2,
+    //M29 sent, waiting printer closed file
+    SD_UPLOAD_CLOSING = 3,
+    SD_UPLOAD_DONE = 4,
+    SD_UPLOAD_ERROR = 5
+} tsd_upload_status;
+
+//file is written on printer SD by M28/M29 from loop(), a new line is sent
+//each time printer confirms one, so web server never waits for printer
+//data comes from buffers given by feed() one at once
+class SDUPLOAD_CLASS
+{
+public:
+    SDUPLOAD_CLASS();
+    ~SDUPLOAD_CLASS();
+    //data will come by feed()
+    bool begin(const String & filename);
+    //owned buffer comes from malloc() and is freed once sent, else
+    //caller keeps it until ready() says it was split in lines
+    bool feed(uint8_t * data, size_t len, bool owned = true);
+    //no more data after what was fed
+    void end();
+    void abort();
+    void process();
+    inline bool active()
+    {
+        return (_status == SD_UPLOAD_OPENING) || (_status == SD_UPLOAD_SENDING) || (_status == SD_UPLOAD_CLOSING);
+    };
+    inline tsd_upload_status status()
+    {
+        return _status;
+    };
+    //a new buffer can be fed
+    inline bool ready()
+    {
+        return active() && (_data == NULL) && !_source_end;
+    };
+    //data given so far
+    inline uint32_t received()
+    {
+        return _received;
+    };
+    inline const String & filename()
+    {
+        return _filename;
+    };
+private:
+    tsd_upload_status _status;
+    String _filename;
+    //no more data to come
+    bool _source_end;
+    bool _close_sent;
+    uint32_t _received;
+    //data being split in lines
+    uint8_t * _data;
+    size_t _data_len;
+    size_t _data_pos;
+    bool _data_owned;
+    char _line[SENDER_LINE_SIZE];
+    uint16_t _line_len;
+    bool _is_comment;
+    bool start(const String & filename);
+    bool next_data();
+    void release_data();
+    bool send_lines();
+    bool send_line();
+    void finish(bool success);
+};
+
+extern SDUPLOAD_CLASS sd_upload;
+
+#endif
@@ -0,0 +1,357 @@
+/*
+  serialout.cpp - esp3d serial output scheduler class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "serialout.h"
+
+//positions are free running counters, only masked when accessing buffer
+#define OUT_MASK (SERIAL_OUT_QUEUE_SIZE - 1)
+#define ACK_MASK (SERIAL_OUT_ACK_SIZE - 1)
+
+//M112 emergency stop, M108 break heating wait, M410 quick stop
+static const uint16_t realtime_codes[] = {112, 108, 410};
+
+SERIALOUT_CLASS serial_out;
+
+//Constructor
+SERIALOUT_CLASS::SERIALOUT_CLASS()
+{
+    for (uint8_t i = 0; i < SERIAL_OUT_LANES; i++) {
+        _lanes[i].head = 0;
+        _lanes[i].tail = 0;
+        _line_data[i] = false;
+        _line_comment[i] = false;
+        _acks[i] = 0;
+        _tags[i] = 0;
+        _tag_ends[i] = 0;
+    }
+    _ack_head = 0;
+    _ack_tail = 0;
+    _acked = NO_LANE;
+    _acked_tag = 0;
+    _held = false;
+    _raw = false;
+    _owner = NO_LANE;
+    _turn = PRIO_INTERACTIVE;
+    _sent = 0;
+}
+
+//Print interface, used by print() and println()
+size_t SERIALOUT_CLASS::write(uint8_t c)
+{
+    return queue(&c, 1, PRIO_INTERACTIVE);
+}
+
+size_t SERIALOUT_CLASS::write(const uint8_t * data, size_t len)
+{
+    return queue(data, len, PRIO_INTERACTIVE);
+}
+
+size_t SERIALOUT_CLASS::pending(tserial_priority prio)
+{
+    return _lanes[prio].head - _lanes[prio].tail;
+}
+
+size_t SERIALOUT_CLASS::room(tserial_priority prio)
+{
+    return SERIAL_OUT_QUEUE_SIZE - pending(prio);
+}
+
+//interactive lines are kept in lane while printer writes a file on SD
+//as printer would write them in file too, other lanes go on
+void SERIALOUT_CLASS::hold(bool on)
+{
+    _held = on;
+}
+
+//raw data must not be mixed with lines, so lanes wait until raw mode ends
+void SERIALOUT_CLASS::raw(bool on)
+{
+    _raw = on;
+}
+
+//lane is not written for now
+bool SERIALOUT_CLASS::lane_held(uint8_t lane)
+{
+    return _raw || (_held && (lane == PRIO_INTERACTIVE));
+}
+
+//raw data wait for end of line already started by a lane
+size_t SERIALOUT_CLASS::raw_room()
+{
+    if (!_raw || (_owner != NO_LANE)) {
+        return 0;
+    }
+    return ESP_SERIAL_OUT.availableForWrite();
+}
+
+//raw data are not tracked, printer answers are not expected for them
+size_t SERIALOUT_CLASS::write_raw(const uint8_t * data, size_t len)
+{
+    size_t room = raw_room();
+    if (len > room) {
+        len = room;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    return ESP_SERIAL_OUT.write(data, len);
+}
+
+//wait UART takes enough data to queue len bytes in lane
+//a held lane does not move, so nothing is waited for
+void SERIALOUT_CLASS::reserve(tserial_priority prio, size_t len)
+{
+    if (len > SERIAL_OUT_QUEUE_SIZE) {
+        len = SERIAL_OUT_QUEUE_SIZE;
+    }
+    while ((room(prio) < len) && !lane_held(prio)) {
+        process();
+        delay(0);
+    }
+}
+
+//data are written by process(), so a line can be queued in several parts
+size_t SERIALOUT_CLASS::queue(const uint8_t * data, size_t len, tserial_priority prio)
+{
+    out_lane & l = _lanes[prio];
+    size_t done = 0;
+    while (done < len) {
+        size_t chunk = len - done;
+        //whole chunk at once so a line is not split between lanes
+        reserve(prio, chunk);
+        if (chunk > room(prio)) {
+            chunk = room(prio);
+        }
+        //held lane is full, what is left is lost
+        if (chunk == 0) {
+            break;
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            l.buffer[(l.head + i) & OUT_MASK] = data[done + i];
+        }
+        l.head += chunk;
+        done += chunk;
+    }
+    return done;
+}
+
+//queue a full line, realtime commands go to urgent lane and are written at once
+bool SERIALOUT_CLASS::command(const char * line, tserial_priority prio, uint16_t tag)
+{
+    size_t len = strlen(line);
+    //line end is added here, so tag is on line ended by it
+    while ((len > 0) && ((line[len - 1] == '\r') || (line[len - 1] == '\n'))) {
+        len--;
+    }
+    if (len >= SERIAL_OUT_QUEUE_SIZE) {
+        return false;
+    }
+    if (is_realtime(line)) {
+        prio = PRIO_URGENT;
+    }
+    reserve(prio, len + 1);
+    //lane is held and full, line is not cut
+    if (room(prio) < (len + 1)) {
+        return false;
+    }
+    queue((const uint8_t *)line, len, prio);
+    queue((const uint8_t *)"\n", 1, prio);
+    if (tag) {
+        _tags[prio] = tag;
+        _tag_ends[prio] = _lanes[prio].head;
+    }
+    process();
+    return true;
+}
+
+//lane to write from, NO_LANE if nothing is queued
+uint8_t SERIALOUT_CLASS::next_lane()
+{
+    //finish line already started
+    if (_owner != NO_LANE) {
+        if (pending((tserial_priority)_owner) > 0) {
+            return _owner;
+        }
+        //rest of line is not queued yet, do not hold other lanes for it
+        _owner = NO_LANE;
+    }
+    if (!lane_held(PRIO_URGENT) && (pending(PRIO_URGENT) > 0)) {
+        return PRIO_URGENT;
+    }
+    bool interactive = !lane_held(PRIO_INTERACTIVE) && (pending(PRIO_INTERACTIVE) > 0);
+    bool bulk = !lane_held(PRIO_BULK) && (pending(PRIO_BULK) > 0);
+    if (interactive && bulk) {
+        return _turn;
+    }
+    if (interactive) {
+        return PRIO_INTERACTIVE;
+    }
+    if (bulk) {
+        return PRIO_BULK;
+    }
+    return NO_LANE;
+}
+
+//printer ignores empty and comment lines, others get one ok
+//\r ends a line as \n does, data are not written from lane yet
+void SERIALOUT_CLASS::track_lines(uint8_t lane, const uint8_t * data, size_t len)
+{
+    uint32_t pos = _lanes[lane].tail;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        pos++;
+        if ((c == '\n') || (c == '\r')) {
+            //tagged line ends here, if it was only a comment it gets no ok
+            uint16_t tag = 0;
+            if (_tags[lane] && ((int32_t)(pos - _tag_ends[lane]) >= 0)) {
+                tag = _tags[lane];
+                _tags[lane] = 0;
+            }
+            if (_line_data[lane]) {
+                //oldest line is forgotten if printer does not answer anymore
+                if ((uint8_t)(_ack_head - _ack_tail) >= SERIAL_OUT_ACK_SIZE) {
+                    _ack_tail++;
+                }
+                _ack_lanes[_ack_head & ACK_MASK] = lane;
+                _ack_tags[_ack_head & ACK_MASK] = tag;
+                _ack_head++;
+            }
+            _line_data[lane] = false;
+            _line_comment[lane] = false;
+        } else if (c == ';') {
+            _line_comment[lane] = true;
+        } else if (!_line_comment[lane] && (c != ' ') && (c != '\t')) {
+            _line_data[lane] = true;
+        }
+    }
+}
+
+//ok answers oldest line written, wait means every line was handled
+void SERIALOUT_CLASS::check_response(tline_event & event)
+{
+    _acked = NO_LANE;
+    _acked_tag = 0;
+    if (event.type == LINE_OK) {
+        if (_ack_head != _ack_tail) {
+            _acked = _ack_lanes[_ack_tail & ACK_MASK];
+            _acked_tag = _ack_tags[_ack_tail & ACK_MASK];
+            _ack_tail++;
+            _acks[_acked]++;
+        }
+    } else if (event.type == LINE_WAIT) {
+        _ack_tail = _ack_head;
+    }
+}
+
+//write from lane up to end of current line, return bytes written
+size_t SERIALOUT_CLASS::write_lane(uint8_t lane, size_t room)
+{
+    out_lane & l = _lanes[lane];
+    size_t pos = l.tail & OUT_MASK;
+    size_t len = l.head - l.tail;
+    if (len > (SERIAL_OUT_QUEUE_SIZE - pos)) {
+        len = SERIAL_OUT_QUEUE_SIZE - pos;
+    }
+    if (len > room) {
+        len = room;
+    }
+    const uint8_t * eol = (const uint8_t *)memchr(&l.buffer[pos], '\n', len);
+    if (eol) {
+        len = (eol - &l.buffer[pos]) + 1;
+    }
+    ESP_SERIAL_OUT.write(&l.buffer[pos], len);
+    track_lines(lane, &l.buffer[pos], len);
+    l.tail += len;
+    _owner = eol ? NO_LANE : lane;
+    if (lane != PRIO_URGENT) {
+        //other lane had nothing to send, so turn is given to this one
+        if (lane != _turn) {
+            _turn = lane;
+            _sent = 0;
+        }
+        _sent += len;
+        if (eol && (_sent >= SERIAL_OUT_QUANTUM)) {
+            _turn = (lane == PRIO_BULK) ? PRIO_INTERACTIVE : PRIO_BULK;
+            _sent = 0;
+        }
+    }
+    return len;
+}
+
+//called in loop, write queued data as long as UART has room
+void SERIALOUT_CLASS::process()
+{
+    size_t room = ESP_SERIAL_OUT.availableForWrite();
+    uint8_t lane;
+    while ((room > 0) && ((lane = next_lane()) != NO_LANE)) {
+        room -= write_lane(lane, room);
+    }
+}
+
+//write everything queued and wait UART sent it
+//held lane stays queued, it would never be written before hold ends
+void SERIALOUT_CLASS::flush()
+{
+    for (uint8_t lane = 0; lane < SERIAL_OUT_LANES; lane++) {
+        while ((pending((tserial_priority)lane) > 0) && !lane_held(lane)) {
+            process();
+            delay(0);
+        }
+    }
+    ESP_SERIAL_OUT.flush();
+}
+
+//line is a command printer handles immediately, line number is allowed
+bool SERIALOUT_CLASS::is_realtime(const char * line)
+{
+    while (*line == ' ') {
+        line++;
+    }
+    if ((*line == 'N') || (*line == 'n')) {
+        line++;
+        while (isdigit(*line)) {
+            line++;
+        }
+        while (*line == ' ') {
+            line++;
+        }
+    }
+    if ((*line != 'M') && (*line != 'm')) {
+        return false;
+    }
+    line++;
+    if (!isdigit(*line)) {
+        return false;
+    }
+    uint16_t code = 0;
+    while (isdigit(*line) && (code < 1000)) {
+        code = (code * 10) + (*line - '0');
+        line++;
+    }
+    if (isdigit(*line)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < (sizeof(realtime_codes) / sizeof(realtime_codes[0])); i++) {
+        if (code == realtime_codes[i]) {
+            return true;
+        }
+    }
+    return false;
+}
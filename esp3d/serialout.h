@@ -0,0 +1,139 @@
+/*
+  serialout.h - esp3d serial output scheduler class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SERIALOUT_h
+#define SERIALOUT_h
+#include <Arduino.h>
+#include "config.h"
+#include "tokenizer.h"
+
+#if (SERIAL_OUT_QUEUE_SIZE & (SERIAL_OUT_QUEUE_SIZE - 1)) != 0
+#error SERIAL_OUT_QUEUE_SIZE must be a power of 2
+#endif
+
+typedef enum {
+    //realtime commands, written before anything queued
+    PRIO_URGENT = 0,
+    //web, tcp and esp messages
+    PRIO_INTERACTIVE = 1,
+    //sd upload and [ESP700] job
+    PRIO_BULK = 2
+} tserial_priority;
+
+#define SERIAL_OUT_LANES 3
+//no lane, like for an ok which does not answer a known line
+#define NO_LANE SERIAL_OUT_LANES
+//lines written to UART waiting for their ok, size must be a power of 2
+#define SERIAL_OUT_ACK_SIZE 32
+
+//every producer queues data here instead of writing UART directly
+//process() writes them when UART has room: urgent lane first, then
+//interactive and bulk lanes share UART by turns of SERIAL_OUT_QUANTUM bytes
+//lane is only switched at end of line, so queued lines are not mixed
+//print() and println() use interactive lane
+//command() returns false only when its lane is held and full
+//in raw mode every lane is held and raw data go to UART as they are,
+//they are not lines, so nothing is waited for them
+//printer answers lines in order they were written, one ok each, so
+//lane of every line written is kept to know whom an ok belongs to
+//a command can be given a tag, so its producer knows which ok is its own,
+//each lane keeps one tag at once
+class SERIALOUT_CLASS : public Print
+{
+public:
+    SERIALOUT_CLASS();
+    size_t write(uint8_t c);
+    size_t write(const uint8_t * data, size_t len);
+    using Print::write;
+    size_t queue(const uint8_t * data, size_t len, tserial_priority prio);
+    bool command(const char * line, tserial_priority prio = PRIO_INTERACTIVE, uint16_t tag = 0);
+    void process();
+    void flush();
+    size_t pending(tserial_priority prio);
+    size_t room(tserial_priority prio);
+    static bool is_realtime(const char * line);
+    void hold(bool on);
+    inline bool held()
+    {
+        return _held;
+    };
+    void raw(bool on);
+    inline bool raw_active()
+    {
+        return _raw;
+    };
+    size_t raw_room();
+    size_t write_raw(const uint8_t * data, size_t len);
+    void check_response(tline_event & event);
+    //lane of line answered by last ok, NO_LANE if not known
+    inline uint8_t acknowledged()
+    {
+        return _acked;
+    };
+    //tag of line answered by last ok, 0 if line had none
+    inline uint16_t acknowledged_tag()
+    {
+        return _acked_tag;
+    };
+    //oks received for lines of lane
+    inline uint32_t acks(tserial_priority prio)
+    {
+        return _acks[prio];
+    };
+private:
+    struct out_lane {
+        uint8_t buffer[SERIAL_OUT_QUEUE_SIZE];
+        uint32_t head;
+        uint32_t tail;
+    };
+    out_lane _lanes[SERIAL_OUT_LANES];
+    //lane which wrote start of a line not finished yet
+    uint8_t _owner;
+    //fair lane having the turn and bytes it sent during it
+    uint8_t _turn;
+    uint16_t _sent;
+    //line being written by each lane has a command or is only a comment
+    bool _line_data[SERIAL_OUT_LANES];
+    bool _line_comment[SERIAL_OUT_LANES];
+    //lanes of lines written, oldest is answered by next ok
+    uint8_t _ack_lanes[SERIAL_OUT_ACK_SIZE];
+    uint16_t _ack_tags[SERIAL_OUT_ACK_SIZE];
+    uint8_t _ack_head;
+    uint8_t _ack_tail;
+    uint8_t _acked;
+    uint16_t _acked_tag;
+    //tag of each lane and lane position where its line ends
+    uint16_t _tags[SERIAL_OUT_LANES];
+    uint32_t _tag_ends[SERIAL_OUT_LANES];
+    uint32_t _acks[SERIAL_OUT_LANES];
+    //interactive lane is not written
+    bool _held;
+    //no lane is written, UART belongs to raw data
+    bool _raw;
+    bool lane_held(uint8_t lane);
+    void reserve(tserial_priority prio, size_t len);
+    uint8_t next_lane();
+    size_t write_lane(uint8_t lane, size_t room);
+    void track_lines(uint8_t lane, const uint8_t * data, size_t len);
+};
+
+extern SERIALOUT_CLASS serial_out;
+
+#endif
@@ -0,0 +1,295 @@
+/*
+  settings.cpp - esp3d settings description class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include "settings.h"
+#include "bridge.h"
+
+#define OPTIONS(list) list, sizeof(list) / sizeof(setting_option)
+
+static const setting_option baud_options[] PROGMEM = {
+    {"9600", 9600},
+    {"19200", 19200},
+    {"38400", 38400},
+    {"57600", 57600},
+    {"115200", 115200},
+    {"230400", 230400},
+    {"250000", 250000}
+};
+
+static const setting_option sleep_options[] PROGMEM = {
+    {"None", WIFI_NONE_SLEEP},
+#ifdef ARDUINO_ARCH_ESP8266
+    {"Light", WIFI_LIGHT_SLEEP},
+#endif
+    {"Modem", WIFI_MODEM_SLEEP}
+};
+
+static const setting_option wifi_mode_options[] PROGMEM = {
+    {"AP", AP_MODE},
+    {"STA", CLIENT_MODE}
+};
+
+static const setting_option sta_phy_options[] PROGMEM = {
+    {"11b", WIFI_PHY_MODE_11B},
+    {"11g", WIFI_PHY_MODE_11G},
+    {"11n", WIFI_PHY_MODE_11N}
+};
+
+static const setting_option ap_phy_options[] PROGMEM = {
+    {"11b", WIFI_PHY_MODE_11B},
+    {"11g", WIFI_PHY_MODE_11G}
+};
+
+static const setting_option ip_mode_options[] PROGMEM = {
+    {"DHCP", DHCP_MODE},
+    {"Static", STATIC_IP_MODE}
+};
+
+static const setting_option yes_no_options[] PROGMEM = {
+    {"No", 0},
+    {"Yes", 1}
+};
+
+static const setting_option auth_options[] PROGMEM = {
+    {"Open", AUTH_OPEN},
+    {"WPA", AUTH_WPA_PSK},
+    {"WPA2", AUTH_WPA2_PSK},
+    {"WPA/WPA2", AUTH_WPA_WPA2_PSK}
+};
+
+static const setting_option fw_options[] PROGMEM = {
+    {"Repetier", REPETIER},
+    {"Repetier for Davinci", REPETIER4DV},
+    {"Marlin", MARLIN},
+    {"Marlin Kimbra", MARLINKIMBRA},
+    {"Smoothieware", SMOOTHIEWARE},
+    {"Unknown", UNKNOWN_FW}
+};
+
+//[ESP400] lists settings in this order
+static const setting_desc settings_table[] PROGMEM = {
+    {EP_BAUD_RATE, 'I', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Baud Rate", OPTIONS(baud_options)},
+    {EP_SLEEP_MODE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Sleep Mode", OPTIONS(sleep_options)},
+    {EP_WEB_PORT, 'I', SETTING_NETWORK, LEVEL_ADMIN, 0, DEFAULT_MIN_WEB_PORT, DEFAULT_MAX_WEB_PORT, "Web Port", NULL, 0},
+    {EP_DATA_PORT, 'I', SETTING_NETWORK, LEVEL_ADMIN, 0, DEFAULT_MIN_DATA_PORT, DEFAULT_MAX_DATA_PORT, "Data Port", NULL, 0},
+    {EP_ADMIN_PWD, 'S', SETTING_NETWORK, LEVEL_ADMIN, SETTING_SECRET | SETTING_AUTH, MIN_LOCAL_PASSWORD_LENGTH, MAX_LOCAL_PASSWORD_LENGTH, "Admin Password", NULL, 0},
+    {EP_USER_PWD, 'S', SETTING_NETWORK, LEVEL_USER, SETTING_SECRET | SETTING_AUTH, MIN_LOCAL_PASSWORD_LENGTH, MAX_LOCAL_PASSWORD_LENGTH, "User Password", NULL, 0},
+    {EP_HOSTNAME, 'S', SETTING_NETWORK, LEVEL_ADMIN, 0, MIN_HOSTNAME_LENGTH, MAX_HOSTNAME_LENGTH, "Hostname", NULL, 0},
+    {EP_WIFI_MODE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Wifi mode", OPTIONS(wifi_mode_options)},
+    {EP_STA_SSID, 'S', SETTING_NETWORK, LEVEL_ADMIN, 0, MIN_SSID_LENGTH, MAX_SSID_LENGTH, "Station SSID", NULL, 0},
+    {EP_STA_PASSWORD, 'S', SETTING_NETWORK, LEVEL_ADMIN, SETTING_SECRET, MIN_PASSWORD_LENGTH, MAX_PASSWORD_LENGTH, "Station Password", NULL, 0},
+    {EP_STA_PHY_MODE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Station Network Mode", OPTIONS(sta_phy_options)},
+    {EP_STA_IP_MODE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Station IP Mode", OPTIONS(ip_mode_options)},
+    {EP_STA_IP_VALUE, 'A', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Station Static IP", NULL, 0},
+    {EP_STA_MASK_VALUE, 'A', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Station Static Mask", NULL, 0},
+    {EP_STA_GATEWAY_VALUE, 'A', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Station Static Gateway", NULL, 0},
+    {EP_AP_SSID, 'S', SETTING_NETWORK, LEVEL_ADMIN, 0, MIN_SSID_LENGTH, MAX_SSID_LENGTH, "AP SSID", NULL, 0},
+    {EP_AP_PASSWORD, 'S', SETTING_NETWORK, LEVEL_ADMIN, SETTING_SECRET, MIN_PASSWORD_LENGTH, MAX_PASSWORD_LENGTH, "AP Password", NULL, 0},
+    {EP_AP_PHY_MODE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "AP Network Mode", OPTIONS(ap_phy_options)},
+    {EP_SSID_VISIBLE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "SSID Visible", OPTIONS(yes_no_options)},
+    {EP_CHANNEL, 'B', SETTING_NETWORK, LEVEL_ADMIN, SETTING_RANGE_LIST, 1, 11, "AP Channel", NULL, 0},
+    {EP_AUTH_TYPE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "Authentication", OPTIONS(auth_options)},
+    {EP_AP_IP_MODE, 'B', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "AP IP Mode", OPTIONS(ip_mode_options)},
+    {EP_AP_IP_VALUE, 'A', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "AP Static IP", NULL, 0},
+    {EP_AP_MASK_VALUE, 'A', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "AP Static Mask", NULL, 0},
+    {EP_AP_GATEWAY_VALUE, 'A', SETTING_NETWORK, LEVEL_ADMIN, 0, 0, 0, "AP Static Gateway", NULL, 0},
+    {EP_TARGET_FW, 'B', SETTING_PRINTER, LEVEL_USER, 0, 0, 0, "Target FW", OPTIONS(fw_options)},
+    {EP_REFRESH_PAGE_TIME, 'B', SETTING_PRINTER, LEVEL_USER, 0, DEFAULT_MIN_REFRESH, DEFAULT_MAX_REFRESH, "Temperature Refresh Time", NULL, 0},
+    {EP_REFRESH_PAGE_TIME2, 'B', SETTING_PRINTER, LEVEL_USER, 0, DEFAULT_MIN_REFRESH, DEFAULT_MAX_REFRESH, "Position Refresh Time", NULL, 0},
+    {EP_XY_FEEDRATE, 'I', SETTING_PRINTER, LEVEL_USER, 0, DEFAULT_MIN_XY_FEEDRATE, DEFAULT_MAX_XY_FEEDRATE, "XY feedrate", NULL, 0},
+    {EP_Z_FEEDRATE, 'I', SETTING_PRINTER, LEVEL_USER, 0, DEFAULT_MIN_Z_FEEDRATE, DEFAULT_MAX_Z_FEEDRATE, "Z feedrate", NULL, 0},
+    {EP_E_FEEDRATE, 'I', SETTING_PRINTER, LEVEL_USER, 0, DEFAULT_MIN_E_FEEDRATE, DEFAULT_MAX_E_FEEDRATE, "E feedrate", NULL, 0},
+    {EP_DATA_STRING, 'S', SETTING_PRINTER, LEVEL_USER, 0, MIN_DATA_LENGTH, MAX_DATA_LENGTH, "Camera address", NULL, 0},
+    //not listed, but can be set by [ESP401]
+    {EP_TIMEZONE, 'B', SETTING_NETWORK, LEVEL_USER, SETTING_HIDDEN, -12, 14, "Time Zone", NULL, 0},
+    {EP_TIME_ISDST, 'B', SETTING_NETWORK, LEVEL_USER, SETTING_HIDDEN, 0, 1, "Daylight Saving Time", NULL, 0},
+    {EP_TIME_SERVER1, 'S', SETTING_NETWORK, LEVEL_USER, SETTING_HIDDEN, MIN_DATA_LENGTH, MAX_DATA_LENGTH, "Time Server 1", NULL, 0},
+    {EP_TIME_SERVER2, 'S', SETTING_NETWORK, LEVEL_USER, SETTING_HIDDEN, MIN_DATA_LENGTH, MAX_DATA_LENGTH, "Time Server 2", NULL, 0},
+    {EP_TIME_SERVER3, 'S', SETTING_NETWORK, LEVEL_USER, SETTING_HIDDEN, MIN_DATA_LENGTH, MAX_DATA_LENGTH, "Time Server 3", NULL, 0},
+    {EP_IS_DIRECT_SD, 'B', SETTING_PRINTER, LEVEL_USER, SETTING_HIDDEN, 0, 1, "Direct SD", NULL, 0},
+    {EP_PRIMARY_SD, 'B', SETTING_PRINTER, LEVEL_USER, SETTING_HIDDEN, NO_SD, EXT_DIRECTORY, "Primary SD", NULL, 0},
+    {EP_SECONDARY_SD, 'B', SETTING_PRINTER, LEVEL_USER, SETTING_HIDDEN, NO_SD, EXT_DIRECTORY, "Secondary SD", NULL, 0},
+    {EP_DIRECT_SD_CHECK, 'B', SETTING_PRINTER, LEVEL_USER, SETTING_HIDDEN, 0, 1, "Direct SD Check", NULL, 0},
+    {EP_SD_CHECK_UPDATE_AT_BOOT, 'B', SETTING_PRINTER, LEVEL_USER, SETTING_HIDDEN, 0, 1, "SD Update At Boot", NULL, 0}
+};
+
+#define SETTINGS_NB (sizeof(settings_table) / sizeof(setting_desc))
+
+//values are sent as json strings, like web UI expects
+static const char * int_str(char * buf, size_t size, long value)
+{
+    snprintf(buf, size, "%ld", value);
+    return buf;
+}
+
+//copy description from flash
+bool SETTINGS::get(int pos, setting_desc & desc)
+{
+    for (uint8_t i = 0; i < SETTINGS_NB; i++) {
+        memcpy_P(&desc, &settings_table[i], sizeof(setting_desc));
+        if (desc.pos == pos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//unknown setting needs admin
+level_authenticate_type SETTINGS::level(int pos)
+{
+    setting_desc desc;
+    if (!get(pos, desc)) {
+        return LEVEL_ADMIN;
+    }
+    return (level_authenticate_type)desc.level;
+}
+
+//validate [ESP401] value according description
+bool SETTINGS::check(const setting_desc & desc, char type, const String & value)
+{
+    if (type != desc.type) {
+        return false;
+    }
+    if (type == 'S') {
+        return ((long)value.length() >= desc.min) && ((long)value.length() <= desc.max);
+    }
+    //IP is checked when parsed
+    if (type == 'A') {
+        return true;
+    }
+    long v = value.toInt();
+    if (desc.options) {
+        setting_option option;
+        for (uint8_t i = 0; i < desc.options_nb; i++) {
+            memcpy_P(&option, &desc.options[i], sizeof(setting_option));
+            if (option.value == v) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return (v >= desc.min) && (v <= desc.max);
+}
+
+//one setting as json object
+void SETTINGS::print_setting(const setting_desc & desc, JSONWRITER_CLASS & json)
+{
+    char sbuf[MAX_DATA_LENGTH + 1];
+    char tmp[12];
+    json.begin_object();
+    json.add("F", (desc.family == SETTING_PRINTER) ? "printer" : "network");
+    json.add("P", int_str(tmp, sizeof(tmp), desc.pos));
+    tmp[0] = desc.type;
+    tmp[1] = 0;
+    json.add("T", tmp);
+    switch (desc.type) {
+    case 'B': {
+        byte bbuf = 0;
+        json.add("V", CONFIG::read_byte(desc.pos, &bbuf) ? int_str(tmp, sizeof(tmp), bbuf) : "???");
+    }
+    break;
+    case 'I': {
+        int ibuf = 0;
+        json.add("V", CONFIG::read_buffer(desc.pos, (byte *)&ibuf, INTEGER_LENGTH) ? int_str(tmp, sizeof(tmp), ibuf) : "???");
+    }
+    break;
+    case 'A': {
+        byte ipbuf[IP_LENGTH];
+        if (!CONFIG::read_buffer(desc.pos, ipbuf, IP_LENGTH)) {
+            json.add("V", "???");
+        } else {
+            snprintf(sbuf, sizeof(sbuf), "%d.%d.%d.%d", ipbuf[0], ipbuf[1], ipbuf[2], ipbuf[3]);
+            json.add("V", sbuf);
+        }
+    }
+    break;
+    default:
+        if (!CONFIG::read_string(desc.pos, sbuf, desc.max)) {
+            json.add("V", "???");
+        } else if (desc.flags & SETTING_SECRET) {
+            json.add("V", "********");
+        } else {
+            json.add("V", sbuf);
+        }
+        break;
+    }
+    json.add("H", desc.label);
+    if (desc.options || (desc.flags & SETTING_RANGE_LIST)) {
+        json.begin_array("O");
+        setting_option option;
+        uint8_t nb = desc.options ? desc.options_nb : (desc.max - desc.min + 1);
+        for (uint8_t i = 0; i < nb; i++) {
+            if (desc.options) {
+                memcpy_P(&option, &desc.options[i], sizeof(setting_option));
+            } else {
+                option.value = desc.min + i;
+                snprintf(option.label, OPTION_LABEL_SIZE, "%ld", (long)option.value);
+            }
+            //option label is the key
+            json.begin_object();
+            json.add(option.label, int_str(tmp, sizeof(tmp), option.value));
+            json.end_object();
+        }
+        json.end_array();
+    } else if (desc.type != 'A') {
+        json.add("S", int_str(tmp, sizeof(tmp), desc.max));
+        json.add("M", int_str(tmp, sizeof(tmp), desc.min));
+    }
+    json.end_object();
+}
+
+//[ESP400] content, filter is network, printer or empty for all
+void SETTINGS::print_json(tpipe output, const String & filter)
+{
+    setting_desc desc;
+    uint8_t family = SETTING_NETWORK;
+    bool all = (filter.length() == 0);
+    if (filter == "printer") {
+        family = SETTING_PRINTER;
+    } else if (!all && (filter != "network")) {
+        //nothing to list
+        family = 0xFF;
+    }
+    //labels and string values can have any char, so writer escapes them
+    PIPEPRINT_CLASS pipe(output);
+    JSONWRITER_CLASS json(pipe);
+    json.begin_object();
+    json.begin_array("EEPROM");
+    for (uint8_t i = 0; i < SETTINGS_NB; i++) {
+        memcpy_P(&desc, &settings_table[i], sizeof(setting_desc));
+        if (desc.flags & SETTING_HIDDEN) {
+            continue;
+        }
+#ifndef AUTHENTICATION_FEATURE
+        if (desc.flags & SETTING_AUTH) {
+            continue;
+        }
+#endif
+        if (!all && (desc.family != family)) {
+            continue;
+        }
+        print_setting(desc, json);
+        delay(0);
+    }
+    json.end_array();
+    json.end_object();
+    BRIDGE::println(F(""), output);
+}
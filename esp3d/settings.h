@@ -0,0 +1,71 @@
+/*
+  settings.h - esp3d settings description class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+#include <Arduino.h>
+#include "config.h"
+#include "jsonwriter.h"
+
+//setting families
+#define SETTING_NETWORK 0
+#define SETTING_PRINTER 1
+
+//setting flags
+#define SETTING_SECRET      0x01 //value is never sent
+#define SETTING_AUTH        0x02 //listed only if authentication is enabled
+#define SETTING_HIDDEN      0x04 //not listed by [ESP400]
+#define SETTING_RANGE_LIST  0x08 //options are each value from min to max
+
+#define SETTING_LABEL_SIZE  28
+#define OPTION_LABEL_SIZE   22
+
+typedef struct {
+    char label[OPTION_LABEL_SIZE];
+    int32_t value;
+} setting_option;
+
+//setting description, table is in flash
+typedef struct {
+    uint16_t pos;
+    char type; //B(byte), I(integer), S(string), A(IP address)
+    uint8_t family;
+    uint8_t level;
+    uint8_t flags;
+    //value range, or string length range
+    int32_t min;
+    int32_t max;
+    char label[SETTING_LABEL_SIZE];
+    const setting_option * options;
+    uint8_t options_nb;
+} setting_desc;
+
+class SETTINGS
+{
+public:
+    static bool get(int pos, setting_desc & desc);
+    static bool check(const setting_desc & desc, char type, const String & value);
+    static level_authenticate_type level(int pos);
+    static void print_json(tpipe output, const String & filter);
+private:
+    static void print_setting(const setting_desc & desc, JSONWRITER_CLASS & json);
+};
+
+#endif
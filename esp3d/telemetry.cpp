@@ -0,0 +1,334 @@
+/*
+  telemetry.cpp - esp3d temperature history class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "telemetry.h"
+
+#ifdef MONITORING_FEATURE
+#include "printerstate.h"
+
+//positions are free running counters, only masked when accessing buffer
+#define TELEMETRY_MASK (TELEMETRY_LEVEL_SIZE - 1)
+//data are sent to client by blocks of this size
+#define TELEMETRY_OUT_SIZE 512
+
+//seconds between records of each level
+static const uint16_t level_interval[TELEMETRY_LEVELS] = {1, 10, 60};
+//records of a level averaged in one record of next level
+static const uint8_t level_ratio[TELEMETRY_LEVELS - 1] = {10, 6};
+
+TELEMETRY_CLASS telemetry;
+
+//small writes are grouped so client sends full packets
+class telemetry_out
+{
+public:
+    telemetry_out(Print & output): _output(output), _len(0) {}
+    void write(const void * data, size_t len)
+    {
+        const uint8_t * p = (const uint8_t *)data;
+        while (len > 0) {
+            size_t chunk = TELEMETRY_OUT_SIZE - _len;
+            if (chunk > len) {
+                chunk = len;
+            }
+            memcpy(&_buffer[_len], p, chunk);
+            _len += chunk;
+            p += chunk;
+            len -= chunk;
+            if (_len == TELEMETRY_OUT_SIZE) {
+                flush();
+            }
+        }
+    }
+    void print(const char * text)
+    {
+        write(text, strlen(text));
+    }
+    void flush()
+    {
+        if (_len > 0) {
+            _output.write(_buffer, _len);
+            _len = 0;
+        }
+    }
+private:
+    Print & _output;
+    uint8_t _buffer[TELEMETRY_OUT_SIZE];
+    size_t _len;
+};
+
+//Constructor
+TELEMETRY_CLASS::TELEMETRY_CLASS()
+{
+    for (uint8_t i = 0; i < TELEMETRY_LEVELS; i++) {
+        telemetry_level & l = _levels[i];
+        l.head = 0;
+        l.tail = 0;
+        l.count = 0;
+        l.time = 0;
+        l.nb = 0;
+        for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+            l.first[c] = 0;
+            l.last[c] = 0;
+            l.sum[c] = 0;
+        }
+    }
+    _last_sample = 0;
+    _started = false;
+}
+
+//called in loop, take one sample each second once printer reported temperatures
+void TELEMETRY_CLASS::process()
+{
+    uint32_t now = millis();
+    if ((now - _last_sample) < 1000) {
+        return;
+    }
+    heater_state & hotend = printer_state.hotend(0);
+    heater_state & bed = printer_state.bed();
+    if (!_started) {
+        if (!hotend.present && !bed.present) {
+            _last_sample = now;
+            return;
+        }
+        _started = true;
+        _last_sample = now - 1000;
+    }
+    int16_t values[TELEMETRY_CHANNELS] = {hotend.current, hotend.target, bed.current, bed.target};
+    //if loop was blocked, missed samples get current values so time stays regular
+    while ((now - _last_sample) >= 1000) {
+        _last_sample += 1000;
+        add(0, values, _last_sample / 1000);
+    }
+}
+
+//read record at pos, return its length
+uint8_t TELEMETRY_CLASS::decode(telemetry_level & l, uint32_t pos, int32_t * deltas)
+{
+    uint8_t len = 0;
+    uint8_t mask = l.buffer[pos & TELEMETRY_MASK];
+    len++;
+    for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+        deltas[c] = 0;
+        if (!(mask & (1 << c))) {
+            continue;
+        }
+        uint32_t z = 0;
+        uint8_t shift = 0;
+        uint8_t b;
+        do {
+            b = l.buffer[(pos + len) & TELEMETRY_MASK];
+            len++;
+            z |= (uint32_t)(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        //zigzag
+        deltas[c] = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+    }
+    return len;
+}
+
+//remove oldest record, next one becomes first so its deltas are applied
+void TELEMETRY_CLASS::evict(telemetry_level & l)
+{
+    int32_t deltas[TELEMETRY_CHANNELS];
+    l.tail += decode(l, l.tail, deltas);
+    l.count--;
+    if (l.count == 0) {
+        l.tail = l.head;
+        return;
+    }
+    decode(l, l.tail, deltas);
+    for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+        l.first[c] += deltas[c];
+    }
+}
+
+void TELEMETRY_CLASS::add(uint8_t level, const int16_t * values, uint32_t time)
+{
+    telemetry_level & l = _levels[level];
+    uint8_t record[TELEMETRY_RECORD_SIZE];
+    uint8_t len = 1;
+    uint8_t mask = 0;
+    for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+        int32_t delta = (int32_t)values[c] - l.last[c];
+        if ((l.count == 0) || (delta == 0)) {
+            continue;
+        }
+        mask |= (1 << c);
+        uint32_t z = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        do {
+            uint8_t b = z & 0x7F;
+            z >>= 7;
+            record[len++] = z ? (b | 0x80) : b;
+        } while (z);
+    }
+    record[0] = mask;
+    while ((TELEMETRY_LEVEL_SIZE - (l.head - l.tail)) < len) {
+        evict(l);
+    }
+    for (uint8_t i = 0; i < len; i++) {
+        l.buffer[(l.head + i) & TELEMETRY_MASK] = record[i];
+    }
+    l.head += len;
+    for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+        if (l.count == 0) {
+            l.first[c] = values[c];
+        }
+        l.last[c] = values[c];
+    }
+    l.count++;
+    l.time = time;
+    //rollup to next level
+    if (level < (TELEMETRY_LEVELS - 1)) {
+        l.nb++;
+        for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+            l.sum[c] += values[c];
+        }
+        if (l.nb == level_ratio[level]) {
+            int16_t average[TELEMETRY_CHANNELS];
+            for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+                int32_t sum = l.sum[c];
+                average[c] = (sum + ((sum < 0) ? -(l.nb / 2) : (l.nb / 2))) / l.nb;
+                l.sum[c] = 0;
+            }
+            l.nb = 0;
+            add(level + 1, average, time);
+        }
+    }
+}
+
+uint32_t TELEMETRY_CLASS::first_time(uint8_t level)
+{
+    telemetry_level & l = _levels[level];
+    if (l.count == 0) {
+        return 0;
+    }
+    return l.time - ((uint32_t)(l.count - 1) * level_interval[level]);
+}
+
+//finest level which still has data since this time, else coarsest one
+int8_t TELEMETRY_CLASS::level_for(uint32_t since)
+{
+    for (uint8_t i = 0; i < TELEMETRY_LEVELS; i++) {
+        if ((_levels[i].count > 0) && (first_time(i) <= since)) {
+            return i;
+        }
+    }
+    return TELEMETRY_LEVELS - 1;
+}
+
+//send records newer than since (s from boot)
+//json: {"res":"10","start":"120","now":"300","scale":"10","channels":[...],"data":[[T,T target,B,B target],...]}
+//binary: "ESPT", version, channels, interval u16, start u32, count u16, first values i16,
+//then records as stored (little endian)
+void TELEMETRY_CLASS::stream(Print & output, int8_t level, uint32_t since, bool binary)
+{
+    if ((level < 0) || (level >= TELEMETRY_LEVELS)) {
+        level = level_for(since);
+    }
+    telemetry_level & l = _levels[level];
+    uint16_t interval = level_interval[level];
+    //skip records older than since
+    uint16_t skip = 0;
+    uint32_t start = first_time(level);
+    if ((l.count > 0) && (since > start)) {
+        skip = (since - start + interval - 1) / interval;
+        if (skip > l.count) {
+            skip = l.count;
+        }
+    }
+    int32_t values[TELEMETRY_CHANNELS];
+    int32_t deltas[TELEMETRY_CHANNELS];
+    for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+        values[c] = l.first[c];
+    }
+    uint32_t pos = l.tail;
+    uint16_t index = 0;
+    while ((index < skip) && (index < l.count)) {
+        pos += decode(l, pos, deltas);
+        index++;
+        if (index < l.count) {
+            decode(l, pos, deltas);
+            for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+                values[c] += deltas[c];
+            }
+        }
+    }
+    uint16_t count = l.count - index;
+    start += (uint32_t)index * interval;
+    telemetry_out out(output);
+    if (binary) {
+        uint8_t header[14 + (2 * TELEMETRY_CHANNELS)];
+        memcpy(header, "ESPT", 4);
+        header[4] = 1;
+        header[5] = TELEMETRY_CHANNELS;
+        header[6] = interval & 0xFF;
+        header[7] = interval >> 8;
+        for (uint8_t i = 0; i < 4; i++) {
+            header[8 + i] = (start >> (8 * i)) & 0xFF;
+        }
+        header[12] = count & 0xFF;
+        header[13] = count >> 8;
+        for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+            header[14 + (2 * c)] = values[c] & 0xFF;
+            header[15 + (2 * c)] = (values[c] >> 8) & 0xFF;
+        }
+        out.write(header, sizeof(header));
+        if (count > 0) {
+            //first record is in header
+            pos += decode(l, pos, deltas);
+            while (pos != l.head) {
+                uint32_t offset = pos & TELEMETRY_MASK;
+                size_t len = l.head - pos;
+                if (len > (TELEMETRY_LEVEL_SIZE - offset)) {
+                    len = TELEMETRY_LEVEL_SIZE - offset;
+                }
+                out.write(&l.buffer[offset], len);
+                pos += len;
+            }
+        }
+        out.flush();
+        return;
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"res\":\"%u\",\"start\":\"%u\",\"now\":\"%u\",", interval, (unsigned int)start, (unsigned int)(millis() / 1000));
+    out.print(buf);
+    out.print("\"scale\":\"10\",\"channels\":[\"T0\",\"T0target\",\"B\",\"Btarget\"],\"data\":[");
+    for (uint16_t i = 0; i < count; i++) {
+        if (i > 0) {
+            pos += decode(l, pos, deltas);
+            decode(l, pos, deltas);
+            for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+                values[c] += deltas[c];
+            }
+        }
+        snprintf(buf, sizeof(buf), "%s[%d,%d,%d,%d]", i ? "," : "", (int)values[0], (int)values[1], (int)values[2], (int)values[3]);
+        out.print(buf);
+        //feed the WD for safety
+        if ((i & 0xFF) == 0xFF) {
+            delay(0);
+        }
+    }
+    out.print("]}");
+    out.flush();
+}
+
+#endif //MONITORING_FEATURE
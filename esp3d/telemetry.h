@@ -0,0 +1,77 @@
+/*
+  telemetry.h - esp3d temperature history class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef TELEMETRY_h
+#define TELEMETRY_h
+#include <Arduino.h>
+#include "config.h"
+
+#ifdef MONITORING_FEATURE
+
+#if (TELEMETRY_LEVEL_SIZE & (TELEMETRY_LEVEL_SIZE - 1)) != 0
+#error TELEMETRY_LEVEL_SIZE must be a power of 2
+#endif
+
+//hotend current/target, bed current/target
+#define TELEMETRY_CHANNELS 4
+//1s, 10s and 1min
+#define TELEMETRY_LEVELS 3
+//longest record: mask + one 3 bytes varint per channel
+#define TELEMETRY_RECORD_SIZE (1 + (3 * TELEMETRY_CHANNELS))
+
+//one ring per resolution, each filled with 1s samples averaged
+//record is a mask of channels which changed, followed by zigzag varint
+//of delta for each of them, so oldest values are kept aside to decode
+class TELEMETRY_CLASS
+{
+public:
+    TELEMETRY_CLASS();
+    void process();
+    int8_t level_for(uint32_t since);
+    void stream(Print & output, int8_t level, uint32_t since, bool binary);
+private:
+    struct telemetry_level {
+        uint8_t buffer[TELEMETRY_LEVEL_SIZE];
+        uint32_t head;
+        uint32_t tail;
+        uint16_t count;
+        //values of record at tail and of newest one
+        int16_t first[TELEMETRY_CHANNELS];
+        int16_t last[TELEMETRY_CHANNELS];
+        //time in s of newest record
+        uint32_t time;
+        //samples of finer level summed for next record
+        int32_t sum[TELEMETRY_CHANNELS];
+        uint8_t nb;
+    };
+    telemetry_level _levels[TELEMETRY_LEVELS];
+    uint32_t _last_sample;
+    bool _started;
+    void add(uint8_t level, const int16_t * values, uint32_t time);
+    uint8_t decode(telemetry_level & l, uint32_t pos, int32_t * deltas);
+    void evict(telemetry_level & l);
+    uint32_t first_time(uint8_t level);
+};
+
+extern TELEMETRY_CLASS telemetry;
+
+#endif //MONITORING_FEATURE
+
+#endif
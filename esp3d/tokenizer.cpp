@@ -0,0 +1,201 @@
+/*
+  tokenizer.cpp - esp3d line tokenizer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "tokenizer.h"
+
+//Constructor
+TOKENIZER_CLASS::TOKENIZER_CLASS()
+{
+    reset();
+}
+
+void TOKENIZER_CLASS::reset()
+{
+    _len = 0;
+    _iscomment = false;
+}
+
+//compare word before ':' with keyword
+static bool is_word(const char * word, size_t len, const char * keyword)
+{
+    return (strlen(keyword) == len) && (strncmp(word, keyword, len) == 0);
+}
+
+//consume data until a line is complete, then fill event and return true
+//data and len are updated so caller just calls again until false
+bool TOKENIZER_CLASS::feed(const uint8_t * &data, size_t &len, tline_event & event)
+{
+    while (len > 0) {
+        //look for end of line, \r or \n
+        const uint8_t * eol = (const uint8_t *)memchr(data, '\n', len);
+        size_t seg = eol ? (eol - data) : len;
+        const uint8_t * cr = (const uint8_t *)memchr(data, '\r', seg);
+        if (cr) {
+            eol = cr;
+            seg = cr - data;
+        }
+        for (size_t i = 0; i < seg; i++) {
+            uint8_t c = data[i];
+            //to ensure it is continuous string, no char separated by binaries
+            if (!isPrintable(c)) {
+                _len = 0;
+                _iscomment = false;
+            } else if (!_iscomment) {
+                if (c == ';') {
+                    _iscomment = true;
+                } else if (_len < TOKENIZER_LINE_SIZE) {
+                    _line[_len++] = c;
+                }
+            }
+        }
+        if (!eol) {
+            data += seg;
+            len -= seg;
+            return false;
+        }
+        data += seg + 1;
+        len -= seg + 1;
+        //Minimum is something like M10 so 3 char, but ok is needed for flow control
+        bool ready = (_len > 3) || ((_len >= 2) && (strncmp(_line, "ok", 2) == 0));
+        if (ready) {
+            classify(event);
+        }
+        _len = 0;
+        _iscomment = false;
+        if (ready) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//same as feed() for a stream where only lines with marker matter, like
+//[ESP commands in gcode sent by a host: complete lines of data without
+//marker are skipped, only line being finished and last one are parsed
+bool TOKENIZER_CLASS::feed_marked(const uint8_t * &data, size_t &len, tline_event & event, char marker)
+{
+    while (len > 0) {
+        if (memchr(data, marker, len)) {
+            return feed(data, len, event);
+        }
+        const uint8_t * end = data + len;
+        const uint8_t * first = data;
+        while ((first < end) && (*first != '\n') && (*first != '\r')) {
+            first++;
+        }
+        //no end of line, just keep data for current line
+        if (first == end) {
+            return feed(data, len, event);
+        }
+        //finish line already started, it may have marker
+        size_t head = first + 1 - data;
+        bool found = feed(data, head, event);
+        //only keep last line which is not complete yet
+        const uint8_t * last = end;
+        while ((last > data) && (last[-1] != '\n') && (last[-1] != '\r')) {
+            last--;
+        }
+        reset();
+        len = end - last;
+        data = last;
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//one pass on line: keywords are words followed by ':' or [ESP
+void TOKENIZER_CLASS::classify(tline_event & event)
+{
+    byte fw = CONFIG::GetFirmwareTarget();
+    const char * error_word = "Error";
+    const char * info_word = "Info";
+    const char * status_word = "Status";
+    if (fw == SMOOTHIEWARE) {
+        error_word = "error";
+        info_word = "info";
+        status_word = "warning";
+    } else if (fw == MARLIN) {
+        status_word = "echo";
+    }
+    char * error = NULL;
+    char * info = NULL;
+    char * status = NULL;
+    char * esp = NULL;
+    char * resend = NULL;
+    bool busy = false;
+    _line[_len] = '\0';
+    event.line = _line;
+    event.length = _len;
+    event.payload = NULL;
+    event.has_temperature = false;
+    char * word = _line;
+    for (char * p = _line; *p; p++) {
+        char c = *p;
+        if (c == ':') {
+            size_t wlen = p - word;
+            if ((wlen == 1) && ((word[0] == 'T') || (word[0] == 'B'))) {
+                event.has_temperature = true;
+            } else if (!error && is_word(word, wlen, error_word)) {
+                error = p + 1;
+            } else if (!info && is_word(word, wlen, info_word)) {
+                info = p + 1;
+            } else if (!status && is_word(word, wlen, status_word)) {
+                status = p + 1;
+            } else if (is_word(word, wlen, "busy")) {
+                busy = true;
+            } else if (!resend && is_word(word, wlen, "Resend")) {
+                resend = p + 1;
+            }
+        } else if ((c == '[') && !esp && (strncmp(p, "[ESP", 4) == 0)) {
+            esp = p + 4;
+        }
+        if (!isalnum(c)) {
+            word = p + 1;
+        }
+    }
+    if (esp) {
+        event.type = LINE_ESP_COMMAND;
+        event.payload = esp;
+    } else if (resend) {
+        event.type = LINE_RESEND;
+        event.payload = resend;
+    } else if (error && !strstr(_line, "Format error") && (strncmp(error, "wait", 4) != 0)) {
+        event.type = LINE_ERROR;
+        event.payload = error;
+    } else if (info) {
+        event.type = LINE_INFO;
+        event.payload = info;
+    } else if (busy) {
+        //Marlin sends echo:busy: processing, so it is checked before status
+        event.type = LINE_BUSY;
+    } else if (status) {
+        event.type = LINE_STATUS;
+        event.payload = status;
+    } else if (strncmp(_line, "ok", 2) == 0) {
+        event.type = LINE_OK;
+    } else if (strncmp(_line, "wait", 4) == 0) {
+        event.type = LINE_WAIT;
+    } else if (event.has_temperature) {
+        event.type = LINE_TEMPERATURE;
+    } else {
+        event.type = LINE_OTHER;
+    }
+}
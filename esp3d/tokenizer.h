@@ -0,0 +1,67 @@
+/*
+  tokenizer.h - esp3d line tokenizer class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef TOKENIZER_h
+#define TOKENIZER_h
+#include <Arduino.h>
+#include "config.h"
+
+//longer lines are truncated
+#define TOKENIZER_LINE_SIZE 128
+
+typedef enum {
+    LINE_OTHER = 0,
+    LINE_OK = 1,
+    LINE_WAIT = 2,
+    LINE_BUSY = 3,
+    LINE_TEMPERATURE = 4,
+    LINE_ERROR = 5,
+    LINE_INFO = 6,
+    LINE_STATUS = 7,
+    LINE_ESP_COMMAND = 8,
+    LINE_RESEND = 9
+} tline_type;
+
+//a complete line, valid until next call of feed()
+typedef struct {
+    tline_type type;
+    char * line;
+    uint16_t length;
+    //text after keyword for error/info/status/resend, command number for [ESP
+    char * payload;
+    //T: or B: is in line
+    bool has_temperature;
+} tline_event;
+
+class TOKENIZER_CLASS
+{
+public:
+    TOKENIZER_CLASS();
+    void reset();
+    bool feed(const uint8_t * &data, size_t &len, tline_event & event);
+    bool feed_marked(const uint8_t * &data, size_t &len, tline_event & event, char marker);
+private:
+    char _line[TOKENIZER_LINE_SIZE + 1];
+    uint16_t _len;
+    bool _iscomment;
+    void classify(tline_event & event);
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*
+  webcommand.cpp - esp3d web command queue class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "webcommand.h"
+#include "webinterface.h"
+#include "bridge.h"
+#include "serialout.h"
+#ifdef ARDUINO_ARCH_ESP32
+//ESP32 client has no availableForWrite(), bundled WebServer library tells it
+#include <ClientRoom.h>
+#endif
+
+web_ticket WEBCOMMAND::_tickets[MAX_WEB_COMMANDS];
+uint8_t WEBCOMMAND::_first = 0;
+uint8_t WEBCOMMAND::_count = 0;
+bool WEBCOMMAND::_running = false;
+bool WEBCOMMAND::_done = false;
+bool WEBCOMMAND::_data_sent = false;
+uint8_t WEBCOMMAND::_temp_counter = 0;
+uint32_t WEBCOMMAND::_last_data = 0;
+uint16_t WEBCOMMAND::_tag = 0;
+char WEBCOMMAND::_answer[WEB_COMMAND_ANSWER_SIZE];
+uint16_t WEBCOMMAND::_answer_len = 0;
+
+//[ESP] commands are run by /command handler and never get a ticket, so
+//only a line with something for printer has to wait for serial
+static bool needs_printer(const String & command)
+{
+    for (size_t i = 0; i < command.length(); i++) {
+        char c = command[i];
+        if (c == ';') {
+            return false;
+        }
+        if ((c != ' ') && (c != '\t') && (c != '\r') && (c != '\n')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//keep client and command, answer will be sent from loop()
+bool WEBCOMMAND::add(WiFiClient & client, String & command)
+{
+    //queue is full
+    if (_count >= MAX_WEB_COMMANDS) {
+        return false;
+    }
+    web_ticket & t = _tickets[(_first + _count) % MAX_WEB_COMMANDS];
+    t.client = client;
+    t.command = command;
+    _count++;
+    LOG("Web command queued\r\n")
+    return true;
+}
+
+//answer length is unknown so connection is closed at the end
+void WEBCOMMAND::send_header()
+{
+    _tickets[_first].client.print(F("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n"));
+}
+
+//send command of oldest ticket to serial
+void WEBCOMMAND::start()
+{
+    web_ticket & t = _tickets[_first];
+    //lines received before are not part of answer
+    BRIDGE::processFromSerial2TCP();
+    _running = true;
+    _done = false;
+    _data_sent = false;
+    _temp_counter = 0;
+    _answer_len = 0;
+    _last_data = millis();
+    //ok of this line is told by its tag, 0 is no tag
+    if (++_tag == 0) {
+        _tag = 1;
+    }
+    send_header();
+    LOG("Send Command\r\n")
+    serial_out.command(t.command.c_str(), PRIO_INTERACTIVE, _tag);
+}
+
+//keep line for client, it is dropped if client is too slow to take it
+void WEBCOMMAND::add_answer(const char * line, uint16_t len)
+{
+    if ((_answer_len + len + 1) > WEB_COMMAND_ANSWER_SIZE) {
+        return;
+    }
+    memcpy(_answer + _answer_len, line, len);
+    _answer_len += len;
+    _answer[_answer_len++] = '\n';
+    _data_sent = true;
+}
+
+//called by serial parser for each line, only keeps answer, process() sends it
+void WEBCOMMAND::check_line(tline_event & event)
+{
+    if (!_running || _done) {
+        return;
+    }
+    _last_data = millis();
+    //printer has nothing to do anymore
+    if (event.type == LINE_WAIT) {
+        _done = true;
+        return;
+    }
+    //oks of other producers, like tcp clients or [ESP700] job, are skipped
+    if (event.type == LINE_OK) {
+        if (serial_out.acknowledged_tag() != _tag) {
+            return;
+        }
+        //marlin answers M105 on its ok line
+        if (event.has_temperature) {
+            add_answer(event.line, event.length);
+        }
+        LOG("Found ok\r\n")
+        _done = true;
+        return;
+    }
+    bool repetier = (CONFIG::GetFirmwareTarget() == REPETIER) || (CONFIG::GetFirmwareTarget() == REPETIER4DV);
+    if (repetier && strstr(event.line, "busy:")) {
+        _temp_counter++;
+    } else if (event.has_temperature) {
+        _temp_counter++;
+    }
+    //it is sending too many temp status should be heating so stop here
+    if (_temp_counter > 5) {
+        _done = true;
+        return;
+    }
+    add_answer(event.line, event.length);
+}
+
+//write what client can take now, so loop() never waits for it
+void WEBCOMMAND::send_answer()
+{
+    web_ticket & t = _tickets[_first];
+#ifdef ARDUINO_ARCH_ESP32
+    size_t room = clientRoom(t.client);
+#else
+    size_t room = t.client.availableForWrite();
+#endif
+    if (room > _answer_len) {
+        room = _answer_len;
+    }
+    if (room == 0) {
+        return;
+    }
+    room = t.client.write((const uint8_t *)_answer, room);
+    memmove(_answer, _answer + room, _answer_len - room);
+    _answer_len -= room;
+    _last_data = millis();
+}
+
+//close connection of current ticket and release serial
+void WEBCOMMAND::finish()
+{
+    web_ticket & t = _tickets[_first];
+    if (!_data_sent) {
+        t.client.print(F(" \r\n"));
+    }
+    t.client.stop();
+    t.client = WiFiClient();
+    t.command = "";
+    _first = (_first + 1) % MAX_WEB_COMMANDS;
+    _count--;
+    _running = false;
+}
+
+//called from loop(), never waits for printer
+void WEBCOMMAND::process()
+{
+    if (!_running) {
+        if (_count == 0) {
+            return;
+        }
+        //printer would not answer, so ticket does not wait for serial
+        if (!needs_printer(_tickets[_first].command)) {
+            send_header();
+            _data_sent = false;
+            finish();
+            return;
+        }
+        //raw client has UART, line would wait until it leaves
+        if (serial_out.raw_active()) {
+            send_header();
+            _tickets[_first].client.print(F("Serial is used by raw client\r\n"));
+            _data_sent = true;
+            finish();
+            return;
+        }
+        //during SD upload printer line would wait longer than WEB_COMMAND_TIMEOUT
+        //other tickets wait behind it, to be answered in order
+        if (serial_out.held()) {
+            return;
+        }
+        start();
+    }
+    web_ticket & t = _tickets[_first];
+    bool done = !t.client.connected();
+    if (!done) {
+        send_answer();
+        if (_done && (_answer_len == 0)) {
+            done = true;
+        } else if ((millis() - _last_data) > WEB_COMMAND_TIMEOUT) {
+            //printer does not answer anymore, or client does not read
+            done = true;
+        }
+    }
+    if (done) {
+        finish();
+    }
+}
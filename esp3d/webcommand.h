@@ -0,0 +1,78 @@
+/*
+  webcommand.h - esp3d web command queue class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WEBCOMMAND_h
+#define WEBCOMMAND_h
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include "config.h"
+#include "tokenizer.h"
+
+//web commands waiting for serial
+#define MAX_WEB_COMMANDS 4
+//ms without printer answer before closing web answer
+#define WEB_COMMAND_TIMEOUT 2000
+//answer waiting for client, lines which do not fit are dropped
+#define WEB_COMMAND_ANSWER_SIZE 512
+
+struct web_ticket {
+    WiFiClient client;
+    String command;
+};
+
+//each /command for printer gets a ticket, tickets are sent to serial one
+//by one and answer is given to waiting client as it comes from loop()
+//serial parser gives answer lines, they are kept until client takes them
+//answer ends on ok of ticket line, found by its tag
+//[ESP] commands are answered by handler, so they never wait for a ticket
+//during SD upload, only tickets with a line for printer are held
+//while a raw tcp client has UART, they are answered with an error
+class WEBCOMMAND
+{
+public:
+    static bool add(WiFiClient & client, String & command);
+    static void process();
+    static void check_line(tline_event & event);
+    inline static bool running()
+    {
+        return _running;
+    };
+private:
+    static web_ticket _tickets[MAX_WEB_COMMANDS];
+    static uint8_t _first;
+    static uint8_t _count;
+    static bool _running;
+    //answer is complete, what is kept is still sent
+    static bool _done;
+    static bool _data_sent;
+    static uint8_t _temp_counter;
+    static uint32_t _last_data;
+    //tag of line sent for running ticket
+    static uint16_t _tag;
+    static char _answer[WEB_COMMAND_ANSWER_SIZE];
+    static uint16_t _answer_len;
+    static void send_header();
+    static void start();
+    static void add_answer(const char * line, uint16_t len);
+    static void send_answer();
+    static void finish();
+};
+
+#endif
@@ -0,0 +1,180 @@
+/*
+  webevents.cpp - esp3d web events push class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "webevents.h"
+
+#ifdef WEB_EVENTS_FEATURE
+#ifdef MONITORING_FEATURE
+#include "printerstate.h"
+#endif
+#ifdef ARDUINO_ARCH_ESP32
+//ESP32 client has no availableForWrite(), bundled WebServer library tells it
+#include <ClientRoom.h>
+#endif
+
+WiFiClient WEBEVENTS::_clients[MAX_EVENT_CLIENTS];
+uint32_t WEBEVENTS::_last_send[MAX_EVENT_CLIENTS];
+uint8_t WEBEVENTS::_count = 0;
+uint32_t WEBEVENTS::_state_version = 0;
+uint32_t WEBEVENTS::_last_state = 0;
+
+//keep client connection open, events will be sent from loop()
+bool WEBEVENTS::add(WiFiClient & client)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_EVENT_CLIENTS; i++) {
+        if (!_clients[i] || !_clients[i].connected()) {
+            break;
+        }
+    }
+    //no free spot
+    if (i == MAX_EVENT_CLIENTS) {
+        return false;
+    }
+    _clients[i] = client;
+    _clients[i].print(F("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\nretry: 3000\n\n"));
+    _last_send[i] = millis();
+    _count++;
+    //new client needs current state
+    _state_version--;
+    _last_state = millis() - WEB_EVENTS_STATE_DELAY;
+    LOG("Events client added\r\n")
+    return true;
+}
+
+//event is written only if client can take it at once
+bool WEBEVENTS::has_room(uint8_t i, size_t len)
+{
+    if (!_clients[i] || !_clients[i].connected()) {
+        return false;
+    }
+#ifdef ARDUINO_ARCH_ESP32
+    return clientRoom(_clients[i]) >= len;
+#else
+    return _clients[i].availableForWrite() >= len;
+#endif
+}
+
+bool WEBEVENTS::send_to(uint8_t i, const char * data, size_t len)
+{
+    if (!has_room(i, len)) {
+        return false;
+    }
+    _clients[i].write((const uint8_t *)data, len);
+    _last_send[i] = millis();
+    return true;
+}
+
+//event is written by pieces, so its text is never copied
+void WEBEVENTS::send(const char * name, const char * data)
+{
+    size_t name_len = strlen(name);
+    size_t data_len = strlen(data);
+    //"event: ", "\ndata: " and "\n\n"
+    size_t len = name_len + data_len + 16;
+    for (uint8_t i = 0; i < MAX_EVENT_CLIENTS; i++) {
+        if (!has_room(i, len)) {
+            continue;
+        }
+        _clients[i].write((const uint8_t *)"event: ", 7);
+        _clients[i].write((const uint8_t *)name, name_len);
+        _clients[i].write((const uint8_t *)"\ndata: ", 7);
+        _clients[i].write((const uint8_t *)data, data_len);
+        _clients[i].write((const uint8_t *)"\n\n", 2);
+        _last_send[i] = millis();
+    }
+}
+
+void WEBEVENTS::send_state()
+{
+#ifdef MONITORING_FEATURE
+    String state;
+    STRINGPRINT_CLASS output(state);
+    JSONWRITER_CLASS json(output);
+    printer_state.print_json(json);
+    send("state", state.c_str());
+    _state_version = printer_state.version();
+    _last_state = millis();
+#endif
+}
+
+//called for each line printer sent
+void WEBEVENTS::check_line(tline_event & event)
+{
+    if (_count == 0) {
+        return;
+    }
+    //acks would flood clients during a print
+    if (((event.type == LINE_OK) && (event.length == 2)) || (event.type == LINE_WAIT)) {
+        return;
+    }
+    send("console", event.line);
+    const char * name = NULL;
+    switch (event.type) {
+    case LINE_ERROR:
+        name = "error";
+        break;
+    case LINE_INFO:
+        name = "info";
+        break;
+    case LINE_STATUS:
+        name = "status";
+        break;
+    default:
+        break;
+    }
+    if (name) {
+        const char * text = event.payload;
+        while (*text == ' ') {
+            text++;
+        }
+        send(name, text);
+    }
+}
+
+//called in loop, remove closed clients, send state changes and keep alive
+void WEBEVENTS::process()
+{
+    if (_count == 0) {
+        return;
+    }
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MAX_EVENT_CLIENTS; i++) {
+        if (!_clients[i]) {
+            continue;
+        }
+        if (!_clients[i].connected()) {
+            _clients[i].stop();
+            continue;
+        }
+        count++;
+        if ((millis() - _last_send[i]) > WEB_EVENTS_KEEPALIVE) {
+            send_to(i, ":\n\n", 3);
+        }
+    }
+    _count = count;
+#ifdef MONITORING_FEATURE
+    if ((_count > 0) && (printer_state.version() != _state_version) && ((millis() - _last_state) >= WEB_EVENTS_STATE_DELAY)) {
+        send_state();
+    }
+#endif
+}
+
+#endif //WEB_EVENTS_FEATURE
@@ -0,0 +1,65 @@
+/*
+  webevents.h - esp3d web events push class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WEBEVENTS_h
+#define WEBEVENTS_h
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include "config.h"
+#include "tokenizer.h"
+
+#ifdef WEB_EVENTS_FEATURE
+
+//clients connected to /events at once
+#define MAX_EVENT_CLIENTS 4
+//ms without event before sending a comment to check connection
+#define WEB_EVENTS_KEEPALIVE 15000
+//min ms between two printer state events
+#define WEB_EVENTS_STATE_DELAY 500
+
+//each /events client keeps its connection and gets server-sent events:
+//console (every printer line but ok), error, info, status (messages)
+//and state (printer state json, if MONITORING_FEATURE)
+//an event a slow client cannot take at once is dropped for it
+class WEBEVENTS
+{
+public:
+    static bool add(WiFiClient & client);
+    static void process();
+    static void check_line(tline_event & event);
+    inline static bool listening()
+    {
+        return _count > 0;
+    };
+private:
+    static WiFiClient _clients[MAX_EVENT_CLIENTS];
+    static uint32_t _last_send[MAX_EVENT_CLIENTS];
+    static uint8_t _count;
+    static uint32_t _state_version;
+    static uint32_t _last_state;
+    static void send(const char * name, const char * data);
+    static bool has_room(uint8_t i, size_t len);
+    static bool send_to(uint8_t i, const char * data, size_t len);
+    static void send_state();
+};
+
+#endif //WEB_EVENTS_FEATURE
+
+#endif
@@ -37,12 +37,27 @@
 #include <WebServer.h>
 #include "SPIFFS.h"
 #include "Update.h"
+#include "esp_system.h"
 #endif
 
-#include "GenLinkedList.h"
-#include "storestrings.h"
+#include "eventlog.h"
+#include "responsewriter.h"
+#include "jsonwriter.h"
+#include "dirindex.h"
 #include "command.h"
 #include "bridge.h"
+#include "ringbuffer.h"
+#include "gcodesender.h"
+#include "printjob.h"
+#include "webcommand.h"
+#include "assetindex.h"
+#include "serialout.h"
+#include "printerstate.h"
+#include "telemetry.h"
+#include "webevents.h"
+#include "webterminal.h"
+#include "chunkupload.h"
+#include "sdupload.h"
 
 #ifdef SSDP_FEATURE
 #include <ESP8266SSDP.h>
@@ -51,7 +66,6 @@
 //embedded response file if no files on SPIFFS
 #include "nofile.h"
 
-#define MAX_AUTH_IP 10
 #define HIDDEN_PASSWORD "********"
 
 
@@ -69,83 +83,155 @@ const char CONTENT_TYPE_HTML [] PROGMEM ="text/html";
 
 void handle_web_interface_root()
 {
-    String path = "/index.html";
-    String contentType =  web_interface->getContentType(path);
-    String pathWithGz = path + ".gz";
     //if have a index.html or gzip version this is default root page
-    if((SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) && !web_interface->web_server.hasArg("fallback") && web_interface->web_server.arg("forcefallback")!="yes") {
-        if(SPIFFS.exists(pathWithGz)) {
-            path = pathWithGz;
+    if (!web_interface->web_server.hasArg("fallback") && web_interface->web_server.arg("forcefallback")!="yes") {
+        if (asset_index.serve("/index.html")) {
+            return;
         }
-		FS_FILE file = SPIFFS.open(path, SPIFFS_FILE_READ);
-        web_interface->web_server.streamFile(file, contentType);
-        file.close();
-        return;
     }
     //if no lets launch the default content
     web_interface->web_server.sendHeader("Content-Encoding", "gzip");
     web_interface->web_server.send_P(200,CONTENT_TYPE_HTML,PAGE_NOFILES,PAGE_NOFILES_SIZE);
 }
 
+//messages of one kind as {"line":"..."} array, for clients not using since
+static void status_messages(JSONWRITER_CLASS & json, const char * key, tevent_severity severity)
+{
+    json.begin_array(key);
+    for (uint8_t i=0; i<event_log.size(); i++) {
+        const tevent_entry & entry = event_log.get(i);
+        if (entry.severity != severity) {
+            continue;
+        }
+        json.begin_object();
+        json.add("line", entry.text);
+        json.end_object();
+    }
+    json.end_array();
+}
+
 //concat several catched informations temperatures/position/status/flow/speed
+//printer is never queried, state comes from answers already parsed
+//with since=<seq> only messages newer than seq are sent, in one events array,
+//reset is set if client must drop messages it has, nothing if no new message
 void handle_web_interface_status()
 {
-  //  static const char NO_TEMP_LINE[] PROGMEM = "\"temperature\":\"0\",\"target\":\"0\",\"active\":\"0\"";
     //we do not care if need authentication - just reset counter
     web_interface->is_authenticated();
-    //int tagpos,tagpos2;
-    String buffer2send;
-    String value;
-    //start JSON answer
-    buffer2send="{";
-#ifdef INFO_MSG_FEATURE
-    //information
-    buffer2send.concat(F("\"InformationMsg\":["));
-
-    for (int i=0; i<web_interface->info_msg.size(); i++) {
-        if (i>0) {
-            buffer2send+=",";
+    response_writer.begin(200, "application/json");
+    JSONWRITER_CLASS json(response_writer);
+    json.begin_object();
+    json.add_uint("seq", event_log.seq());
+    if (web_interface->web_server.hasArg("since")) {
+        uint32_t since = strtoul(web_interface->web_server.arg("since").c_str(), NULL, 10);
+        if (since != event_log.seq()) {
+            bool reset = event_log.reset_since(since);
+            if (reset) {
+                json.add_bool("reset", true);
+            }
+            json.begin_array("events");
+            for (uint8_t i=0; i<event_log.size(); i++) {
+                const tevent_entry & entry = event_log.get(i);
+                if ((entry.severity == EVENT_NONE) || (!reset && (entry.seq <= since))) {
+                    continue;
+                }
+                json.begin_object();
+                json.add_uint("seq", entry.seq);
+                json.add_uint("time", entry.time);
+                json.add("type", EVENTLOG_CLASS::severity_name(entry.severity));
+                json.add("line", entry.text);
+                json.end_object();
+            }
+            json.end_array();
         }
-        buffer2send+="{\"line\":\"";
-        buffer2send+=web_interface->info_msg.get(i);
-        buffer2send+="\"}";
-    }
-    buffer2send+="],";
+    } else {
+#ifdef INFO_MSG_FEATURE
+        //information
+        status_messages(json, "InformationMsg", EVENT_INFO);
 #endif
 #ifdef ERROR_MSG_FEATURE
-    //Error
-    buffer2send.concat(F("\"ErrorMsg\":["));
-    for (int i=0; i<web_interface->error_msg.size(); i++) {
-        if (i>0) {
-            buffer2send+=",";
-        }
-        buffer2send+="{\"line\":\"";
-        buffer2send+=web_interface->error_msg.get(i);
-        buffer2send+="\"}";
-    }
-    buffer2send+="],";
+        //Error
+        status_messages(json, "ErrorMsg", EVENT_ERROR);
 #endif
 #ifdef STATUS_MSG_FEATURE
-    //Status
-    buffer2send.concat(F("\"StatusMsg\":["));
-
-    for (int i=0; i<web_interface->status_msg.size(); i++) {
-        if (i>0) {
-            buffer2send+=",";
-        }
-        buffer2send+="{\"line\":\"";
-        buffer2send+=web_interface->status_msg.get(i);
-        buffer2send+="\"}";
+        //Status
+        status_messages(json, "StatusMsg", EVENT_STATUS);
+#endif
     }
-    buffer2send+="],";
+#ifdef MONITORING_FEATURE
+    //printer state
+    printer_state.print_json(json, "printer");
 #endif
     //status color
-    buffer2send+="\"status\":\""+value +"\"";
-    buffer2send+="}";
-    web_interface->web_server.sendHeader("Cache-Control", "no-cache");
-    web_interface->web_server.send(200, "application/json",buffer2send);
+    json.add("status", "");
+    json.end_object();
+    response_writer.end();
 }
 
+#ifdef MONITORING_FEATURE
+//temperature history: /telemetry?since=<s from boot>&res=<1|10|60>&format=<json|bin>
+//resolution is chosen from since if not given
+void handle_telemetry()
+{
+    //we do not care if need authentication - just reset counter
+    web_interface->is_authenticated();
+    uint32_t since = 0;
+    int8_t level = -1;
+    bool binary = false;
+    if (web_interface->web_server.hasArg("since")) {
+        since = web_interface->web_server.arg("since").toInt();
+    }
+    if (web_interface->web_server.hasArg("res")) {
+        int res = web_interface->web_server.arg("res").toInt();
+        level = (res >= 60) ? 2 : ((res >= 10) ? 1 : 0);
+    }
+    if (web_interface->web_server.hasArg("format")) {
+        binary = (web_interface->web_server.arg("format") == "bin");
+    }
+    //answer length is unknown so connection is closed at the end
+    WiFiClient client = web_interface->web_server.client();
+    client.print(F("HTTP/1.1 200 OK\r\nContent-Type: "));
+    client.print(binary ? F("application/octet-stream") : F("application/json"));
+    client.print(F("\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n"));
+    telemetry.stream(client, level, since, binary);
+    client.stop();
+}
+#endif
+
+#ifdef WEB_EVENTS_FEATURE
+//server-sent events, connection is kept and events are sent from loop()
+void handle_web_events()
+{
+    level_authenticate_type auth_level= web_interface->is_authenticated();
+    if (auth_level == LEVEL_GUEST) {
+        web_interface->web_server.send(401,"text/plain","Authentication failed!\n");
+        return;
+    }
+    WiFiClient client = web_interface->web_server.client();
+    if (!WEBEVENTS::add(client)) {
+        web_interface->web_server.send(503,"text/plain","Too many clients, retry later!");
+        return;
+    }
+#ifdef ARDUINO_ARCH_ESP32
+    //connection is an event stream now, server must not wait on it
+    web_interface->web_server.keepClient();
+#endif
+}
+#endif
+
+#ifdef WS_TERMINAL_FEATURE
+//serial terminal over WebSocket, connection is kept after upgrade
+void handle_web_terminal()
+{
+    level_authenticate_type auth_level= web_interface->is_authenticated();
+    if (auth_level == LEVEL_GUEST) {
+        web_interface->web_server.send(401,"text/plain","Authentication failed!\n");
+        return;
+    }
+    WEBTERMINAL::add(auth_level);
+}
+#endif
+
 //SPIFFS files uploader handle
 void SPIFFSFileupload()
 {
@@ -159,7 +245,7 @@ void SPIFFSFileupload()
     //Guest cannot upload
     if (auth_level == LEVEL_GUEST) {
         web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
-        ESP_SERIAL_OUT.println("M117 Error ESP upload");
+        serial_out.println("M117 Error ESP upload");
 #ifdef ARDUINO_ARCH_ESP8266
         web_interface->web_server.client().stopAll();
 #else 
@@ -185,7 +271,7 @@ void SPIFFSFileupload()
         } else {
             filename = "/user" + upload.filename;
         }
-        ESP_SERIAL_OUT.println("M117 Start ESP upload");
+        serial_out.println("M117 Start ESP upload");
         //create file
 		web_interface->fsUploadFile = SPIFFS.open(filename, SPIFFS_FILE_WRITE);
         //check If creation succeed
@@ -195,7 +281,7 @@ void SPIFFSFileupload()
         } else {
             //if no set cancel flag
             web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
-            ESP_SERIAL_OUT.println("M117 Error ESP create");
+            serial_out.println("M117 Error ESP create");
 #ifdef ARDUINO_ARCH_ESP8266
 			web_interface->web_server.client().stopAll();
 #else 
@@ -224,7 +310,7 @@ void SPIFFSFileupload()
 #else 
 			web_interface->web_server.client().stop();
 #endif
-            ESP_SERIAL_OUT.println("M117 Error ESP write");
+            serial_out.println("M117 Error ESP write");
         }
         //Upload end
         //**************
@@ -235,9 +321,10 @@ void SPIFFSFileupload()
         DEBUG_PERF_VARIABLE.add(String(write_time).c_str());
         DEBUG_PERF_VARIABLE.add(String(filesize).c_str());
 #endif
-        ESP_SERIAL_OUT.println("M117 End ESP upload");
+        serial_out.println("M117 End ESP upload");
         //check if file is still open
         if(web_interface->fsUploadFile) {
+            dir_index.add_file(filename, web_interface->fsUploadFile.size());
             //close it
             web_interface->fsUploadFile.close();
             web_interface->_upload_status=UPLOAD_STATUS_SUCCESSFUL;
@@ -250,43 +337,30 @@ void SPIFFSFileupload()
 			web_interface->web_server.client().stop();
 #endif
             SPIFFS.remove(filename);
-            ESP_SERIAL_OUT.println("M117 Error ESP close");
+            serial_out.println("M117 Error ESP close");
         }
         //Upload cancelled
         //**************
     } else {
-			ESP_SERIAL_OUT.println("M117 Error ESP close");
+			serial_out.println("M117 Error ESP close");
 			return;
         web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
         SPIFFS.remove(filename);
-        ESP_SERIAL_OUT.println("M117 Error ESP upload");
+        serial_out.println("M117 Error ESP upload");
     }
     delay(0);
 }
 
-#define NB_RETRY 5
-#define MAX_RESEND_BUFFER 128
-//SD file upload by serial
+//SD file upload by serial: each block is split in lines sent by sd_upload
+//before web server gets next one, so what printer cannot take yet waits
+//in tcp buffer of client, only last lines are sent from loop()
 void SDFile_serial_upload()
 {
-    static char buffer_line[MAX_RESEND_BUFFER]; //if need to resend
-    static char previous = 0;
-    static int  buffer_size;
-    static bool com_error = false;
-    static bool is_comment = false;
-    bool client_closed = false;
-    static String filename;
-    String response;
     //Guest cannot upload - only admin and user
     if(web_interface->is_authenticated() == LEVEL_GUEST) {
         web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
-        ESP_SERIAL_OUT.println("M117 SD upload rejected");
+        serial_out.println("M117 SD upload rejected");
         LOG("SD upload rejected\r\n");
-        if (!client_closed){
-            //web_interface->web_server.client().stopAll();
-            LOG("Need to stop");
-            client_closed = true;
-        }
         return;
     }
 #ifdef DEBUG_PERFORMANCE
@@ -299,310 +373,74 @@ void SDFile_serial_upload()
     //Upload start
     //**************
     if(upload.status == UPLOAD_FILE_START) {
-        //need to lock serial out to avoid garbage in file
-        (web_interface->blockserial) = true;
-        //init flags
-        buffer_size=0;
-        com_error = false;
-        is_comment = false;
-        previous = 0;
-        web_interface->_upload_status= UPLOAD_STATUS_ONGOING;
-        ESP_SERIAL_OUT.println("M117 Uploading...");
-        ESP_SERIAL_OUT.flush();
+        //printer is busy with a job started by [ESP700] or another upload
+        if (print_job.active() || sd_upload.active()) {
+            web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
+            LOG("SD upload rejected, serial busy\r\n");
+            return;
+        }
 #ifdef DEBUG_PERFORMANCE
         startupload = millis();
         write_time = 0;
         filesize = 0;
 #endif
-        LOG("Clear Serial\r\n");
-        if(ESP_SERIAL_OUT.available()) {
-                //get size of buffer
-                size_t len = ESP_SERIAL_OUT.available();
-                uint8_t sbuf[len+1];
-                //read buffer
-                ESP_SERIAL_OUT.readBytes(sbuf, len);
-                //convert buffer to zero end array
-                sbuf[len]='\0';
-                //use string because easier to handle
-                response = (const char*)sbuf;
-                LOG(response);
-                LOG("\r\n");
-                }
-        //command to pritnter to start print
-        String command = "M28 " + upload.filename;
-        LOG(command);
-        LOG("\r\n");
-        ESP_SERIAL_OUT.println(command);
-        ESP_SERIAL_OUT.flush();
-        filename = upload.filename;
-        //now need to purge all serial data
-        //let's sleep 1s
-        //delay(1000);
-        for (int retry=0; retry < 400; retry++) { //time out is  5x400ms = 2000ms
-            //if there is something in serial buffer
-            if(ESP_SERIAL_OUT.available()) {
-                //get size of buffer
-                size_t len = ESP_SERIAL_OUT.available();
-                uint8_t sbuf[len+1];
-                //read buffer
-                ESP_SERIAL_OUT.readBytes(sbuf, len);
-                //convert buffer to zero end array
-                sbuf[len]='\0';
-                //use string because easier to handle
-                response =(const char*)sbuf;
-                LOG(response);
-                //if there is a wait it means purge is done
-                if (response.indexOf("wait")>-1) {
-                    LOG("Exit start writing\r\n");
-                    break;
-                }
-               if (response.indexOf("Resend")>-1 || response.indexOf("failed")>-1) {
-                    com_error = true;
-                    web_interface->blockserial = false;
-                    LOG("Error start writing\r\n");
-                    break;
-                }
-            }
-            delay(5);
+        //M28 is sent, lines wait until printer opened file
+        if (sd_upload.begin(upload.filename)) {
+            web_interface->_upload_status= UPLOAD_STATUS_ONGOING;
+        } else {
+            web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
         }
         //Upload write
         //**************
-        //upload is on going with data coming by 2K blocks
-    } else if((upload.status == UPLOAD_FILE_WRITE) && (com_error == false)) { //if com error no need to send more data to serial
-        web_interface->_upload_status= UPLOAD_STATUS_ONGOING;
+    } else if(upload.status == UPLOAD_FILE_WRITE) {
+        if (web_interface->_upload_status == UPLOAD_STATUS_ONGOING) {
 #ifdef DEBUG_PERFORMANCE
-        filesize+=upload.currentSize;
-        uint32_t startwrite = millis();
+            filesize+=upload.currentSize;
+            uint32_t startwrite = millis();
 #endif
-        for (int pos = 0; pos < upload.currentSize; pos++) { //parse full post data
-            if (buffer_size < MAX_RESEND_BUFFER-1) { //raise error/handle if overbuffer - copy is space available
-                //remove/ignore every comment to save transfert time and avoid over buffer issues
-                if (upload.buf[pos] == ';') {
-                    is_comment = true;
-                    previous = ';';
+            //web server reuses its buffer, so block must be split before returning
+            //lines go as printer confirms them, its answers are read meanwhile
+            if (sd_upload.feed(upload.buf, upload.currentSize, false)) {
+                while (sd_upload.active() && !sd_upload.ready()) {
+                    serial_out.process();
+                    BRIDGE::processFromSerial2TCP();
+                    sd_upload.process();
+                    delay(0);
                 }
-                if (!is_comment) {
-                    buffer_line[buffer_size] = upload.buf[pos]; //copy current char to buffer to send/resend
-                    buffer_size++;
-                    //convert buffer to zero end array
-                    buffer_line[buffer_size] = '\0';
-                    //check it is not an end line char and line is not empty
-                    if (((buffer_line[0] == '\n') && (buffer_size==1)) ||((buffer_line[1] == '\n') && (buffer_line[0] == '\r') && (buffer_size==2)) || ((buffer_line[0] == ' ') && (buffer_size==1)) ) {
-                        //ignore empty line
-                        buffer_size=0;
-                        buffer_line[buffer_size] = '\0';
-                    }
-                    //line is not empty so check if last char is an end line
-                    //if error no need to proceed
-                    else if (((buffer_line[buffer_size-1] == '\n')) && (com_error == false)) { //end of line and no error
-                        //if resend use buffer
-                        bool success = false;
-
-                        //check NB_RETRY times if get no error when send line
-                        for (int r = 0 ; r < NB_RETRY ; r++) {
-                            response = "";
-                            //print out line
-                            ESP_SERIAL_OUT.print(buffer_line);
-                            LOG(buffer_line);
-                            //ensure buffer is empty before continuing
-                            ESP_SERIAL_OUT.flush();
-                            //wait for answer with time out
-                            for (int retry=0; retry < 30; retry++) { //time out 30x5ms = 150ms
-                                //if there is serial data
-                                if(ESP_SERIAL_OUT.available()) {
-                                    //get size of available data
-                                    size_t len = ESP_SERIAL_OUT.available();
-                                    uint8_t sbuf[len+1];
-                                    //read serial buffer
-                                    ESP_SERIAL_OUT.readBytes(sbuf, len);
-                                    //convert buffer in zero end array
-                                    sbuf[len]='\0';
-                                    //use string because easier
-                                    response = (const char*)sbuf;
-                                    LOG("Retry:");
-                                    LOG(String(retry));
-                                    LOG("\r\n");
-                                    LOG(response);
-                                    //if buffer contain ok or wait - it means command is pass
-                                    if ((response.indexOf("wait")>-1)||(response.indexOf("ok")>-1)) {
-                                        success = true;
-                                        break;
-                                    }
-                                    //if buffer contain resend then need to resend
-                                    if (response.indexOf("Resend") > -1) { //if error
-                                        success = false;
-                                        break;
-                                    }
-                                }
-                                delay(5);
-                            }
-                            //if command is pass no need to retry
-                            if (success == true) {
-                                break;
-                            }
-                            //purge extra serial if any
-                            if(ESP_SERIAL_OUT.available()) {
-                                //get size of available data
-                                size_t len = ESP_SERIAL_OUT.available();
-                                uint8_t sbuf[len+1];
-                                //read serial buffer
-                                ESP_SERIAL_OUT.readBytes(sbuf, len);
-                                //convert buffer in zero end array
-                                sbuf[len]='\0';
-                            }
-                        }
-                        //if even after the number of retry still have error - then we are in error
-                        if (!success) {
-                            //raise error
-                            LOG("Error detected\r\n");
-                            LOG(response);
-                            com_error = true;
-                        }
-                        //reset buffer for next command
-                        buffer_size = 0;
-                        buffer_line[buffer_size] = '\0';
-                    }
-                } else { //it is a comment
-                    if (upload.buf[pos] == '\r') { //store if CR
-                        previous = '\r';
-                    } else if (upload.buf[pos] == '\n') { //this is the end of the comment
-                        is_comment = false;
-                        if (buffer_size > 0) {
-                            if (previous == '\r') {
-                                pos--;
-                            }
-                            pos--; //do a loop back and process as normal
-                        }
-                        previous = '\n';
-                    }//if not just ignore and continue
-                    else {
-                        previous = upload.buf[pos];
-                    }
-
-                }
-            } else { //raise error
-                LOG("\r\nlong line detected\r\n");
-                LOG(buffer_line);
-                com_error = true;
             }
-        }
+            //printer did not answer or rejected lines, sd_upload told it by M117
+            if (!sd_upload.ready()) {
+                web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
+            }
 #ifdef DEBUG_PERFORMANCE
-        write_time += (millis()-startwrite);
+            write_time += (millis()-startwrite);
 #endif
+        }
         //Upload end
         //**************
     } else if(upload.status == UPLOAD_FILE_END) {
-        if (buffer_size > 0) { //if last part does not have '\n'
-            //print the line
-            ESP_SERIAL_OUT.print(buffer_line);
-            if (is_comment && (previous == '\r')) {
-                ESP_SERIAL_OUT.print("\r\n");
-            } else {
-                ESP_SERIAL_OUT.print("\n");
-            }
-            ESP_SERIAL_OUT.flush();
-            //if resend use buffer
-            bool success = false;
-            //check NB_RETRY times if get no error when send line
-            for (int r = 0 ; r < NB_RETRY ; r++) {
-                response = "";
-                ESP_SERIAL_OUT.print(buffer_line);
-                ESP_SERIAL_OUT.flush();
-                //wait for answer with time out
-                for (int retry=0; retry < 20; retry++) { //time out
-                    if(ESP_SERIAL_OUT.available()) {
-                        size_t len = ESP_SERIAL_OUT.available();
-                        uint8_t sbuf[len+1];
-                        ESP_SERIAL_OUT.readBytes(sbuf, len);
-                        sbuf[len]='\0';
-                        response = (const char*)sbuf;
-                        if ((response.indexOf("wait")>-1)||(response.indexOf("ok")>-1)) {
-                            success = true;
-                            break;
-                        }
-                        if (response.indexOf("Resend") > -1) { //if error
-                            success = false;
-                            break;
-                        }
-                    }
-                    delay(5);
-                }
-                if (success == true) {
-                    break;
-                }
-            }
-            if (!success) {
-                //raise error
-                LOG("Error detected 2\r\n");
-                LOG(response);
-                com_error = true;
-            }
-            //reset buffer for next command
-            buffer_size = 0;
-            buffer_line[buffer_size] = '\0';
-
-        }
-        LOG("Upload finished ");
-        buffer_size=0;
-        buffer_line[buffer_size] = '\0';
-        //send M29 command to close file on SD
-        ESP_SERIAL_OUT.print("\r\nM29\r\n");
-        ESP_SERIAL_OUT.flush();
-        web_interface->blockserial = false;
-        delay(1000);//give time to FW
-        //resend M29 command to close file on SD as first command may be lost
-        ESP_SERIAL_OUT.print("\r\nM29\r\n");
-        ESP_SERIAL_OUT.flush();
 #ifdef DEBUG_PERFORMANCE
         uint32_t endupload = millis();
         DEBUG_PERF_VARIABLE.add(String(endupload-startupload).c_str());
         DEBUG_PERF_VARIABLE.add(String(write_time).c_str());
         DEBUG_PERF_VARIABLE.add(String(filesize).c_str());
 #endif
-        if (com_error) {
-            web_interface->blockserial = false;
-            LOG("with error\r\n");
-            web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
-            if (!client_closed){
-                //web_interface->web_server.client().stopAll();
-                 LOG("Need to stop");
-                client_closed = true;
-            }   
-            filename = "M30 " + filename;
-            ESP_SERIAL_OUT.println(filename);
-            ESP_SERIAL_OUT.println("M117 SD upload failed");
-            ESP_SERIAL_OUT.flush();
-
-        } else {
-            LOG("with success\r\n");
+        if (web_interface->_upload_status == UPLOAD_STATUS_ONGOING) {
+            //last lines and M29 are sent from loop()
+            sd_upload.end();
             web_interface->_upload_status=UPLOAD_STATUS_SUCCESSFUL;
-            ESP_SERIAL_OUT.println("M117 SD upload done");
-            ESP_SERIAL_OUT.flush();
         }
         //Upload cancelled
         //**************
     } else { //UPLOAD_FILE_ABORTED
         LOG("Error, Something happened\r\n");
-        com_error = true;
         web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
-        buffer_size=0;
-        buffer_line[buffer_size] = '\0';
-        //send M29 command to close file on SD
-        ESP_SERIAL_OUT.print("\r\nM29\r\n");
-        ESP_SERIAL_OUT.flush();
-        web_interface->blockserial = false;
-        delay(1000);
-        //resend M29 command to close file on SD as first command may be lost
-        ESP_SERIAL_OUT.print("\r\nM29\r\n");
-        ESP_SERIAL_OUT.flush();
-        filename = "M30 " + filename;
-        ESP_SERIAL_OUT.println(filename);
-        ESP_SERIAL_OUT.println("M117 SD upload failed");
-        ESP_SERIAL_OUT.flush();
+        //file on printer SD is closed and removed
+        sd_upload.abort();
     }
+    delay(0);
 }
 
-
 //FW update using Web interface
 #ifdef WEB_UPDATE_FEATURE
 void WebUpdateUpload()
@@ -617,7 +455,7 @@ void WebUpdateUpload()
 #else 
 		web_interface->web_server.client().stop();
 #endif
-        ESP_SERIAL_OUT.println("M117 Update failed");
+        serial_out.println("M117 Update failed");
         LOG("SD Update failed\r\n");
         return;
     }
@@ -626,7 +464,7 @@ void WebUpdateUpload()
     //Upload start
     //**************
     if(upload.status == UPLOAD_FILE_START) {
-        ESP_SERIAL_OUT.println(F("M117 Update Firmware"));
+        serial_out.println(F("M117 Update Firmware"));
         web_interface->_upload_status= UPLOAD_STATUS_ONGOING;
 #ifdef ARDUINO_ARCH_ESP8266
 		WiFiUDP::stopAll();
@@ -641,8 +479,8 @@ void WebUpdateUpload()
         if(!Update.begin(maxSketchSpace)) { //start with max available size
             web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
         } else {
-        if (( CONFIG::GetFirmwareTarget() == REPETIER4DV) || (CONFIG::GetFirmwareTarget() == REPETIER)) ESP_SERIAL_OUT.println(F("M117 Update 0%%"));
-        else ESP_SERIAL_OUT.println(F("M117 Update 0%"));
+        if (( CONFIG::GetFirmwareTarget() == REPETIER4DV) || (CONFIG::GetFirmwareTarget() == REPETIER)) serial_out.println(F("M117 Update 0%%"));
+        else serial_out.println(F("M117 Update 0%"));
         }
         //Upload write
         //**************
@@ -652,10 +490,10 @@ void WebUpdateUpload()
             //we do not know the total file size yet but we know the available space so let's use it
             if ( ((100 * upload.totalSize) / maxSketchSpace) !=last_upload_update) {
                 last_upload_update = (100 * upload.totalSize) / maxSketchSpace;
-                ESP_SERIAL_OUT.print(F("M117 Update "));
-                ESP_SERIAL_OUT.print(last_upload_update);
-                if (( CONFIG::GetFirmwareTarget() == REPETIER4DV) || (CONFIG::GetFirmwareTarget() == REPETIER)) ESP_SERIAL_OUT.println(F("%%"));
-                else ESP_SERIAL_OUT.println(F("%"));
+                serial_out.print(F("M117 Update "));
+                serial_out.print(last_upload_update);
+                if (( CONFIG::GetFirmwareTarget() == REPETIER4DV) || (CONFIG::GetFirmwareTarget() == REPETIER)) serial_out.println(F("%%"));
+                else serial_out.println(F("%"));
             }
             if(Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
                 web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
@@ -666,12 +504,12 @@ void WebUpdateUpload()
     } else if(upload.status == UPLOAD_FILE_END) {
         if(Update.end(true)) { //true to set the size to the current progress
             //Now Reboot
-            if (( CONFIG::GetFirmwareTarget() == REPETIER4DV) || (CONFIG::GetFirmwareTarget() == REPETIER)) ESP_SERIAL_OUT.println(F("M117 Update 100%%"));
-            else ESP_SERIAL_OUT.println(F("M117 Update 100%"));
+            if (( CONFIG::GetFirmwareTarget() == REPETIER4DV) || (CONFIG::GetFirmwareTarget() == REPETIER)) serial_out.println(F("M117 Update 100%%"));
+            else serial_out.println(F("M117 Update 100%"));
             web_interface->_upload_status=UPLOAD_STATUS_SUCCESSFUL;
         }
     } else if(upload.status == UPLOAD_FILE_ABORTED) {
-        ESP_SERIAL_OUT.println(F("M117 Update Failed"));
+        serial_out.println(F("M117 Update Failed"));
         Update.end();
         web_interface->_upload_status=UPLOAD_STATUS_CANCELLED;
     }
@@ -686,12 +524,13 @@ void handleUpdate()
         web_interface->web_server.send(403,"text/plain","Not allowed, log in first!\n");
         return;
     }
-    String jsonfile = "{\"status\":\"" ;
-    jsonfile+=CONFIG::intTostr(web_interface->_upload_status);
-    jsonfile+="\"}";
     //send status
-    web_interface->web_server.sendHeader("Cache-Control", "no-cache");
-    web_interface->web_server.send(200, "application/json", jsonfile);
+    response_writer.begin(200, "application/json");
+    JSONWRITER_CLASS json(response_writer);
+    json.begin_object();
+    json.add("status", CONFIG::intTostr(web_interface->_upload_status));
+    json.end_object();
+    response_writer.end();
     //if success restart
     if (web_interface->_upload_status==UPLOAD_STATUS_SUCCESSFUL) {
         web_interface->restartmodule=true;
@@ -740,28 +579,14 @@ void handleFileList()
             shortname.replace("/","");
             filename = path + web_interface->web_server.arg("filename");
             filename.replace("//","/");
-            if(!SPIFFS.exists(filename)) {
+            dir_node * node = dir_index.find(filename);
+            if(!node || node->is_dir) {
                 status = shortname + F(" does not exists!");
             } else {
+                //directory stays, index writes its placeholder once empty
                 if (SPIFFS.remove(filename)) {
+                    dir_index.remove_file(filename);
                     status = shortname + F(" deleted");
-                    //what happen if no "/." and no other subfiles ?
-#ifdef ARDUINO_ARCH_ESP8266
-                    FS_DIR dir = SPIFFS.openDir(path);
-                    if (!dir.next()) {
-#else
-					String ptmp = path;
-					if ((path != "/") && (path[path.length()-1]='/'))ptmp = path.substring(0,path.length()-1);
-					FS_FILE dir = SPIFFS.open(ptmp);
-					FS_FILE dircontent = dir.openNextFile();
-                    if (!dircontent) {
-#endif
-                        //keep directory alive even empty
-                        FS_FILE r = SPIFFS.open(path+"/.", SPIFFS_FILE_WRITE);
-                        if (r) {
-                            r.close();
-                        }
-                    }
                 } else {
                     status = F("Cannot deleted ") ;
                     status+=shortname ;
@@ -777,133 +602,51 @@ void handleFileList()
             filename += "/";
             filename.replace("//","/");
             if (filename != "/") {
-                bool delete_error = false;
-#ifdef ARDUINO_ARCH_ESP8266
-                FS_DIR dir = SPIFFS.openDir(path + shortname);
-                {
-                    while (dir.next()) {
-#else
-				FS_FILE dir = SPIFFS.open(path + shortname);
-                {
-					FS_FILE file2deleted = dir.openNextFile();
-                    while (file2deleted) {
-#endif
-#ifdef ARDUINO_ARCH_ESP8266
-                        String fullpath = dir.fileName();
-#else
-						String fullpath = file2deleted.name();
-#endif
-                        if (!SPIFFS.remove(fullpath)) {
-                            delete_error = true;
-                            status = F("Cannot deleted ") ;
-                            status+=fullpath;
-                        }
-#ifdef ARDUINO_ARCH_ESP32     
-                     file2deleted = dir.openNextFile();
-#endif
-                    }
-                }
-                if (!delete_error) {
+                if (dir_index.remove_dir(filename)) {
                     status = shortname ;
                     status+=" deleted";
+                } else {
+                    status = F("Cannot deleted ") ;
+                    status+=shortname;
                 }
             }
         }
         //create a directory
         if(web_interface->web_server.arg("action")=="createdir" && web_interface->web_server.hasArg("filename")) {
             String filename;
-            filename = path + web_interface->web_server.arg("filename") +"/.";
+            filename = path + web_interface->web_server.arg("filename");
             String shortname = web_interface->web_server.arg("filename");
             shortname.replace("/","");
             filename.replace("//","/");
-            if(SPIFFS.exists(filename)) {
+            //SPIFFS has no directory, so index writes a placeholder file in it
+            if(dir_index.find(filename)) {
                 status = shortname + F(" already exists!");
+            } else if (!dir_index.add_dir(filename)) {
+                status = F("Cannot create ");
+                status += shortname ;
             } else {
-                FS_FILE r = SPIFFS.open(filename,SPIFFS_FILE_WRITE);
-                if (!r) {
-                    status = F("Cannot create ");
-                    status += shortname ;
-                } else {
-                    r.close();
-                    status = shortname + F(" created");
-                }
+                status = shortname + F(" created");
             }
         }
     }
-    String jsonfile = "{";
-#ifdef ARDUINO_ARCH_ESP8266
-    FS_DIR dir = SPIFFS.openDir(path);
-#else
-	String ptmp = path;
-	if ((path != "/") && (path[path.length()-1]='/'))ptmp = path.substring(0,path.length()-1);
-	FS_FILE dir = SPIFFS.open(ptmp);
-#endif
-    jsonfile+="\"files\":[";
-    bool firstentry=true;
-    String subdirlist="";
-#ifdef ARDUINO_ARCH_ESP8266
-    while (dir.next()) {
-        String filename = dir.fileName();
-#else
-	File fileparsed = dir.openNextFile();
-	while (fileparsed) {
-        String filename = fileparsed.name();
-#endif
-        String size ="";
-        bool addtolist=true;
-        //remove path from name
-        filename = filename.substring(path.length(),filename.length());
-        //check if file or subfile
-        if (filename.indexOf("/")>-1) {
-            //Do not rely on "/." to define directory as SPIFFS upload won't create it but directly files
-            //and no need to overload SPIFFS if not necessary to create "/." if no need
-            //it will reduce SPIFFS available space so limit it to creation
-            filename = filename.substring(0,filename.indexOf("/"));
-            String tag="*";
-            tag += filename + "*";
-            if (subdirlist.indexOf(tag)>-1 || filename.length()==0) { //already in list
-                addtolist = false; //no need to add
-            } else {
-                size = -1; //it is subfile so display only directory, size will be -1 to describe it is directory
-                if (subdirlist.length()==0) {
-                    subdirlist+="*";
-                }
-                subdirlist += filename + "*"; //add to list
-            }
-        } else {
-            //do not add "." file
-            if (!((filename==".") || (filename==""))) {
-#ifdef ARDUINO_ARCH_ESP8266
-                size = CONFIG::formatBytes(dir.fileSize());
-#else
-				size = CONFIG::formatBytes(fileparsed.size());
-#endif
-                
-            } else {
-                addtolist = false;
-            }
+    //listing is sent while directory is parsed
+    response_writer.begin(200, "application/json");
+    JSONWRITER_CLASS json(response_writer);
+    json.begin_object();
+    json.begin_array("files");
+    dir_node * dir = dir_index.find(path);
+    if (dir && dir->is_dir) {
+        for (dir_node * entry = dir->child; entry; entry = entry->next) {
+            json.begin_object();
+            json.add("name", entry->name);
+            //size is -1 to describe it is directory
+            json.add("size", entry->is_dir ? String("-1") : CONFIG::formatBytes(entry->size));
+            json.end_object();
         }
-        if(addtolist) {
-            if (!firstentry) {
-                jsonfile+=",";
-            } else {
-                firstentry=false;
-            }
-            jsonfile+="{";
-            jsonfile+="\"name\":\"";
-            jsonfile+=filename;
-            jsonfile+="\",\"size\":\"";
-            jsonfile+=size;
-            jsonfile+="\"";
-            jsonfile+="}";
-        }
-#ifdef ARDUINO_ARCH_ESP32
-        fileparsed = dir.openNextFile();
-#endif
     }
-    jsonfile+="],";
-    jsonfile+="\"path\":\"" + path + "\",";
-    jsonfile+="\"status\":\"" + status + "\",";
+    json.end_array();
+    json.add("path", path);
+    json.add("status", status);
     size_t totalBytes;
     size_t usedBytes;
 #ifdef ARDUINO_ARCH_ESP8266
@@ -915,15 +658,12 @@ void handleFileList()
 	totalBytes = SPIFFS.totalBytes();
     usedBytes = SPIFFS.usedBytes();
 #endif
-    jsonfile+="\"total\":\"" + CONFIG::formatBytes(totalBytes) + "\",";
-    jsonfile+="\"used\":\"" + CONFIG::formatBytes(usedBytes) + "\",";
-    jsonfile.concat(F("\"occupation\":\""));
-    jsonfile+= CONFIG::intTostr(100*usedBytes/totalBytes);
-    jsonfile+="\"";
-    jsonfile+="}";
+    json.add("total", CONFIG::formatBytes(totalBytes));
+    json.add("used", CONFIG::formatBytes(usedBytes));
+    json.add("occupation", CONFIG::intTostr(100*usedBytes/totalBytes));
+    json.end_object();
+    response_writer.end();
     path = "";
-    web_interface->web_server.sendHeader("Cache-Control", "no-cache");
-    web_interface->web_server.send(200, "application/json", jsonfile);
     web_interface->_upload_status=UPLOAD_STATUS_NONE;
 }
 
@@ -937,19 +677,109 @@ void handle_serial_SDFileList()
         web_interface->web_server.send(401, "application/json", "{\"status\":\"Authentication failed!\"}");
         return;
     }
-    LOG("serial SD upload done\r\n")
+    //file is on its way to printer, sd_upload tells by M117 when done
+    LOG("serial SD upload received\r\n")
     String sstatus="Ok";
     if ((web_interface->_upload_status == UPLOAD_STATUS_FAILED) || (web_interface->_upload_status == UPLOAD_STATUS_CANCELLED)) {
         sstatus = "Upload failed";
         web_interface->_upload_status = UPLOAD_STATUS_NONE;
     }
-    String jsonfile = "{\"status\":\"" + sstatus + "\"}";
-    web_interface->web_server.sendHeader("Cache-Control", "no-cache");
-    web_interface->web_server.send(200, "application/json", jsonfile);
-    web_interface->blockserial = false;
+    response_writer.begin(200, "application/json");
+    JSONWRITER_CLASS json(response_writer);
+    json.begin_object();
+    json.add("status", sstatus);
+    json.end_object();
+    response_writer.end();
     web_interface->_upload_status=UPLOAD_STATUS_NONE;
 }
 
+#ifdef CHUNK_UPLOAD_FEATURE
+//file targeted by chunk request, user is isolated to /user on SPIFFS
+static String chunk_upload_path(level_authenticate_type auth_level, tchunk_target target)
+{
+    String path = web_interface->web_server.arg("path");
+    if (!path.startsWith("/")) {
+        path = "/" + path;
+    }
+    if ((target == CHUNK_TARGET_SPIFFS) && (auth_level != LEVEL_ADMIN)) {
+        path = "/user" + path;
+    }
+    return path;
+}
+
+static tchunk_target chunk_upload_target()
+{
+    return (web_interface->web_server.arg("target") == "sd") ? CHUNK_TARGET_SD : CHUNK_TARGET_SPIFFS;
+}
+
+//chunk of /upload_chunk?path=&offset=&total=&crc=, crc is hex CRC32 of chunk
+void chunk_upload_data()
+{
+    level_authenticate_type auth_level = web_interface->is_authenticated();
+    //Guest cannot upload, answer is sent by handle_chunk_upload
+    if (auth_level == LEVEL_GUEST) {
+        return;
+    }
+    HTTPUpload& upload = (web_interface->web_server).upload();
+    if (upload.status == UPLOAD_FILE_START) {
+        if (!web_interface->web_server.hasArg("path") || !web_interface->web_server.hasArg("offset") ||
+                !web_interface->web_server.hasArg("total") || !web_interface->web_server.hasArg("crc")) {
+            chunk_upload.fail(400, "Missing argument");
+            return;
+        }
+        tchunk_target target = chunk_upload_target();
+        uint32_t offset = strtoul(web_interface->web_server.arg("offset").c_str(), NULL, 10);
+        uint32_t total = strtoul(web_interface->web_server.arg("total").c_str(), NULL, 10);
+        uint32_t crc = strtoul(web_interface->web_server.arg("crc").c_str(), NULL, 16);
+        chunk_upload.begin(target, chunk_upload_path(auth_level, target), offset, total, crc);
+    } else if (upload.status == UPLOAD_FILE_WRITE) {
+        chunk_upload.write(upload.buf, upload.currentSize);
+    } else if (upload.status == UPLOAD_FILE_END) {
+        chunk_upload.end();
+    } else {
+        //UPLOAD_FILE_ABORTED, data already committed is kept
+        chunk_upload.abort();
+    }
+    delay(0);
+}
+
+//answer chunk with offset where next one must start,
+//request without chunk only asks this offset to resume upload
+void handle_chunk_upload()
+{
+    level_authenticate_type auth_level = web_interface->is_authenticated();
+    if (auth_level == LEVEL_GUEST) {
+        web_interface->web_server.sendHeader("Cache-Control", "no-cache");
+        web_interface->web_server.send(401, "application/json", "{\"status\":\"Authentication failed!\"}");
+        return;
+    }
+    tchunk_target target = chunk_upload_target();
+    String path = chunk_upload_path(auth_level, target);
+    int code;
+    const char * status;
+    uint32_t offset;
+    if (!chunk_upload.get_result(code, status, offset)) {
+        code = 200;
+        status = "Ok";
+        offset = chunk_upload.committed(target, path);
+        //data kept is of another file than the one client wants to resume
+        if ((offset > 0) && web_interface->web_server.hasArg("total") &&
+                (strtoul(web_interface->web_server.arg("total").c_str(), NULL, 10) != chunk_upload.expected_total(target, path))) {
+            code = 409;
+            status = "Wrong total";
+            offset = 0;
+        }
+    }
+    response_writer.begin(code, "application/json");
+    JSONWRITER_CLASS json(response_writer);
+    json.begin_object();
+    json.add("status", status);
+    json.add("path", path);
+    json.add_uint("offset", offset);
+    json.end_object();
+    response_writer.end();
+}
+#endif
 
 //do a redirect to avoid to many query
 //and handle not registred path
@@ -962,10 +792,8 @@ void handle_not_found()
         //web_interface->web_server.client().stop();
         return;
     }
-    bool page_not_found = false;
     String path = web_interface->web_server.urlDecode(web_interface->web_server.uri());
     String contentType =  web_interface->getContentType(path);
-    String pathWithGz = path + ".gz";
     LOG("request:")
     LOG(path)
     LOG("\r\n")
@@ -982,71 +810,50 @@ void handle_not_found()
     LOG("type:")
     LOG(contentType)
     LOG("\r\n")
-        if(SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) {
-            if(SPIFFS.exists(pathWithGz)) {
-                path = pathWithGz;
-            }
-            FS_FILE file = SPIFFS.open(path, SPIFFS_FILE_READ);
-            web_interface->web_server.streamFile(file, contentType);
-            file.close();
-            return;
-        } else {
-            page_not_found = true;
-        }
-
-    if (page_not_found ) {
+    //file is resolved from index, no SPIFFS lookup
+    if (asset_index.serve(path)) {
+        return;
+    }
 #ifdef CAPTIVE_PORTAL_FEATURE
-        if (WiFi.getMode()!=WIFI_STA ) {
-            String contentType=FPSTR(PAGE_CAPTIVE);
-            String stmp = WiFi.softAPIP().toString();
-            //Web address = ip + port
-            String KEY_IP = F("$WEB_ADDRESS$");
-            String KEY_QUERY = F("$QUERY$");
-            if (wifi_config.iweb_port!=80) {
-                stmp+=":";
-                stmp+=CONFIG::intTostr(wifi_config.iweb_port);
-            }
-            contentType.replace(KEY_IP,stmp);
-             contentType.replace(KEY_IP,stmp);
-            contentType.replace(KEY_QUERY,web_interface->web_server.uri());
-            web_interface->web_server.send(200,"text/html",contentType);
-            //web_interface->web_server.sendContent_P(NOT_AUTH_NF);
-            //web_interface->web_server.client().stop();
-            return;
+    if (WiFi.getMode()!=WIFI_STA ) {
+        String contentType=FPSTR(PAGE_CAPTIVE);
+        String stmp = WiFi.softAPIP().toString();
+        //Web address = ip + port
+        String KEY_IP = F("$WEB_ADDRESS$");
+        String KEY_QUERY = F("$QUERY$");
+        if (wifi_config.iweb_port!=80) {
+            stmp+=":";
+            stmp+=CONFIG::intTostr(wifi_config.iweb_port);
         }
+        contentType.replace(KEY_IP,stmp);
+        contentType.replace(KEY_QUERY,web_interface->web_server.uri());
+        web_interface->web_server.send(200,"text/html",contentType);
+        //web_interface->web_server.sendContent_P(NOT_AUTH_NF);
+        //web_interface->web_server.client().stop();
+        return;
+    }
 #endif
-        LOG("Page not found\r\n")
-        path = F("/404.htm");
-        contentType =  web_interface->getContentType(path);
-        pathWithGz =  path + F(".gz");
-        if(SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) {
-            if(SPIFFS.exists(pathWithGz)) {
-                path = pathWithGz;
-            }
-            FS_FILE file = SPIFFS.open(path, SPIFFS_FILE_READ);
-            web_interface->web_server.streamFile(file, contentType);
-            file.close();
-           
+    LOG("Page not found\r\n")
+    path = F("/404.htm");
+    if (!asset_index.serve(path)) {
+        //if not template use default page
+        contentType=FPSTR(PAGE_404);
+        String stmp;
+        if (WiFi.getMode()==WIFI_STA ) {
+            stmp=WiFi.localIP().toString();
         } else {
-            //if not template use default page
-            contentType=FPSTR(PAGE_404);
-            String stmp;
-            if (WiFi.getMode()==WIFI_STA ) {
-                stmp=WiFi.localIP().toString();
-            } else {
-                stmp=WiFi.softAPIP().toString();
-            }
-            //Web address = ip + port
-            String KEY_IP = F("$WEB_ADDRESS$");
-            String KEY_QUERY = F("$QUERY$");
-            if (wifi_config.iweb_port!=80) {
-                stmp+=":";
-                stmp+=CONFIG::intTostr(wifi_config.iweb_port);
-            }
-            contentType.replace(KEY_IP,stmp);
-            contentType.replace(KEY_QUERY,web_interface->web_server.uri());
-            web_interface->web_server.send(200,"text/html",contentType);
+            stmp=WiFi.softAPIP().toString();
+        }
+        //Web address = ip + port
+        String KEY_IP = F("$WEB_ADDRESS$");
+        String KEY_QUERY = F("$QUERY$");
+        if (wifi_config.iweb_port!=80) {
+            stmp+=":";
+            stmp+=CONFIG::intTostr(wifi_config.iweb_port);
         }
+        contentType.replace(KEY_IP,stmp);
+        contentType.replace(KEY_QUERY,web_interface->web_server.uri());
+        web_interface->web_server.send(200,"text/html",contentType);
     }
 }
 
@@ -1069,9 +876,13 @@ void handle_login()
             }
         web_interface->ClearAuthIP(web_interface->web_server.client().remoteIP(), sessionID.c_str());
         web_interface->web_server.sendHeader("Set-Cookie","ESPSESSIONID=0");
-        web_interface->web_server.sendHeader("Cache-Control","no-cache");
-        String buffer2send = "{\"status\":\"Ok\",\"authentication_lvl\":\"guest\"}";
-        web_interface->web_server.send(code, "application/json", buffer2send);
+        response_writer.begin(code, "application/json");
+        JSONWRITER_CLASS json(response_writer);
+        json.begin_object();
+        json.add("status", "Ok");
+        json.add("authentication_lvl", "guest");
+        json.end_object();
+        response_writer.end();
         //web_interface->web_server.client().stop();
         return;
     }
@@ -1149,15 +960,10 @@ void handle_login()
         }
         //create Session
         if ((current_auth_level != auth_level) || (auth_level== LEVEL_GUEST)) {
-            auth_ip * current_auth = new auth_ip;
-            current_auth->level = current_auth_level;
-            current_auth->ip=web_interface->web_server.client().remoteIP();
-            strcpy(current_auth->sessionID,web_interface->create_session_ID());
-            strcpy(current_auth->userID,sUser.c_str());
-            current_auth->last_time=millis();
-            if (web_interface->AddAuthIP(current_auth)) {
+            auth_ip * current_auth = web_interface->AddAuthIP(web_interface->web_server.client().remoteIP(), current_auth_level, sUser.c_str());
+            if (current_auth) {
                 String tmps ="ESPSESSIONID="; 
-                tmps+=current_auth->sessionID;
+                tmps+=web_interface->GetSessionID(current_auth);
                 web_interface->web_server.sendHeader("Set-Cookie",tmps);
                 web_interface->web_server.sendHeader("Cache-Control","no-cache");
                 switch(current_auth->level) {
@@ -1171,7 +977,6 @@ void handle_login()
                         auths = "guest";
                     }
             } else {
-                delete current_auth;
                 msg_alert_error=true;
                 code = 500;
                 smsg = F("Error: Too many connections");
@@ -1181,10 +986,13 @@ void handle_login()
     if (code == 200) smsg = F("Ok");
     
     //build  JSON
-    String buffer2send = "{\"status\":\"" + smsg + "\",\"authentication_lvl\":\"";
-    buffer2send += auths;
-    buffer2send += "\"}";
-    web_interface->web_server.send(code, "application/json", buffer2send);
+    response_writer.begin(code, "application/json");
+    JSONWRITER_CLASS json(response_writer);
+    json.begin_object();
+    json.add("status", smsg);
+    json.add("authentication_lvl", auths);
+    json.end_object();
+    response_writer.end();
     } else {
     if (auth_level != LEVEL_GUEST) {
         String cookie = web_interface->web_server.header("Cookie");
@@ -1199,12 +1007,14 @@ void handle_login()
                 }
         }
     }
-    String buffer2send = "{\"status\":\"200\",\"authentication_lvl\":\"";
-    buffer2send += auths;
-    buffer2send += "\",\"user\":\"";
-    buffer2send += sUser;
-    buffer2send +="\"}";
-    web_interface->web_server.send(code, "application/json", buffer2send);
+    response_writer.begin(code, "application/json");
+    JSONWRITER_CLASS json(response_writer);
+    json.begin_object();
+    json.add("status", "200");
+    json.add("authentication_lvl", auths);
+    json.add("user", sUser);
+    json.end_object();
+    response_writer.end();
     }
 }
 #endif
@@ -1218,7 +1028,6 @@ void handle_web_command()
         web_interface->web_server.send(403,"text/plain","Not allowed, log in first!\n");
         return;
     }*/
-    String buffer2send = "";
     LOG(String (web_interface->web_server.args()))
     LOG(" Web command\r\n")
 #ifdef DEBUG_ESP3D
@@ -1231,7 +1040,6 @@ void handle_web_command()
     }
 #endif
     String cmd = "";
-    int count ;
     if (web_interface->web_server.hasArg("plain") || web_interface->web_server.hasArg("commandText")) {
         if (web_interface->web_server.hasArg("plain")) {
             cmd = web_interface->web_server.arg("plain");
@@ -1247,6 +1055,7 @@ void handle_web_command()
         return;
     }
     //if it is for ESP module [ESPXXX]<parameter>
+    //it does not use serial, so it is run at once, even during SD upload
     cmd.trim();
     int ESPpos = cmd.indexOf("[ESP");
     if (ESPpos>-1) {
@@ -1277,135 +1086,23 @@ void handle_web_command()
         web_interface->web_server.send(401,"text/plain","Authentication failed!\n");
         return;
     }
+        //realtime command like M112 is never refused and goes before anything queued
+        if (SERIALOUT_CLASS::is_realtime(cmd.c_str())) {
+            serial_out.command(cmd.c_str());
+            web_interface->web_server.send(200,"text/plain","ok");
+            return;
+        }
         //send command to serial as no need to transfer ESP command
-        //to avoid any pollution if Uploading file to SDCard
-        if ((web_interface->blockserial) == false) {
-            //block every query
-            web_interface->blockserial = true;
-            LOG("Block Serial\r\n")
-            //empty the serial buffer and incoming data
-            LOG("Start PurgeSerial\r\n")
-            if(ESP_SERIAL_OUT.available()) {
-                BRIDGE::processFromSerial2TCP();
-                delay(1);
-            }
-            LOG("End PurgeSerial\r\n")
-            web_interface->web_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
-            web_interface->web_server.sendHeader("Content-Type","text/plain",true);
-            web_interface->web_server.sendHeader("Cache-Control","no-cache");
-            web_interface->web_server.send(200);
-            //send command
-            LOG(String(cmd.length()))
-            LOG("Start PurgeSerial\r\n")
-            if(ESP_SERIAL_OUT.available()) {
-                BRIDGE::processFromSerial2TCP();
-                delay(1);
-            }
-            LOG("End PurgeSerial\r\n")
-            LOG("Send Command\r\n")
-            ESP_SERIAL_OUT.println(cmd);
-            count = 0;
-            String current_buffer;
-            String current_line;
-            //int pos;
-            int temp_counter = 0;
-            String tmp;
-            bool datasent = false;
-            //pickup the list
-            while (count < MAX_TRY) {
-                //give some time between each buffer
-                if (ESP_SERIAL_OUT.available()) {
-                    count = 0;
-                    size_t len = ESP_SERIAL_OUT.available();
-                    uint8_t sbuf[len+1];
-                    //read buffer
-                    ESP_SERIAL_OUT.readBytes(sbuf, len);
-                    //change buffer as string
-                    sbuf[len]='\0';
-                    //add buffer to current one if any
-                    current_buffer += (char * ) sbuf;
-                    while (current_buffer.indexOf("\n") !=-1) {
-                        //remove the possible "\r"
-                        current_buffer.replace("\r","");
-                        //pos = current_buffer.indexOf("\n");
-                        //get line
-                        current_line = current_buffer.substring(0,current_buffer.indexOf("\n"));
-                        //if line is command ack - just exit so save the time out period
-                        if ((current_line == "ok") || (current_line == "wait")) {
-                            count = MAX_TRY;
-                            LOG("Found ok\r\n")
-                            break;
-                        }
-                        //get the line and transmit it
-                        LOG("Check command: ")
-                        LOG(current_line)
-                        LOG("\r\n")
-                        //check command
-                        if ((CONFIG::GetFirmwareTarget() == REPETIER) || (CONFIG::GetFirmwareTarget() == REPETIER4DV)){
-                            //save time no need to continue
-                            if (current_line.indexOf("busy:") > -1) {
-                                temp_counter++;
-                            } else if (COMMAND::check_command(current_line, NO_PIPE, false)) {
-                                    temp_counter ++ ;
-                                }
-                        }else {
-                            if (COMMAND::check_command(current_line, NO_PIPE, false)) {
-                                temp_counter ++ ;
-                            }
-                        }
-                        if (temp_counter > 5) {
-                            break;
-                        }
-                        if ((CONFIG::GetFirmwareTarget()  == REPETIER) || (CONFIG::GetFirmwareTarget() == REPETIER4DV)) {
-                            if (!current_line.startsWith( "ok "))
-                                {
-                                    buffer2send +=current_line;
-                                    buffer2send +="\n";
-                                }
-                        } else {
-                            buffer2send +=current_line;
-                            buffer2send +="\n";
-                        }
-                        if (buffer2send.length() > 1200) {
-                            web_interface->web_server.sendContent(buffer2send);
-                            buffer2send = "";
-                            datasent = true;
-                        }
-                        //current remove line from buffer
-                        tmp = current_buffer.substring(current_buffer.indexOf("\n")+1,current_buffer.length());
-                        current_buffer = tmp;
-                        delay(0);
-                    }
-                    delay (0);
-                } else {
-                    delay(1);
-                }
-                //it is sending too many temp status should be heating so let's exit the loop
-                if (temp_counter > 5) {
-                    count = MAX_TRY;
-                }
-                count++;
-            }
-            //to be sure connection close
-            if (buffer2send.length() > 0) {
-                web_interface->web_server.sendContent(buffer2send);
-                datasent = true;
-            }
-            if (!datasent) {
-                web_interface->web_server.sendContent(" \r\n");
-            }
-            web_interface->web_server.sendContent("");
-            LOG("Start PurgeSerial\r\n")
-            if(ESP_SERIAL_OUT.available()) {
-                BRIDGE::processFromSerial2TCP();
-                delay(1);
-            }
-            LOG("End PurgeSerial\r\n")
-            web_interface->blockserial = false;
-            LOG("Release Serial\r\n")
-        } else {
+        //answer is sent from loop() so other clients are not blocked
+        WiFiClient client = web_interface->web_server.client();
+        if (!WEBCOMMAND::add(client, cmd)) {
             web_interface->web_server.send(200,"text/plain","Serial is busy, retry later!");
+            return;
         }
+#ifdef ARDUINO_ARCH_ESP32
+        //ticket answers and closes connection, server must not wait on it
+        web_interface->web_server.keepClient();
+#endif
     }
 }
 
@@ -1472,11 +1169,10 @@ void handle_web_command_silent()
         }
     } else {
         //send command to serial as no need to transfer ESP command
-        //to avoid any pollution if Uploading file to SDCard
-        if ((web_interface->blockserial) == false) {
-            LOG("Send Command\r\n")
-            //send command
-            ESP_SERIAL_OUT.println(cmd);
+        //realtime command like M112 goes ahead of queued data, others wait
+        //their turn, during SD upload until file is closed
+        LOG("Send Command\r\n")
+        if (serial_out.command(cmd.c_str())) {
             web_interface->web_server.send(200,"text/plain","ok");
         } else {
             web_interface->web_server.send(200,"text/plain","Serial is busy, retry later!");
@@ -1501,6 +1197,9 @@ WEBINTERFACE_CLASS::WEBINTERFACE_CLASS (int port):web_server(port)
     web_server.on("/command_silent",HTTP_ANY, handle_web_command_silent);
     web_server.on("/upload_serial", HTTP_ANY, handle_serial_SDFileList,SDFile_serial_upload);
     web_server.on("/files", HTTP_ANY, handleFileList,SPIFFSFileupload);
+#ifdef CHUNK_UPLOAD_FEATURE
+    web_server.on("/upload_chunk", HTTP_ANY, handle_chunk_upload, chunk_upload_data);
+#endif
 #ifdef WEB_UPDATE_FEATURE
     web_server.on("/updatefw",HTTP_ANY, handleUpdate,WebUpdateUpload);
 #endif
@@ -1509,6 +1208,15 @@ WEBINTERFACE_CLASS::WEBINTERFACE_CLASS (int port):web_server(port)
 #endif
     //TODO: to be reviewed
     web_server.on("/STATUS",HTTP_ANY, handle_web_interface_status);
+#ifdef MONITORING_FEATURE
+    web_server.on("/telemetry",HTTP_ANY, handle_telemetry);
+#endif
+#ifdef WEB_EVENTS_FEATURE
+    web_server.on("/events",HTTP_GET, handle_web_events);
+#endif
+#ifdef WS_TERMINAL_FEATURE
+    web_server.on("/ws",HTTP_GET, handle_web_terminal);
+#endif
 #ifdef SSDP_FEATURE
     web_server.on("/description.xml", HTTP_GET, handle_SSDP);
 #endif
@@ -1519,44 +1227,23 @@ WEBINTERFACE_CLASS::WEBINTERFACE_CLASS (int port):web_server(port)
     web_server.on("/fwlink/",HTTP_ANY, handle_web_interface_root);
 #endif
     web_server.onNotFound( handle_not_found);
-    blockserial = false;
     restartmodule=false;
-    //rolling list of 4entries with a maximum of 50 char for each entry
-#ifdef ERROR_MSG_FEATURE
-    error_msg.setsize(4);
-    error_msg.setlength(50);
-#endif
-#ifdef INFO_MSG_FEATURE
-    info_msg.setsize(4);
-    info_msg.setlength(50);
-#endif
-#ifdef STATUS_MSG_FEATURE
-    status_msg.setsize(4);
-    status_msg.setlength(50);
-#endif
     fsUploadFile=(FS_FILE)0;
-    _head=NULL;
+#ifdef AUTHENTICATION_FEATURE
+    for (uint8_t i = 0; i < AUTH_TABLE_SIZE; i++) {
+        _sessions[i].used = false;
+    }
     _nb_ip=0;
+    _expiry_index=0;
+#endif
     _upload_status=UPLOAD_STATUS_NONE;
 }
 //Destructor
 WEBINTERFACE_CLASS::~WEBINTERFACE_CLASS()
 {
-#ifdef INFO_MSG_FEATURE
-    info_msg.clear();
-#endif
-#ifdef ERROR_MSG_FEATURE
-    error_msg.clear();
-#endif
-#ifdef STATUS_MSG_FEATURE
-    status_msg.clear();
-#endif
-    while (_head) {
-        auth_ip * current = _head;
-        _head=_head->_next;
-        delete current;
-    }
+#ifdef AUTHENTICATION_FEATURE
     _nb_ip=0;
+#endif
 }
 //check authentification
 level_authenticate_type  WEBINTERFACE_CLASS::is_authenticated()
@@ -1580,120 +1267,169 @@ level_authenticate_type  WEBINTERFACE_CLASS::is_authenticated()
 }
 
 #ifdef AUTHENTICATION_FEATURE
-//add the information in the linked list if possible
-bool WEBINTERFACE_CLASS::AddAuthIP(auth_ip * item)
+//128 bits from hardware random generator
+static uint32_t session_random()
 {
-    if (_nb_ip>MAX_AUTH_IP) {
-        return false;
-    }
-    item->_next=_head;
-    _head=item;
-    _nb_ip++;
-    return true;
+#ifdef ARDUINO_ARCH_ESP8266
+    return RANDOM_REG32;
+#else
+    return esp_random();
+#endif
 }
 
-//Session ID based on IP and time using 16 char
-char * WEBINTERFACE_CLASS::create_session_ID()
+//cookie value to token, false if not 32 hex chars
+static bool parse_session_ID(const char * sessionID, uint32_t token[4])
 {
-    static char  sessionID[17];
-//reset SESSIONID
-    for (int i=0; i<17; i++) {
-        sessionID[i]='\0';
-    }
-//get time
-    uint32_t now = millis();
-//get remote IP
-    IPAddress remoteIP=web_server.client().remoteIP();
-//generate SESSIONID
-    if (0>sprintf(sessionID,"%02X%02X%02X%02X%02X%02X%02X%02X",remoteIP[0],remoteIP[1],remoteIP[2],remoteIP[3],(uint8_t) ((now >> 0) & 0xff),(uint8_t) ((now >> 8) & 0xff),(uint8_t) ((now >> 16) & 0xff),(uint8_t) ((now >> 24) & 0xff))) {
-        strcpy(sessionID,"NONE");
+    for (uint8_t w = 0; w < 4; w++) {
+        uint32_t v = 0;
+        for (uint8_t i = 0; i < 8; i++) {
+            char c = *sessionID++;
+            uint8_t d;
+            if ((c >= '0') && (c <= '9')) {
+                d = c - '0';
+            } else if ((c >= 'A') && (c <= 'F')) {
+                d = c - 'A' + 10;
+            } else if ((c >= 'a') && (c <= 'f')) {
+                d = c - 'a' + 10;
+            } else {
+                return false;
+            }
+            v = (v << 4) | d;
+        }
+        token[w] = v;
     }
-    return sessionID;
+    return (*sessionID == '\0');
 }
 
+//create session in pool if possible
+auth_ip * WEBINTERFACE_CLASS::AddAuthIP(IPAddress ip, level_authenticate_type level, const char * userID)
+{
+    if (_nb_ip >= MAX_AUTH_IP) {
+        //try to make room before refusing
+        for (uint8_t i = 0; i < AUTH_TABLE_SIZE; i++) {
+            CheckAuthExpiry();
+        }
+        if (_nb_ip >= MAX_AUTH_IP) {
+            return NULL;
+        }
+    }
+    uint32_t token[4];
+    int index;
+    //a token already used is very unlikely but cheap to avoid
+    do {
+        for (uint8_t w = 0; w < 4; w++) {
+            token[w] = session_random();
+        }
+        index = token[0] & (AUTH_TABLE_SIZE - 1);
+        while (_sessions[index].used && (memcmp(_sessions[index].token, token, sizeof(token)) != 0)) {
+            index = (index + 1) & (AUTH_TABLE_SIZE - 1);
+        }
+    } while (_sessions[index].used);
+    auth_ip & item = _sessions[index];
+    item.used = true;
+    item.ip = ip;
+    item.level = level;
+    strncpy(item.userID, userID, sizeof(item.userID) - 1);
+    item.userID[sizeof(item.userID) - 1] = '\0';
+    memcpy(item.token, token, sizeof(token));
+    item.last_time = millis();
+    _nb_ip++;
+    return &item;
+}
 
+//session ID as sent in cookie
+String WEBINTERFACE_CLASS::GetSessionID(auth_ip * item)
+{
+    char sessionID[SESSION_ID_SIZE + 1];
+    snprintf(sessionID, sizeof(sessionID), "%08X%08X%08X%08X", item->token[0], item->token[1], item->token[2], item->token[3]);
+    return String(sessionID);
+}
 
-bool WEBINTERFACE_CLASS::ClearAuthIP(IPAddress ip, const char * sessionID){
-    auth_ip * current = _head;
-    auth_ip * previous = NULL;
-    bool done = false;
-    while (current) {
-        if ((ip == current->ip) && (strcmp(sessionID,current->sessionID)==0)) {
-            //remove
-            done = true;
-            if (current ==_head) {
-                _head=current->_next;
-                _nb_ip--;
-                delete current;
-                current=_head;
-            } else {
-                previous->_next=current->_next;
-                _nb_ip--;
-                delete current;
-                current=previous->_next;
+//slot of session, or -1 - probing stops at first free slot
+int WEBINTERFACE_CLASS::find_session(IPAddress ip, const char * sessionID)
+{
+    uint32_t token[4];
+    if (!parse_session_ID(sessionID, token)) {
+        return -1;
+    }
+    uint8_t index = token[0] & (AUTH_TABLE_SIZE - 1);
+    for (uint8_t n = 0; (n < AUTH_TABLE_SIZE) && _sessions[index].used; n++) {
+        auth_ip & item = _sessions[index];
+        if ((memcmp(item.token, token, sizeof(token)) == 0) && (ip == item.ip)) {
+            if ((millis() - item.last_time) > AUTH_SESSION_TIMEOUT) {
+                remove_session(index);
+                return -1;
             }
-        } else {
-            previous = current;
-            current=current->_next;
+            return index;
         }
+        index = (index + 1) & (AUTH_TABLE_SIZE - 1);
+    }
+    return -1;
+}
+
+//free slot and move back following entries so probing never meets a hole
+void WEBINTERFACE_CLASS::remove_session(uint8_t index)
+{
+    _sessions[index].used = false;
+    _nb_ip--;
+    uint8_t hole = index;
+    uint8_t next = (index + 1) & (AUTH_TABLE_SIZE - 1);
+    while (_sessions[next].used) {
+        uint8_t home = _sessions[next].token[0] & (AUTH_TABLE_SIZE - 1);
+        //entry can fill the hole if its home is not between hole and its slot
+        if (((next - home) & (AUTH_TABLE_SIZE - 1)) >= ((next - hole) & (AUTH_TABLE_SIZE - 1))) {
+            _sessions[hole] = _sessions[next];
+            _sessions[next].used = false;
+            hole = next;
+        }
+        next = (next + 1) & (AUTH_TABLE_SIZE - 1);
+    }
+}
+
+bool WEBINTERFACE_CLASS::ClearAuthIP(IPAddress ip, const char * sessionID)
+{
+    int index = find_session(ip, sessionID);
+    if (index == -1) {
+        return false;
     }
-    return done;
+    remove_session(index);
+    return true;
 }
 
 //Get info
 auth_ip * WEBINTERFACE_CLASS::GetAuth(IPAddress ip,const char * sessionID)
 {
-    auth_ip * current = _head;
-    auth_ip * previous = NULL;
-    //get time
-    //uint32_t now = millis();
-    while (current) {
-        if (ip==current->ip) {
-            if (strcmp(sessionID,current->sessionID)==0) {
-                //found
-                return current;
-            }
-        }
-        previous = current;
-        current=current->_next;
+    int index = find_session(ip, sessionID);
+    if (index == -1) {
+        return NULL;
     }
-    return NULL;
+    return &_sessions[index];
 }
 
-//Review all IP to reset timers
+//check session and reset its timer
 level_authenticate_type WEBINTERFACE_CLASS::ResetAuthIP(IPAddress ip,const char * sessionID)
 {
-    auth_ip * current = _head;
-    auth_ip * previous = NULL;
-    //get time
-    //uint32_t now = millis();
-    while (current) {
-        if ((millis()-current->last_time)>180000) {
-            //remove
-            if (current==_head) {
-                _head=current->_next;
-                _nb_ip--;
-                delete current;
-                current=_head;
-            } else {
-                previous->_next=current->_next;
-                _nb_ip--;
-                delete current;
-                current=previous->_next;
-            }
-        } else {
-            if (ip==current->ip) {
-                if (strcmp(sessionID,current->sessionID)==0) {
-                    //reset time
-                    current->last_time=millis();
-                    return (level_authenticate_type)current->level;
-                }
-            }
-            previous = current;
-            current=current->_next;
-        }
+    auth_ip * item = GetAuth(ip, sessionID);
+    if (item == NULL) {
+        return LEVEL_GUEST;
+    }
+    item->last_time = millis();
+    return item->level;
+}
+
+//called from loop(), check one slot each time
+void WEBINTERFACE_CLASS::CheckAuthExpiry()
+{
+    if (_nb_ip == 0) {
+        return;
+    }
+    _expiry_index = (_expiry_index + 1) & (AUTH_TABLE_SIZE - 1);
+    auth_ip & item = _sessions[_expiry_index];
+    if (item.used && ((millis() - item.last_time) > AUTH_SESSION_TIMEOUT)) {
+        remove_session(_expiry_index);
+        //an entry may have moved in this slot
+        _expiry_index = (_expiry_index - 1) & (AUTH_TABLE_SIZE - 1);
     }
-    return LEVEL_GUEST;
 }
 #endif
 
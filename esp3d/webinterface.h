@@ -34,18 +34,27 @@
 #endif
 
 
-#include "storestrings.h"
-
 #define MAX_EXTRUDERS 4
 
+#ifdef AUTHENTICATION_FEATURE
+//sessions kept at same time
+#define MAX_AUTH_IP 10
+//open addressing table, power of 2 bigger than MAX_AUTH_IP
+#define AUTH_TABLE_SIZE 16
+//ms without request before session is removed
+#define AUTH_SESSION_TIMEOUT 180000
+//random token of 128 bits, sent as 32 hex chars
+#define SESSION_ID_SIZE 32
+
 struct auth_ip {
     IPAddress ip;
     level_authenticate_type level;
     char userID[17];
-    char sessionID[17];
+    uint32_t token[4];
     uint32_t last_time;
-    auth_ip * _next;
+    bool used;
 };
+#endif
 
 class WEBINTERFACE_CLASS
 {
@@ -58,31 +67,28 @@ public:
 	WebServer web_server;
 #endif
      FS_FILE fsUploadFile;
-#ifdef ERROR_MSG_FEATURE
-    STORESTRINGS_CLASS error_msg;
-#endif
-#ifdef INFO_MSG_FEATURE
-    STORESTRINGS_CLASS info_msg;
-#endif
-#ifdef STATUS_MSG_FEATURE
-    STORESTRINGS_CLASS status_msg;
-#endif
     bool restartmodule;
     String getContentType(String filename);
     level_authenticate_type is_authenticated();
-    bool AddAuthIP(auth_ip * item);
-    bool blockserial;
 #ifdef AUTHENTICATION_FEATURE
+    auth_ip * AddAuthIP(IPAddress ip, level_authenticate_type level, const char * userID);
     level_authenticate_type ResetAuthIP(IPAddress ip,const char * sessionID);
     auth_ip * GetAuth(IPAddress ip,const char * sessionID);
     bool ClearAuthIP(IPAddress ip, const char * sessionID);
-    char * create_session_ID();
+    String GetSessionID(auth_ip * item);
+    void CheckAuthExpiry();
 #endif
     uint8_t _upload_status;
 
 private:
-    auth_ip * _head;
+#ifdef AUTHENTICATION_FEATURE
+    //sessions pool, slot is token[0] modulo table size
+    auth_ip _sessions[AUTH_TABLE_SIZE];
     uint8_t _nb_ip;
+    uint8_t _expiry_index;
+    int find_session(IPAddress ip, const char * sessionID);
+    void remove_session(uint8_t index);
+#endif
 };
 
 extern WEBINTERFACE_CLASS * web_interface;
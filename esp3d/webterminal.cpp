@@ -0,0 +1,178 @@
+/*
+  webterminal.cpp - esp3d websocket serial terminal class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "webterminal.h"
+
+#ifdef WS_TERMINAL_FEATURE
+#include "webinterface.h"
+#include "command.h"
+#include "ringbuffer.h"
+#include "serialout.h"
+
+WebSocket WEBTERMINAL::_sockets[MAX_WS_CLIENTS];
+level_authenticate_type WEBTERMINAL::_auth[MAX_WS_CLIENTS];
+uint32_t WEBTERMINAL::_last_activity[MAX_WS_CLIENTS];
+int8_t WEBTERMINAL::_current = -1;
+String WEBTERMINAL::_answer;
+
+//answer upgrade of current web request and subscribe client to serial output
+bool WEBTERMINAL::add(level_authenticate_type auth_level)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (!_sockets[i].connected()) {
+            break;
+        }
+    }
+    //no free spot
+    if (i == MAX_WS_CLIENTS) {
+        web_interface->web_server.send(503,"text/plain","Too many clients, retry later!");
+        return false;
+    }
+    drop(i);
+    if (!_sockets[i].accept(web_interface->web_server)) {
+        return false;
+    }
+    //client only gets serial data received from now
+    serial_ring.attach(RING_READER_WS + i, true);
+    _auth[i] = auth_level;
+    _last_activity[i] = millis();
+    LOG("Terminal client added\r\n")
+    return true;
+}
+
+void WEBTERMINAL::drop(uint8_t i)
+{
+    serial_ring.detach(RING_READER_WS + i);
+    if (_sockets[i].connected()) {
+        _sockets[i].close();
+    }
+}
+
+//give each client the serial data it can take now, a slow one only loses its data
+bool WEBTERMINAL::dispatch()
+{
+    bool done = false;
+    for (uint8_t i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (!serial_ring.attached(RING_READER_WS + i)) {
+            continue;
+        }
+        if (!_sockets[i].connected()) {
+            drop(i);
+            continue;
+        }
+        const uint8_t * data;
+        size_t len = serial_ring.peek(RING_READER_WS + i, &data);
+        if (len == 0) {
+            continue;
+        }
+        if (len > WS_TERMINAL_FRAME_SIZE) {
+            len = WS_TERMINAL_FRAME_SIZE;
+        }
+        //keep room for frame header
+        size_t room = _sockets[i].room();
+        if (room <= 4) {
+            continue;
+        }
+        if (len > room - 4) {
+            len = room - 4;
+        }
+        if (_sockets[i].send(data, len)) {
+            _last_activity[i] = millis();
+        }
+        serial_ring.consume(RING_READER_WS + i, len);
+        done = true;
+    }
+    return done;
+}
+
+//[ESP] answer goes in one text frame once command is done
+void WEBTERMINAL::print(const char * data)
+{
+    if (_current >= 0) {
+        _answer += data;
+    }
+}
+
+void WEBTERMINAL::execute(uint8_t i, char * line)
+{
+    char * esp = strstr(line, "[ESP");
+    if (esp) {
+        char * cmd_end;
+        int cmd = strtol(esp + 4, &cmd_end, 10);
+        if ((*cmd_end == ']') && (cmd != 0)) {
+            _current = i;
+            _answer = "";
+            COMMAND::execute_command(cmd, String(cmd_end + 1), WS_PIPE, _auth[i]);
+            _current = -1;
+            if (_answer.length() > 0) {
+                _sockets[i].sendText(_answer.c_str());
+            }
+            _answer = "";
+            return;
+        }
+    }
+    //during SD upload line waits until file is closed, unless lane is full
+    if (!serial_out.command(line)) {
+        _sockets[i].sendText("Serial is busy, retry later!\n");
+    }
+}
+
+//called in loop, execute lines browsers typed, keep connections alive
+void WEBTERMINAL::process()
+{
+    for (uint8_t i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (!serial_ring.attached(RING_READER_WS + i)) {
+            continue;
+        }
+        while (_sockets[i].poll()) {
+            _last_activity[i] = millis();
+            if (_sockets[i].opcode() != WS_TEXT) {
+                continue;
+            }
+            //message can have several lines, none is longer than message
+            char line[WEBSOCKET_MAX_MESSAGE + 1];
+            const uint8_t * data = _sockets[i].data();
+            size_t len = _sockets[i].length();
+            size_t pos = 0;
+            for (size_t p = 0; p <= len; p++) {
+                if ((p == len) || (data[p] == '\n') || (data[p] == '\r')) {
+                    line[pos] = 0;
+                    if (pos > 0) {
+                        execute(i, line);
+                    }
+                    pos = 0;
+                } else {
+                    line[pos++] = data[p];
+                }
+            }
+        }
+        if (!_sockets[i].connected()) {
+            drop(i);
+            continue;
+        }
+        if ((millis() - _last_activity[i]) > WS_TERMINAL_PING) {
+            _sockets[i].ping();
+            _last_activity[i] = millis();
+        }
+    }
+}
+
+#endif //WS_TERMINAL_FEATURE
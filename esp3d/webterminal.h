@@ -0,0 +1,58 @@
+/*
+  webterminal.h - esp3d websocket serial terminal class
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WEBTERMINAL_h
+#define WEBTERMINAL_h
+#include <Arduino.h>
+#include "config.h"
+
+#ifdef WS_TERMINAL_FEATURE
+#include <WebSocket.h>
+
+//max printer output sent in one frame
+#define WS_TERMINAL_FRAME_SIZE 512
+//ms without traffic before pinging browser
+#define WS_TERMINAL_PING 30000
+
+//each /ws client gets UART output from its own lossy serial ring reader,
+//like data port clients, as binary frames
+//lines it sends in text frames go to serial scheduler, [ESP] commands are
+//executed and answered in one text frame
+class WEBTERMINAL
+{
+public:
+    static bool add(level_authenticate_type auth_level);
+    static void process();
+    static bool dispatch();
+    static void print(const char * data);
+private:
+    static WebSocket _sockets[MAX_WS_CLIENTS];
+    static level_authenticate_type _auth[MAX_WS_CLIENTS];
+    static uint32_t _last_activity[MAX_WS_CLIENTS];
+    //client whose [ESP] command is running
+    static int8_t _current;
+    static String _answer;
+    static void drop(uint8_t i);
+    static void execute(uint8_t i, char * line);
+};
+
+#endif //WS_TERMINAL_FEATURE
+
+#endif
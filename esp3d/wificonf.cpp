@@ -415,7 +415,7 @@ bool WIFI_CONFIG::Enable_servers()
       //start web interface
     web_interface = new WEBINTERFACE_CLASS(wifi_config.iweb_port);
     //here the list of headers to be recorded
-    const char * headerkeys[] = {"Cookie"} ;
+    const char * headerkeys[] = {"Cookie", "If-None-Match", "Range", "If-Range"} ;
     size_t headerkeyssize = sizeof(headerkeys)/sizeof(char*);
     //ask server to track these headers
     web_interface->web_server.collectHeaders(headerkeys, headerkeyssize );
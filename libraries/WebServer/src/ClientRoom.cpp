@@ -0,0 +1,44 @@
+/*
+  ClientRoom.cpp - bytes a client can take without blocking, so a slow one
+  never stalls loop().
+
+  Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "ClientRoom.h"
+#ifndef ESP8266
+#include <lwip/sockets.h>
+#endif
+
+size_t clientRoom(WiFiClient& client) {
+#ifdef ESP8266
+  return client.availableForWrite();
+#else
+  int fd = client.fd();
+  if (fd < 0) {
+    return 0;
+  }
+  fd_set set;
+  FD_ZERO(&set);
+  FD_SET(fd, &set);
+  struct timeval tv = {0, 0};
+  if (select(fd + 1, NULL, &set, NULL, &tv) <= 0) {
+    return 0;
+  }
+  return TCP_SNDLOWAT;
+#endif
+}
@@ -0,0 +1,34 @@
+/*
+  ClientRoom.h - bytes a client can take without blocking, so a slow one
+  never stalls loop().
+
+  Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef CLIENTROOM_H
+#define CLIENTROOM_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+// ESP8266 gives free room of send buffer; ESP32 client only tells if socket
+// is writable, lwIP then has more than TCP_SNDLOWAT free, so that much is
+// returned, 0 otherwise
+size_t clientRoom(WiFiClient& client);
+
+#endif //CLIENTROOM_H
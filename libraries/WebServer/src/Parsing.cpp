@@ -88,6 +88,8 @@ bool WebServer::_parseRequest(WiFiClient& client) {
   String url = req.substring(addr_start + 1, addr_end);
   String versionEnd = req.substring(addr_end + 8);
   _currentVersion = atoi(versionEnd.c_str());
+  //HTTP/1.1 connections are persistent unless client asks to close
+  _keepAlive = (_currentVersion > 0);
   String searchStr = "";
   int hasSearch = url.indexOf('?');
   if (hasSearch != -1){
@@ -172,6 +174,8 @@ bool WebServer::_parseRequest(WiFiClient& client) {
         contentLength = headerValue.toInt();
       } else if (headerName.equalsIgnoreCase("Host")){
         _hostHeader = headerValue;
+      } else if (headerName.equalsIgnoreCase("Connection")){
+        _parseConnectionHeader(headerValue);
       }
     }
 
@@ -242,6 +246,8 @@ bool WebServer::_parseRequest(WiFiClient& client) {
 
 	  if (headerName.equalsIgnoreCase("Host")){
         _hostHeader = headerValue;
+      } else if (headerName.equalsIgnoreCase("Connection")){
+        _parseConnectionHeader(headerValue);
       }
     }
     _parseArguments(searchStr);
@@ -258,6 +264,15 @@ bool WebServer::_parseRequest(WiFiClient& client) {
   return true;
 }
 
+void WebServer::_parseConnectionHeader(String value) {
+  value.toLowerCase();
+  if (value.indexOf("close") != -1) {
+    _keepAlive = false;
+  } else if (value.indexOf("keep-alive") != -1) {
+    _keepAlive = true;
+  }
+}
+
 bool WebServer::_collectHeader(const char* headerName, const char* headerValue) {
   for (int i = 0; i < _headerKeysCount; i++) {
     if (_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
@@ -343,28 +358,100 @@ void WebServer::_parseArguments(String data) {
 
 }
 
-void WebServer::_uploadWriteByte(uint8_t b){
-  if (_currentUpload.currentSize == HTTP_UPLOAD_BUFLEN){
-    if(_currentHandler && _currentHandler->canUpload(_currentUri))
-      _currentHandler->upload(*this, _currentUri, _currentUpload);
-    _currentUpload.totalSize += _currentUpload.currentSize;
-    _currentUpload.currentSize = 0;
+// Next form byte, -1 once form data are all read
+int WebServer::_formRead(WiFiClient& client){
+  // bytes read ahead while looking for end of file come first
+  if (_formPos < _formLen) return _currentUpload.buf[_formPos++];
+  uint8_t c;
+  return _formReadBlock(client, &c, 1) ? c : -1;
+}
+
+String WebServer::_formReadLine(WiFiClient& client){
+  String line;
+  int c;
+  while ((c = _formRead(client)) >= 0) {
+    if (c == '\n') break;
+    if (c != '\r') line += (char)c;
   }
-  _currentUpload.buf[_currentUpload.currentSize++] = b;
+  return line;
 }
 
-uint8_t WebServer::_uploadReadByte(WiFiClient& client){
-  int res = client.read();
-  if(res == -1){
-    while(!client.available() && client.connected())
-      yield();
-    res = client.read();
+// Reads never go past Content-Length, so a pipelined request on a
+// persistent connection is left for the next _parseRequest
+size_t WebServer::_formReadBlock(WiFiClient& client, uint8_t* dst, size_t len){
+  if (len > _formLeft) len = _formLeft;
+  if (!len) return 0;
+  size_t avail = client.available();
+  int tries = HTTP_MAX_POST_WAIT;
+  while (!avail) {
+    // client stalled in the middle of a file, nothing more is read
+    if (!client.connected() || !tries--) {
+      _formLeft = 0;
+      return 0;
+    }
+    delay(1);
+    avail = client.available();
+  }
+  if (avail > len) avail = len;
+  int res = client.read(dst, avail);
+  if (res <= 0) return 0;
+  _formLeft -= res;
+  return (size_t)res;
+}
+
+// Read file content straight into upload buffer by blocks and look for
+// the "\r\n--boundary" delimiter with Boyer-Moore-Horspool, so handler gets
+// every byte that cannot be part of the delimiter without per byte copy
+bool WebServer::_parseFormFile(WiFiClient& client, const String& boundary){
+  String delimiter = "\r\n--" + boundary;
+  const uint8_t* delim = (const uint8_t*)delimiter.c_str();
+  size_t dlen = delimiter.length();
+  if (dlen > 255 || dlen > HTTP_UPLOAD_BUFLEN / 2) return _parseFormUploadAborted();
+  uint8_t skip[256];
+  memset(skip, dlen, sizeof(skip));
+  for (size_t i = 0; i < dlen - 1; i++) {
+    skip[delim[i]] = dlen - 1 - i;
+  }
+  uint8_t* buf = _currentUpload.buf;
+  // start with what was read ahead
+  size_t fill = _formLen - _formPos;
+  memmove(buf, buf + _formPos, fill);
+  _formPos = _formLen = 0;
+  size_t pos = 0;
+  while (1) {
+    while (pos + dlen <= fill) {
+      uint8_t last = buf[pos + dlen - 1];
+      if (last == delim[dlen - 1] && memcmp(buf + pos, delim, dlen - 1) == 0) {
+        _currentUpload.currentSize = pos;
+        if (pos && _currentHandler && _currentHandler->canUpload(_currentUri))
+          _currentHandler->upload(*this, _currentUri, _currentUpload);
+        _currentUpload.totalSize += pos;
+        _currentUpload.currentSize = 0;
+        // what follows the delimiter is parsed by _formReadLine
+        _formPos = pos + dlen;
+        _formLen = fill;
+        return true;
+      }
+      pos += skip[last];
+    }
+    if (fill == HTTP_UPLOAD_BUFLEN) {
+      // no delimiter can start before pos, only the tail is kept
+      _currentUpload.currentSize = pos;
+      if (_currentHandler && _currentHandler->canUpload(_currentUri))
+        _currentHandler->upload(*this, _currentUri, _currentUpload);
+      _currentUpload.totalSize += pos;
+      _currentUpload.currentSize = 0;
+      fill -= pos;
+      memmove(buf, buf + pos, fill);
+      pos = 0;
+    }
+    size_t n = _formReadBlock(client, buf + fill, HTTP_UPLOAD_BUFLEN - fill);
+    if (!n) return _parseFormUploadAborted();
+    fill += n;
   }
-  return (uint8_t)res;
 }
 
 bool WebServer::_parseForm(WiFiClient& client, String boundary, uint32_t len){
-  (void) len;
 #ifdef DEBUG_ESP_HTTP_SERVER
   DEBUG_OUTPUT.print("Parse Form: Boundary: ");
   DEBUG_OUTPUT.print(boundary);
@@ -373,12 +460,14 @@ bool WebServer::_parseForm(WiFiClient& client, String boundary, uint32_t len){
 #endif
   String line;
   int retry = 0;
+  _formPos = _formLen = 0;
+  // without length, form is read up to its last delimiter
+  _formLeft = len ? len : (size_t)-1;
   do {
-    line = client.readStringUntil('\r');
+    line = _formReadLine(client);
     ++retry;
   } while (line.length() == 0 && retry < 3);
 
-  client.readStringUntil('\n');
   //start reading the form
   if (line == ("--"+boundary)){
     RequestArgument* postArgs = new RequestArgument[32];
@@ -390,8 +479,7 @@ bool WebServer::_parseForm(WiFiClient& client, String boundary, uint32_t len){
       String argFilename;
       bool argIsFile = false;
 
-      line = client.readStringUntil('\r');
-      client.readStringUntil('\n');
+      line = _formReadLine(client);
       if (line.length() > 19 && line.substring(0, 19).equalsIgnoreCase("Content-Disposition")){
         int nameStart = line.indexOf('=');
         if (nameStart != -1){
@@ -415,13 +503,11 @@ bool WebServer::_parseForm(WiFiClient& client, String boundary, uint32_t len){
           DEBUG_OUTPUT.println(argName);
 #endif
           argType = "text/plain";
-          line = client.readStringUntil('\r');
-          client.readStringUntil('\n');
+          line = _formReadLine(client);
           if (line.length() > 12 && line.substring(0, 12).equalsIgnoreCase("Content-Type")){
             argType = line.substring(line.indexOf(':')+2);
             //skip next line
-            client.readStringUntil('\r');
-            client.readStringUntil('\n');
+            _formReadLine(client);
           }
 #ifdef DEBUG_ESP_HTTP_SERVER
           DEBUG_OUTPUT.print("PostArg Type: ");
@@ -429,9 +515,12 @@ bool WebServer::_parseForm(WiFiClient& client, String boundary, uint32_t len){
 #endif
           if (!argIsFile){
             while(1){
-              line = client.readStringUntil('\r');
-              client.readStringUntil('\n');
+              line = _formReadLine(client);
               if (line.startsWith("--"+boundary)) break;
+              if (!_formLeft && _formPos >= _formLen){
+                delete[] postArgs;
+                return false;
+              }
               if (argValue.length() > 0) argValue += "\n";
               argValue += line;
             }
@@ -467,82 +556,36 @@ bool WebServer::_parseForm(WiFiClient& client, String boundary, uint32_t len){
             if(_currentHandler && _currentHandler->canUpload(_currentUri))
               _currentHandler->upload(*this, _currentUri, _currentUpload);
             _currentUpload.status = UPLOAD_FILE_WRITE;
-            uint8_t argByte = _uploadReadByte(client);
-readfile:
-            while(argByte != 0x0D){
-              if (!client.connected()) return _parseFormUploadAborted();
-              _uploadWriteByte(argByte);
-              argByte = _uploadReadByte(client);
+            if (!_parseFormFile(client, boundary)) {
+              delete[] postArgs;
+              return false;
             }
-
-            argByte = _uploadReadByte(client);
-            if (!client.connected()) return _parseFormUploadAborted();
-            if (argByte == 0x0A){
-              argByte = _uploadReadByte(client);
-              if (!client.connected()) return _parseFormUploadAborted();
-              if ((char)argByte != '-'){
-                //continue reading the file
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                goto readfile;
-              } else {
-                argByte = _uploadReadByte(client);
-                if (!client.connected()) return _parseFormUploadAborted();
-                if ((char)argByte != '-'){
-                  //continue reading the file
-                  _uploadWriteByte(0x0D);
-                  _uploadWriteByte(0x0A);
-                  _uploadWriteByte((uint8_t)('-'));
-                  goto readfile;
-                }
-              }
-
-              uint8_t endBuf[boundary.length()];
-              client.readBytes(endBuf, boundary.length());
-
-              if (strstr((const char*)endBuf, boundary.c_str()) != NULL){
-                if(_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, _currentUpload);
-                _currentUpload.totalSize += _currentUpload.currentSize;
-                _currentUpload.status = UPLOAD_FILE_END;
-                if(_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, _currentUpload);
+            _currentUpload.status = UPLOAD_FILE_END;
+            if(_currentHandler && _currentHandler->canUpload(_currentUri))
+              _currentHandler->upload(*this, _currentUri, _currentUpload);
 #ifdef DEBUG_ESP_HTTP_SERVER
-                DEBUG_OUTPUT.print("End File: ");
-                DEBUG_OUTPUT.print(_currentUpload.filename);
-                DEBUG_OUTPUT.print(" Type: ");
-                DEBUG_OUTPUT.print(_currentUpload.type);
-                DEBUG_OUTPUT.print(" Size: ");
-                DEBUG_OUTPUT.println(_currentUpload.totalSize);
+            DEBUG_OUTPUT.print("End File: ");
+            DEBUG_OUTPUT.print(_currentUpload.filename);
+            DEBUG_OUTPUT.print(" Type: ");
+            DEBUG_OUTPUT.print(_currentUpload.type);
+            DEBUG_OUTPUT.print(" Size: ");
+            DEBUG_OUTPUT.println(_currentUpload.totalSize);
 #endif
-                line = client.readStringUntil(0x0D);
-                client.readStringUntil(0x0A);
-                if (line == "--"){
+            line = _formReadLine(client);
+            if (line == "--"){
 #ifdef DEBUG_ESP_HTTP_SERVER
-                  DEBUG_OUTPUT.println("Done Parsing POST");
+              DEBUG_OUTPUT.println("Done Parsing POST");
 #endif
-                  break;
-                }
-                continue;
-              } else {
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                _uploadWriteByte((uint8_t)('-'));
-                _uploadWriteByte((uint8_t)('-'));
-                uint32_t i = 0;
-                while(i < boundary.length()){
-                  _uploadWriteByte(endBuf[i++]);
-                }
-                argByte = _uploadReadByte(client);
-                goto readfile;
-              }
-            } else {
-              _uploadWriteByte(0x0D);
-              goto readfile;
+              break;
             }
-            break;
+            continue;
           }
         }
+      } else {
+        // each part starts with its Content-Disposition, anything else is
+        // a broken form or a lost connection and would be read forever
+        delete[] postArgs;
+        return false;
       }
     }
 
@@ -1,6 +1,6 @@
 /*
   WebServer.cpp - Dead simple web-server.
-  Supports only one simultaneous client, knows how to handle GET and POST.
+  Serves several clients with persistent connections, knows how to handle GET and POST.
 
   Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -26,6 +26,7 @@
 #include "WiFiServer.h"
 #include "WiFiClient.h"
 #include "WebServer.h"
+#include "HttpRange.h"
 #include "FS.h"
 #include "detail/RequestHandlersImpl.h"
 
@@ -37,40 +38,55 @@
 #endif
 
 const char * AUTHORIZATION_HEADER = "Authorization";
+// always collected, needed to accept a WebSocket and to answer a byte range
+static const char * SERVER_HEADERS[] = {"Upgrade", "Sec-WebSocket-Key", "Sec-WebSocket-Version", "Range"};
+#define SERVER_HEADERS_COUNT 4
 
 WebServer::WebServer(IPAddress addr, int port)
 : _server(addr, port)
+, _nextConnection(0)
 , _currentMethod(HTTP_ANY)
 , _currentVersion(0)
-, _currentStatus(HC_NONE)
-, _statusChange(0)
+, _keepAlive(false)
+, _responseKeepAlive(false)
+, _chunkEnded(false)
 , _currentHandler(0)
 , _firstHandler(0)
 , _lastHandler(0)
 , _currentArgCount(0)
 , _currentArgs(0)
+, _formPos(0)
+, _formLen(0)
+, _formLeft(0)
 , _headerKeysCount(0)
 , _currentHeaders(0)
 , _contentLength(0)
 , _chunked(false)
+, _clientKept(false)
 {
 }
 
 WebServer::WebServer(int port)
 : _server(port)
+, _nextConnection(0)
 , _currentMethod(HTTP_ANY)
 , _currentVersion(0)
-, _currentStatus(HC_NONE)
-, _statusChange(0)
+, _keepAlive(false)
+, _responseKeepAlive(false)
+, _chunkEnded(false)
 , _currentHandler(0)
 , _firstHandler(0)
 , _lastHandler(0)
 , _currentArgCount(0)
 , _currentArgs(0)
+, _formPos(0)
+, _formLen(0)
+, _formLeft(0)
 , _headerKeysCount(0)
 , _currentHeaders(0)
 , _contentLength(0)
 , _chunked(false)
+, _clientKept(false)
 {
 }
 
@@ -88,7 +104,9 @@ WebServer::~WebServer() {
 }
 
 void WebServer::begin() {
-  _currentStatus = HC_NONE;
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    _dropConnection(_connections[i]);
+  }
   _server.begin();
   if(!_headerKeysCount)
     collectHeaders(0, 0);
@@ -164,70 +182,132 @@ void WebServer::serveStatic(const char* uri, FS& fs, const char* path, const cha
 }
 
 void WebServer::handleClient() {
-  if (_currentStatus == HC_NONE) {
+  // Accept new connections, at most one per slot on each call
+  for (int n = 0; n < HTTP_MAX_CLIENTS; n++) {
     WiFiClient client = _server.available();
     if (!client) {
-      return;
+      break;
     }
-
 #ifdef DEBUG_ESP_HTTP_SERVER
     DEBUG_OUTPUT.println("New client");
 #endif
-
-    _currentClient = client;
-    _currentStatus = HC_WAIT_READ;
-    _statusChange = millis();
-  }
-
-  if (!_currentClient.connected()) {
-    _currentClient = WiFiClient();
-    _currentStatus = HC_NONE;
-    return;
+    _acceptConnection(client);
   }
 
-  // Wait for data from client to become available
-  if (_currentStatus == HC_WAIT_READ) {
-    if (!_currentClient.available()) {
-      if (millis() - _statusChange > HTTP_MAX_DATA_WAIT) {
-        _currentClient = WiFiClient();
-        _currentStatus = HC_NONE;
-      }
-      yield();
-      return;
+  // Serve one request per call, starting from a different connection each
+  // time so that a busy client cannot starve the others
+  bool served = false;
+  for (int n = 0; n < HTTP_MAX_CLIENTS; n++) {
+    HTTPConnection& connection = _connections[(_nextConnection + n) % HTTP_MAX_CLIENTS];
+    if (connection.status == HC_NONE) {
+      continue;
     }
-
-    if (!_parseRequest(_currentClient)) {
-      _currentClient = WiFiClient();
-      _currentStatus = HC_NONE;
-      return;
+    if (!connection.client.connected()) {
+      _dropConnection(connection);
+      continue;
     }
-    _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
-    _contentLength = CONTENT_LENGTH_NOT_SET;
-    _handleRequest();
-
-    if (!_currentClient.connected()) {
-      _currentClient = WiFiClient();
-      _currentStatus = HC_NONE;
-      return;
-    } else {
-      _currentStatus = HC_WAIT_CLOSE;
-      _statusChange = millis();
-      return;
+    if (connection.status == HC_WAIT_READ) {
+      if (!connection.client.available()) {
+        // Idle persistent connections are kept longer than new ones
+        unsigned long wait = connection.requests ? HTTP_MAX_KEEPALIVE_WAIT : HTTP_MAX_DATA_WAIT;
+        if (millis() - connection.statusChange > wait) {
+          _dropConnection(connection);
+        }
+        continue;
+      }
+      if (!served) {
+        served = true;
+        _serveConnection(connection);
+      }
+    } else if (connection.status == HC_WAIT_CLOSE) {
+      if (millis() - connection.statusChange > HTTP_MAX_CLOSE_WAIT) {
+        _dropConnection(connection);
+      }
     }
   }
+  _nextConnection = (_nextConnection + 1) % HTTP_MAX_CLIENTS;
+  if (!served) {
+    yield();
+  }
+}
 
-  if (_currentStatus == HC_WAIT_CLOSE) {
-    if (millis() - _statusChange > HTTP_MAX_CLOSE_WAIT) {
-      _currentClient = WiFiClient();
-      _currentStatus = HC_NONE;
+void WebServer::_acceptConnection(WiFiClient& client) {
+  // Use a free slot, or else the oldest connection not waiting for an answer:
+  // one already answered, then an idle persistent one, then any
+  int slot = -1;
+  int rank = 0;
+  unsigned long age = 0;
+  unsigned long now = millis();
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    HTTPConnection& connection = _connections[i];
+    int r;
+    if (connection.status == HC_NONE) {
+      r = 4;
+    } else if (connection.status == HC_WAIT_CLOSE) {
+      r = 3;
+    } else if (connection.requests > 0) {
+      r = 2;
     } else {
-      yield();
-      return;
+      r = 1;
     }
+    if ((r > rank) || ((r == rank) && (now - connection.statusChange > age))) {
+      slot = i;
+      rank = r;
+      age = now - connection.statusChange;
+    }
+  }
+  HTTPConnection& connection = _connections[slot];
+  _dropConnection(connection);
+  connection.client = client;
+  connection.status = HC_WAIT_READ;
+  connection.statusChange = millis();
+}
+
+void WebServer::_serveConnection(HTTPConnection& connection) {
+  _currentClient = connection.client;
+  if (!_parseRequest(_currentClient)) {
+    _dropConnection(connection);
+    _currentClient = WiFiClient();
+    return;
+  }
+  connection.requests++;
+  // Last request allowed on this connection is answered with Connection: close
+  if (connection.requests >= HTTP_MAX_KEEPALIVE_REQUESTS) {
+    _keepAlive = false;
+  }
+  _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+  _contentLength = CONTENT_LENGTH_NOT_SET;
+  _responseKeepAlive = false;
+  _chunkEnded = false;
+  _clientKept = false;
+  _handleRequest();
+
+  if (!_currentClient.connected() || _clientKept) {
+    // connection closed, or no more HTTP so slot is freed without closing it
+    _dropConnection(connection);
+  } else if (_responseKeepAlive && (!_chunked || _chunkEnded)) {
+    // Response was complete, wait for next request on same connection
+    connection.status = HC_WAIT_READ;
+    connection.statusChange = millis();
+  } else {
+    // Response has no length or handler kept the client, let it close
+    connection.status = HC_WAIT_CLOSE;
+    connection.statusChange = millis();
   }
+  _currentClient = WiFiClient();
+}
+
+void WebServer::_dropConnection(HTTPConnection& connection) {
+  connection.client = WiFiClient();
+  connection.status = HC_NONE;
+  connection.statusChange = 0;
+  connection.requests = 0;
 }
 
 void WebServer::close() {
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    _dropConnection(_connections[i]);
+  }
 #ifdef ESP8266
   _server.stop();
 #else
@@ -254,6 +334,15 @@ void WebServer::sendHeader(const String& name, const String& value, bool first)
   }
 }
 
+// Content-Range is added here, 416 one is left to caller
+int WebServer::_rangeRequest(size_t size, size_t& start, size_t& length) {
+  int code = parse_range(header("Range"), size, start, length);
+  if (code == 206) {
+    sendHeader("Content-Range", "bytes " + String(start) + "-" + String(start + length - 1) + "/" + String(size));
+  }
+  return code;
+}
+
 void WebServer::setContentLength(size_t contentLength) {
     _contentLength = contentLength;
 }
@@ -269,6 +358,8 @@ void WebServer::_prepareHeader(String& response, int code, const char* content_t
         content_type = "text/html";
 
     sendHeader("Content-Type", content_type, true);
+    //connection can only be kept if client knows where response ends
+    bool framed = true;
     if (_contentLength == CONTENT_LENGTH_NOT_SET) {
         sendHeader("Content-Length", String(contentLength));
     } else if (_contentLength != CONTENT_LENGTH_UNKNOWN) {
@@ -278,8 +369,11 @@ void WebServer::_prepareHeader(String& response, int code, const char* content_t
       _chunked = true;
       sendHeader("Accept-Ranges","none");
       sendHeader("Transfer-Encoding","chunked");
+    } else {
+      framed = false;
     }
-    sendHeader("Connection", "close");
+    _responseKeepAlive = _keepAlive && framed;
+    sendHeader("Connection", _responseKeepAlive ? "keep-alive" : "close");
 
     response += _responseHeaders;
     response += "\r\n";
@@ -330,20 +424,45 @@ void WebServer::send(int code, const String& content_type, const String& content
 }
 
 void WebServer::sendContent(const String& content) {
-  const char * footer = "\r\n";
-  size_t len = content.length();
-  if(_chunked) {
-    char * chunkSize = (char *)malloc(11);
-    if(chunkSize){
-      sprintf(chunkSize, "%x%s", len, footer);
-      _currentClient.write(chunkSize, strlen(chunkSize));
-      free(chunkSize);
+  sendContent(content.c_str(), content.length());
+}
+
+// chunk size line is built on stack, a small chunk goes in one write
+void WebServer::_sendChunk(const char* content, size_t size, bool progmem) {
+  if(_chunked && (size == 0)) {
+    _chunkEnded = true;
+  }
+  if(!_chunked) {
+    if (progmem) {
+      _currentClient.write_P(content, size);
+    } else {
+      _currentClient.write(content, size);
     }
+    return;
+  }
+  char chunk[HTTP_SMALL_CHUNK_SIZE + 12];
+  size_t headerLen = sprintf(chunk, "%x\r\n", (unsigned int)size);
+  if (size <= HTTP_SMALL_CHUNK_SIZE) {
+    if (progmem) {
+      memcpy_P(chunk + headerLen, content, size);
+    } else {
+      memcpy(chunk + headerLen, content, size);
+    }
+    memcpy(chunk + headerLen + size, "\r\n", 2);
+    _currentClient.write(chunk, headerLen + size + 2);
+    return;
   }
-  _currentClient.write(content.c_str(), len);
-  if(_chunked){
-    _currentClient.write(footer, 2);
+  _currentClient.write(chunk, headerLen);
+  if (progmem) {
+    _currentClient.write_P(content, size);
+  } else {
+    _currentClient.write(content, size);
   }
+  _currentClient.write("\r\n", 2);
+}
+
+void WebServer::sendContent(const char* content, size_t size) {
+  _sendChunk(content, size, false);
 }
 
 void WebServer::sendContent_P(PGM_P content) {
@@ -351,19 +470,7 @@ void WebServer::sendContent_P(PGM_P content) {
 }
 
 void WebServer::sendContent_P(PGM_P content, size_t size) {
-  const char * footer = "\r\n";
-  if(_chunked) {
-    char * chunkSize = (char *)malloc(11);
-    if(chunkSize){
-      sprintf(chunkSize, "%x%s", size, footer);
-      _currentClient.write(chunkSize, strlen(chunkSize));
-      free(chunkSize);
-    }
-  }
-  _currentClient.write_P(content, size);
-  if(_chunked){
-    _currentClient.write(footer, 2);
-  }
+  _sendChunk(content, size, true);
 }
 
 
@@ -409,13 +516,16 @@ String WebServer::header(String name) {
 }
 
 void WebServer::collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {
-  _headerKeysCount = headerKeysCount + 1;
+  _headerKeysCount = headerKeysCount + 1 + SERVER_HEADERS_COUNT;
   if (_currentHeaders)
      delete[]_currentHeaders;
   _currentHeaders = new RequestArgument[_headerKeysCount];
   _currentHeaders[0].key = AUTHORIZATION_HEADER;
-  for (int i = 1; i < _headerKeysCount; i++){
-    _currentHeaders[i].key = headerKeys[i-1];
+  for (int i = 0; i < SERVER_HEADERS_COUNT; i++){
+    _currentHeaders[i + 1].key = SERVER_HEADERS[i];
+  }
+  for (int i = 1 + SERVER_HEADERS_COUNT; i < _headerKeysCount; i++){
+    _currentHeaders[i].key = headerKeys[i - 1 - SERVER_HEADERS_COUNT];
   }
 }
 
@@ -519,6 +629,7 @@ String WebServer::_responseCodeToString(int code) {
     case 415: return F("Unsupported Media Type");
     case 416: return F("Requested range not satisfiable");
     case 417: return F("Expectation Failed");
+    case 426: return F("Upgrade Required");
     case 500: return F("Internal Server Error");
     case 501: return F("Not Implemented");
     case 502: return F("Bad Gateway");
@@ -1,6 +1,6 @@
 /*
   WebServer.h - Dead simple web-server.
-  Supports only one simultaneous client, knows how to handle GET and POST.
+  Serves several clients with persistent connections, knows how to handle GET and POST.
 
   Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -39,6 +39,7 @@ enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END,
 enum HTTPClientStatus { HC_NONE, HC_WAIT_READ, HC_WAIT_CLOSE };
 
 #define HTTP_DOWNLOAD_UNIT_SIZE 1460
+#define HTTP_SMALL_CHUNK_SIZE 128 //chunks up to this size are sent in one write
 
 #ifndef HTTP_UPLOAD_BUFLEN
 #define HTTP_UPLOAD_BUFLEN 2048
@@ -48,6 +49,12 @@ enum HTTPClientStatus { HC_NONE, HC_WAIT_READ, HC_WAIT_CLOSE };
 #define HTTP_MAX_POST_WAIT 1000 //ms to wait for POST data to arrive
 #define HTTP_MAX_SEND_WAIT 5000 //ms to wait for data chunk to be ACKed
 #define HTTP_MAX_CLOSE_WAIT 2000 //ms to wait for the client to close the connection
+#define HTTP_MAX_KEEPALIVE_WAIT 5000 //ms to wait for next request on a persistent connection
+#define HTTP_MAX_KEEPALIVE_REQUESTS 100 //requests served before closing a persistent connection
+
+#ifndef HTTP_MAX_CLIENTS
+#define HTTP_MAX_CLIENTS 4 //connections served at the same time
+#endif
 
 #define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
 #define CONTENT_LENGTH_NOT_SET ((size_t) -2)
@@ -72,6 +79,7 @@ class FS;
 
 class WebServer
 {
+  friend class WebSocket;
 public:
   WebServer(IPAddress addr, int port = 80);
   WebServer(int port = 80);
@@ -98,6 +106,9 @@ public:
   String uri() { return _currentUri; }
   HTTPMethod method() { return _currentMethod; }
   WiFiClient client() { return _currentClient; }
+  // handler keeps connection for itself, like an event stream, so server
+  // frees its slot without waiting for the connection to close
+  void keepClient() { _clientKept = true; }
   HTTPUpload& upload() { return _currentUpload; }
 
   String arg(String name);        // get request argument value by name
@@ -127,41 +138,48 @@ public:
   void setContentLength(size_t contentLength);
   void sendHeader(const String& name, const String& value, bool first = false);
   void sendContent(const String& content);
+  void sendContent(const char* content, size_t size);
   void sendContent_P(PGM_P content);
   void sendContent_P(PGM_P content, size_t size);
 
   static String urlDecode(const String& text);
 
-#ifdef ESP8266
-template<typename T> size_t streamFile(T &file, const String& contentType){
-  setContentLength(file.size());
-  if (String(file.name()).endsWith(".gz") &&
-      contentType != "application/x-gzip" &&
-      contentType != "application/octet-stream"){
-    sendHeader("Content-Encoding", "gzip");
-  }
-  send(200, contentType, "");
-  return _currentClient.write(file);
-}
-#else
+// a single byte range asked by client is answered with 206, out of file one with 416
 template<typename T> size_t streamFile(T &file, const String& contentType){
 #define STREAMFILE_BUFSIZE 2*1460
-  setContentLength(file.size());
+  size_t start;
+  size_t length;
+  int code = _rangeRequest(file.size(), start, length);
+  if (code == 416) {
+    sendHeader("Content-Range", "bytes */" + String(file.size()));
+    send(416, "text/plain", "");
+    return 0;
+  }
+  if ((start > 0) && !file.seek(start)) {
+    send(500, "text/plain", "");
+    return 0;
+  }
+  setContentLength(length);
+  sendHeader("Accept-Ranges", "bytes");
   if (String(file.name()).endsWith(".gz") &&
       contentType != "application/x-gzip" &&
       contentType != "application/octet-stream") {
     sendHeader("Content-Encoding", "gzip");
   }
-  send(200, contentType, "");
+  send(code, contentType, "");
   uint8_t *buf = (uint8_t *)malloc(STREAMFILE_BUFSIZE);
   if (buf == NULL) {
     //DBG_OUTPUT_PORT.printf("streamFile malloc failed");
     return 0;
   }
   size_t totalBytesOut = 0;
-  while (client().connected() && (file.available() > 0)) {
+  while (client().connected() && (totalBytesOut < length)) {
     int bytesOut;
-    int bytesIn = file.read(buf, STREAMFILE_BUFSIZE);
+    size_t bytesWanted = length - totalBytesOut;
+    if (bytesWanted > STREAMFILE_BUFSIZE) {
+      bytesWanted = STREAMFILE_BUFSIZE;
+    }
+    int bytesIn = file.read(buf, bytesWanted);
     if (bytesIn <= 0) break;
     while (1) {
       bytesOut = 0;
@@ -176,41 +194,57 @@ template<typename T> size_t streamFile(T &file, const String& contentType){
     totalBytesOut += bytesOut;
     yield();
   }
-  if (totalBytesOut != file.size()) {
-    //DBG_OUTPUT_PORT.printf("file size %d bytes out %d\r\n",
-    //    file.size(), totalBytesOut);
-  }
   free(buf);
   return totalBytesOut;
 }
-#endif
 
 protected:
   void _addRequestHandler(RequestHandler* handler);
   void _handleRequest();
+  void _sendChunk(const char* content, size_t size, bool progmem);
+  int _rangeRequest(size_t size, size_t& start, size_t& length);
   bool _parseRequest(WiFiClient& client);
   void _parseArguments(String data);
   static String _responseCodeToString(int code);
   bool _parseForm(WiFiClient& client, String boundary, uint32_t len);
   bool _parseFormUploadAborted();
-  void _uploadWriteByte(uint8_t b);
-  uint8_t _uploadReadByte(WiFiClient& client);
+  int _formRead(WiFiClient& client);
+  String _formReadLine(WiFiClient& client);
+  size_t _formReadBlock(WiFiClient& client, uint8_t* dst, size_t len);
+  bool _parseFormFile(WiFiClient& client, const String& boundary);
   void _prepareHeader(String& response, int code, const char* content_type, size_t contentLength);
   bool _collectHeader(const char* headerName, const char* headerValue);
+  void _parseConnectionHeader(String value);
 
   struct RequestArgument {
     String key;
     String value;
   };
 
+  struct HTTPConnection {
+    HTTPConnection() : status(HC_NONE), statusChange(0), requests(0) {}
+    WiFiClient client;
+    HTTPClientStatus status;
+    unsigned long statusChange;
+    uint16_t requests;
+  };
+
+  void _acceptConnection(WiFiClient& client);
+  void _serveConnection(HTTPConnection& connection);
+  void _dropConnection(HTTPConnection& connection);
+
   WiFiServer  _server;
 
+  HTTPConnection _connections[HTTP_MAX_CLIENTS];
+  uint8_t     _nextConnection;
+
   WiFiClient  _currentClient;
   HTTPMethod  _currentMethod;
   String      _currentUri;
   uint8_t     _currentVersion;
-  HTTPClientStatus _currentStatus;
-  unsigned long _statusChange;
+  bool        _keepAlive;
+  bool        _responseKeepAlive;
+  bool        _chunkEnded;
 
   RequestHandler*  _currentHandler;
   RequestHandler*  _firstHandler;
@@ -221,6 +255,9 @@ protected:
   int              _currentArgCount;
   RequestArgument* _currentArgs;
   HTTPUpload       _currentUpload;
+  size_t           _formPos;   // form data already read from client
+  size_t           _formLen;   // but not parsed yet, kept in _currentUpload.buf
+  size_t           _formLeft;  // form data not read yet, next request follows
 
   int              _headerKeysCount;
   RequestArgument* _currentHeaders;
@@ -229,6 +266,7 @@ protected:
 
   String           _hostHeader;
   bool             _chunked;
+  bool             _clientKept; // handler took connection, like a WebSocket
 
 };
 
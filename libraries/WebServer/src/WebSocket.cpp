@@ -0,0 +1,372 @@
+/*
+  WebSocket.cpp - WebSocket (RFC 6455) server side connection for WebServer.
+  A request handler accepts the upgrade, then the connection is polled from loop().
+
+  Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <Arduino.h>
+#include <libb64/cencode.h>
+#include "WiFiClient.h"
+#include "WebServer.h"
+#include "WebSocket.h"
+#include "ClientRoom.h"
+
+static const char WS_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// SHA-1 is only needed for the handshake, so keep a small one here
+static uint32_t _rol(uint32_t value, uint8_t bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+static void _sha1Block(uint32_t state[5], const uint8_t block[64]) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+           ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+  }
+  for (int i = 16; i < 80; i++) {
+    w[i] = _rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    uint32_t t = _rol(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = _rol(b, 30);
+    b = a;
+    a = t;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+
+static void _sha1(const uint8_t* data, size_t len, uint8_t digest[20]) {
+  uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  uint8_t block[64];
+  size_t pos = 0;
+  while (len - pos >= 64) {
+    _sha1Block(state, data + pos);
+    pos += 64;
+  }
+  size_t rest = len - pos;
+  memcpy(block, data + pos, rest);
+  block[rest++] = 0x80;
+  if (rest > 56) {
+    memset(block + rest, 0, 64 - rest);
+    _sha1Block(state, block);
+    rest = 0;
+  }
+  memset(block + rest, 0, 56 - rest);
+  uint64_t bits = (uint64_t)len * 8;
+  for (int i = 0; i < 8; i++) {
+    block[63 - i] = (uint8_t)(bits >> (8 * i));
+  }
+  _sha1Block(state, block);
+  for (int i = 0; i < 20; i++) {
+    digest[i] = (uint8_t)(state[i / 4] >> (24 - 8 * (i % 4)));
+  }
+}
+
+WebSocket::WebSocket()
+: _headerLen(0)
+, _headerNeed(2)
+, _frameOpcode(0)
+, _frameFin(false)
+, _payloadLen(0)
+, _payloadPos(0)
+, _messageLen(0)
+, _messageOpcode(WS_TEXT)
+, _messageReady(false)
+, _fragmented(false)
+{
+}
+
+String WebSocket::acceptKey(const String& key) {
+  String text = key + WS_GUID;
+  uint8_t digest[20];
+  _sha1((const uint8_t*)text.c_str(), text.length(), digest);
+  char encoded[base64_encode_expected_len(20) + 1];
+  int len = base64_encode_chars((const char*)digest, 20, encoded);
+  encoded[len] = 0;
+  return String(encoded);
+}
+
+bool WebSocket::accept(WebServer& server) {
+  String key = server.header("Sec-WebSocket-Key");
+  if (!server.header("Upgrade").equalsIgnoreCase("websocket") || key.length() == 0) {
+    server.send(400, "text/plain", "WebSocket upgrade expected");
+    return false;
+  }
+  if (server.header("Sec-WebSocket-Version") != "13") {
+    server.sendHeader("Sec-WebSocket-Version", "13");
+    server.send(426, "text/plain", "Unsupported WebSocket version");
+    return false;
+  }
+  key.trim();
+  String response = "HTTP/1.1 101 Switching Protocols\r\n"
+                    "Upgrade: websocket\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Sec-WebSocket-Accept: ";
+  response += acceptKey(key);
+  response += "\r\n\r\n";
+  _client = server.client();
+  _client.write(response.c_str(), response.length());
+  // connection is no more an HTTP one, server must not wait on it
+  server.keepClient();
+  _resetFrame();
+  _messageLen = 0;
+  _messageReady = false;
+  _fragmented = false;
+  return true;
+}
+
+bool WebSocket::connected() {
+  return _client && _client.connected();
+}
+
+size_t WebSocket::room() {
+  return clientRoom(_client);
+}
+
+void WebSocket::_resetFrame() {
+  _headerLen = 0;
+  _headerNeed = 2;
+  _payloadLen = 0;
+  _payloadPos = 0;
+}
+
+void WebSocket::_fail(uint16_t code) {
+  close(code);
+  _resetFrame();
+  _messageLen = 0;
+  _fragmented = false;
+}
+
+// header is complete, check it and find where payload goes
+bool WebSocket::_startFrame() {
+  _frameFin = _header[0] & 0x80;
+  _frameOpcode = _header[0] & 0x0F;
+  uint8_t len7 = _header[1] & 0x7F;
+  uint8_t pos = 2;
+  if (len7 == 126) {
+    _payloadLen = ((uint32_t)_header[2] << 8) | _header[3];
+    pos = 4;
+  } else if (len7 == 127) {
+    // messages are small, so upper bytes of 64 bits length must be 0
+    if (_header[2] | _header[3] | _header[4] | _header[5]) {
+      _fail(1009);
+      return false;
+    }
+    _payloadLen = ((uint32_t)_header[6] << 24) | ((uint32_t)_header[7] << 16) |
+                  ((uint32_t)_header[8] << 8) | _header[9];
+    pos = 10;
+  } else {
+    _payloadLen = len7;
+  }
+  memcpy(_mask, &_header[pos], 4);
+  _payloadPos = 0;
+  if ((_header[0] & 0x70) != 0) {
+    // no extension was negotiated
+    _fail(1002);
+    return false;
+  }
+  if (_frameOpcode & 0x08) {
+    if (!_frameFin || (_payloadLen > WEBSOCKET_MAX_CONTROL) ||
+        ((_frameOpcode != WS_CLOSE) && (_frameOpcode != WS_PING) && (_frameOpcode != WS_PONG))) {
+      _fail(1002);
+      return false;
+    }
+    return true;
+  }
+  if (_frameOpcode == WS_CONTINUATION) {
+    if (!_fragmented) {
+      _fail(1002);
+      return false;
+    }
+  } else if ((_frameOpcode == WS_TEXT) || (_frameOpcode == WS_BINARY)) {
+    if (_fragmented) {
+      _fail(1002);
+      return false;
+    }
+    _messageLen = 0;
+    _messageOpcode = (WSOpcode)_frameOpcode;
+  } else {
+    _fail(1002);
+    return false;
+  }
+  if (_messageLen + _payloadLen > WEBSOCKET_MAX_MESSAGE) {
+    _fail(1009);
+    return false;
+  }
+  return true;
+}
+
+// payload is complete, return true if a data message is complete
+bool WebSocket::_endFrame() {
+  bool ready = false;
+  switch (_frameOpcode) {
+    case WS_PING:
+      send(_control, _payloadLen, WS_PONG);
+      break;
+    case WS_PONG:
+      break;
+    case WS_CLOSE: {
+      // echo status code then close
+      uint8_t frame[4] = {0x80 | WS_CLOSE, 0, 0, 0};
+      if (_payloadLen >= 2) {
+        frame[1] = 2;
+        frame[2] = _control[0];
+        frame[3] = _control[1];
+      }
+      if (connected()) {
+        _client.write(frame, 2 + frame[1]);
+      }
+      _client.stop();
+      _fragmented = false;
+      _messageLen = 0;
+    }
+    break;
+    default:
+      _messageLen += _payloadLen;
+      _fragmented = !_frameFin;
+      ready = _frameFin;
+      break;
+  }
+  _resetFrame();
+  return ready;
+}
+
+bool WebSocket::poll() {
+  if (_messageReady) {
+    // previous message was given to caller
+    _messageReady = false;
+    _messageLen = 0;
+  }
+  if (!connected()) {
+    return false;
+  }
+  while (_client.available()) {
+    if (_headerLen < _headerNeed) {
+      _header[_headerLen++] = _client.read();
+      if (_headerLen == 2) {
+        // frames from client are always masked
+        if (!(_header[1] & 0x80)) {
+          _fail(1002);
+          return false;
+        }
+        uint8_t len7 = _header[1] & 0x7F;
+        _headerNeed = 2 + ((len7 == 126) ? 2 : ((len7 == 127) ? 8 : 0)) + 4;
+      }
+      if (_headerLen < _headerNeed) {
+        continue;
+      }
+      if (!_startFrame()) {
+        return false;
+      }
+    } else {
+      uint8_t* dst = (_frameOpcode & 0x08) ? _control : &_message[_messageLen];
+      size_t len = _payloadLen - _payloadPos;
+      size_t available = _client.available();
+      if (len > available) {
+        len = available;
+      }
+      len = _client.read(dst + _payloadPos, len);
+      if (len == 0) {
+        break;
+      }
+      for (size_t i = 0; i < len; i++) {
+        dst[_payloadPos + i] ^= _mask[(_payloadPos + i) & 3];
+      }
+      _payloadPos += len;
+    }
+    if (_payloadPos == _payloadLen) {
+      if (_endFrame()) {
+        _messageReady = true;
+        return true;
+      }
+      if (!connected()) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+bool WebSocket::send(const uint8_t* data, size_t len, WSOpcode opcode) {
+  if (!connected()) {
+    return false;
+  }
+  // small frames are sent in one write so they go in one packet
+  uint8_t frame[10 + 128];
+  size_t headerLen = 2;
+  frame[0] = 0x80 | opcode;
+  if (len < 126) {
+    frame[1] = len;
+  } else if (len < 65536) {
+    frame[1] = 126;
+    frame[2] = (len >> 8) & 0xFF;
+    frame[3] = len & 0xFF;
+    headerLen = 4;
+  } else {
+    frame[1] = 127;
+    for (int i = 0; i < 8; i++) {
+      frame[9 - i] = (i < 4) ? (((uint32_t)len >> (8 * i)) & 0xFF) : 0;
+    }
+    headerLen = 10;
+  }
+  if (len <= 128) {
+    if (len > 0) {
+      memcpy(frame + headerLen, data, len);
+    }
+    return _client.write(frame, headerLen + len) == headerLen + len;
+  }
+  if (_client.write(frame, headerLen) != headerLen) {
+    return false;
+  }
+  return _client.write(data, len) == len;
+}
+
+bool WebSocket::ping() {
+  return send(NULL, 0, WS_PING);
+}
+
+void WebSocket::close(uint16_t code) {
+  if (connected()) {
+    uint8_t frame[4] = {0x80 | WS_CLOSE, 2, (uint8_t)(code >> 8), (uint8_t)(code & 0xFF)};
+    _client.write(frame, 4);
+  }
+  _client.stop();
+}
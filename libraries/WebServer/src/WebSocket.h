@@ -0,0 +1,87 @@
+/*
+  WebSocket.h - WebSocket (RFC 6455) server side connection for WebServer.
+  A request handler accepts the upgrade, then the connection is polled from loop().
+
+  Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include "WebServer.h"
+
+#ifndef WEBSOCKET_MAX_MESSAGE
+#define WEBSOCKET_MAX_MESSAGE 512 //longest message received, a longer one closes the connection
+#endif
+
+#define WEBSOCKET_MAX_CONTROL 125 //ping, pong and close payload limit
+
+enum WSOpcode { WS_CONTINUATION = 0, WS_TEXT = 1, WS_BINARY = 2,
+                WS_CLOSE = 8, WS_PING = 9, WS_PONG = 10 };
+
+class WebSocket
+{
+public:
+  WebSocket();
+
+  // answer upgrade request of current server client, 400/426 is sent if not valid
+  bool accept(WebServer& server);
+  // read what client sent without blocking, pings and close are answered here
+  // return true when a complete text or binary message is ready
+  bool poll();
+  const uint8_t* data() { return _message; }
+  size_t length() { return _messageLen; }
+  WSOpcode opcode() { return _messageOpcode; }
+
+  bool send(const uint8_t* data, size_t len, WSOpcode opcode = WS_BINARY);
+  bool sendText(const char* text) { return send((const uint8_t*)text, strlen(text), WS_TEXT); }
+  bool ping();
+  void close(uint16_t code = 1000);
+  bool connected();
+  // bytes which can be sent without blocking, see clientRoom()
+  size_t room();
+  WiFiClient& client() { return _client; }
+
+  static String acceptKey(const String& key);
+
+protected:
+  void _resetFrame();
+  bool _startFrame();
+  bool _endFrame();
+  void _fail(uint16_t code);
+
+  WiFiClient _client;
+
+  uint8_t  _header[14];
+  uint8_t  _headerLen;
+  uint8_t  _headerNeed;
+  uint8_t  _frameOpcode;
+  bool     _frameFin;
+  uint8_t  _mask[4];
+  uint32_t _payloadLen;
+  uint32_t _payloadPos;
+
+  uint8_t  _control[WEBSOCKET_MAX_CONTROL];
+  uint8_t  _message[WEBSOCKET_MAX_MESSAGE];
+  size_t   _messageLen;
+  WSOpcode _messageOpcode;
+  bool     _messageReady;
+  bool     _fragmented;
+};
+
+#endif //WEBSOCKET_H
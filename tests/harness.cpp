@@ -0,0 +1,163 @@
+/*
+  harness.cpp - host test harness: tests, benchmarks and heap counters
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include "config.h"
+#include <chrono>
+#include <new>
+
+static harness_case * cases = NULL;
+static harness_case * last_case = NULL;
+static int failures = 0;
+uint8_t harness_firmware = MARLIN;
+
+uint8_t CONFIG::GetFirmwareTarget()
+{
+    return harness_firmware;
+}
+
+harness_case::harness_case(const char * name, harness_function function, bool bench) :
+    name(name), function(function), bench(bench), next(NULL)
+{
+    //run in file order
+    if (last_case) {
+        last_case->next = this;
+    } else {
+        cases = this;
+    }
+    last_case = this;
+}
+
+void harness_check(bool ok, const char * text, const char * file, int line)
+{
+    if (!ok) {
+        printf("%s:%d: CHECK(%s) failed\n", file, line, text);
+        failures++;
+    }
+}
+
+void harness_check_equal(long a, long b, const char * ta, const char * tb, const char * file, int line)
+{
+    if (a != b) {
+        printf("%s:%d: %s == %s failed: %ld != %ld\n", file, line, ta, tb, a, b);
+        failures++;
+    }
+}
+
+void harness_check_string(const char * a, const char * b, const char * text, const char * file, int line)
+{
+    if (strcmp(a, b) != 0) {
+        printf("%s:%d: %s failed:\n  got:      \"%s\"\n  expected: \"%s\"\n", file, line, text, a, b);
+        failures++;
+    }
+}
+
+double harness_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void harness_report(const char * name, double value, const char * unit)
+{
+    printf("  %-40s %12.2f %s\n", name, value, unit);
+}
+
+//size is kept before each block so delete knows what is freed
+static harness_heap heap;
+static size_t heap_current = 0;
+static const size_t heap_header = 16;
+
+void harness_heap_reset()
+{
+    heap.allocations = 0;
+    heap.bytes = 0;
+    heap.peak = heap_current;
+}
+
+harness_heap harness_heap_get()
+{
+    return heap;
+}
+
+void * operator new(size_t size)
+{
+    uint8_t * p = (uint8_t *)malloc(size + heap_header);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    *(size_t *)p = size;
+    heap.allocations++;
+    heap.bytes += size;
+    heap_current += size;
+    if (heap_current > heap.peak) {
+        heap.peak = heap_current;
+    }
+    return p + heap_header;
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+    if (ptr) {
+        uint8_t * p = (uint8_t *)ptr - heap_header;
+        heap_current -= *(size_t *)p;
+        free(p);
+    }
+}
+
+void operator delete[](void * ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+int main(int argc, char ** argv)
+{
+    bool bench = (argc > 1) && (strcmp(argv[1], "--bench") == 0);
+    int count = 0;
+    for (harness_case * c = cases; c; c = c->next) {
+        if (c->bench != bench) {
+            continue;
+        }
+        if (bench) {
+            printf("%s\n", c->name);
+        }
+        host_millis = 0;
+        c->function();
+        count++;
+    }
+    if (!bench) {
+        printf("%s: %d tests, %d failures\n", argv[0], count, failures);
+    }
+    return failures ? 1 : 0;
+}
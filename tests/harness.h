@@ -0,0 +1,70 @@
+/*
+  harness.h - host test harness: tests, benchmarks and heap counters
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <Arduino.h>
+
+//TEST() runs on every call, BENCH() only with --bench
+#define TEST(name) static void name(); \
+    static harness_case name##_case(#name, name, false); \
+    static void name()
+#define BENCH(name) static void name(); \
+    static harness_case name##_case(#name, name, true); \
+    static void name()
+
+#define CHECK(cond) harness_check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQUAL(a, b) harness_check_equal((long)(a), (long)(b), #a, #b, __FILE__, __LINE__)
+#define CHECK_STRING(a, b) harness_check_string(String(a).c_str(), String(b).c_str(), #a, __FILE__, __LINE__)
+
+typedef void (*harness_function)();
+
+struct harness_case {
+    harness_case(const char * name, harness_function function, bool bench);
+    const char * name;
+    harness_function function;
+    bool bench;
+    harness_case * next;
+};
+
+void harness_check(bool ok, const char * text, const char * file, int line);
+void harness_check_equal(long a, long b, const char * ta, const char * tb, const char * file, int line);
+void harness_check_string(const char * a, const char * b, const char * text, const char * file, int line);
+
+//wall clock for benchmarks, in seconds
+double harness_seconds();
+
+//heap use through new/delete since last reset
+struct harness_heap {
+    size_t allocations;
+    size_t bytes;
+    size_t peak;
+};
+void harness_heap_reset();
+harness_heap harness_heap_get();
+
+//one benchmark result line
+void harness_report(const char * name, double value, const char * unit);
+
+//firmware target returned by CONFIG::GetFirmwareTarget()
+extern uint8_t harness_firmware;
+
+#endif
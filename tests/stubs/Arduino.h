@@ -0,0 +1,557 @@
+/*
+  Arduino.h - host build of the few Arduino core pieces used by the
+  modules under test: String, Print/Stream, Serial and a clock driven
+  by the tests.
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string>
+#include <deque>
+#include <algorithm>
+
+//flash is plain memory on host
+#define PROGMEM
+#define PGM_P const char *
+#define PGM_VOID_P const void *
+#define PSTR(s) (s)
+#define F(s) ((const __FlashStringHelper *)(s))
+#define FPSTR(s) ((const __FlashStringHelper *)(s))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+#define memccpy_P memccpy
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p) (*(void * const *)(p))
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+
+//core debug output is off
+#define DEBUGV(...)
+
+typedef uint8_t byte;
+typedef bool boolean;
+class __FlashStringHelper;
+
+using std::min;
+using std::max;
+
+class String
+{
+public:
+    String() {}
+    String(const char * c)
+    {
+        if (c) {
+            _s = c;
+        }
+    }
+    String(const __FlashStringHelper * c) : String((const char *)c) {}
+    String(const std::string & s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    String(int v, unsigned char base = 10)
+    {
+        from_number((long)v, base);
+    }
+    String(unsigned int v, unsigned char base = 10)
+    {
+        from_number((unsigned long)v, base);
+    }
+    String(long v, unsigned char base = 10)
+    {
+        from_number(v, base);
+    }
+    String(unsigned long v, unsigned char base = 10)
+    {
+        from_number(v, base);
+    }
+    String(float v, unsigned char decimals = 2) : String((double)v, decimals) {}
+    String(double v, unsigned char decimals = 2)
+    {
+        char b[48];
+        snprintf(b, sizeof(b), "%.*f", decimals, v);
+        _s = b;
+    }
+    const char * c_str() const
+    {
+        return _s.c_str();
+    }
+    unsigned int length() const
+    {
+        return _s.size();
+    }
+    bool reserve(unsigned int n)
+    {
+        _s.reserve(n);
+        return true;
+    }
+    bool concat(const String & o)
+    {
+        _s += o._s;
+        return true;
+    }
+    bool concat(const char * o)
+    {
+        if (o) {
+            _s += o;
+        }
+        return true;
+    }
+    bool concat(char c)
+    {
+        _s += c;
+        return true;
+    }
+    bool concat(const __FlashStringHelper * o)
+    {
+        return concat((const char *)o);
+    }
+    template<typename T> String & operator+=(const T & o)
+    {
+        concat(String(o));
+        return *this;
+    }
+    String & operator+=(const String & o)
+    {
+        concat(o);
+        return *this;
+    }
+    String & operator+=(const char * o)
+    {
+        concat(o);
+        return *this;
+    }
+    String & operator+=(char c)
+    {
+        concat(c);
+        return *this;
+    }
+    bool operator==(const String & o) const
+    {
+        return _s == o._s;
+    }
+    bool operator==(const char * o) const
+    {
+        return _s == (o ? o : "");
+    }
+    bool operator!=(const String & o) const
+    {
+        return !(*this == o);
+    }
+    bool operator!=(const char * o) const
+    {
+        return !(*this == o);
+    }
+    bool operator<(const String & o) const
+    {
+        return _s < o._s;
+    }
+    bool equals(const String & o) const
+    {
+        return *this == o;
+    }
+    bool equals(const char * o) const
+    {
+        return *this == o;
+    }
+    bool equalsIgnoreCase(const String & o) const
+    {
+        return strcasecmp(c_str(), o.c_str()) == 0;
+    }
+    char charAt(unsigned int i) const
+    {
+        return (i < _s.size()) ? _s[i] : 0;
+    }
+    char operator[](unsigned int i) const
+    {
+        return charAt(i);
+    }
+    char & operator[](unsigned int i)
+    {
+        return _s[i];
+    }
+    void setCharAt(unsigned int i, char c)
+    {
+        if (i < _s.size()) {
+            _s[i] = c;
+        }
+    }
+    int indexOf(char c, unsigned int from = 0) const
+    {
+        return pos(_s.find(c, from));
+    }
+    int indexOf(const String & x, unsigned int from = 0) const
+    {
+        return pos(_s.find(x._s, from));
+    }
+    int lastIndexOf(char c) const
+    {
+        return pos(_s.rfind(c));
+    }
+    int lastIndexOf(const String & x) const
+    {
+        return pos(_s.rfind(x._s));
+    }
+    String substring(unsigned int from) const
+    {
+        return substring(from, _s.size());
+    }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to) {
+            unsigned int t = from;
+            from = to;
+            to = t;
+        }
+        if (from >= _s.size()) {
+            return String();
+        }
+        return String(_s.substr(from, to - from));
+    }
+    bool startsWith(const String & p) const
+    {
+        return _s.compare(0, p._s.size(), p._s) == 0;
+    }
+    bool endsWith(const String & p) const
+    {
+        return (_s.size() >= p._s.size()) && (_s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0);
+    }
+    void replace(const String & from, const String & to)
+    {
+        if (from._s.empty()) {
+            return;
+        }
+        size_t p = 0;
+        while ((p = _s.find(from._s, p)) != std::string::npos) {
+            _s.replace(p, from._s.size(), to._s);
+            p += to._s.size();
+        }
+    }
+    void replace(char from, char to)
+    {
+        for (size_t i = 0; i < _s.size(); i++) {
+            if (_s[i] == from) {
+                _s[i] = to;
+            }
+        }
+    }
+    void remove(unsigned int index)
+    {
+        if (index < _s.size()) {
+            _s.erase(index);
+        }
+    }
+    void remove(unsigned int index, unsigned int count)
+    {
+        if (index < _s.size()) {
+            _s.erase(index, count);
+        }
+    }
+    void trim()
+    {
+        size_t b = 0;
+        while ((b < _s.size()) && isspace((unsigned char)_s[b])) {
+            b++;
+        }
+        size_t e = _s.size();
+        while ((e > b) && isspace((unsigned char)_s[e - 1])) {
+            e--;
+        }
+        _s = _s.substr(b, e - b);
+    }
+    void toLowerCase()
+    {
+        for (size_t i = 0; i < _s.size(); i++) {
+            _s[i] = tolower((unsigned char)_s[i]);
+        }
+    }
+    void toUpperCase()
+    {
+        for (size_t i = 0; i < _s.size(); i++) {
+            _s[i] = toupper((unsigned char)_s[i]);
+        }
+    }
+    long toInt() const
+    {
+        return atol(c_str());
+    }
+    float toFloat() const
+    {
+        return atof(c_str());
+    }
+    void toCharArray(char * buf, unsigned int size) const
+    {
+        getBytes((unsigned char *)buf, size);
+    }
+    void getBytes(unsigned char * buf, unsigned int size) const
+    {
+        if (size == 0) {
+            return;
+        }
+        size_t n = (_s.size() < size - 1) ? _s.size() : size - 1;
+        memcpy(buf, _s.data(), n);
+        buf[n] = 0;
+    }
+private:
+    std::string _s;
+    static int pos(size_t p)
+    {
+        return (p == std::string::npos) ? -1 : (int)p;
+    }
+    template<typename T> void from_number(T v, unsigned char base)
+    {
+        char b[72];
+        if (base == 16) {
+            snprintf(b, sizeof(b), "%lx", (unsigned long)v);
+        } else if (v < 0) {
+            snprintf(b, sizeof(b), "%ld", (long)v);
+        } else {
+            snprintf(b, sizeof(b), "%lu", (unsigned long)v);
+        }
+        _s = b;
+    }
+};
+
+inline String operator+(const String & a, const String & b)
+{
+    String r(a);
+    r += b;
+    return r;
+}
+inline String operator+(const String & a, const char * b)
+{
+    String r(a);
+    r += b;
+    return r;
+}
+inline String operator+(const char * a, const String & b)
+{
+    String r(a);
+    r += b;
+    return r;
+}
+inline String operator+(const String & a, char b)
+{
+    String r(a);
+    r += b;
+    return r;
+}
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t * data, size_t len)
+    {
+        size_t n = 0;
+        while (len--) {
+            n += write(*data++);
+        }
+        return n;
+    }
+    size_t write(const char * data, size_t len)
+    {
+        return write((const uint8_t *)data, len);
+    }
+    size_t write(const char * s)
+    {
+        return s ? write((const uint8_t *)s, strlen(s)) : 0;
+    }
+    virtual int availableForWrite()
+    {
+        return 0;
+    }
+    virtual void flush() {}
+    size_t print(const char * s)
+    {
+        return write(s);
+    }
+    size_t print(const String & s)
+    {
+        return write((const uint8_t *)s.c_str(), s.length());
+    }
+    size_t print(const __FlashStringHelper * s)
+    {
+        return print((const char *)s);
+    }
+    size_t print(char c)
+    {
+        return write((uint8_t)c);
+    }
+    size_t print(int v)
+    {
+        return print(String(v));
+    }
+    size_t print(unsigned int v)
+    {
+        return print(String(v));
+    }
+    size_t print(long v)
+    {
+        return print(String(v));
+    }
+    size_t print(unsigned long v)
+    {
+        return print(String(v));
+    }
+    size_t print(double v, int decimals = 2)
+    {
+        return print(String(v, decimals));
+    }
+    size_t println()
+    {
+        return print("\r\n");
+    }
+    template<typename T> size_t println(const T & v)
+    {
+        size_t n = print(v);
+        return n + println();
+    }
+    size_t printf(const char * format, ...)
+    {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        return write((const uint8_t *)buf, (len < (int)sizeof(buf)) ? len : sizeof(buf) - 1);
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long) {}
+    size_t readBytes(char * buf, size_t len)
+    {
+        size_t n = 0;
+        while ((n < len) && (available() > 0)) {
+            buf[n++] = read();
+        }
+        return n;
+    }
+    size_t readBytes(uint8_t * buf, size_t len)
+    {
+        return readBytes((char *)buf, len);
+    }
+    //no data means timeout on host
+    String readStringUntil(char terminator)
+    {
+        String s;
+        while (available() > 0) {
+            int c = read();
+            if (c == terminator) {
+                break;
+            }
+            s += (char)c;
+        }
+        return s;
+    }
+};
+
+//UART: written bytes are kept for tests, read bytes come from rx
+class HardwareSerial : public Stream
+{
+public:
+    HardwareSerial() : room(128) {}
+    size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t * data, size_t len)
+    {
+        tx.append((const char *)data, len);
+        return len;
+    }
+    using Print::write;
+    int availableForWrite()
+    {
+        return room;
+    }
+    int available()
+    {
+        return rx.size();
+    }
+    int read()
+    {
+        if (rx.empty()) {
+            return -1;
+        }
+        int c = (uint8_t)rx.front();
+        rx.pop_front();
+        return c;
+    }
+    int peek()
+    {
+        return rx.empty() ? -1 : (uint8_t)rx.front();
+    }
+    void begin(unsigned long) {}
+    void end() {}
+    void setRxBufferSize(size_t) {}
+    void swap() {}
+    //what was written since last clear
+    std::string tx;
+    std::deque<char> rx;
+    //free room of TX FIFO given to availableForWrite()
+    int room;
+};
+
+extern HardwareSerial Serial;
+
+//clock only moves when tests make it move
+extern unsigned long host_millis;
+inline unsigned long millis()
+{
+    return host_millis;
+}
+inline unsigned long micros()
+{
+    return host_millis * 1000;
+}
+inline void delay(unsigned long ms)
+{
+    host_millis += ms;
+}
+inline void yield() {}
+inline bool isPrintable(int c)
+{
+    return isprint(c);
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*
+  FS.h - host SPIFFS kept in memory, flat names like the real one
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace fs
+{
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+typedef std::vector<uint8_t> file_data;
+
+class File : public Stream
+{
+public:
+    File() : _pos(0) {}
+    File(const std::string & name, std::shared_ptr<file_data> data, size_t pos) : _name(name), _data(data), _pos(pos) {}
+    size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t * buf, size_t len)
+    {
+        if (!_data) {
+            return 0;
+        }
+        if (_data->size() < _pos + len) {
+            _data->resize(_pos + len);
+        }
+        memcpy(&(*_data)[_pos], buf, len);
+        _pos += len;
+        return len;
+    }
+    using Print::write;
+    int available()
+    {
+        return _data ? _data->size() - _pos : 0;
+    }
+    int read()
+    {
+        uint8_t c;
+        return (read(&c, 1) == 1) ? c : -1;
+    }
+    int read(uint8_t * buf, size_t len)
+    {
+        size_t left = available();
+        if (len > left) {
+            len = left;
+        }
+        if (len) {
+            memcpy(buf, &(*_data)[_pos], len);
+        }
+        _pos += len;
+        return len;
+    }
+    int peek()
+    {
+        return available() ? (*_data)[_pos] : -1;
+    }
+    bool seek(uint32_t pos, SeekMode mode = SeekSet)
+    {
+        if (!_data) {
+            return false;
+        }
+        size_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? _pos : _data->size();
+        if (base + pos > _data->size()) {
+            return false;
+        }
+        _pos = base + pos;
+        return true;
+    }
+    size_t position() const
+    {
+        return _pos;
+    }
+    size_t size() const
+    {
+        return _data ? _data->size() : 0;
+    }
+    const char * name() const
+    {
+        return _name.c_str();
+    }
+    bool isDirectory()
+    {
+        return false;
+    }
+    void close()
+    {
+        _data.reset();
+    }
+    operator bool() const
+    {
+        return _data != NULL;
+    }
+private:
+    std::string _name;
+    std::shared_ptr<file_data> _data;
+    size_t _pos;
+};
+
+typedef std::map<std::string, std::shared_ptr<file_data> > file_map;
+
+class Dir
+{
+public:
+    Dir() : _files(NULL), _started(false) {}
+    Dir(file_map * files, const std::string & path) : _files(files), _path(path), _started(false) {}
+    bool next()
+    {
+        if (!_files) {
+            return false;
+        }
+        _it = _started ? ++_it : _files->lower_bound(_path);
+        _started = true;
+        return (_it != _files->end()) && (_it->first.compare(0, _path.size(), _path) == 0);
+    }
+    String fileName()
+    {
+        return String(_it->first.c_str());
+    }
+    size_t fileSize()
+    {
+        return _it->second->size();
+    }
+private:
+    file_map * _files;
+    std::string _path;
+    file_map::iterator _it;
+    bool _started;
+};
+
+struct FSInfo {
+    size_t totalBytes;
+    size_t usedBytes;
+    size_t blockSize;
+    size_t pageSize;
+    size_t maxOpenFiles;
+    size_t maxPathLength;
+};
+
+class FS
+{
+public:
+    bool begin()
+    {
+        return true;
+    }
+    void end() {}
+    bool format()
+    {
+        _files.clear();
+        return true;
+    }
+    //modes "r", "w" and "a" like SPIFFS
+    File open(const String & path, const char * mode)
+    {
+        std::string name(path.c_str());
+        file_map::iterator it = _files.find(name);
+        if (mode[0] == 'r') {
+            return (it == _files.end()) ? File() : File(name, it->second, 0);
+        }
+        if ((it == _files.end()) || (mode[0] == 'w')) {
+            _files[name] = std::make_shared<file_data>();
+        }
+        std::shared_ptr<file_data> data = _files[name];
+        return File(name, data, (mode[0] == 'a') ? data->size() : 0);
+    }
+    bool exists(const String & path)
+    {
+        return _files.count(path.c_str()) > 0;
+    }
+    bool remove(const String & path)
+    {
+        return _files.erase(path.c_str()) > 0;
+    }
+    bool rename(const String & from, const String & to)
+    {
+        file_map::iterator it = _files.find(from.c_str());
+        if ((it == _files.end()) || exists(to)) {
+            return false;
+        }
+        _files[to.c_str()] = it->second;
+        _files.erase(it);
+        return true;
+    }
+    Dir openDir(const String & path)
+    {
+        return Dir(&_files, path.c_str());
+    }
+    bool info(FSInfo & info)
+    {
+        memset(&info, 0, sizeof(info));
+        info.totalBytes = 1 << 20;
+        for (file_map::iterator it = _files.begin(); it != _files.end(); ++it) {
+            info.usedBytes += it->second->size();
+        }
+        return true;
+    }
+private:
+    file_map _files;
+};
+
+}
+
+#ifndef FS_NO_GLOBALS
+using fs::FS;
+using fs::File;
+using fs::Dir;
+using fs::FSInfo;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+#endif
+
+extern fs::FS SPIFFS;
+
+#endif
@@ -1,5 +1,5 @@
 /*
-  storestrings.h - rolling storage class
+  IPAddress.h - host IPv4 address
 
   Copyright (c) 2014 Luc Lebosse. All rights reserved.
 
@@ -18,44 +18,51 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
-#ifndef STORESTRINGS_h
-#define STORESTRINGS_h
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
 #include <Arduino.h>
-#include "GenLinkedList.h"
-class STORESTRINGS_CLASS
+
+class IPAddress
 {
 public:
-    STORESTRINGS_CLASS (int maxsize = -1, int maxstringlength=-1);
-    ~STORESTRINGS_CLASS ();
-    bool add (const char * string);
-    inline bool add (String & string)
+    IPAddress()
     {
-        return add(string.c_str());
-    };
-    bool add (const __FlashStringHelper *str);
-    bool remove(int pos);
-    const char * get(int pos);
-    int get_index(const char * string);
-    void clear();
-    inline int size()
+        _b[0] = _b[1] = _b[2] = _b[3] = 0;
+    }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
     {
-        return _charlist.size();
-    };
-    bool setsize(int size);
-    bool setlength(int len);
-    inline int getsize()
+        _b[0] = a;
+        _b[1] = b;
+        _b[2] = c;
+        _b[3] = d;
+    }
+    IPAddress(uint32_t v)
     {
-        return _maxsize;
-    };
-    inline int getlength()
+        memcpy(_b, &v, 4);
+    }
+    operator uint32_t() const
     {
-        return _maxstringlength;
-    };
-
+        uint32_t v;
+        memcpy(&v, _b, 4);
+        return v;
+    }
+    uint8_t operator[](int i) const
+    {
+        return _b[i];
+    }
+    uint8_t & operator[](int i)
+    {
+        return _b[i];
+    }
+    String toString() const
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _b[0], _b[1], _b[2], _b[3]);
+        return String(buf);
+    }
 private:
-    int _maxsize;
-    int _maxstringlength;
-    GenLinkedList<char *> _charlist;
+    uint8_t _b[4];
 };
 
 #endif
@@ -0,0 +1,137 @@
+/*
+  WiFiClient.h - loopback TCP client: both ends of a connection share two byte queues
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <memory>
+
+struct loopback_link {
+    loopback_link() : open(true), room(1 << 30) {}
+    //data for each end
+    std::deque<uint8_t> in[2];
+    bool open;
+    //bytes each end can write before other one reads
+    size_t room;
+};
+
+class WiFiClient : public Stream
+{
+public:
+    WiFiClient() : _side(0) {}
+    WiFiClient(std::shared_ptr<loopback_link> link, int side) : _link(link), _side(side) {}
+    int available()
+    {
+        return _link ? _link->in[_side].size() : 0;
+    }
+    int read()
+    {
+        if (!available()) {
+            return -1;
+        }
+        int c = _link->in[_side].front();
+        _link->in[_side].pop_front();
+        return c;
+    }
+    int read(uint8_t * buf, size_t len)
+    {
+        size_t n = std::min(len, (size_t)available());
+        if (n) {
+            std::deque<uint8_t> & in = _link->in[_side];
+            std::copy(in.begin(), in.begin() + n, buf);
+            in.erase(in.begin(), in.begin() + n);
+        }
+        return n;
+    }
+    int peek()
+    {
+        return available() ? _link->in[_side].front() : -1;
+    }
+    size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t * data, size_t len)
+    {
+        if (!connected()) {
+            return 0;
+        }
+        size_t room = availableForWrite();
+        if (len > room) {
+            len = room;
+        }
+        _link->in[1 - _side].insert(_link->in[1 - _side].end(), data, data + len);
+        return len;
+    }
+    size_t write_P(const char * data, size_t len)
+    {
+        return write((const uint8_t *)data, len);
+    }
+    using Print::write;
+    int availableForWrite()
+    {
+        if (!connected()) {
+            return 0;
+        }
+        size_t queued = _link->in[1 - _side].size();
+        return (queued < _link->room) ? _link->room - queued : 0;
+    }
+    //data already received can still be read once closed
+    uint8_t connected()
+    {
+        return _link && (_link->open || available());
+    }
+    operator bool()
+    {
+        return _link != NULL;
+    }
+    bool operator==(const WiFiClient & o) const
+    {
+        return _link == o._link;
+    }
+    void stop()
+    {
+        if (_link) {
+            _link->open = false;
+        }
+        _link.reset();
+    }
+    void flush() {}
+    void setNoDelay(bool) {}
+    IPAddress remoteIP()
+    {
+        return IPAddress(127, 0, 0, 1);
+    }
+    uint16_t remotePort()
+    {
+        return 0;
+    }
+    std::shared_ptr<loopback_link> link()
+    {
+        return _link;
+    }
+private:
+    std::shared_ptr<loopback_link> _link;
+    int _side;
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+  WiFiServer.h - loopback server, connections are opened by tests
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HOST_WIFISERVER_H
+#define HOST_WIFISERVER_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+class WiFiServer
+{
+public:
+    WiFiServer(int port) : _port(port) {}
+    WiFiServer(IPAddress, int port) : _port(port) {}
+    void begin();
+    void close();
+    void stop()
+    {
+        close();
+    }
+    void end()
+    {
+        close();
+    }
+    void setNoDelay(bool) {}
+    bool hasClient();
+    //next connection opened on port, or a not connected client
+    WiFiClient available();
+    //test side: open a connection, server gets it on next available()
+    static WiFiClient connect(int port);
+private:
+    int _port;
+};
+
+#endif
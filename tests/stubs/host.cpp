@@ -0,0 +1,83 @@
+/*
+  host.cpp - globals of host Arduino stubs
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+#include <FS.h>
+#include <WiFiServer.h>
+#include <libb64/cencode.h>
+#include <map>
+
+HardwareSerial Serial;
+unsigned long host_millis = 0;
+fs::FS SPIFFS;
+
+//connections opened by tests and not taken by server yet, by port
+static std::map<int, std::deque<WiFiClient> > pending;
+
+void WiFiServer::begin() {}
+
+void WiFiServer::close()
+{
+    pending.erase(_port);
+}
+
+bool WiFiServer::hasClient()
+{
+    return !pending[_port].empty();
+}
+
+WiFiClient WiFiServer::available()
+{
+    std::deque<WiFiClient> & queue = pending[_port];
+    if (queue.empty()) {
+        return WiFiClient();
+    }
+    WiFiClient client = queue.front();
+    queue.pop_front();
+    return client;
+}
+
+WiFiClient WiFiServer::connect(int port)
+{
+    std::shared_ptr<loopback_link> link = std::make_shared<loopback_link>();
+    pending[port].push_back(WiFiClient(link, 0));
+    return WiFiClient(link, 1);
+}
+
+int base64_encode_chars(const char * in, int len, char * out)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int n = 0;
+    for (int i = 0; i < len; i += 3) {
+        uint32_t v = (uint8_t)in[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint8_t)in[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            v |= (uint8_t)in[i + 2];
+        }
+        out[n++] = table[(v >> 18) & 0x3f];
+        out[n++] = table[(v >> 12) & 0x3f];
+        out[n++] = (i + 1 < len) ? table[(v >> 6) & 0x3f] : '=';
+        out[n++] = (i + 2 < len) ? table[v & 0x3f] : '=';
+    }
+    out[n] = 0;
+    return n;
+}
@@ -0,0 +1,343 @@
+/*
+  test_chunkupload.cpp - resumable chunked upload and its CRC32
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include "chunkupload.h"
+#include "sdupload.h"
+#include "dirindex.h"
+#include "command.h"
+#include "bridge.h"
+#include <FS.h>
+#include <vector>
+
+//print_job runs ESP commands and prints through bridge, not used here
+bool COMMAND::execute_command(int cmd, String cmd_params, tpipe output, level_authenticate_type auth_level)
+{
+    return false;
+}
+
+void BRIDGE::println(const __FlashStringHelper * data, tpipe output) {}
+
+size_t PIPEPRINT_CLASS::write(uint8_t c)
+{
+    return 1;
+}
+
+size_t PIPEPRINT_CLASS::write(const uint8_t * data, size_t len)
+{
+    return len;
+}
+
+static uint32_t crc_of(const char * text)
+{
+    return CHUNKUPLOAD_CLASS::crc32(0, (const uint8_t *)text, strlen(text));
+}
+
+struct chunk_answer {
+    int code;
+    String status;
+    uint32_t offset;
+};
+
+//one chunk as upload handler gives it: begin, data in pieces, end
+static chunk_answer send_chunk(tchunk_target target, const char * path, uint32_t offset, uint32_t total,
+                               const std::string & data, uint32_t crc, size_t piece = 100)
+{
+    chunk_upload.begin(target, path, offset, total, crc);
+    for (size_t done = 0; done < data.size(); done += piece) {
+        size_t len = (data.size() - done < piece) ? data.size() - done : piece;
+        chunk_upload.write((const uint8_t *)data.data() + done, len);
+    }
+    chunk_upload.end();
+    chunk_answer answer = {0, "", 0};
+    const char * status = NULL;
+    if (chunk_upload.get_result(answer.code, status, answer.offset)) {
+        answer.status = status;
+    }
+    return answer;
+}
+
+static chunk_answer send_chunk(const char * path, uint32_t offset, uint32_t total, const std::string & data)
+{
+    return send_chunk(CHUNK_TARGET_SPIFFS, path, offset, total, data,
+                      CHUNKUPLOAD_CLASS::crc32(0, (const uint8_t *)data.data(), data.size()));
+}
+
+static std::string file_content(const char * path)
+{
+    FS_FILE file = SPIFFS.open(path, SPIFFS_FILE_READ);
+    std::string content;
+    if (file) {
+        content.resize(file.size());
+        file.read((uint8_t *)&content[0], content.size());
+        file.close();
+    }
+    return content;
+}
+
+static std::string test_data(size_t size)
+{
+    std::string data(size, 0);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (char)((i * 2654435761u) >> 13);
+    }
+    return data;
+}
+
+static void reset_fs()
+{
+    SPIFFS.format();
+    dir_index.build();
+}
+
+//staging file left by older firmware is not listed and is removed
+TEST(old_sd_stage_removed)
+{
+    SPIFFS.format();
+    FS_FILE file = SPIFFS.open("/sdupload.tmp", SPIFFS_FILE_WRITE);
+    file.write((const uint8_t *)"G28\n", 4);
+    file.close();
+    file = SPIFFS.open("/a.gco", SPIFFS_FILE_WRITE);
+    file.close();
+    dir_index.build();
+    CHECK(dir_index.find("/a.gco") != NULL);
+    CHECK(dir_index.find("/sdupload.tmp") == NULL);
+    CHECK(!SPIFFS.exists("/sdupload.tmp"));
+}
+
+TEST(crc32_vectors)
+{
+    CHECK_EQUAL(crc_of(""), 0);
+    CHECK_EQUAL(crc_of("123456789"), 0xCBF43926UL);
+    CHECK_EQUAL(crc_of("The quick brown fox jumps over the lazy dog"), 0x414FA339UL);
+    uint8_t zeros[32] = {0};
+    CHECK_EQUAL(CHUNKUPLOAD_CLASS::crc32(0, zeros, sizeof(zeros)), 0x190A55ADUL);
+}
+
+//crc of a chunk can be computed as data comes
+TEST(crc32_incremental)
+{
+    std::string data = test_data(1000);
+    const uint8_t * p = (const uint8_t *)data.data();
+    uint32_t whole = CHUNKUPLOAD_CLASS::crc32(0, p, data.size());
+    for (size_t cut = 0; cut <= data.size(); cut += 37) {
+        uint32_t crc = CHUNKUPLOAD_CLASS::crc32(0, p, cut);
+        crc = CHUNKUPLOAD_CLASS::crc32(crc, p + cut, data.size() - cut);
+        CHECK_EQUAL(crc, whole);
+    }
+}
+
+TEST(spiffs_chunks)
+{
+    reset_fs();
+    std::string data = test_data(2500);
+    chunk_answer a = send_chunk("/big.gco", 0, data.size(), data.substr(0, 1000));
+    CHECK_EQUAL(a.code, 200);
+    CHECK_STRING(a.status, "Ok");
+    CHECK_EQUAL(a.offset, 1000);
+    CHECK(SPIFFS.exists("/big.gco" CHUNK_UPLOAD_PART_EXT));
+    CHECK(!SPIFFS.exists("/big.gco"));
+    CHECK_EQUAL(chunk_upload.committed(CHUNK_TARGET_SPIFFS, "/big.gco"), 1000);
+    a = send_chunk("/big.gco", 1000, data.size(), data.substr(1000, 1000));
+    CHECK_EQUAL(a.offset, 2000);
+    a = send_chunk("/big.gco", 2000, data.size(), data.substr(2000));
+    CHECK_EQUAL(a.code, 200);
+    CHECK_STRING(a.status, "Upload done");
+    CHECK_EQUAL(a.offset, data.size());
+    CHECK(!SPIFFS.exists("/big.gco" CHUNK_UPLOAD_PART_EXT));
+    CHECK(file_content("/big.gco") == data);
+    CHECK(dir_index.find("/big.gco") != NULL);
+    CHECK(dir_index.find("/big.gco" CHUNK_UPLOAD_PART_EXT) == NULL);
+}
+
+//bad chunk is not written, client sends it again from committed offset
+TEST(spiffs_crc_mismatch)
+{
+    reset_fs();
+    std::string data = test_data(300);
+    send_chunk("/a.gco", 0, data.size(), data.substr(0, 100));
+    chunk_answer a = send_chunk(CHUNK_TARGET_SPIFFS, "/a.gco", 100, data.size(), data.substr(100, 100),
+                                crc_of("something else"));
+    CHECK_EQUAL(a.code, 400);
+    CHECK_STRING(a.status, "CRC mismatch");
+    CHECK_EQUAL(a.offset, 100);
+    CHECK_EQUAL(chunk_upload.committed(CHUNK_TARGET_SPIFFS, "/a.gco"), 100);
+    a = send_chunk("/a.gco", 100, data.size(), data.substr(100));
+    CHECK_STRING(a.status, "Upload done");
+    CHECK(file_content("/a.gco") == data);
+}
+
+TEST(spiffs_wrong_offset)
+{
+    reset_fs();
+    std::string data = test_data(300);
+    send_chunk("/a.gco", 0, data.size(), data.substr(0, 100));
+    //chunk already committed, answer gives where to continue
+    chunk_answer a = send_chunk("/a.gco", 50, data.size(), data.substr(50, 100));
+    CHECK_EQUAL(a.code, 409);
+    CHECK_STRING(a.status, "Wrong offset");
+    CHECK_EQUAL(a.offset, 100);
+    a = send_chunk("/a.gco", 200, data.size(), data.substr(200));
+    CHECK_EQUAL(a.code, 409);
+    CHECK_EQUAL(a.offset, 100);
+    //chunk going past announced total
+    a = send_chunk("/a.gco", 100, data.size(), data.substr(100) + "x");
+    CHECK_EQUAL(a.code, 400);
+    CHECK_STRING(a.status, "Wrong size");
+    CHECK_EQUAL(chunk_upload.committed(CHUNK_TARGET_SPIFFS, "/a.gco"), 100);
+}
+
+//total of first chunk is kept with .part, other total means another file
+TEST(spiffs_wrong_total)
+{
+    reset_fs();
+    std::string data = test_data(300);
+    send_chunk("/a.gco", 0, data.size(), data.substr(0, 100));
+    CHECK_EQUAL(chunk_upload.expected_total(CHUNK_TARGET_SPIFFS, "/a.gco"), data.size());
+    CHECK(dir_index.find("/a.gco" CHUNK_UPLOAD_SIZE_EXT) != NULL);
+    chunk_answer a = send_chunk("/a.gco", 100, 200, data.substr(100, 100));
+    CHECK_EQUAL(a.code, 409);
+    CHECK_STRING(a.status, "Wrong total");
+    CHECK_EQUAL(a.offset, 0);
+    CHECK(file_content("/a.gco" CHUNK_UPLOAD_PART_EXT) == data.substr(0, 100));
+    //.part without its total cannot be resumed
+    SPIFFS.remove("/a.gco" CHUNK_UPLOAD_SIZE_EXT);
+    a = send_chunk("/a.gco", 100, data.size(), data.substr(100, 100));
+    CHECK_STRING(a.status, "Wrong total");
+    a = send_chunk("/a.gco", 0, data.size(), data.substr(0, 200));
+    CHECK_EQUAL(a.code, 200);
+    a = send_chunk("/a.gco", 200, data.size(), data.substr(200));
+    CHECK_STRING(a.status, "Upload done");
+    CHECK(file_content("/a.gco") == data);
+    CHECK(!SPIFFS.exists("/a.gco" CHUNK_UPLOAD_SIZE_EXT));
+    CHECK(dir_index.find("/a.gco" CHUNK_UPLOAD_SIZE_EXT) == NULL);
+}
+
+//.part name must fit in SPIFFS object name
+TEST(spiffs_name_too_long)
+{
+    reset_fs();
+    std::string data = test_data(100);
+    //26 chars, 31 with .part
+    chunk_answer a = send_chunk("/abcdefghijklmnopqrstu.gco", 0, data.size(), data);
+    CHECK_EQUAL(a.code, 200);
+    a = send_chunk("/abcdefghijklmnopqrstuv.gco", 0, data.size(), data);
+    CHECK_EQUAL(a.code, 400);
+    CHECK_STRING(a.status, "File name too long");
+    CHECK_EQUAL(a.offset, 0);
+}
+
+TEST(spiffs_restart_and_replace)
+{
+    reset_fs();
+    std::string old_data = test_data(50);
+    FS_FILE file = SPIFFS.open("/a.gco", SPIFFS_FILE_WRITE);
+    file.write((const uint8_t *)old_data.data(), old_data.size());
+    file.close();
+    std::string data = test_data(300);
+    send_chunk("/a.gco", 0, data.size(), "garbage from first try");
+    //offset 0 drops .part and starts again
+    chunk_answer a = send_chunk("/a.gco", 0, data.size(), data.substr(0, 200));
+    CHECK_EQUAL(a.code, 200);
+    CHECK_EQUAL(a.offset, 200);
+    CHECK(file_content("/a.gco" CHUNK_UPLOAD_PART_EXT) == data.substr(0, 200));
+    //old file is kept until upload is complete
+    CHECK(file_content("/a.gco") == old_data);
+    a = send_chunk("/a.gco", 200, data.size(), data.substr(200));
+    CHECK_STRING(a.status, "Upload done");
+    CHECK(file_content("/a.gco") == data);
+}
+
+//connection lost during chunk: no answer, nothing written
+TEST(spiffs_abort)
+{
+    reset_fs();
+    std::string data = test_data(300);
+    send_chunk("/a.gco", 0, data.size(), data.substr(0, 100));
+    chunk_upload.begin(CHUNK_TARGET_SPIFFS, "/a.gco", 100, data.size(), 0);
+    chunk_upload.write((const uint8_t *)data.data() + 100, 50);
+    chunk_upload.abort();
+    int code;
+    const char * status;
+    uint32_t offset;
+    CHECK(!chunk_upload.get_result(code, status, offset));
+    CHECK_EQUAL(chunk_upload.committed(CHUNK_TARGET_SPIFFS, "/a.gco"), 100);
+}
+
+TEST(chunk_too_big)
+{
+    reset_fs();
+    std::string data = test_data(CHUNK_UPLOAD_MAX_SIZE + 1);
+    chunk_answer a = send_chunk("/a.gco", 0, data.size(), data);
+    CHECK_EQUAL(a.code, 413);
+    CHECK_STRING(a.status, "Chunk too big");
+    CHECK(!SPIFFS.exists("/a.gco" CHUNK_UPLOAD_PART_EXT));
+}
+
+//SD chunk belongs to sd_upload until printer has it
+TEST(sd_chunks_wait_printer)
+{
+    reset_fs();
+    std::string data = test_data(300);
+    chunk_answer a = send_chunk(CHUNK_TARGET_SD, "/a.gco", 0, data.size(), data.substr(0, 100),
+                                CHUNKUPLOAD_CLASS::crc32(0, (const uint8_t *)data.data(), 100));
+    CHECK_EQUAL(a.code, 200);
+    CHECK_EQUAL(a.offset, 100);
+    CHECK(sd_upload.active());
+    CHECK_EQUAL(chunk_upload.committed(CHUNK_TARGET_SD, "/a.gco"), 100);
+    CHECK_EQUAL(chunk_upload.committed(CHUNK_TARGET_SD, "/other.gco"), 0);
+    //first chunk is not sent yet
+    a = send_chunk(CHUNK_TARGET_SD, "/a.gco", 100, data.size(), data.substr(100, 100),
+                   CHUNKUPLOAD_CLASS::crc32(0, (const uint8_t *)data.data() + 100, 100));
+    CHECK_EQUAL(a.code, 503);
+    CHECK_STRING(a.status, "Busy");
+    CHECK_EQUAL(a.offset, 100);
+    //client waits, so upload is not closed
+    delay(CHUNK_UPLOAD_SD_TIMEOUT * 2);
+    chunk_upload.process();
+    CHECK(sd_upload.active());
+    sd_upload.abort();
+    chunk_upload.process();
+    CHECK_EQUAL(chunk_upload.committed(CHUNK_TARGET_SD, "/a.gco"), 0);
+}
+
+TEST(sd_printer_busy)
+{
+    reset_fs();
+    CHECK(sd_upload.begin("/other.gco"));
+    chunk_answer a = send_chunk(CHUNK_TARGET_SD, "/a.gco", 0, 10, "0123456789", crc_of("0123456789"));
+    CHECK_EQUAL(a.code, 409);
+    CHECK_STRING(a.status, "Printer busy");
+    sd_upload.abort();
+}
+
+BENCH(crc32_speed)
+{
+    std::string data = test_data(CHUNK_UPLOAD_MAX_SIZE);
+    const int runs = 2000;
+    uint32_t crc = 0;
+    double start = harness_seconds();
+    for (int i = 0; i < runs; i++) {
+        crc = CHUNKUPLOAD_CLASS::crc32(crc, (const uint8_t *)data.data(), data.size());
+    }
+    double elapsed = harness_seconds() - start;
+    CHECK(crc != 0);
+    harness_report("crc32, 16 entries table", (double)data.size() * runs / elapsed / 1e6, "MB/s");
+}
@@ -0,0 +1,334 @@
+/*
+  test_gcodesender.cpp - windowed sender against a simulated printer
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include "gcodesender.h"
+#include "serialout.h"
+#include <set>
+#include <vector>
+
+//printer model close to Marlin: 4 commands buffer, line numbers and
+//checksum checked on reading, a rejected line gets Error, Resend and ok
+//at once, a command gets its ok once run
+#define PRINTER_BUFSIZE 4
+//115200 bauds
+#define UART_BYTES_PER_MS 11
+#define UART_FIFO 128
+
+struct printer_command {
+    std::string line;
+    uint32_t number;
+};
+
+struct printer_sim {
+    std::string rx;
+    std::deque<printer_command> queue;
+    //commands accepted, in order
+    std::vector<std::string> done;
+    std::string answers;
+    uint32_t last_number;
+    bool running;
+    unsigned long busy_until;
+    int exec_ms;
+    //line numbers rejected on first reading, ok lost after run
+    std::set<uint32_t> corrupt;
+    std::set<uint32_t> lose_ok;
+    uint32_t rejected;
+    TOKENIZER_CLASS tokenizer;
+};
+
+static printer_sim printer;
+
+static void printer_reset(int exec_ms)
+{
+    printer.rx.clear();
+    printer.queue.clear();
+    printer.done.clear();
+    printer.answers.clear();
+    printer.last_number = 0;
+    printer.running = false;
+    printer.busy_until = 0;
+    printer.exec_ms = exec_ms;
+    printer.corrupt.clear();
+    printer.lose_ok.clear();
+    printer.rejected = 0;
+    printer.tokenizer.reset();
+    Serial.tx.clear();
+    Serial.room = UART_FIFO;
+    harness_firmware = MARLIN;
+    //forget oks expected by previous test
+    tline_event wait;
+    wait.type = LINE_WAIT;
+    serial_out.check_response(wait);
+}
+
+static void printer_reject(const char * error)
+{
+    char answer[100];
+    snprintf(answer, sizeof(answer), "Error:%s, Last Line: %lu\nResend: %lu\nok\n", error,
+             (unsigned long)printer.last_number, (unsigned long)printer.last_number + 1);
+    printer.answers += answer;
+    printer.rejected++;
+}
+
+static void printer_read(const std::string & line)
+{
+    printer_command command;
+    command.number = 0xFFFFFFFF;
+    command.line = line;
+    if (line[0] == 'N') {
+        size_t space = line.find(' ');
+        size_t star = line.rfind('*');
+        if ((space == std::string::npos) || (star == std::string::npos)) {
+            printer_reject("No Checksum with line number");
+            return;
+        }
+        uint8_t checksum = 0;
+        for (size_t i = 0; i < star; i++) {
+            checksum ^= line[i];
+        }
+        command.number = strtoul(line.c_str() + 1, NULL, 10);
+        command.line = line.substr(space + 1, star - space - 1);
+        bool m110 = (command.line.compare(0, 4, "M110") == 0);
+        if (!m110 && (command.number != printer.last_number + 1)) {
+            printer_reject("Line Number is not Last Line Number+1");
+            return;
+        }
+        if ((checksum != (uint8_t)atoi(line.c_str() + star + 1)) || printer.corrupt.erase(command.number)) {
+            printer_reject("checksum mismatch");
+            return;
+        }
+        printer.last_number = command.number;
+    }
+    printer.queue.push_back(command);
+}
+
+//one ms: UART moves, printer reads when it has room and runs commands,
+//then answers go through tokenizer like command.cpp does
+static void tick()
+{
+    size_t len = std::min(Serial.tx.size(), (size_t)UART_BYTES_PER_MS);
+    printer.rx.append(Serial.tx, 0, len);
+    Serial.tx.erase(0, len);
+    Serial.room = UART_FIFO - Serial.tx.size();
+    serial_out.process();
+    size_t eol;
+    while ((printer.queue.size() < PRINTER_BUFSIZE) && ((eol = printer.rx.find('\n')) != std::string::npos)) {
+        std::string line = printer.rx.substr(0, eol);
+        printer.rx.erase(0, eol + 1);
+        if (!line.empty()) {
+            printer_read(line);
+        }
+    }
+    while (!printer.queue.empty()) {
+        if (!printer.running) {
+            printer.running = true;
+            printer.busy_until = millis() + printer.exec_ms;
+        }
+        if (millis() < printer.busy_until) {
+            break;
+        }
+        printer_command & command = printer.queue.front();
+        printer.done.push_back(command.line);
+        if (!printer.lose_ok.erase(command.number)) {
+            printer.answers += (command.line == "M105") ? "ok T:20.0 /0.0 B:20.0 /0.0\n" : "ok\n";
+        }
+        printer.queue.pop_front();
+        printer.running = false;
+    }
+    const uint8_t * data = (const uint8_t *)printer.answers.data();
+    size_t size = printer.answers.size();
+    tline_event event;
+    while (printer.tokenizer.feed(data, size, event)) {
+        serial_out.check_response(event);
+        gcode_sender.check_response(event);
+    }
+    printer.answers.clear();
+    host_millis++;
+}
+
+//send lines like sd_upload does, M105 every ms_m105 if not 0
+//stop_and_wait only sends when previous line is confirmed
+static unsigned long stream(int lines, bool stop_and_wait = false, int ms_m105 = 0)
+{
+    unsigned long start = millis();
+    int sent = 0;
+    gcode_sender.begin(true);
+    while (((sent < lines) || !gcode_sender.idle()) && !gcode_sender.error()) {
+        while ((sent < lines) && gcode_sender.can_send() && (!stop_and_wait || gcode_sender.idle())) {
+            char line[32];
+            snprintf(line, sizeof(line), "G1 X%d", sent);
+            gcode_sender.send(line);
+            sent++;
+        }
+        gcode_sender.check_timeout();
+        if (ms_m105 && ((millis() % ms_m105) == 0)) {
+            serial_out.command("M105");
+        }
+        tick();
+        if ((millis() - start) > 600000) {
+            break;
+        }
+    }
+    gcode_sender.end();
+    //lines confirmed early may still be in UART or printer buffer
+    while (!Serial.tx.empty() || !printer.rx.empty() || !printer.queue.empty() || serial_out.pending(PRIO_BULK)) {
+        tick();
+    }
+    return millis() - start;
+}
+
+//every line ran once and in order, M105 are not counted
+static bool ran_in_order(int lines)
+{
+    std::vector<std::string> expected;
+    expected.push_back("M110 N0");
+    for (int i = 0; i < lines; i++) {
+        char line[32];
+        snprintf(line, sizeof(line), "G1 X%d", i);
+        expected.push_back(line);
+    }
+    std::vector<std::string> ran;
+    for (size_t i = 0; i < printer.done.size(); i++) {
+        if (printer.done[i] != "M105") {
+            ran.push_back(printer.done[i]);
+        }
+    }
+    return ran == expected;
+}
+
+TEST(lines_run_in_order)
+{
+    printer_reset(2);
+    stream(100);
+    CHECK(!gcode_sender.error());
+    CHECK(ran_in_order(100));
+    CHECK_EQUAL(printer.rejected, 0);
+    CHECK_EQUAL(serial_out.pending(PRIO_BULK), 0);
+}
+
+TEST(checksum_error_is_resent)
+{
+    printer_reset(2);
+    printer.corrupt.insert(10);
+    stream(100);
+    CHECK(!gcode_sender.error());
+    CHECK(ran_in_order(100));
+    //line 10 and lines written after it before Resend came back
+    CHECK(printer.rejected > 1);
+}
+
+TEST(errors_close_together)
+{
+    printer_reset(1);
+    printer.corrupt.insert(3);
+    printer.corrupt.insert(4);
+    printer.corrupt.insert(7);
+    printer.corrupt.insert(50);
+    stream(100);
+    CHECK(!gcode_sender.error());
+    CHECK(ran_in_order(100));
+}
+
+TEST(lost_ok_is_recovered_after_timeout)
+{
+    printer_reset(2);
+    printer.lose_ok.insert(20);
+    unsigned long ms = stream(40);
+    CHECK(!gcode_sender.error());
+    CHECK(ran_in_order(40));
+    CHECK(ms >= SENDER_TIMEOUT);
+}
+
+TEST(last_ok_lost)
+{
+    printer_reset(2);
+    printer.lose_ok.insert(40);
+    stream(40);
+    CHECK(!gcode_sender.error());
+    CHECK(ran_in_order(40));
+}
+
+TEST(interactive_oks_are_not_counted)
+{
+    printer_reset(3);
+    uint32_t before = serial_out.acks(PRIO_INTERACTIVE);
+    stream(200, false, 25);
+    CHECK(!gcode_sender.error());
+    CHECK(ran_in_order(200));
+    size_t m105 = std::count(printer.done.begin(), printer.done.end(), std::string("M105"));
+    CHECK(m105 > 0);
+    CHECK_EQUAL(serial_out.acks(PRIO_INTERACTIVE) - before, m105);
+}
+
+TEST(wrong_resend_is_an_error)
+{
+    printer_reset(2);
+    gcode_sender.begin(true);
+    gcode_sender.send("G28");
+    tick();
+    tline_event event;
+    const uint8_t * data = (const uint8_t *)"Resend: 1000\n";
+    size_t len = strlen((const char *)data);
+    TOKENIZER_CLASS tokenizer;
+    CHECK(tokenizer.feed(data, len, event));
+    gcode_sender.check_response(event);
+    CHECK(gcode_sender.error());
+    CHECK(!gcode_sender.can_send());
+    gcode_sender.end();
+    while (!printer.queue.empty() || serial_out.pending(PRIO_BULK)) {
+        tick();
+    }
+}
+
+//virtual time, so result is lines per second of printer, not of host
+static void compare(int exec_ms)
+{
+    char name[64];
+    printer_reset(exec_ms);
+    double windowed = 2000.0 * 1000 / stream(2000);
+    CHECK(ran_in_order(2000));
+    printer_reset(exec_ms);
+    double single = 2000.0 * 1000 / stream(2000, true);
+    CHECK(ran_in_order(2000));
+    printf("  %d ms per command\n", exec_ms);
+    snprintf(name, sizeof(name), "window of %d lines", SENDER_WINDOW);
+    harness_report(name, windowed, "lines/s");
+    harness_report("stop and wait", single, "lines/s");
+}
+
+BENCH(short_moves)
+{
+    compare(0);
+    compare(2);
+    compare(5);
+}
+
+BENCH(with_checksum_errors)
+{
+    printer_reset(2);
+    for (uint32_t n = 50; n < 2000; n += 100) {
+        printer.corrupt.insert(n);
+    }
+    double windowed = 2000.0 * 1000 / stream(2000);
+    CHECK(ran_in_order(2000));
+    harness_report("1 line of 100 rejected", windowed, "lines/s");
+    harness_report("lines rejected", printer.rejected, "");
+}
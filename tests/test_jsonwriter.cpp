@@ -0,0 +1,301 @@
+/*
+  test_jsonwriter.cpp - streaming json writer used by file lists
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include "jsonwriter.h"
+
+//same size as one TCP segment, like response writer chunks
+#define SINK_SIZE 1460
+
+//fixed buffer flushed when full, like response writer sends chunks
+class chunk_sink : public Print
+{
+public:
+    chunk_sink() : len(0), sent(0), chunks(0), hash(5381) {}
+    size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t * data, size_t size)
+    {
+        for (size_t done = 0; done < size;) {
+            size_t room = SINK_SIZE - len;
+            if (room > size - done) {
+                room = size - done;
+            }
+            memcpy(buffer + len, data + done, room);
+            len += room;
+            done += room;
+            if (len == SINK_SIZE) {
+                flush();
+            }
+        }
+        return size;
+    }
+    using Print::write;
+    void flush()
+    {
+        for (size_t i = 0; i < len; i++) {
+            hash = hash * 33 + buffer[i];
+        }
+        sent += len;
+        if (len) {
+            chunks++;
+        }
+        len = 0;
+    }
+    uint8_t buffer[SINK_SIZE];
+    size_t len;
+    size_t sent;
+    size_t chunks;
+    //to check both listings give same text without keeping it
+    uint32_t hash;
+};
+
+static uint32_t text_hash(const String & text)
+{
+    uint32_t hash = 5381;
+    for (size_t i = 0; i < text.length(); i++) {
+        hash = hash * 33 + (uint8_t)text[i];
+    }
+    return hash;
+}
+
+TEST(empty_containers)
+{
+    String out;
+    STRINGPRINT_CLASS print(out);
+    JSONWRITER_CLASS json(print);
+    json.begin_object();
+    json.begin_array("files");
+    json.end_array();
+    json.begin_object("info");
+    json.end_object();
+    json.end_object();
+    CHECK_STRING(out, "{\"files\":[],\"info\":{}}");
+}
+
+TEST(commas_and_nesting)
+{
+    String out;
+    STRINGPRINT_CLASS print(out);
+    JSONWRITER_CLASS json(print);
+    json.begin_object();
+    json.begin_array("files");
+    json.begin_object();
+    json.add("name", "a.gco");
+    json.add("size", "1 KB");
+    json.end_object();
+    json.begin_object();
+    json.add("name", "b");
+    json.begin_array("list");
+    json.add(NULL, "x");
+    json.add_int(NULL, 2);
+    json.begin_array();
+    json.end_array();
+    json.end_array();
+    json.end_object();
+    json.end_array();
+    json.add("path", "/");
+    json.end_object();
+    CHECK_STRING(out, "{\"files\":[{\"name\":\"a.gco\",\"size\":\"1 KB\"},"
+                 "{\"name\":\"b\",\"list\":[\"x\",2,[]]}],\"path\":\"/\"}");
+}
+
+TEST(escaping)
+{
+    String out;
+    STRINGPRINT_CLASS print(out);
+    JSONWRITER_CLASS::escape(print, "plain");
+    CHECK_STRING(out, "plain");
+    out = "";
+    JSONWRITER_CLASS::escape(print, "a\"b\\c\nd\re\tf");
+    CHECK_STRING(out, "a\\\"b\\\\c\\nd\\re\\tf");
+    out = "";
+    JSONWRITER_CLASS::escape(print, "\x01x\x1f");
+    CHECK_STRING(out, "\\u0001x\\u001f");
+    //utf-8 is kept as it is
+    out = "";
+    JSONWRITER_CLASS::escape(print, "\xc3\xa9t\xc3\xa9");
+    CHECK_STRING(out, "\xc3\xa9t\xc3\xa9");
+    //special char first and last
+    out = "";
+    JSONWRITER_CLASS::escape(print, "\"\"");
+    CHECK_STRING(out, "\\\"\\\"");
+}
+
+TEST(values)
+{
+    String out;
+    STRINGPRINT_CLASS print(out);
+    JSONWRITER_CLASS json(print);
+    json.begin_object();
+    json.add_int("neg", -2147483647L - 1);
+    json.add_uint("big", 4294967295UL);
+    json.add_int("zero", 0);
+    json.add_bool("on", true);
+    json.add_bool("off", false);
+    json.add("none", (const char *)NULL);
+    json.add("name", String("my \"file\""));
+    json.end_object();
+    CHECK_STRING(out, "{\"neg\":-2147483648,\"big\":4294967295,\"zero\":0,"
+                 "\"on\":true,\"off\":false,\"none\":\"\",\"name\":\"my \\\"file\\\"\"}");
+}
+
+//deeper levels than JSON_MAX_DEPTH are kept on last one, so output stays balanced
+TEST(depth_limit)
+{
+    String out;
+    STRINGPRINT_CLASS print(out);
+    JSONWRITER_CLASS json(print);
+    for (int i = 0; i < JSON_MAX_DEPTH + 2; i++) {
+        json.begin_array();
+    }
+    for (int i = 0; i < JSON_MAX_DEPTH + 2; i++) {
+        json.end_array();
+    }
+    CHECK_EQUAL(out.length(), 2 * (JSON_MAX_DEPTH + 2));
+    CHECK_EQUAL(out.indexOf("],"), -1);
+    json.begin_object();
+    json.end_object();
+    CHECK_STRING(out.substring(out.length() - 4), "],{}");
+}
+
+TEST(sink_chunks)
+{
+    chunk_sink sink;
+    JSONWRITER_CLASS json(sink);
+    String expected;
+    STRINGPRINT_CLASS print(expected);
+    JSONWRITER_CLASS reference(print);
+    json.begin_array();
+    reference.begin_array();
+    for (int i = 0; i < 300; i++) {
+        json.add_int(NULL, i);
+        reference.add_int(NULL, i);
+    }
+    json.end_array();
+    reference.end_array();
+    sink.flush();
+    CHECK_EQUAL(sink.sent, expected.length());
+    CHECK_EQUAL(sink.hash, text_hash(expected));
+    CHECK(sink.chunks > 0);
+}
+
+#define LIST_ENTRIES 500
+
+static String entry_name(int i)
+{
+    char name[40];
+    snprintf(name, sizeof(name), "part_%03d_layer_height_0.2.gco", i);
+    return String(name);
+}
+
+static String entry_size(int i)
+{
+    return String((i * 7919) % 100000 / 1024.0) + " KB";
+}
+
+//list built in a String, then sent in one piece like handleFileList did
+static uint32_t legacy_list(size_t & length)
+{
+    String jsonfile = "{";
+    jsonfile += "\"files\":[";
+    for (int i = 0; i < LIST_ENTRIES; i++) {
+        if (i) {
+            jsonfile += ",";
+        }
+        jsonfile += "{";
+        jsonfile += "\"name\":\"";
+        jsonfile += entry_name(i);
+        jsonfile += "\",\"size\":\"";
+        jsonfile += entry_size(i);
+        jsonfile += "\"";
+        jsonfile += "}";
+    }
+    jsonfile += "],";
+    jsonfile += "\"path\":\"/\",";
+    jsonfile += "\"status\":\"Ok\",";
+    jsonfile += "\"total\":\"1.00 MB\",";
+    jsonfile += "\"used\":\"512.00 KB\",";
+    jsonfile += "\"occupation\":\"50\"";
+    jsonfile += "}";
+    length = jsonfile.length();
+    return text_hash(jsonfile);
+}
+
+//same list written as it is built
+static uint32_t streamed_list(size_t & length)
+{
+    chunk_sink sink;
+    JSONWRITER_CLASS json(sink);
+    json.begin_object();
+    json.begin_array("files");
+    for (int i = 0; i < LIST_ENTRIES; i++) {
+        json.begin_object();
+        json.add("name", entry_name(i));
+        json.add("size", entry_size(i));
+        json.end_object();
+    }
+    json.end_array();
+    json.add("path", "/");
+    json.add("status", "Ok");
+    json.add("total", "1.00 MB");
+    json.add("used", "512.00 KB");
+    json.add("occupation", "50");
+    json.end_object();
+    sink.flush();
+    length = sink.sent;
+    return sink.hash;
+}
+
+TEST(listing_same_text)
+{
+    size_t legacy_length;
+    size_t streamed_length;
+    uint32_t legacy = legacy_list(legacy_length);
+    uint32_t streamed = streamed_list(streamed_length);
+    CHECK_EQUAL(legacy_length, streamed_length);
+    CHECK_EQUAL(legacy, streamed);
+}
+
+static void list_bench(const char * name, uint32_t (*list)(size_t &))
+{
+    const int runs = 200;
+    size_t length = 0;
+    harness_heap_reset();
+    list(length);
+    harness_heap heap = harness_heap_get();
+    double start = harness_seconds();
+    for (int i = 0; i < runs; i++) {
+        list(length);
+    }
+    double elapsed = harness_seconds() - start;
+    printf("  %s, %u bytes\n", name, (unsigned int)length);
+    harness_report("peak heap", heap.peak, "bytes");
+    harness_report("allocations", heap.allocations, "");
+    harness_report("time per list", elapsed / runs * 1e6, "us");
+}
+
+BENCH(listing_500_entries)
+{
+    list_bench("String concatenation", legacy_list);
+    list_bench("json writer + 1460 bytes chunks", streamed_list);
+}
@@ -0,0 +1,307 @@
+/*
+  test_multipart.cpp - multipart upload parsing of WebServer
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include <WebServer.h>
+#include <WiFiServer.h>
+#include <vector>
+
+#define BOUNDARY "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+
+//what upload handler was given
+struct upload_log {
+    std::string data;
+    std::vector<int> statuses;
+    size_t calls;
+    size_t total;
+    String filename;
+};
+
+struct upload_server {
+    upload_server() : server(80), keep(true)
+    {
+        server.on("/upload", HTTP_POST, [this]() {
+            server.send(200, "text/plain", server.arg("path"));
+        }, [this]() {
+            HTTPUpload & upload = server.upload();
+            if (upload.status == UPLOAD_FILE_START) {
+                files.push_back(upload_log());
+                files.back().calls = 0;
+                files.back().filename = upload.filename;
+            }
+            upload_log & log = files.back();
+            log.statuses.push_back(upload.status);
+            if (upload.status == UPLOAD_FILE_WRITE) {
+                log.calls++;
+                if (keep) {
+                    log.data.append((const char *)upload.buf, upload.currentSize);
+                } else {
+                    log.total += upload.currentSize;
+                }
+            }
+            if (upload.status == UPLOAD_FILE_END) {
+                log.total = upload.totalSize;
+            }
+        });
+        server.begin();
+    }
+    WebServer server;
+    std::vector<upload_log> files;
+    //benchmark only counts bytes
+    bool keep;
+};
+
+static std::string part_field(const char * name, const char * value)
+{
+    return std::string("--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"") + name +
+           "\"\r\n\r\n" + value + "\r\n";
+}
+
+static std::string part_file(const char * name, const std::string & content)
+{
+    return std::string("--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"myfile[]\"; filename=\"") +
+           name + "\"\r\nContent-Type: application/octet-stream\r\n\r\n" + content + "\r\n";
+}
+
+//whole request is written before server reads it, then client may leave
+static std::string post(upload_server & t, const std::string & body, bool leave = false)
+{
+    WiFiClient client = WiFiServer::connect(80);
+    char header[200];
+    snprintf(header, sizeof(header), "POST /upload HTTP/1.1\r\nHost: esp3d\r\n"
+             "Content-Type: multipart/form-data; boundary=" BOUNDARY "\r\nContent-Length: %u\r\n\r\n",
+             (unsigned int)body.size());
+    client.write((const uint8_t *)header, strlen(header));
+    client.write((const uint8_t *)body.data(), body.size());
+    if (leave) {
+        client.stop();
+    }
+    t.server.handleClient();
+    std::string answer;
+    while (client.available()) {
+        answer += (char)client.read();
+    }
+    return answer;
+}
+
+static const std::string end_mark = "--" BOUNDARY "--\r\n";
+
+TEST(small_file_and_fields)
+{
+    upload_server t;
+    std::string answer = post(t, part_field("path", "/sd") + part_file("a.gco", "G28\nG1 X10\n") +
+                              part_field("size", "12") + end_mark);
+    CHECK(answer.find("200 OK") != std::string::npos);
+    CHECK(answer.find("/sd") != std::string::npos);
+    CHECK_EQUAL(t.files.size(), 1);
+    CHECK_STRING(t.files[0].filename, "a.gco");
+    CHECK(t.files[0].data == "G28\nG1 X10\n");
+    CHECK_EQUAL(t.files[0].total, 11);
+    CHECK_EQUAL(t.files[0].statuses.front(), UPLOAD_FILE_START);
+    CHECK_EQUAL(t.files[0].statuses.back(), UPLOAD_FILE_END);
+    CHECK(t.server.hasArg("size"));
+    CHECK_STRING(t.server.arg("size"), "12");
+}
+
+TEST(content_looking_like_boundary)
+{
+    upload_server t;
+    //boundary without \r\n before, or cut, or with a wrong last byte
+    std::string content = "--" BOUNDARY "\r\n--\r\n-" "\r\n--" "----WebKit\r\n\r\n";
+    content += "\r\n--" + std::string(BOUNDARY).substr(0, strlen(BOUNDARY) - 1) + "X\r\n--";
+    post(t, part_file("tricky.bin", content) + end_mark);
+    CHECK_EQUAL(t.files.size(), 1);
+    CHECK(t.files[0].data == content);
+}
+
+TEST(broken_form_is_refused)
+{
+    upload_server t;
+    //file never ends, server does not wait past Content-Length for more
+    unsigned long start = millis();
+    std::string answer = post(t, part_file("a.txt", "aaa") + "garbage\r\n\r\n");
+    CHECK(answer.empty());
+    CHECK_EQUAL(t.files[0].statuses.back(), UPLOAD_FILE_ABORTED);
+    CHECK(millis() - start < HTTP_MAX_POST_WAIT);
+    //value not ended when connection is lost
+    post(t, part_field("path", "/sd"), true);
+    CHECK(!t.server.hasArg("path"));
+}
+
+//next request on same connection is not read as form data
+TEST(pipelined_request_is_kept)
+{
+    upload_server t;
+    t.server.on("/status", HTTP_GET, [&]() {
+        t.server.send(200, "text/plain", "idle");
+    });
+    std::string body = part_field("path", "/sd") + part_file("a.gco", "G28\n") + end_mark;
+    WiFiClient client = WiFiServer::connect(80);
+    char header[200];
+    snprintf(header, sizeof(header), "POST /upload HTTP/1.1\r\nHost: esp3d\r\n"
+             "Content-Type: multipart/form-data; boundary=" BOUNDARY "\r\nContent-Length: %u\r\n\r\n",
+             (unsigned int)body.size());
+    std::string requests = header + body + "GET /status HTTP/1.1\r\nHost: esp3d\r\n\r\n";
+    client.write((const uint8_t *)requests.data(), requests.size());
+    t.server.handleClient();
+    t.server.handleClient();
+    std::string answer;
+    while (client.available()) {
+        answer += (char)client.read();
+    }
+    CHECK(t.files.size() == 1);
+    CHECK(t.files[0].data == "G28\n");
+    CHECK(answer.find("/sd") != std::string::npos);
+    CHECK(answer.find("idle") != std::string::npos);
+}
+
+TEST(empty_file_and_two_files)
+{
+    upload_server t;
+    post(t, part_file("empty.txt", "") + part_file("b.txt", "bbb") + end_mark);
+    CHECK_EQUAL(t.files.size(), 2);
+    CHECK(t.files[0].data.empty());
+    CHECK_EQUAL(t.files[0].calls, 0);
+    CHECK(t.files[1].data == "bbb");
+}
+
+//delimiter is cut at every place by end of upload buffer
+TEST(delimiter_across_buffer_end)
+{
+    for (size_t size = HTTP_UPLOAD_BUFLEN - 300; size < HTTP_UPLOAD_BUFLEN + 100; size++) {
+        upload_server t;
+        std::string content;
+        for (size_t i = 0; i < size; i++) {
+            content += (char)(i * 7);
+        }
+        post(t, part_file("f.bin", content) + end_mark);
+        if ((t.files.size() != 1) || (t.files[0].data != content)) {
+            CHECK_EQUAL(size, 0);
+            break;
+        }
+    }
+}
+
+TEST(large_binary_file)
+{
+    upload_server t;
+    std::string content;
+    for (size_t i = 0; i < 100000; i++) {
+        content += (char)((i * 2654435761u) >> 13);
+    }
+    post(t, part_file("firmware.bin", content) + part_field("path", "/") + end_mark);
+    CHECK_EQUAL(t.files.size(), 1);
+    CHECK(t.files[0].data == content);
+    CHECK_EQUAL(t.files[0].total, content.size());
+    //handler gets full buffers, not bytes
+    CHECK(t.files[0].calls <= (content.size() / (HTTP_UPLOAD_BUFLEN / 2)) + 1);
+    CHECK_STRING(t.server.arg("path"), "/");
+}
+
+TEST(connection_lost_aborts)
+{
+    upload_server t;
+    std::string body = part_file("cut.bin", std::string(5000, 'x'));
+    WiFiClient client = WiFiServer::connect(80);
+    char header[200];
+    snprintf(header, sizeof(header), "POST /upload HTTP/1.1\r\nHost: esp3d\r\n"
+             "Content-Type: multipart/form-data; boundary=" BOUNDARY "\r\nContent-Length: %u\r\n\r\n",
+             (unsigned int)body.size() + 1000);
+    client.write((const uint8_t *)header, strlen(header));
+    client.write((const uint8_t *)body.data(), 3000);
+    client.stop();
+    t.server.handleClient();
+    CHECK_EQUAL(t.files.size(), 1);
+    CHECK_EQUAL(t.files[0].statuses.back(), UPLOAD_FILE_ABORTED);
+}
+
+//previous parser: one client.read() and one buffer write per byte,
+//checking each \r\n-- against boundary
+static size_t legacy_parse(WiFiClient & client, const String & boundary, uint8_t * buf, size_t buflen)
+{
+    size_t total = 0;
+    size_t current = 0;
+    std::string end;
+    while (client.available()) {
+        uint8_t b = client.read();
+        if ((b == '\r') && (client.peek() == '\n')) {
+            client.read();
+            if ((client.peek() == '-')) {
+                client.read();
+                if (client.peek() == '-') {
+                    client.read();
+                    uint8_t endbuf[80];
+                    client.readBytes(endbuf, boundary.length());
+                    if (memcmp(endbuf, boundary.c_str(), boundary.length()) == 0) {
+                        return total + current;
+                    }
+                }
+            }
+        }
+        if (current == buflen) {
+            total += current;
+            current = 0;
+        }
+        buf[current++] = b;
+    }
+    return total + current;
+}
+
+static void upload(size_t size)
+{
+    std::string content(size, 0);
+    for (size_t i = 0; i < size; i++) {
+        content[i] = (char)((i * 2654435761u) >> 13);
+    }
+    std::string body = part_file("big.bin", content) + end_mark;
+    upload_server t;
+    t.keep = false;
+    WiFiClient client = WiFiServer::connect(80);
+    char header[200];
+    snprintf(header, sizeof(header), "POST /upload HTTP/1.1\r\nHost: esp3d\r\n"
+             "Content-Type: multipart/form-data; boundary=" BOUNDARY "\r\nContent-Length: %u\r\n\r\n",
+             (unsigned int)body.size());
+    client.write((const uint8_t *)header, strlen(header));
+    client.write((const uint8_t *)body.data(), body.size());
+    double start = harness_seconds();
+    t.server.handleClient();
+    double elapsed = harness_seconds() - start;
+    CHECK_EQUAL(t.files.size(), 1);
+    CHECK_EQUAL(t.files[0].total, size);
+    printf("  %u MB body\n", (unsigned int)(size >> 20));
+    harness_report("block read + Horspool", size / elapsed / 1e6, "MB/s");
+    harness_report("upload callbacks", t.files[0].calls, "");
+
+    client = WiFiServer::connect(80);
+    WiFiClient server_side = WiFiServer(80).available();
+    client.write((const uint8_t *)body.data(), body.size());
+    std::vector<uint8_t> buf(HTTP_UPLOAD_BUFLEN);
+    start = harness_seconds();
+    size_t got = legacy_parse(server_side, BOUNDARY, &buf[0], buf.size());
+    elapsed = harness_seconds() - start;
+    CHECK(got > size);
+    harness_report("byte per byte", size / elapsed / 1e6, "MB/s");
+}
+
+BENCH(upload_speed)
+{
+    upload(1 << 20);
+    upload(10 << 20);
+}
@@ -0,0 +1,244 @@
+/*
+  test_ringbuffer.cpp - serial ring shared by UART readers
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include "ringbuffer.h"
+
+//copy data in ring like UART read does, return what was taken
+static size_t put(RINGBUFFER_CLASS & ring, const char * text, size_t len)
+{
+    size_t done = 0;
+    while (done < len) {
+        uint8_t * space;
+        size_t room = ring.write_space(&space);
+        if (room == 0) {
+            break;
+        }
+        if (room > len - done) {
+            room = len - done;
+        }
+        memcpy(space, text + done, room);
+        ring.commit(room);
+        done += room;
+    }
+    return done;
+}
+
+static size_t put(RINGBUFFER_CLASS & ring, const char * text)
+{
+    return put(ring, text, strlen(text));
+}
+
+//read everything reader has, in as many pieces as needed
+static String take(RINGBUFFER_CLASS & ring, uint8_t reader)
+{
+    String s;
+    const uint8_t * data;
+    size_t len;
+    while ((len = ring.peek(reader, &data)) > 0) {
+        s += String(std::string((const char *)data, len));
+        ring.consume(reader, len);
+    }
+    return s;
+}
+
+TEST(reader_starts_at_current_data)
+{
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    put(ring, "ok\n");
+    ring.attach(RING_READER_TCP);
+    put(ring, "T:20\n");
+    CHECK_STRING(take(ring, RING_READER_COMMAND), "ok\nT:20\n");
+    CHECK_STRING(take(ring, RING_READER_TCP), "T:20\n");
+    CHECK_EQUAL(ring.available(RING_READER_TCP + 1), 0);
+}
+
+TEST(each_reader_has_its_own_cursor)
+{
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    ring.attach(RING_READER_TCP, true);
+    put(ring, "echo:SD card ok\n");
+    const uint8_t * data;
+    CHECK_EQUAL(ring.peek(RING_READER_COMMAND, &data), 16);
+    ring.consume(RING_READER_COMMAND, 5);
+    CHECK_EQUAL(ring.available(RING_READER_COMMAND), 11);
+    CHECK_EQUAL(ring.available(RING_READER_TCP), 16);
+    //peek gives ring memory, nothing is copied
+    const uint8_t * again;
+    ring.peek(RING_READER_TCP, &again);
+    CHECK(again + 5 == data + 5);
+    CHECK_STRING(take(ring, RING_READER_COMMAND), "SD card ok\n");
+}
+
+TEST(data_wraps_in_two_pieces)
+{
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    char fill[SERIAL_RING_SIZE - 10];
+    memset(fill, 'x', sizeof(fill));
+    CHECK_EQUAL(put(ring, fill, sizeof(fill)), sizeof(fill));
+    take(ring, RING_READER_COMMAND);
+    put(ring, "T:210.0 /210.0 B:60.0 /60.0\n");
+    const uint8_t * data;
+    //first piece stops at end of buffer
+    CHECK_EQUAL(ring.peek(RING_READER_COMMAND, &data), 10);
+    CHECK_STRING(take(ring, RING_READER_COMMAND), "T:210.0 /210.0 B:60.0 /60.0\n");
+}
+
+TEST(lossless_reader_holds_writer)
+{
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    char fill[SERIAL_RING_SIZE + 100];
+    memset(fill, 'a', sizeof(fill));
+    CHECK_EQUAL(put(ring, fill, sizeof(fill)), SERIAL_RING_SIZE);
+    uint8_t * space;
+    CHECK_EQUAL(ring.write_space(&space), 0);
+    ring.consume(RING_READER_COMMAND, 100);
+    CHECK_EQUAL(ring.write_space(&space), 100);
+    CHECK_EQUAL(ring.dropped(RING_READER_COMMAND), 0);
+}
+
+TEST(lossy_reader_is_overrun)
+{
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_TCP, true);
+    char fill[SERIAL_RING_SIZE];
+    memset(fill, 'a', sizeof(fill));
+    put(ring, fill, sizeof(fill));
+    put(ring, "ok\nok\n");
+    //writer never waits for it, it skips what it missed
+    CHECK_EQUAL(ring.available(RING_READER_TCP), SERIAL_RING_SIZE);
+    CHECK_EQUAL(ring.dropped(RING_READER_TCP), 6);
+    String s = take(ring, RING_READER_TCP);
+    CHECK(s.endsWith("ok\nok\n"));
+}
+
+TEST(detached_reader_frees_writer)
+{
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    ring.attach(RING_READER_TCP);
+    char fill[SERIAL_RING_SIZE];
+    memset(fill, 'a', sizeof(fill));
+    put(ring, fill, sizeof(fill));
+    take(ring, RING_READER_COMMAND);
+    uint8_t * space;
+    CHECK_EQUAL(ring.write_space(&space), 0);
+    ring.detach(RING_READER_TCP);
+    CHECK(!ring.attached(RING_READER_TCP));
+    CHECK(ring.write_space(&space) > 0);
+}
+
+TEST(clear_drops_pending_data)
+{
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    ring.attach(RING_READER_TCP);
+    put(ring, "Begin file list\n");
+    ring.clear();
+    CHECK_EQUAL(ring.available(RING_READER_COMMAND), 0);
+    CHECK_EQUAL(ring.available(RING_READER_TCP), 0);
+}
+
+//printer output like M20 listing and temperature reports, cut in UART bursts
+static std::string marlin_output(size_t size)
+{
+    std::string out;
+    unsigned int n = 0;
+    while (out.size() < size) {
+        char line[96];
+        switch (n % 4) {
+        case 0:
+            snprintf(line, sizeof(line), "T:%u.%u /210.0 B:%u.0 /60.0 T0:%u.0 /210.0 @:127 B@:0\n", 200 + n % 10, n % 10, 50 + n % 10, 200 + n % 10);
+            break;
+        case 1:
+            snprintf(line, sizeof(line), "PART_%05u.GCO %u\n", n, 100000 + n);
+            break;
+        case 2:
+            snprintf(line, sizeof(line), "echo:busy: processing\n");
+            break;
+        default:
+            snprintf(line, sizeof(line), "ok\n");
+            break;
+        }
+        out += line;
+        n++;
+    }
+    return out;
+}
+
+//UART fills ring by bursts, command reader and 4 data port clients read it
+BENCH(fan_out_to_readers)
+{
+    std::string out = marlin_output(8 << 20);
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    for (uint8_t i = 0; i < 4; i++) {
+        ring.attach(RING_READER_TCP + i, true);
+    }
+    size_t pos = 0;
+    size_t burst = 0;
+    size_t read = 0;
+    double start = harness_seconds();
+    while (pos < out.size()) {
+        //bursts from 1 to 256 bytes, like UART FIFO reads
+        burst = (burst * 7 + 13) % 256 + 1;
+        if (burst > out.size() - pos) {
+            burst = out.size() - pos;
+        }
+        pos += put(ring, out.data() + pos, burst);
+        for (uint8_t r = 0; r < RING_READER_TCP + 4; r++) {
+            const uint8_t * data;
+            size_t len;
+            while ((len = ring.peek(r, &data)) > 0) {
+                read += len;
+                ring.consume(r, len);
+            }
+        }
+    }
+    double elapsed = harness_seconds() - start;
+    harness_report("UART to 5 readers", out.size() / elapsed / 1e6, "MB/s");
+    harness_report("bytes read by all readers", read / 1e6, "MB");
+}
+
+//a slow data port client misses data, command reader never does
+BENCH(slow_client_is_overrun)
+{
+    std::string out = marlin_output(1 << 20);
+    RINGBUFFER_CLASS ring;
+    ring.attach(RING_READER_COMMAND);
+    ring.attach(RING_READER_TCP, true);
+    size_t pos = 0;
+    size_t command = 0;
+    size_t n = 0;
+    while (pos < out.size()) {
+        pos += put(ring, out.data() + pos, (out.size() - pos < 128) ? out.size() - pos : 128);
+        command += take(ring, RING_READER_COMMAND).length();
+        //client reads once every 16 bursts
+        if ((++n % 16) == 0) {
+            take(ring, RING_READER_TCP);
+        }
+    }
+    harness_report("command reader got", 100.0 * command / out.size(), "%");
+    harness_report("slow client dropped", ring.dropped(RING_READER_TCP) / 1e3, "kB");
+}
@@ -0,0 +1,234 @@
+/*
+  test_serialout.cpp - serial output lanes shared by every producer
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include "serialout.h"
+
+//nothing queued or expected by previous test
+static void reset_out()
+{
+    serial_out.hold(false);
+    serial_out.raw(false);
+    Serial.room = 128;
+    serial_out.flush();
+    Serial.tx.clear();
+    tline_event wait;
+    wait.type = LINE_WAIT;
+    serial_out.check_response(wait);
+}
+
+static void queue(const char * text, tserial_priority prio)
+{
+    serial_out.queue((const uint8_t *)text, strlen(text), prio);
+}
+
+static void ok()
+{
+    char line[] = "ok";
+    tline_event event;
+    event.type = LINE_OK;
+    event.line = line;
+    event.length = 2;
+    event.payload = line + 2;
+    event.has_temperature = false;
+    serial_out.check_response(event);
+}
+
+TEST(realtime_first)
+{
+    reset_out();
+    Serial.room = 0;
+    queue("G28\n", PRIO_INTERACTIVE);
+    queue("G1 X1\n", PRIO_BULK);
+    CHECK(serial_out.command("M112"));
+    CHECK(serial_out.command("N5 M410"));
+    Serial.room = 128;
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "M112\nN5 M410\nG28\nG1 X1\n");
+}
+
+TEST(is_realtime)
+{
+    CHECK(SERIALOUT_CLASS::is_realtime("M112"));
+    CHECK(SERIALOUT_CLASS::is_realtime("  m108 "));
+    CHECK(SERIALOUT_CLASS::is_realtime("N12 M410*33"));
+    CHECK(!SERIALOUT_CLASS::is_realtime("M1120"));
+    CHECK(!SERIALOUT_CLASS::is_realtime("M11"));
+    CHECK(!SERIALOUT_CLASS::is_realtime("G1 M112"));
+    CHECK(!SERIALOUT_CLASS::is_realtime(""));
+}
+
+//a line started by one lane is finished before another lane writes
+TEST(lines_not_mixed)
+{
+    reset_out();
+    Serial.room = 0;
+    queue("G1 X", PRIO_INTERACTIVE);
+    Serial.room = 128;
+    serial_out.process();
+    queue("G1 Y2\n", PRIO_BULK);
+    queue("10\n", PRIO_INTERACTIVE);
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "G1 X10\nG1 Y2\n");
+}
+
+TEST(lanes_take_turns)
+{
+    reset_out();
+    Serial.room = 0;
+    //20 bytes each
+    for (int i = 0; i < 20; i++) {
+        queue("G1 X100.000 Y100.00\n", PRIO_INTERACTIVE);
+        queue("G1 X200.000 Y200.00\n", PRIO_BULK);
+    }
+    Serial.room = 128;
+    serial_out.flush();
+    std::string & tx = Serial.tx;
+    CHECK_EQUAL(tx.size(), 40 * 20);
+    //bulk gets its turn long before interactive lane is empty
+    size_t first_bulk = tx.find("X200");
+    size_t last_interactive = tx.rfind("X100");
+    CHECK(first_bulk < last_interactive);
+    CHECK(first_bulk <= SERIAL_OUT_QUANTUM + 20);
+}
+
+TEST(held_lane_waits)
+{
+    reset_out();
+    serial_out.hold(true);
+    queue("M105\n", PRIO_INTERACTIVE);
+    queue("G1 X1\n", PRIO_BULK);
+    CHECK(serial_out.command("M112"));
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "M112\nG1 X1\n");
+    CHECK_EQUAL(serial_out.pending(PRIO_INTERACTIVE), 5);
+    serial_out.hold(false);
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "M112\nG1 X1\nM105\n");
+}
+
+//restart or bridge flush during SD upload must not wait for held lane
+TEST(flush_while_held)
+{
+    reset_out();
+    serial_out.hold(true);
+    serial_out.println("M117 Restarting");
+    queue("G1 X1\n", PRIO_BULK);
+    serial_out.flush();
+    CHECK_STRING(Serial.tx.c_str(), "G1 X1\n");
+    CHECK(serial_out.pending(PRIO_INTERACTIVE) > 0);
+    CHECK_EQUAL(serial_out.pending(PRIO_BULK), 0);
+    serial_out.hold(false);
+    serial_out.flush();
+    CHECK_EQUAL(serial_out.pending(PRIO_INTERACTIVE), 0);
+    CHECK_STRING(Serial.tx.c_str(), "G1 X1\nM117 Restarting\r\n");
+}
+
+//held lane which is full refuses a line instead of cutting it
+TEST(held_lane_full)
+{
+    reset_out();
+    serial_out.hold(true);
+    char line[100];
+    memset(line, 'A', sizeof(line) - 1);
+    line[sizeof(line) - 1] = 0;
+    int taken = 0;
+    while (serial_out.command(line)) {
+        taken++;
+    }
+    CHECK_EQUAL(taken, SERIAL_OUT_QUEUE_SIZE / sizeof(line));
+    CHECK_EQUAL(serial_out.pending(PRIO_INTERACTIVE), taken * sizeof(line));
+    serial_out.hold(false);
+    serial_out.flush();
+}
+
+//printer answers lines in order, comments and empty lines get no ok
+TEST(oks_by_lane)
+{
+    reset_out();
+    queue("G28\n", PRIO_INTERACTIVE);
+    serial_out.process();
+    queue("; comment only\n\nG1 X1 ; move\n", PRIO_BULK);
+    serial_out.process();
+    queue("M105\n", PRIO_INTERACTIVE);
+    serial_out.process();
+    uint32_t interactive = serial_out.acks(PRIO_INTERACTIVE);
+    uint32_t bulk = serial_out.acks(PRIO_BULK);
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), PRIO_INTERACTIVE);
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), PRIO_BULK);
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), PRIO_INTERACTIVE);
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), NO_LANE);
+    CHECK_EQUAL(serial_out.acks(PRIO_INTERACTIVE) - interactive, 2);
+    CHECK_EQUAL(serial_out.acks(PRIO_BULK) - bulk, 1);
+}
+
+//raw data have UART alone, are never put in a line and get no ok
+TEST(raw_mode)
+{
+    reset_out();
+    Serial.room = 4;
+    queue("G1 X10\n", PRIO_INTERACTIVE);
+    serial_out.process();
+    serial_out.raw(true);
+    CHECK_EQUAL(serial_out.raw_room(), 0);
+    CHECK_EQUAL(serial_out.write_raw((const uint8_t *)"\x7e", 1), 0);
+    queue("M105\n", PRIO_INTERACTIVE);
+    queue("G1 Y2\n", PRIO_BULK);
+    CHECK(serial_out.command("M112"));
+    Serial.room = 128;
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "G1 X10\n");
+    CHECK_EQUAL(serial_out.write_raw((const uint8_t *)"\x7e\n\x01\n", 4), 4);
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "G1 X10\n\x7e\n\x01\n");
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), PRIO_INTERACTIVE);
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), NO_LANE);
+    serial_out.raw(false);
+    CHECK_EQUAL(serial_out.write_raw((const uint8_t *)"x", 1), 0);
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "G1 X10\n\x7e\n\x01\nM112\nM105\nG1 Y2\n");
+}
+
+//ok of tagged line is told apart from oks of other lines on same lane
+TEST(tagged_ok)
+{
+    reset_out();
+    Serial.room = 0;
+    queue("G28\n", PRIO_INTERACTIVE);
+    CHECK(serial_out.command("M105\r\n", PRIO_INTERACTIVE, 7));
+    queue("G1 X1\n", PRIO_INTERACTIVE);
+    Serial.room = 128;
+    serial_out.process();
+    CHECK_STRING(Serial.tx.c_str(), "G28\nM105\nG1 X1\n");
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), PRIO_INTERACTIVE);
+    CHECK_EQUAL(serial_out.acknowledged_tag(), 0);
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged_tag(), 7);
+    ok();
+    CHECK_EQUAL(serial_out.acknowledged(), PRIO_INTERACTIVE);
+    CHECK_EQUAL(serial_out.acknowledged_tag(), 0);
+}
@@ -0,0 +1,432 @@
+/*
+  test_tokenizer.cpp - printer line classification
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include "tokenizer.h"
+#include "serialout.h"
+#include <WiFiServer.h>
+#include <fstream>
+#include <sstream>
+
+//feed text at once, keep last event
+static int parse(TOKENIZER_CLASS & tokenizer, const char * text, tline_event & event)
+{
+    const uint8_t * data = (const uint8_t *)text;
+    size_t len = strlen(text);
+    int lines = 0;
+    tline_event e;
+    while (tokenizer.feed(data, len, e)) {
+        event = e;
+        lines++;
+    }
+    return lines;
+}
+
+static tline_type type_of(const char * line, uint8_t fw = MARLIN)
+{
+    harness_firmware = fw;
+    TOKENIZER_CLASS tokenizer;
+    tline_event event;
+    if (parse(tokenizer, line, event) != 1) {
+        return (tline_type) - 1;
+    }
+    return event.type;
+}
+
+TEST(classify_marlin)
+{
+    CHECK_EQUAL(type_of("ok\n"), LINE_OK);
+    CHECK_EQUAL(type_of(" T:21.33 /0.00 B:21.41 /0.00 @:0 B@:0\n"), LINE_TEMPERATURE);
+    CHECK_EQUAL(type_of("echo:busy: processing\n"), LINE_BUSY);
+    CHECK_EQUAL(type_of("echo:SD card ok\n"), LINE_STATUS);
+    CHECK_EQUAL(type_of("Error:Printer halted. kill() called!\n"), LINE_ERROR);
+    CHECK_EQUAL(type_of("Resend: 12\n"), LINE_RESEND);
+    CHECK_EQUAL(type_of("[ESP800]\n"), LINE_ESP_COMMAND);
+    CHECK_EQUAL(type_of("Begin file list\n"), LINE_OTHER);
+}
+
+TEST(classify_repetier)
+{
+    CHECK_EQUAL(type_of("ok 12\n", REPETIER), LINE_OK);
+    CHECK_EQUAL(type_of("wait\n", REPETIER), LINE_WAIT);
+    CHECK_EQUAL(type_of("busy:processing\n", REPETIER), LINE_BUSY);
+    CHECK_EQUAL(type_of("Info:Autolevel enabled\n", REPETIER), LINE_INFO);
+    CHECK_EQUAL(type_of("Status:Printing\n", REPETIER), LINE_STATUS);
+    CHECK_EQUAL(type_of("Resend:7\n", REPETIER), LINE_RESEND);
+    //not reported as errors
+    CHECK_EQUAL(type_of("Error:Format error\n", REPETIER), LINE_OTHER);
+    CHECK_EQUAL(type_of("Error:wait\n", REPETIER), LINE_OTHER);
+}
+
+TEST(classify_smoothie)
+{
+    CHECK_EQUAL(type_of("ok T:21.9 /0.0 @0 B:22.1 /0.0 @0\n", SMOOTHIEWARE), LINE_OK);
+    CHECK_EQUAL(type_of("error:Alarm lock\n", SMOOTHIEWARE), LINE_ERROR);
+    CHECK_EQUAL(type_of("info:Use $X to unlock\n", SMOOTHIEWARE), LINE_INFO);
+    CHECK_EQUAL(type_of("warning:Temperature took too long\n", SMOOTHIEWARE), LINE_STATUS);
+    //keywords of other firmwares are plain text
+    CHECK_EQUAL(type_of("Error:Alarm lock\n", SMOOTHIEWARE), LINE_OTHER);
+}
+
+TEST(payloads)
+{
+    harness_firmware = MARLIN;
+    TOKENIZER_CLASS tokenizer;
+    tline_event event;
+    parse(tokenizer, "Error:Line Number is not Last Line Number+1\n", event);
+    CHECK_STRING(event.payload, "Line Number is not Last Line Number+1");
+    parse(tokenizer, "Resend: 12\n", event);
+    CHECK_EQUAL(atoi(event.payload), 12);
+    parse(tokenizer, "echo:[ESP401]P=1 T=B V=0\n", event);
+    CHECK_EQUAL(event.type, LINE_ESP_COMMAND);
+    CHECK_STRING(event.payload, "401]P=1 T=B V=0");
+    //ok with temperatures is still ok, but has them
+    parse(tokenizer, "ok T:201.25 /210.00 B:59.84 /60.00 @:127 B@:0\n", event);
+    CHECK_EQUAL(event.type, LINE_OK);
+    CHECK(event.has_temperature);
+}
+
+TEST(lines_split_between_reads)
+{
+    harness_firmware = MARLIN;
+    TOKENIZER_CLASS tokenizer;
+    tline_event event;
+    CHECK_EQUAL(parse(tokenizer, "echo:busy: pro", event), 0);
+    CHECK_EQUAL(parse(tokenizer, "cessing\r\nok\r", event), 2);
+    CHECK_EQUAL(event.type, LINE_OK);
+    //\n after \r is an empty line, not reported
+    CHECK_EQUAL(parse(tokenizer, "\n", event), 0);
+}
+
+TEST(comments_binary_and_long_lines)
+{
+    harness_firmware = MARLIN;
+    TOKENIZER_CLASS tokenizer;
+    tline_event event;
+    parse(tokenizer, "M105 ; Error:not an error\n", event);
+    CHECK_STRING(event.line, "M105 ");
+    CHECK_EQUAL(event.type, LINE_OTHER);
+    //binary byte drops what was before it
+    parse(tokenizer, "garbage\x01ok\n", event);
+    CHECK_STRING(event.line, "ok");
+    //too short lines are ignored, except ok
+    CHECK_EQUAL(parse(tokenizer, "M1\n", event), 0);
+    char line[TOKENIZER_LINE_SIZE + 50];
+    memset(line, 'A', sizeof(line) - 2);
+    line[sizeof(line) - 2] = '\n';
+    line[sizeof(line) - 1] = 0;
+    CHECK_EQUAL(parse(tokenizer, line, event), 1);
+    CHECK_EQUAL(event.length, TOKENIZER_LINE_SIZE);
+}
+
+//[ESP commands found in data given by pieces
+static std::string marked(TOKENIZER_CLASS & tokenizer, const char * text, bool skip)
+{
+    const uint8_t * data = (const uint8_t *)text;
+    size_t len = strlen(text);
+    tline_event event;
+    std::string found;
+    while (skip ? tokenizer.feed_marked(data, len, event, '[') : tokenizer.feed(data, len, event)) {
+        if (event.type == LINE_ESP_COMMAND) {
+            found += std::string(event.line) + "|";
+        }
+    }
+    return found;
+}
+
+TEST(marked_lines_only)
+{
+    TOKENIZER_CLASS tokenizer;
+    CHECK(marked(tokenizer, "G1 X1\nG1 X2\n[ESP800]\nG1 X3\n", true) == "[ESP800]|");
+    //marker in line finished by next data, which has none
+    CHECK(marked(tokenizer, "G1 X1\n[ES", true).empty());
+    CHECK(marked(tokenizer, "P401]P=1\nG1 X2\nG1 X3\nG1", true) == "[ESP401]P=1|");
+    //line before marker was started without it
+    CHECK(marked(tokenizer, " X4 ", true).empty());
+    CHECK(marked(tokenizer, "[ESP420]\nG1\n", true) == "G1 X4 [ESP420]|");
+    //a binary byte in skipped lines does not matter
+    CHECK(marked(tokenizer, "G1\x01\nG2\n[ESP111]\r\n", true) == "[ESP111]|");
+}
+
+//same commands as feed() whatever way data is cut
+TEST(marked_same_as_feed)
+{
+    std::string stream;
+    for (int i = 0; i < 400; i++) {
+        char line[40];
+        snprintf(line, sizeof(line), (i % 37) ? "G1 X%d Y%d ;move\r\n" : "[ESP70%d]pos=%d\n", i % 10, i);
+        stream += line;
+    }
+    TOKENIZER_CLASS all;
+    std::string expected = marked(all, stream.c_str(), false);
+    CHECK(!expected.empty());
+    for (size_t block = 1; block < 300; block += 7) {
+        TOKENIZER_CLASS tokenizer;
+        std::string found;
+        for (size_t pos = 0; pos < stream.size(); pos += block) {
+            found += marked(tokenizer, stream.substr(pos, block).c_str(), true);
+        }
+        if (found != expected) {
+            CHECK_EQUAL(block, 0);
+            break;
+        }
+    }
+}
+
+static std::string load(const char * name)
+{
+    std::ifstream file(name, std::ios::binary);
+    std::stringstream s;
+    s << file.rdbuf();
+    return s.str();
+}
+
+//previous code: one String append per byte, line copied to check_command
+//which scanned it with indexOf for each keyword
+static String legacy_buffer;
+static bool legacy_previous_was_char = false;
+static bool legacy_iscomment = false;
+static size_t legacy_found = 0;
+
+static void legacy_check_command(String buffer)
+{
+    bool is_temp = (buffer.indexOf("T:") > -1) || (buffer.indexOf("B:") > -1);
+    uint8_t fw = harness_firmware;
+    if ((fw == REPETIER4DV) || (fw == REPETIER)) {
+        if ((buffer.indexOf("busy:") > -1) || buffer.startsWith("wait") || buffer.startsWith("ok")) {
+            return;
+        }
+    }
+    int error = buffer.indexOf((fw == SMOOTHIEWARE) ? "error:" : "Error:");
+    int info = buffer.indexOf((fw == SMOOTHIEWARE) ? "info:" : "Info:");
+    int status = buffer.indexOf((fw == SMOOTHIEWARE) ? "warning:" : (fw == MARLIN) ? "echo:" : "Status:");
+    int esp = buffer.indexOf("[ESP");
+    if (esp > -1) {
+        int esp2 = buffer.indexOf("]", esp);
+        if (esp2 > -1) {
+            String cmd = buffer.substring(esp + 4, esp2);
+            legacy_found += cmd.toInt() != 0;
+        }
+    }
+    if ((error > -1) && !((buffer.indexOf("Format error") != -1) || (buffer.indexOf("wait") == error + 6))) {
+        String ss = buffer.substring(error + 6);
+        ss.replace("\"", "");
+        ss.replace("'", "");
+        legacy_found += ss.length() > 0;
+    }
+    if (info > -1) {
+        String ss = buffer.substring(info + 5);
+        ss.replace("\"", "");
+        ss.replace("'", "");
+        legacy_found += ss.length() > 0;
+    }
+    if (status > -1) {
+        String ss = buffer.substring(status + 5);
+        ss.replace("\"", "");
+        ss.replace("'", "");
+        legacy_found += ss.length() > 0;
+    }
+    legacy_found += is_temp;
+}
+
+static void legacy_read_buffer_serial(uint8_t b)
+{
+    if (!legacy_previous_was_char) {
+        legacy_buffer = "";
+        legacy_iscomment = false;
+    }
+    if (char(b) == ';') {
+        legacy_iscomment = true;
+    }
+    if (isPrintable(b)) {
+        legacy_previous_was_char = true;
+        if (!legacy_iscomment) {
+            legacy_buffer += char(b);
+        }
+    } else {
+        legacy_previous_was_char = false;
+    }
+    if ((b == 13) || (b == 10)) {
+        legacy_iscomment = false;
+        if (legacy_buffer.length() > 3) {
+            legacy_check_command(legacy_buffer);
+        }
+    }
+}
+
+static size_t count_lines(const std::string & log)
+{
+    return std::count(log.begin(), log.end(), '\n');
+}
+
+//same log replayed many times, data comes by 64 bytes like UART reads
+static void replay(const char * name, uint8_t fw)
+{
+    std::string log = load(name);
+    CHECK(log.size() > 0);
+    if (log.empty()) {
+        return;
+    }
+    harness_firmware = fw;
+    const int rounds = 20000;
+    size_t lines = count_lines(log) * rounds;
+    TOKENIZER_CLASS tokenizer;
+    size_t events = 0;
+    harness_heap_reset();
+    double start = harness_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t pos = 0; pos < log.size(); pos += 64) {
+            const uint8_t * data = (const uint8_t *)log.data() + pos;
+            size_t len = std::min((size_t)64, log.size() - pos);
+            tline_event event;
+            while (tokenizer.feed(data, len, event)) {
+                events += event.type;
+            }
+        }
+    }
+    double elapsed = harness_seconds() - start;
+    harness_heap heap = harness_heap_get();
+    printf("  %s\n", name);
+    harness_report("tokenizer", lines / elapsed / 1e6, "M lines/s");
+    harness_report("tokenizer heap allocations", heap.allocations, "");
+    harness_heap_reset();
+    start = harness_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t pos = 0; pos < log.size(); pos++) {
+            legacy_read_buffer_serial(log[pos]);
+        }
+    }
+    elapsed = harness_seconds() - start;
+    heap = harness_heap_get();
+    harness_report("String + indexOf", lines / elapsed / 1e6, "M lines/s");
+    harness_report("String + indexOf heap allocations", heap.allocations, "");
+    harness_report("String + indexOf heap bytes per line", (double)heap.bytes / lines, "B");
+}
+
+BENCH(replay_marlin)
+{
+    replay("data/marlin.log", MARLIN);
+}
+
+BENCH(replay_repetier)
+{
+    replay("data/repetier.log", REPETIER);
+}
+
+BENCH(replay_smoothie)
+{
+    replay("data/smoothie.log", SMOOTHIEWARE);
+}
+
+//previous TCP to serial path: one read, one UART write and one String
+//append per byte, String copy given to check_command at end of line
+static String legacy_tcp;
+static bool legacy_tcp_char = false;
+static bool legacy_tcp_comment = false;
+
+static void legacy_check_tcp(String buffer)
+{
+    int esp = buffer.indexOf("[ESP");
+    if (esp > -1) {
+        legacy_found += (buffer.indexOf("]", esp) > -1);
+    }
+}
+
+static void legacy_read_buffer_tcp(uint8_t b)
+{
+    if (!legacy_tcp_char) {
+        legacy_tcp = "";
+        legacy_tcp_comment = false;
+    }
+    if (char(b) == ';') {
+        legacy_tcp_comment = true;
+    }
+    if (isPrintable(b)) {
+        legacy_tcp_char = true;
+        if (!legacy_tcp_comment) {
+            legacy_tcp += char(b);
+        }
+    } else {
+        legacy_tcp_char = false;
+    }
+    if ((b == 13) || (b == 10)) {
+        legacy_tcp_comment = false;
+        if (legacy_tcp.length() > 3) {
+            legacy_check_tcp(legacy_tcp);
+        }
+    }
+}
+
+//gcode sent by a host on data port, client writes by 1460 bytes segments
+BENCH(tcp_to_serial)
+{
+    std::string gcode;
+    for (int i = 0; gcode.size() < (4 << 20); i++) {
+        char line[60];
+        snprintf(line, sizeof(line), (i % 5000) ? "G1 X%d.%d Y%d.4 E%d.0321 ; perimeter\n" : "[ESP800]time=%d\n",
+                 i % 200, i % 10, i % 150, i);
+        gcode += line;
+    }
+    const size_t segment = 1460;
+    WiFiServer server(8888);
+    WiFiClient host = WiFiServer::connect(8888);
+    WiFiClient client = server.available();
+    Serial.room = 1 << 30;
+
+    legacy_found = 0;
+    double start = harness_seconds();
+    for (size_t pos = 0; pos < gcode.size(); pos += segment) {
+        host.write((const uint8_t *)gcode.data() + pos, std::min(segment, gcode.size() - pos));
+        while (client.available()) {
+            uint8_t data = client.read();
+            Serial.write(data);
+            legacy_read_buffer_tcp(data);
+        }
+        Serial.tx.clear();
+    }
+    double elapsed = harness_seconds() - start;
+    size_t legacy_commands = legacy_found;
+    harness_report("byte per byte", gcode.size() / elapsed / 1e6, "MB/s");
+
+    TOKENIZER_CLASS tokenizer;
+    size_t commands = 0;
+    uint8_t buf[TCP_TO_SERIAL_BLOCK];
+    start = harness_seconds();
+    for (size_t pos = 0; pos < gcode.size(); pos += segment) {
+        host.write((const uint8_t *)gcode.data() + pos, std::min(segment, gcode.size() - pos));
+        size_t len;
+        while ((len = client.available()) > 0) {
+            len = std::min(len, std::min(serial_out.room(PRIO_INTERACTIVE), sizeof(buf)));
+            len = client.read(buf, len);
+            serial_out.queue(buf, len, PRIO_INTERACTIVE);
+            const uint8_t * data = buf;
+            tline_event event;
+            while (tokenizer.feed_marked(data, len, event, '[')) {
+                commands += (event.type == LINE_ESP_COMMAND);
+            }
+            serial_out.process();
+        }
+        Serial.tx.clear();
+    }
+    elapsed = harness_seconds() - start;
+    harness_report("blocks, lines without [ skipped", gcode.size() / elapsed / 1e6, "MB/s");
+    CHECK(commands > 0);
+    CHECK_EQUAL(commands, legacy_commands);
+}
@@ -0,0 +1,238 @@
+/*
+  test_webserver.cpp - connection table and keep-alive of WebServer
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include <WebServer.h>
+#include <WiFiServer.h>
+#include <vector>
+
+static const char body[] = "{\"heater\":\"T\",\"temperature\":\"210.5\"}";
+
+static void get(WiFiClient & client, const char * uri, bool keep_alive = true, const char * version = "1.1")
+{
+    char request[200];
+    snprintf(request, sizeof(request), "GET %s HTTP/%s\r\nHost: esp3d\r\n%s\r\n", uri, version,
+             keep_alive ? "" : "Connection: close\r\n");
+    client.write((const uint8_t *)request, strlen(request));
+}
+
+//complete response read from client, empty if not all there yet
+static std::string response(WiFiClient & client, std::string & received)
+{
+    while (client.available()) {
+        received += (char)client.read();
+    }
+    size_t end = received.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        return "";
+    }
+    size_t length = 0;
+    size_t pos = received.find("Content-Length: ");
+    if ((pos != std::string::npos) && (pos < end)) {
+        length = atoi(received.c_str() + pos + 16);
+    }
+    if (received.size() < end + 4 + length) {
+        return "";
+    }
+    std::string answer = received.substr(0, end + 4 + length);
+    received.erase(0, answer.size());
+    return answer;
+}
+
+static bool has(const std::string & answer, const char * text)
+{
+    return answer.find(text) != std::string::npos;
+}
+
+struct test_server {
+    test_server() : server(80), served(0)
+    {
+        server.on("/status", HTTP_GET, [this]() {
+            served++;
+            server.send(200, "application/json", body);
+        });
+        server.begin();
+    }
+    WebServer server;
+    int served;
+};
+
+TEST(keep_alive_serves_several_requests)
+{
+    test_server t;
+    WiFiClient client = WiFiServer::connect(80);
+    std::string received;
+    for (int i = 0; i < 3; i++) {
+        get(client, "/status");
+        t.server.handleClient();
+        std::string answer = response(client, received);
+        CHECK(has(answer, "HTTP/1.1 200 OK"));
+        CHECK(has(answer, "Connection: keep-alive"));
+        CHECK(has(answer, body));
+    }
+    CHECK_EQUAL(t.served, 3);
+}
+
+TEST(close_is_honoured)
+{
+    test_server t;
+    WiFiClient client = WiFiServer::connect(80);
+    std::string received;
+    get(client, "/status", false);
+    t.server.handleClient();
+    CHECK(has(response(client, received), "Connection: close"));
+    //HTTP/1.0 without keep-alive
+    WiFiClient old = WiFiServer::connect(80);
+    get(old, "/status", true, "1.0");
+    t.server.handleClient();
+    std::string answer = response(old, received);
+    CHECK(has(answer, "HTTP/1.0 200 OK"));
+    CHECK(has(answer, "Connection: close"));
+}
+
+TEST(clients_are_served_by_turns)
+{
+    test_server t;
+    WiFiClient clients[HTTP_MAX_CLIENTS];
+    std::string received[HTTP_MAX_CLIENTS];
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+        clients[i] = WiFiServer::connect(80);
+        get(clients[i], "/status");
+    }
+    //one request per call
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+        t.server.handleClient();
+        CHECK_EQUAL(t.served, i + 1);
+    }
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+        CHECK(has(response(clients[i], received[i]), body));
+    }
+}
+
+TEST(silent_client_does_not_block_others)
+{
+    test_server t;
+    WiFiClient silent = WiFiServer::connect(80);
+    t.server.handleClient();
+    WiFiClient client = WiFiServer::connect(80);
+    std::string received;
+    get(client, "/status");
+    t.server.handleClient();
+    CHECK(has(response(client, received), body));
+    //silent one is dropped after HTTP_MAX_DATA_WAIT, then request is not read
+    delay(HTTP_MAX_DATA_WAIT + 1);
+    t.server.handleClient();
+    get(silent, "/status");
+    t.server.handleClient();
+    CHECK_EQUAL(t.served, 1);
+}
+
+TEST(new_client_takes_slot_of_idle_one)
+{
+    test_server t;
+    WiFiClient clients[HTTP_MAX_CLIENTS + 1];
+    std::string received;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+        clients[i] = WiFiServer::connect(80);
+        get(clients[i], "/status");
+        t.server.handleClient();
+        CHECK(has(response(clients[i], received), body));
+        delay(10);
+    }
+    //every slot has an idle persistent connection, oldest one is dropped
+    clients[HTTP_MAX_CLIENTS] = WiFiServer::connect(80);
+    get(clients[HTTP_MAX_CLIENTS], "/status");
+    t.server.handleClient();
+    CHECK(has(response(clients[HTTP_MAX_CLIENTS], received), body));
+    get(clients[0], "/status");
+    get(clients[1], "/status");
+    t.server.handleClient();
+    t.server.handleClient();
+    CHECK(response(clients[0], received).empty());
+    CHECK(has(response(clients[1], received), body));
+}
+
+//round trip of a TCP handshake over WiFi, in virtual ms
+#define HANDSHAKE_MS 5
+
+//clients send again as soon as they get their answer, like a browser
+//loading assets, loop() calls handleClient() once per virtual ms
+//host CPU shows cost of serving, virtual time cost of new connections
+static void load(int nb_clients, bool keep_alive)
+{
+    test_server t;
+    std::vector<WiFiClient> clients(nb_clients);
+    std::vector<std::string> received(nb_clients);
+    std::vector<bool> waiting(nb_clients, false);
+    std::vector<unsigned long> ready(nb_clients, 0);
+    const int total = 20000;
+    int answered = 0;
+    int connections = 0;
+    harness_heap_reset();
+    double start = harness_seconds();
+    unsigned long virtual_start = millis();
+    while (answered < total) {
+        for (int i = 0; i < nb_clients; i++) {
+            if (!waiting[i]) {
+                if (!clients[i]) {
+                    clients[i] = WiFiServer::connect(80);
+                    ready[i] = millis() + HANDSHAKE_MS;
+                    connections++;
+                }
+                if (millis() < ready[i]) {
+                    continue;
+                }
+                get(clients[i], "/status", keep_alive);
+                waiting[i] = true;
+            }
+        }
+        t.server.handleClient();
+        delay(1);
+        for (int i = 0; i < nb_clients; i++) {
+            std::string answer = waiting[i] ? response(clients[i], received[i]) : "";
+            if (!answer.empty()) {
+                answered++;
+                waiting[i] = false;
+                //also after HTTP_MAX_KEEPALIVE_REQUESTS
+                if (has(answer, "Connection: close")) {
+                    clients[i].stop();
+                }
+            }
+        }
+    }
+    double elapsed = harness_seconds() - start;
+    double virtual_elapsed = (millis() - virtual_start) / 1000.0;
+    harness_heap heap = harness_heap_get();
+    char name[80];
+    snprintf(name, sizeof(name), "%d client%s, %s", nb_clients, (nb_clients > 1) ? "s" : "",
+             keep_alive ? "keep-alive" : "close");
+    harness_report(name, answered / elapsed, "requests/s");
+    harness_report("  virtual time", answered / virtual_elapsed, "requests/s");
+    harness_report("  connections", connections, "");
+    harness_report("  heap allocations per request", (double)heap.allocations / answered, "");
+}
+
+BENCH(requests_per_second)
+{
+    load(1, true);
+    load(1, false);
+    load(HTTP_MAX_CLIENTS, true);
+    load(HTTP_MAX_CLIENTS, false);
+}
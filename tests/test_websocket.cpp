@@ -0,0 +1,255 @@
+/*
+  test_websocket.cpp - WebSocket handshake and frames against a loopback client
+
+  Copyright (c) 2014 Luc Lebosse. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "harness.h"
+#include <WebServer.h>
+#include <WebSocket.h>
+#include <WiFiServer.h>
+
+static const uint8_t client_mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+//frame as a browser sends it, masked
+static std::string frame(uint8_t opcode, const std::string & payload, bool fin = true, bool masked = true)
+{
+    std::string f;
+    f += (char)((fin ? 0x80 : 0) | opcode);
+    uint8_t mask_bit = masked ? 0x80 : 0;
+    if (payload.size() < 126) {
+        f += (char)(mask_bit | payload.size());
+    } else if (payload.size() < 65536) {
+        f += (char)(mask_bit | 126);
+        f += (char)(payload.size() >> 8);
+        f += (char)(payload.size() & 0xff);
+    } else {
+        f += (char)(mask_bit | 127);
+        for (int i = 7; i >= 0; i--) {
+            f += (char)((uint64_t)payload.size() >> (8 * i));
+        }
+    }
+    if (masked) {
+        f.append((const char *)client_mask, 4);
+    }
+    for (size_t i = 0; i < payload.size(); i++) {
+        f += (char)(payload[i] ^ (masked ? client_mask[i & 3] : 0));
+    }
+    return f;
+}
+
+//frame sent by server, false if not complete
+static bool server_frame(std::string & received, uint8_t & opcode, std::string & payload)
+{
+    if (received.size() < 2) {
+        return false;
+    }
+    const uint8_t * p = (const uint8_t *)received.data();
+    size_t len = p[1] & 0x7f;
+    size_t pos = 2;
+    if (len == 126) {
+        len = (p[2] << 8) | p[3];
+        pos = 4;
+    } else if (len == 127) {
+        len = 0;
+        for (int i = 0; i < 8; i++) {
+            len = (len << 8) | p[2 + i];
+        }
+        pos = 10;
+    }
+    if (received.size() < pos + len) {
+        return false;
+    }
+    opcode = p[0] & 0x0f;
+    payload = received.substr(pos, len);
+    received.erase(0, pos + len);
+    return true;
+}
+
+static std::string take(WiFiClient & client)
+{
+    std::string s;
+    while (client.available()) {
+        s += (char)client.read();
+    }
+    return s;
+}
+
+static void send(WiFiClient & client, const std::string & data)
+{
+    client.write((const uint8_t *)data.data(), data.size());
+}
+
+struct ws_server {
+    ws_server() : server(80), accepted(false)
+    {
+        server.on("/ws", HTTP_GET, [this]() {
+            accepted = ws.accept(server);
+        });
+        server.begin();
+    }
+    //open connection and upgrade it
+    WiFiClient open(const char * version = "13", const char * upgrade = "websocket")
+    {
+        WiFiClient client = WiFiServer::connect(80);
+        char request[300];
+        snprintf(request, sizeof(request), "GET /ws HTTP/1.1\r\nHost: esp3d\r\nUpgrade: %s\r\n"
+                 "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                 "Sec-WebSocket-Version: %s\r\n\r\n", upgrade, version);
+        send(client, request);
+        server.handleClient();
+        handshake = take(client);
+        return client;
+    }
+    WebServer server;
+    WebSocket ws;
+    bool accepted;
+    std::string handshake;
+};
+
+TEST(accept_key_of_rfc_6455)
+{
+    CHECK_STRING(WebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST(upgrade)
+{
+    ws_server t;
+    t.open();
+    CHECK(t.accepted);
+    CHECK(t.handshake.find("HTTP/1.1 101 Switching Protocols\r\n") == 0);
+    CHECK(t.handshake.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    CHECK(t.ws.connected());
+}
+
+TEST(upgrade_refused)
+{
+    ws_server t;
+    t.open("8");
+    CHECK(!t.accepted);
+    CHECK(t.handshake.find("426") != std::string::npos);
+    CHECK(t.handshake.find("Sec-WebSocket-Version: 13") != std::string::npos);
+    t.open("13", "h2c");
+    CHECK(!t.accepted);
+    CHECK(t.handshake.find("400") != std::string::npos);
+}
+
+TEST(masked_messages)
+{
+    ws_server t;
+    WiFiClient client = t.open();
+    send(client, frame(WS_TEXT, "M105"));
+    CHECK(t.ws.poll());
+    CHECK_EQUAL(t.ws.opcode(), WS_TEXT);
+    CHECK(std::string((const char *)t.ws.data(), t.ws.length()) == "M105");
+    CHECK(!t.ws.poll());
+    //length on 16 bits
+    std::string long_text(300, 'g');
+    send(client, frame(WS_BINARY, long_text));
+    CHECK(t.ws.poll());
+    CHECK_EQUAL(t.ws.opcode(), WS_BINARY);
+    CHECK(std::string((const char *)t.ws.data(), t.ws.length()) == long_text);
+}
+
+TEST(frame_given_byte_per_byte)
+{
+    ws_server t;
+    WiFiClient client = t.open();
+    std::string f = frame(WS_TEXT, "G28 X Y");
+    bool ready = false;
+    for (size_t i = 0; i < f.size(); i++) {
+        CHECK(!ready);
+        send(client, f.substr(i, 1));
+        ready = t.ws.poll();
+    }
+    CHECK(ready);
+    CHECK(std::string((const char *)t.ws.data(), t.ws.length()) == "G28 X Y");
+}
+
+TEST(fragments_and_ping_between)
+{
+    ws_server t;
+    WiFiClient client = t.open();
+    send(client, frame(WS_TEXT, "G1 X", false) + frame(WS_PING, "hello") + frame(WS_CONTINUATION, "10"));
+    CHECK(t.ws.poll());
+    CHECK(std::string((const char *)t.ws.data(), t.ws.length()) == "G1 X10");
+    std::string received = take(client);
+    uint8_t opcode;
+    std::string payload;
+    CHECK(server_frame(received, opcode, payload));
+    CHECK_EQUAL(opcode, WS_PONG);
+    CHECK(payload == "hello");
+}
+
+TEST(server_frames)
+{
+    ws_server t;
+    WiFiClient client = t.open();
+    std::string sizes[3] = {std::string(5, 'a'), std::string(200, 'b'), std::string(70000, 'c')};
+    for (int i = 0; i < 3; i++) {
+        CHECK(t.ws.send((const uint8_t *)sizes[i].data(), sizes[i].size(), WS_TEXT));
+    }
+    std::string received = take(client);
+    for (int i = 0; i < 3; i++) {
+        uint8_t opcode;
+        std::string payload;
+        CHECK(server_frame(received, opcode, payload));
+        CHECK_EQUAL(opcode, WS_TEXT);
+        CHECK(payload == sizes[i]);
+    }
+    //server frames are never masked
+    t.ws.sendText("ok");
+    received = take(client);
+    CHECK_EQUAL((uint8_t)received[1], 2);
+}
+
+TEST(protocol_errors_close)
+{
+    ws_server t;
+    WiFiClient client = t.open();
+    send(client, frame(WS_TEXT, "M105", true, false));
+    CHECK(!t.ws.poll());
+    CHECK(!t.ws.connected());
+    std::string received = take(client);
+    uint8_t opcode;
+    std::string payload;
+    CHECK(server_frame(received, opcode, payload));
+    CHECK_EQUAL(opcode, WS_CLOSE);
+    CHECK_EQUAL(((uint8_t)payload[0] << 8) | (uint8_t)payload[1], 1002);
+
+    client = t.open();
+    send(client, frame(WS_TEXT, std::string(WEBSOCKET_MAX_MESSAGE + 1, 'x')));
+    CHECK(!t.ws.poll());
+    received = take(client);
+    CHECK(server_frame(received, opcode, payload));
+    CHECK_EQUAL(((uint8_t)payload[0] << 8) | (uint8_t)payload[1], 1009);
+}
+
+TEST(close_is_echoed)
+{
+    ws_server t;
+    WiFiClient client = t.open();
+    send(client, frame(WS_CLOSE, std::string("\x03\xe8", 2)));
+    CHECK(!t.ws.poll());
+    CHECK(!t.ws.connected());
+    std::string received = take(client);
+    uint8_t opcode;
+    std::string payload;
+    CHECK(server_frame(received, opcode, payload));
+    CHECK_EQUAL(opcode, WS_CLOSE);
+    CHECK(payload == std::string("\x03\xe8", 2));
+}